@@ -28,7 +28,9 @@
 
 #include <set>
 #include <unordered_set>
+#include <unordered_map>
 #include <queue>
+#include <deque>
 #include <mutex>
 #include <tuple>
 #include <boost/serialization/vector.hpp>
@@ -58,16 +60,31 @@ public:
         ScaleRefinement = 3
     };
 
+    // Images are shared with the KeyFrame, not copied. They are left empty, as are the
+    // keypoints and the file name, once the Gaussian mapper has taken the keyframe in
+    // (KeyFrame::mbSentToGaussianMapping, set by the mapper): pose-only update
+    typedef std::tuple<
+        unsigned long/*Id*/,
+        unsigned long/*CameraId*/,
+        Sophus::SE3f/*pose*/,
+        cv::Mat/*image*/,
+        bool/*isLoopClosure*/,
+        cv::Mat/*auxiliaryImage*/,
+        std::vector<float>/*keypoints pixel*/,
+        std::vector<float>/*keypoints local 3D*/,
+        std::string/*main image file name*/,
+        KeyFrame*/*source, marked by the mapper once taken in*/> KeyFrameEntry;
+
 private:
     MappingOperation(
-        const MappingOperation &opr,
+        MappingOperation &&opr,
         const std::lock_guard<std::mutex> &,
         const std::lock_guard<std::mutex> &)
-        : mvAssociatedKeyFrames(std::move(opr.mvAssociatedKeyFrames)),
-          mvAssociatedMapPoints(std::move(opr.mvAssociatedMapPoints)),
-          meOperationType(opr.meOperationType),
+        : meOperationType(opr.meOperationType),
           mfScale(opr.mfScale),
-          mT(opr.mT)
+          mT(opr.mT),
+          mvAssociatedMapPoints(std::move(opr.mvAssociatedMapPoints)),
+          mvAssociatedKeyFrames(std::move(opr.mvAssociatedKeyFrames))
     {}
 
 public:
@@ -87,13 +104,16 @@ public:
         std::get<1>(mvAssociatedMapPoints).reserve(length);
     }
 
-    MappingOperation(const MappingOperation &opr)
+    MappingOperation(MappingOperation &&opr)
         : MappingOperation(
-            opr,
+            std::move(opr),
             std::lock_guard<std::mutex>(opr.mMutexKeyFrames),
             std::lock_guard<std::mutex>(opr.mMutexMapPoints))
     {}
 
+    MappingOperation(const MappingOperation &) = delete;
+    MappingOperation& operator=(const MappingOperation &) = delete;
+
 public:
     void reserveKeyFrames(const std::size_t nKFs)
     {
@@ -103,33 +123,44 @@ public:
     void addKeyFrame(KeyFrame* pKF, bool isLoopClosureKF = false)
     {
         std::unique_lock<std::mutex> lock(mMutexKeyFrames);
-        std::vector<float> pixels;
-        std::vector<float> pointsLocal;
-        pKF->GetKeypointInfo(pixels, pointsLocal);
-        mvAssociatedKeyFrames.emplace_back(
-            std::make_tuple(
+        // Until the mapper has the keyframe, every operation carries it in full,
+        // so that a dropped or merged away operation does not lose it
+        if (pKF->mbSentToGaussianMapping.load()) {
+            mvAssociatedKeyFrames.emplace_back(
                 pKF->mnId,
                 pKF->mpCamera->GetId(),
                 pKF->GetPose(),
-                pKF->imgLeftRGB.clone(),
+                cv::Mat(),
                 isLoopClosureKF,
-                pKF->imgAuxiliary,
-                pixels,
-                pointsLocal,
-                pKF->mNameFile));
+                cv::Mat(),
+                std::vector<float>(),
+                std::vector<float>(),
+                std::string(),
+                pKF);
+            return;
+        }
+        std::vector<float> pixels;
+        std::vector<float> pointsLocal;
+        pKF->GetKeypointInfo(pixels, pointsLocal);
+        mvAssociatedKeyFrames.emplace_back(
+            pKF->mnId,
+            pKF->mpCamera->GetId(),
+            pKF->GetPose(),
+            pKF->imgLeftRGB,
+            isLoopClosureKF,
+            pKF->imgAuxiliary,
+            std::move(pixels),
+            std::move(pointsLocal),
+            pKF->mNameFile,
+            pKF);
     }
 
-    std::vector<std::tuple<
-        unsigned long,
-        unsigned long,
-        Sophus::SE3f,
-        cv::Mat,
-        bool,
-        cv::Mat,
-        std::vector<float>,
-        std::vector<float>,
-        std::string>>&
-    associatedKeyFrames() { return mvAssociatedKeyFrames; }
+    static bool isPoseOnly(const KeyFrameEntry &entry)
+    {
+        return std::get<3>(entry).empty();
+    }
+
+    std::vector<KeyFrameEntry>& associatedKeyFrames() { return mvAssociatedKeyFrames; }
 
     void reserveMapPoints(const std::size_t nMPs)
     {
@@ -154,6 +185,36 @@ public:
     std::tuple<std::vector<float/*pos*/>, std::vector<float/*color*/>>&
     associatedMapPoints() { return mvAssociatedMapPoints; }
 
+    // Fold a later LocalMappingBA into this one: latest poses win, images are kept, points are appended
+    void mergeLater(MappingOperation &&later)
+    {
+        std::lock_guard<std::mutex> lock_kfs(mMutexKeyFrames), lock_later_kfs(later.mMutexKeyFrames);
+        std::lock_guard<std::mutex> lock_mps(mMutexMapPoints), lock_later_mps(later.mMutexMapPoints);
+
+        std::unordered_map<unsigned long, std::size_t> index;
+        for (std::size_t i = 0; i < mvAssociatedKeyFrames.size(); ++i)
+            index[std::get<0>(mvAssociatedKeyFrames[i])] = i;
+        for (auto &entry : later.mvAssociatedKeyFrames) {
+            auto it = index.find(std::get<0>(entry));
+            if (it == index.end()) {
+                index[std::get<0>(entry)] = mvAssociatedKeyFrames.size();
+                mvAssociatedKeyFrames.emplace_back(std::move(entry));
+                continue;
+            }
+            KeyFrameEntry &kept = mvAssociatedKeyFrames[it->second];
+            bool isLoopClosureKF = std::get<4>(kept) || std::get<4>(entry);
+            std::get<2>(kept) = std::get<2>(entry);
+            if (!isPoseOnly(entry))
+                kept = std::move(entry);
+            std::get<4>(kept) = isLoopClosureKF;
+        }
+
+        auto &points = std::get<0>(mvAssociatedMapPoints), &colors = std::get<1>(mvAssociatedMapPoints);
+        auto &later_points = std::get<0>(later.mvAssociatedMapPoints), &later_colors = std::get<1>(later.mvAssociatedMapPoints);
+        points.insert(points.end(), later_points.begin(), later_points.end());
+        colors.insert(colors.end(), later_colors.begin(), later_colors.end());
+    }
+
 public:
     // Type
     OprType meOperationType;
@@ -167,16 +228,7 @@ protected:
     std::tuple<std::vector<float/*pos*/>,
                std::vector<float/*color*/>> mvAssociatedMapPoints;
 
-    std::vector<std::tuple<
-        unsigned long/*Id*/,
-        unsigned long/*CameraId*/,
-        Sophus::SE3f/*pose*/,
-        cv::Mat/*image*/,
-        bool/*isLoopClosure*/,
-        cv::Mat/*auxiliaryImage*/,
-        std::vector<float>/*keypoints pixel*/,
-        std::vector<float>/*keypoints local 3D*/,
-        std::string/*main image file name*/>> mvAssociatedKeyFrames;
+    std::vector<KeyFrameEntry> mvAssociatedKeyFrames;
 
     // Mutex
     mutable std::mutex mMutexMapPoints;
@@ -277,13 +329,16 @@ public:
 
     long unsigned int GetNumLivedMP();
 
-    void pushMappingOperation(MappingOperation opr);
+    void pushMappingOperation(MappingOperation &&opr);
     MappingOperation getAndPopMappingOperation();
     bool hasMappingOperation();
     void clearMappingOperation();
+    void setMappingOperationCapacity(std::size_t capacity);
 
 protected:
-    std::queue<MappingOperation> mqMappingOperations;
+    std::deque<MappingOperation> mqMappingOperations;
+    // Beyond this, a LocalMappingBA is merged into the last one instead of queued
+    std::size_t mnMappingOperationCapacity = 16;
 
     std::set<Map*> mspMaps;
     std::set<Map*> mspBadMaps;
@@ -33,6 +33,7 @@
 #include "SerializationUtils.h"
 
 #include <mutex>
+#include <atomic>
 
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/vector.hpp>
@@ -429,6 +430,8 @@ public:
     // RGB Image
     // -- Useless in ORB-SLAM3 but useful in Gaussian Mapping
     cv::Mat imgLeftRGB, imgAuxiliary;
+    // -- Set by the Gaussian Mapping once it has taken the keyframe in, later operations only carry the pose
+    std::atomic<bool> mbSentToGaussianMapping{false};
 
     // The following variables need to be accessed trough a mutex to be thread safe.
 protected:
@@ -23,6 +23,8 @@
 #include "Pinhole.h"
 #include "KannalaBrandt8.h"
 
+#include <algorithm>
+
 namespace ORB_SLAM3
 {
 
@@ -419,17 +421,26 @@ map<long unsigned int, KeyFrame*> Atlas::GetAtlasKeyframes()
     return mpIdKFs;
 }
 
-void Atlas::pushMappingOperation(MappingOperation opr)
+void Atlas::pushMappingOperation(MappingOperation &&opr)
 {
     std::unique_lock<std::mutex> lock(mMutexMappingOperations);
-    this->mqMappingOperations.push(opr);
+    // Backpressure without stalling the local mapping: when the Gaussian Mapping falls behind,
+    // successive local BA results collapse into one operation carrying only the latest poses
+    if (mqMappingOperations.size() >= mnMappingOperationCapacity &&
+        opr.meOperationType == MappingOperation::OprType::LocalMappingBA &&
+        mqMappingOperations.back().meOperationType == MappingOperation::OprType::LocalMappingBA)
+    {
+        mqMappingOperations.back().mergeLater(std::move(opr));
+        return;
+    }
+    this->mqMappingOperations.emplace_back(std::move(opr));
 }
 
 MappingOperation Atlas::getAndPopMappingOperation()
 {
     std::unique_lock<std::mutex> lock(mMutexMappingOperations);
-    MappingOperation opr = this->mqMappingOperations.front();
-    mqMappingOperations.pop();
+    MappingOperation opr(std::move(this->mqMappingOperations.front()));
+    mqMappingOperations.pop_front();
     return opr;
 }
 
@@ -442,8 +453,13 @@ bool Atlas::hasMappingOperation()
 void Atlas::clearMappingOperation()
 {
     std::unique_lock<std::mutex> lock(mMutexMappingOperations);
-    while (!mqMappingOperations.empty())
-        mqMappingOperations.pop();
+    mqMappingOperations.clear();
+}
+
+void Atlas::setMappingOperationCapacity(std::size_t capacity)
+{
+    std::unique_lock<std::mutex> lock(mMutexMappingOperations);
+    mnMappingOperationCapacity = std::max<std::size_t>(capacity, 1);
 }
 
 } //namespace ORB_SLAM3
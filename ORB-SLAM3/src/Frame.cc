@@ -1033,10 +1033,10 @@ bool Frame::UnprojectStereo(const int &i, Eigen::Vector3f &x3D, Eigen::Vector3f
         const float vOri = mvKeys[i].pt.y;
         const int ui = static_cast<int>(std::round(uOri));
         const int vi = static_cast<int>(std::round(vOri));
-        const cv::Vec3f& color = this->imgLeftRGB.at<cv::Vec3f>(vi, ui);
-        colorRGB.x() = color[0];
-        colorRGB.y() = color[1];
-        colorRGB.z() = color[2];
+        const cv::Vec3b& color = this->imgLeftRGB.at<cv::Vec3b>(vi, ui);
+        colorRGB.x() = color[0] / 255.0f;
+        colorRGB.y() = color[1] / 255.0f;
+        colorRGB.z() = color[2] / 255.0f;
 
         return true;
     } else
@@ -768,10 +768,10 @@ bool KeyFrame::UnprojectStereo(int i, Eigen::Vector3f &x3D, Eigen::Vector3f &col
 
         const int ui = static_cast<int>(std::round(u));
         const int vi = static_cast<int>(std::round(v));
-        const cv::Vec3f& color = this->imgLeftRGB.at<cv::Vec3f>(vi, ui);
-        colorRGB.x() = color[0];
-        colorRGB.y() = color[1];
-        colorRGB.z() = color[2];
+        const cv::Vec3b& color = this->imgLeftRGB.at<cv::Vec3b>(vi, ui);
+        colorRGB.x() = color[0] / 255.0f;
+        colorRGB.y() = color[1] / 255.0f;
+        colorRGB.z() = color[2] / 255.0f;
 
         unique_lock<mutex> lock(mMutexPose);
         x3D = mRwc * x3Dc + mTwc.translation();
@@ -149,14 +149,14 @@ void LocalMapping::Run()
                         MappingOperation opr(MappingOperation::OprType::LocalMappingBA);
                         Optimizer::LocalInertialBA(mpCurrentKeyFrame, &mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, opr, bLarge, !mpCurrentKeyFrame->GetMap()->GetIniertialBA2());
                         b_doneLBA = true;
-                        mpAtlas->pushMappingOperation(opr);
+                        mpAtlas->pushMappingOperation(std::move(opr));
                     }
                     else
                     {
                         MappingOperation opr(MappingOperation::OprType::LocalMappingBA);
                         Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpCurrentKeyFrame->GetMap(),num_FixedKF_BA,num_OptKF_BA,num_MPs_BA,num_edges_BA, opr);
                         b_doneLBA = true;
-                        mpAtlas->pushMappingOperation(opr);
+                        mpAtlas->pushMappingOperation(std::move(opr));
                     }
 
                 }
@@ -594,10 +594,10 @@ void LocalMapping::CreateNewMapPoints()
                     const cv::KeyPoint &kp1Ori = mpCurrentKeyFrame->mvKeys[idx1];
                     const int u = static_cast<int>(std::round(kp1Ori.pt.x));
                     const int v = static_cast<int>(std::round(kp1Ori.pt.y));
-                    const auto& color = mpCurrentKeyFrame->imgLeftRGB.at<cv::Vec3f>(v, u);
-                    colorRGB.x() = color[0];
-                    colorRGB.y() = color[1];
-                    colorRGB.z() = color[2];
+                    const auto& color = mpCurrentKeyFrame->imgLeftRGB.at<cv::Vec3b>(v, u);
+                    colorRGB.x() = color[0] / 255.0f;
+                    colorRGB.y() = color[1] / 255.0f;
+                    colorRGB.z() = color[2] / 255.0f;
                 }
             }
             else if(bStereo1 && cosParallaxStereo1<cosParallaxStereo2)
@@ -1301,7 +1301,7 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA)
                 /*type=*/MappingOperation::OprType::ScaleRefinement,
                 /*scale=*/mScale,
                 /*T=*/Twg);
-            mpAtlas->pushMappingOperation(opr);
+            mpAtlas->pushMappingOperation(std::move(opr));
         }
 
         // Check if initialization OK
@@ -1502,7 +1502,7 @@ void LocalMapping::ScaleRefinement()
             /*type=*/MappingOperation::OprType::ScaleRefinement,
             /*scale=*/mScale,
             /*T=*/Tgw);
-        mpAtlas->pushMappingOperation(opr);
+        mpAtlas->pushMappingOperation(std::move(opr));
     }
     std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
 
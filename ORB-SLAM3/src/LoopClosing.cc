@@ -1198,7 +1198,7 @@ void LoopClosing::CorrectLoop()
     double timeOptEss = std::chrono::duration_cast<std::chrono::duration<double,std::milli> >(time_EndOpt - time_EndFusion).count();
     vdLoopOptEss_ms.push_back(timeOptEss);
 #endif
-    mpAtlas->pushMappingOperation(opr);
+    mpAtlas->pushMappingOperation(std::move(opr));
 
     mpAtlas->InformNewBigChange();
 
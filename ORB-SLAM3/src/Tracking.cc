@@ -1512,19 +1512,17 @@ Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat
         cvtColor(imGrayRight, imRightRGB, cv::COLOR_GRAY2RGB);
     }
 
-    if (mImRGB.type() == CV_8UC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0 / 255.0);
-    else if (mImRGB.type() == CV_16UC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0 / 65535.0);
-    else if (mImRGB.type() == CV_16FC3 || mImRGB.type() == CV_64FC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0);
-
-    if (imRightRGB.type() == CV_8UC3)
-        imRightRGB.convertTo(imRightRGB, CV_32FC3, 1.0 / 255.0);
-    else if (imRightRGB.type() == CV_16UC3)
-        imRightRGB.convertTo(imRightRGB, CV_32FC3, 1.0 / 65535.0);
-    else if (imRightRGB.type() == CV_16FC3 || imRightRGB.type() == CV_64FC3)
-        imRightRGB.convertTo(imRightRGB, CV_32FC3, 1.0);
+    // Colour is kept in 8 bits, the mapper converts it to float only when training needs it
+    if (mImRGB.type() == CV_16UC3)
+        mImRGB.convertTo(mImRGB, CV_8UC3, 255.0 / 65535.0);
+    else if (mImRGB.type() == CV_16FC3 || mImRGB.type() == CV_32FC3 || mImRGB.type() == CV_64FC3)
+        mImRGB.convertTo(mImRGB, CV_8UC3, 255.0);
+
+    // Colour is kept in 8 bits, the mapper converts it to float only when training needs it
+    if (imRightRGB.type() == CV_16UC3)
+        imRightRGB.convertTo(imRightRGB, CV_8UC3, 255.0 / 65535.0);
+    else if (imRightRGB.type() == CV_16FC3 || imRightRGB.type() == CV_32FC3 || imRightRGB.type() == CV_64FC3)
+        imRightRGB.convertTo(imRightRGB, CV_8UC3, 255.0);
 
     //cout << "Incoming frame creation" << endl;
 
@@ -1591,12 +1589,11 @@ Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, co
         cvtColor(mImGray, mImRGB, cv::COLOR_GRAY2RGB);
     }
 
-    if (mImRGB.type() == CV_8UC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0 / 255.0);
-    else if (mImRGB.type() == CV_16UC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0 / 65535.0);
-    else if (mImRGB.type() == CV_16FC3 || mImRGB.type() == CV_64FC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0);
+    // Colour is kept in 8 bits, the mapper converts it to float only when training needs it
+    if (mImRGB.type() == CV_16UC3)
+        mImRGB.convertTo(mImRGB, CV_8UC3, 255.0 / 65535.0);
+    else if (mImRGB.type() == CV_16FC3 || mImRGB.type() == CV_32FC3 || mImRGB.type() == CV_64FC3)
+        mImRGB.convertTo(mImRGB, CV_8UC3, 255.0);
 
     if((fabs(mDepthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
         imDepth.convertTo(imDepth,CV_32F,mDepthMapFactor);
@@ -1658,12 +1655,11 @@ Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &times
         cvtColor(mImGray, mImRGB, cv::COLOR_GRAY2RGB);
     }
 
-    if (mImRGB.type() == CV_8UC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0 / 255.0);
-    else if (mImRGB.type() == CV_16UC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0 / 65535.0);
-    else if (mImRGB.type() == CV_16FC3 || mImRGB.type() == CV_64FC3)
-        mImRGB.convertTo(mImRGB, CV_32FC3, 1.0);
+    // Colour is kept in 8 bits, the mapper converts it to float only when training needs it
+    if (mImRGB.type() == CV_16UC3)
+        mImRGB.convertTo(mImRGB, CV_8UC3, 255.0 / 65535.0);
+    else if (mImRGB.type() == CV_16FC3 || mImRGB.type() == CV_32FC3 || mImRGB.type() == CV_64FC3)
+        mImRGB.convertTo(mImRGB, CV_8UC3, 255.0);
 
     if (mSensor == System::MONOCULAR)
     {
@@ -2600,10 +2596,10 @@ void Tracking::MonocularInitialization()
                 {
                     const int u = static_cast<int>(std::round(mInitialFrame.mvKeys[i].pt.x));
                     const int v = static_cast<int>(std::round(mInitialFrame.mvKeys[i].pt.y));
-                    const auto& color = mInitialFrame.imgLeftRGB.at<cv::Vec3f>(v, u);
-                    mvIniColorRGB[i].x() = color[0];
-                    mvIniColorRGB[i].y() = color[1];
-                    mvIniColorRGB[i].z() = color[2];
+                    const auto& color = mInitialFrame.imgLeftRGB.at<cv::Vec3b>(v, u);
+                    mvIniColorRGB[i].x() = color[0] / 255.0f;
+                    mvIniColorRGB[i].y() = color[1] / 255.0f;
+                    mvIniColorRGB[i].z() = color[2] / 255.0f;
                 }
             }
 
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ *
+ * This file is Derivative Works of Gaussian Splatting,
+ * created by Longwei Li, Huajian Huang, Hui Cheng and Sai-Kit Yeung in 2023,
+ * as part of Photo-SLAM.
+ */
+
+#ifndef CPU_RASTERIZER_AUXILIARY_H_INCLUDED
+#define CPU_RASTERIZER_AUXILIARY_H_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <ATen/Parallel.h>
+
+#include "cuda_rasterizer/config.h"
+
+#define CPU_TILE_SIZE (BLOCK_X * BLOCK_Y)
+
+namespace CpuRasterizer
+{
+	// Host counterparts of the CUDA vector types, so that the math below
+	// stays a line-by-line port of cuda_rasterizer/forward.cu and backward.cu
+	struct float2 { float x, y; };
+	struct float3 { float x, y, z; };
+	struct float4 { float x, y, z, w; };
+	struct uint2 { uint32_t x, y; };
+	struct dim3 { uint32_t x, y, z; };
+
+	inline float3 operator+(const float3& a, const float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline float3 operator-(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline float3 operator*(float s, const float3& a) { return { s * a.x, s * a.y, s * a.z }; }
+	inline float3 operator*(const float3& a, float s) { return { s * a.x, s * a.y, s * a.z }; }
+	inline float3& operator+=(float3& a, const float3& b) { a.x += b.x; a.y += b.y; a.z += b.z; return a; }
+	inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	// Column-major 3x3 matrix, indexed as m[column][row] like glm::mat3
+	struct mat3
+	{
+		float m[3][3];
+		float* operator[](int c) { return m[c]; }
+		const float* operator[](int c) const { return m[c]; }
+	};
+
+	inline mat3 operator*(const mat3& a, const mat3& b)
+	{
+		mat3 r;
+		for (int c = 0; c < 3; c++)
+			for (int k = 0; k < 3; k++)
+				r[c][k] = a[0][k] * b[c][0] + a[1][k] * b[c][1] + a[2][k] * b[c][2];
+		return r;
+	}
+
+	inline mat3 transpose(const mat3& a)
+	{
+		return { { { a[0][0], a[1][0], a[2][0] },
+				   { a[0][1], a[1][1], a[2][1] },
+				   { a[0][2], a[1][2], a[2][2] } } };
+	}
+
+	// Spherical harmonics coefficients
+	constexpr float SH_C0 = 0.28209479177387814f;
+	constexpr float SH_C1 = 0.4886025119029199f;
+	constexpr float SH_C2[] = {
+		1.0925484305920792f,
+		-1.0925484305920792f,
+		0.31539156525252005f,
+		-1.0925484305920792f,
+		0.5462742152960396f
+	};
+	constexpr float SH_C3[] = {
+		-0.5900435899266435f,
+		2.890611442640554f,
+		-0.4570457994644658f,
+		0.3731763325901154f,
+		-0.4570457994644658f,
+		1.445305721320277f,
+		-0.5900435899266435f
+	};
+
+	inline float ndc2Pix(float v, int S)
+	{
+		return ((v + 1.0) * S - 1.0) * 0.5;
+	}
+
+	inline void getRect(const float2 p, int max_radius, uint2& rect_min, uint2& rect_max, dim3 grid)
+	{
+		rect_min = {
+			(uint32_t)std::min((int)grid.x, std::max((int)0, (int)((p.x - max_radius) / BLOCK_X))),
+			(uint32_t)std::min((int)grid.y, std::max((int)0, (int)((p.y - max_radius) / BLOCK_Y)))
+		};
+		rect_max = {
+			(uint32_t)std::min((int)grid.x, std::max((int)0, (int)((p.x + max_radius + BLOCK_X - 1) / BLOCK_X))),
+			(uint32_t)std::min((int)grid.y, std::max((int)0, (int)((p.y + max_radius + BLOCK_Y - 1) / BLOCK_Y)))
+		};
+	}
+
+	inline float3 transformPoint4x3(const float3& p, const float* matrix)
+	{
+		float3 transformed = {
+			matrix[0] * p.x + matrix[4] * p.y + matrix[8] * p.z + matrix[12],
+			matrix[1] * p.x + matrix[5] * p.y + matrix[9] * p.z + matrix[13],
+			matrix[2] * p.x + matrix[6] * p.y + matrix[10] * p.z + matrix[14],
+		};
+		return transformed;
+	}
+
+	inline float4 transformPoint4x4(const float3& p, const float* matrix)
+	{
+		float4 transformed = {
+			matrix[0] * p.x + matrix[4] * p.y + matrix[8] * p.z + matrix[12],
+			matrix[1] * p.x + matrix[5] * p.y + matrix[9] * p.z + matrix[13],
+			matrix[2] * p.x + matrix[6] * p.y + matrix[10] * p.z + matrix[14],
+			matrix[3] * p.x + matrix[7] * p.y + matrix[11] * p.z + matrix[15]
+		};
+		return transformed;
+	}
+
+	inline float3 transformVec4x3Transpose(const float3& p, const float* matrix)
+	{
+		float3 transformed = {
+			matrix[0] * p.x + matrix[1] * p.y + matrix[2] * p.z,
+			matrix[4] * p.x + matrix[5] * p.y + matrix[6] * p.z,
+			matrix[8] * p.x + matrix[9] * p.y + matrix[10] * p.z,
+		};
+		return transformed;
+	}
+
+	inline float3 dnormvdv(float3 v, float3 dv)
+	{
+		float sum2 = v.x * v.x + v.y * v.y + v.z * v.z;
+		float invsum32 = 1.0f / std::sqrt(sum2 * sum2 * sum2);
+
+		float3 dnormvdv;
+		dnormvdv.x = ((+sum2 - v.x * v.x) * dv.x - v.y * v.x * dv.y - v.z * v.x * dv.z) * invsum32;
+		dnormvdv.y = (-v.x * v.y * dv.x + (sum2 - v.y * v.y) * dv.y - v.z * v.y * dv.z) * invsum32;
+		dnormvdv.z = (-v.x * v.z * dv.x - v.y * v.z * dv.y + (sum2 - v.z * v.z) * dv.z) * invsum32;
+		return dnormvdv;
+	}
+
+	inline bool in_frustum(int idx,
+		const float* orig_points,
+		const float* viewmatrix,
+		float3& p_view)
+	{
+		float3 p_orig = { orig_points[3 * idx], orig_points[3 * idx + 1], orig_points[3 * idx + 2] };
+		p_view = transformPoint4x3(p_orig, viewmatrix);
+		return p_view.z > 0.2f;
+	}
+
+	/**
+	 * @brief Run `func(i)` for i in [begin, end) on the ATen intra-op thread pool.
+	 *
+	 * Work is handed out in chunks of `grain` from a shared counter, so uneven
+	 * per-item cost (e.g. crowded vs. empty tiles) balances itself out; the
+	 * pool only starts the `num_threads` workers pulling from it.
+	 */
+	template <typename Func>
+	void parallelFor(int begin, int end, int grain, int num_threads, Func&& func)
+	{
+		const int n = end - begin;
+		if (n <= 0)
+			return;
+		grain = std::max(1, grain);
+		const int num_chunks = (n + grain - 1) / grain;
+		num_threads = std::max(1, std::min(num_threads, num_chunks));
+
+		std::atomic<int> next_chunk(0);
+		auto worker = [&]() {
+			int chunk;
+			while ((chunk = next_chunk.fetch_add(1, std::memory_order_relaxed)) < num_chunks)
+			{
+				const int chunk_end = std::min(end, begin + (chunk + 1) * grain);
+				for (int i = begin + chunk * grain; i < chunk_end; i++)
+					func(i);
+			}
+		};
+
+		if (num_threads == 1)
+		{
+			worker();
+			return;
+		}
+		at::parallel_for(0, num_threads, 1, [&](int64_t worker_begin, int64_t worker_end) {
+			for (int64_t w = worker_begin; w < worker_end; w++)
+				worker();
+		});
+	}
+}
+
+#endif
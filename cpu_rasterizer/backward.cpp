@@ -0,0 +1,628 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ *
+ * This file is Derivative Works of Gaussian Splatting,
+ * created by Longwei Li, Huajian Huang, Hui Cheng and Sai-Kit Yeung in 2023,
+ * as part of Photo-SLAM.
+ */
+
+#include "backward.h"
+#include "forward.h"
+#include "auxiliary.h"
+
+namespace CpuRasterizer
+{
+
+// Backward pass for conversion of spherical harmonics to RGB for
+// each Gaussian.
+static void computeColorFromSH(int idx, int deg, int max_coeffs, const float3* means, float3 campos, const float* shs, const bool* clamped, const float3* dL_dcolor, float3* dL_dmeans, float3* dL_dshs)
+{
+	// Compute intermediate values, as it is done during forward
+	float3 pos = means[idx];
+	float3 dir_orig = pos - campos;
+	float3 dir = dir_orig * (1.0f / std::sqrt(dot(dir_orig, dir_orig)));
+
+	const float3* sh = ((const float3*)shs) + idx * max_coeffs;
+
+	// Use PyTorch rule for clamping: if clamping was applied,
+	// gradient becomes 0.
+	float3 dL_dRGB = dL_dcolor[idx];
+	dL_dRGB.x *= clamped[3 * idx + 0] ? 0 : 1;
+	dL_dRGB.y *= clamped[3 * idx + 1] ? 0 : 1;
+	dL_dRGB.z *= clamped[3 * idx + 2] ? 0 : 1;
+
+	float3 dRGBdx = { 0, 0, 0 };
+	float3 dRGBdy = { 0, 0, 0 };
+	float3 dRGBdz = { 0, 0, 0 };
+	float x = dir.x;
+	float y = dir.y;
+	float z = dir.z;
+
+	// Target location for this Gaussian to write SH gradients to
+	float3* dL_dsh = dL_dshs + idx * max_coeffs;
+
+	// No tricks here, just high school-level calculus.
+	float dRGBdsh0 = SH_C0;
+	dL_dsh[0] = dRGBdsh0 * dL_dRGB;
+	if (deg > 0)
+	{
+		float dRGBdsh1 = -SH_C1 * y;
+		float dRGBdsh2 = SH_C1 * z;
+		float dRGBdsh3 = -SH_C1 * x;
+		dL_dsh[1] = dRGBdsh1 * dL_dRGB;
+		dL_dsh[2] = dRGBdsh2 * dL_dRGB;
+		dL_dsh[3] = dRGBdsh3 * dL_dRGB;
+
+		dRGBdx = -SH_C1 * sh[3];
+		dRGBdy = -SH_C1 * sh[1];
+		dRGBdz = SH_C1 * sh[2];
+
+		if (deg > 1)
+		{
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, yz = y * z, xz = x * z;
+
+			float dRGBdsh4 = SH_C2[0] * xy;
+			float dRGBdsh5 = SH_C2[1] * yz;
+			float dRGBdsh6 = SH_C2[2] * (2.f * zz - xx - yy);
+			float dRGBdsh7 = SH_C2[3] * xz;
+			float dRGBdsh8 = SH_C2[4] * (xx - yy);
+			dL_dsh[4] = dRGBdsh4 * dL_dRGB;
+			dL_dsh[5] = dRGBdsh5 * dL_dRGB;
+			dL_dsh[6] = dRGBdsh6 * dL_dRGB;
+			dL_dsh[7] = dRGBdsh7 * dL_dRGB;
+			dL_dsh[8] = dRGBdsh8 * dL_dRGB;
+
+			dRGBdx += SH_C2[0] * y * sh[4] + SH_C2[2] * 2.f * -x * sh[6] + SH_C2[3] * z * sh[7] + SH_C2[4] * 2.f * x * sh[8];
+			dRGBdy += SH_C2[0] * x * sh[4] + SH_C2[1] * z * sh[5] + SH_C2[2] * 2.f * -y * sh[6] + SH_C2[4] * 2.f * -y * sh[8];
+			dRGBdz += SH_C2[1] * y * sh[5] + SH_C2[2] * 2.f * 2.f * z * sh[6] + SH_C2[3] * x * sh[7];
+
+			if (deg > 2)
+			{
+				float dRGBdsh9 = SH_C3[0] * y * (3.f * xx - yy);
+				float dRGBdsh10 = SH_C3[1] * xy * z;
+				float dRGBdsh11 = SH_C3[2] * y * (4.f * zz - xx - yy);
+				float dRGBdsh12 = SH_C3[3] * z * (2.f * zz - 3.f * xx - 3.f * yy);
+				float dRGBdsh13 = SH_C3[4] * x * (4.f * zz - xx - yy);
+				float dRGBdsh14 = SH_C3[5] * z * (xx - yy);
+				float dRGBdsh15 = SH_C3[6] * x * (xx - 3.f * yy);
+				dL_dsh[9] = dRGBdsh9 * dL_dRGB;
+				dL_dsh[10] = dRGBdsh10 * dL_dRGB;
+				dL_dsh[11] = dRGBdsh11 * dL_dRGB;
+				dL_dsh[12] = dRGBdsh12 * dL_dRGB;
+				dL_dsh[13] = dRGBdsh13 * dL_dRGB;
+				dL_dsh[14] = dRGBdsh14 * dL_dRGB;
+				dL_dsh[15] = dRGBdsh15 * dL_dRGB;
+
+				dRGBdx += (
+					SH_C3[0] * sh[9] * 3.f * 2.f * xy +
+					SH_C3[1] * sh[10] * yz +
+					SH_C3[2] * sh[11] * -2.f * xy +
+					SH_C3[3] * sh[12] * -3.f * 2.f * xz +
+					SH_C3[4] * sh[13] * (-3.f * xx + 4.f * zz - yy) +
+					SH_C3[5] * sh[14] * 2.f * xz +
+					SH_C3[6] * sh[15] * 3.f * (xx - yy));
+
+				dRGBdy += (
+					SH_C3[0] * sh[9] * 3.f * (xx - yy) +
+					SH_C3[1] * sh[10] * xz +
+					SH_C3[2] * sh[11] * (-3.f * yy + 4.f * zz - xx) +
+					SH_C3[3] * sh[12] * -3.f * 2.f * yz +
+					SH_C3[4] * sh[13] * -2.f * xy +
+					SH_C3[5] * sh[14] * -2.f * yz +
+					SH_C3[6] * sh[15] * -3.f * 2.f * xy);
+
+				dRGBdz += (
+					SH_C3[1] * sh[10] * xy +
+					SH_C3[2] * sh[11] * 4.f * 2.f * yz +
+					SH_C3[3] * sh[12] * 3.f * (2.f * zz - xx - yy) +
+					SH_C3[4] * sh[13] * 4.f * 2.f * xz +
+					SH_C3[5] * sh[14] * (xx - yy));
+			}
+		}
+	}
+
+	// The view direction is an input to the computation. View direction
+	// is influenced by the Gaussian's mean, so SHs gradients
+	// must propagate back into 3D position.
+	float3 dL_ddir = { dot(dRGBdx, dL_dRGB), dot(dRGBdy, dL_dRGB), dot(dRGBdz, dL_dRGB) };
+
+	// Account for normalization of direction
+	float3 dL_dmean = dnormvdv(dir_orig, dL_ddir);
+
+	// Gradients of loss w.r.t. Gaussian means, but only the portion
+	// that is caused because the mean affects the view-dependent color.
+	dL_dmeans[idx] += dL_dmean;
+}
+
+// Backward version of INVERSE 2D covariance matrix computation
+static void computeCov2D(int idx,
+	const float3* means,
+	const float* cov3Ds,
+	const float h_x, float h_y,
+	const float tan_fovx, float tan_fovy,
+	const float* view_matrix,
+	const float* dL_dconics,
+	float3* dL_dmeans,
+	float* dL_dcov)
+{
+	// Reading location of 3D covariance for this Gaussian
+	const float* cov3D = cov3Ds + 6 * idx;
+
+	// Fetch gradients, recompute 2D covariance and relevant
+	// intermediate forward results needed in the backward.
+	float3 mean = means[idx];
+	float3 dL_dconic = { dL_dconics[4 * idx], dL_dconics[4 * idx + 1], dL_dconics[4 * idx + 3] };
+	float3 t = transformPoint4x3(mean, view_matrix);
+
+	const float limx = 1.3f * tan_fovx;
+	const float limy = 1.3f * tan_fovy;
+	const float txtz = t.x / t.z;
+	const float tytz = t.y / t.z;
+	t.x = std::min(limx, std::max(-limx, txtz)) * t.z;
+	t.y = std::min(limy, std::max(-limy, tytz)) * t.z;
+
+	const float x_grad_mul = txtz < -limx || txtz > limx ? 0 : 1;
+	const float y_grad_mul = tytz < -limy || tytz > limy ? 0 : 1;
+
+	mat3 J = { {
+		{ h_x / t.z, 0.0f, -(h_x * t.x) / (t.z * t.z) },
+		{ 0.0f, h_y / t.z, -(h_y * t.y) / (t.z * t.z) },
+		{ 0, 0, 0 } } };
+
+	mat3 W = { {
+		{ view_matrix[0], view_matrix[4], view_matrix[8] },
+		{ view_matrix[1], view_matrix[5], view_matrix[9] },
+		{ view_matrix[2], view_matrix[6], view_matrix[10] } } };
+
+	mat3 Vrk = { {
+		{ cov3D[0], cov3D[1], cov3D[2] },
+		{ cov3D[1], cov3D[3], cov3D[4] },
+		{ cov3D[2], cov3D[4], cov3D[5] } } };
+
+	mat3 T = W * J;
+
+	mat3 cov2D = transpose(T) * transpose(Vrk) * T;
+
+	// Use helper variables for 2D covariance entries. More compact.
+	float a = cov2D[0][0] += 0.3f;
+	float b = cov2D[0][1];
+	float c = cov2D[1][1] += 0.3f;
+
+	float denom = a * c - b * b;
+	float dL_da = 0, dL_db = 0, dL_dc = 0;
+	float denom2inv = 1.0f / ((denom * denom) + 0.0000001f);
+
+	if (denom2inv != 0)
+	{
+		// Gradients of loss w.r.t. entries of 2D covariance matrix,
+		// given gradients of loss w.r.t. conic matrix (inverse covariance matrix).
+		// e.g., dL / da = dL / d_conic_a * d_conic_a / d_a
+		dL_da = denom2inv * (-c * c * dL_dconic.x + 2 * b * c * dL_dconic.y + (denom - a * c) * dL_dconic.z);
+		dL_dc = denom2inv * (-a * a * dL_dconic.z + 2 * a * b * dL_dconic.y + (denom - a * c) * dL_dconic.x);
+		dL_db = denom2inv * 2 * (b * c * dL_dconic.x - (denom + 2 * b * b) * dL_dconic.y + a * b * dL_dconic.z);
+
+		// Gradients of loss L w.r.t. each 3D covariance matrix (Vrk) entry,
+		// given gradients w.r.t. 2D covariance matrix (diagonal).
+		// cov2D = transpose(T) * transpose(Vrk) * T;
+		dL_dcov[6 * idx + 0] = (T[0][0] * T[0][0] * dL_da + T[0][0] * T[1][0] * dL_db + T[1][0] * T[1][0] * dL_dc);
+		dL_dcov[6 * idx + 3] = (T[0][1] * T[0][1] * dL_da + T[0][1] * T[1][1] * dL_db + T[1][1] * T[1][1] * dL_dc);
+		dL_dcov[6 * idx + 5] = (T[0][2] * T[0][2] * dL_da + T[0][2] * T[1][2] * dL_db + T[1][2] * T[1][2] * dL_dc);
+
+		// Gradients of loss L w.r.t. each 3D covariance matrix (Vrk) entry,
+		// given gradients w.r.t. 2D covariance matrix (off-diagonal).
+		// Off-diagonal elements appear twice --> double the gradient.
+		// cov2D = transpose(T) * transpose(Vrk) * T;
+		dL_dcov[6 * idx + 1] = 2 * T[0][0] * T[0][1] * dL_da + (T[0][0] * T[1][1] + T[0][1] * T[1][0]) * dL_db + 2 * T[1][0] * T[1][1] * dL_dc;
+		dL_dcov[6 * idx + 2] = 2 * T[0][0] * T[0][2] * dL_da + (T[0][0] * T[1][2] + T[0][2] * T[1][0]) * dL_db + 2 * T[1][0] * T[1][2] * dL_dc;
+		dL_dcov[6 * idx + 4] = 2 * T[0][2] * T[0][1] * dL_da + (T[0][1] * T[1][2] + T[0][2] * T[1][1]) * dL_db + 2 * T[1][1] * T[1][2] * dL_dc;
+	}
+	else
+	{
+		for (int i = 0; i < 6; i++)
+			dL_dcov[6 * idx + i] = 0;
+	}
+
+	// Gradients of loss w.r.t. upper 2x3 portion of intermediate matrix T
+	// cov2D = transpose(T) * transpose(Vrk) * T;
+	float dL_dT00 = 2 * (T[0][0] * Vrk[0][0] + T[0][1] * Vrk[0][1] + T[0][2] * Vrk[0][2]) * dL_da +
+		(T[1][0] * Vrk[0][0] + T[1][1] * Vrk[0][1] + T[1][2] * Vrk[0][2]) * dL_db;
+	float dL_dT01 = 2 * (T[0][0] * Vrk[1][0] + T[0][1] * Vrk[1][1] + T[0][2] * Vrk[1][2]) * dL_da +
+		(T[1][0] * Vrk[1][0] + T[1][1] * Vrk[1][1] + T[1][2] * Vrk[1][2]) * dL_db;
+	float dL_dT02 = 2 * (T[0][0] * Vrk[2][0] + T[0][1] * Vrk[2][1] + T[0][2] * Vrk[2][2]) * dL_da +
+		(T[1][0] * Vrk[2][0] + T[1][1] * Vrk[2][1] + T[1][2] * Vrk[2][2]) * dL_db;
+	float dL_dT10 = 2 * (T[1][0] * Vrk[0][0] + T[1][1] * Vrk[0][1] + T[1][2] * Vrk[0][2]) * dL_dc +
+		(T[0][0] * Vrk[0][0] + T[0][1] * Vrk[0][1] + T[0][2] * Vrk[0][2]) * dL_db;
+	float dL_dT11 = 2 * (T[1][0] * Vrk[1][0] + T[1][1] * Vrk[1][1] + T[1][2] * Vrk[1][2]) * dL_dc +
+		(T[0][0] * Vrk[1][0] + T[0][1] * Vrk[1][1] + T[0][2] * Vrk[1][2]) * dL_db;
+	float dL_dT12 = 2 * (T[1][0] * Vrk[2][0] + T[1][1] * Vrk[2][1] + T[1][2] * Vrk[2][2]) * dL_dc +
+		(T[0][0] * Vrk[2][0] + T[0][1] * Vrk[2][1] + T[0][2] * Vrk[2][2]) * dL_db;
+
+	// Gradients of loss w.r.t. upper 3x2 non-zero entries of Jacobian matrix
+	// T = W * J
+	float dL_dJ00 = W[0][0] * dL_dT00 + W[0][1] * dL_dT01 + W[0][2] * dL_dT02;
+	float dL_dJ02 = W[2][0] * dL_dT00 + W[2][1] * dL_dT01 + W[2][2] * dL_dT02;
+	float dL_dJ11 = W[1][0] * dL_dT10 + W[1][1] * dL_dT11 + W[1][2] * dL_dT12;
+	float dL_dJ12 = W[2][0] * dL_dT10 + W[2][1] * dL_dT11 + W[2][2] * dL_dT12;
+
+	float tz = 1.f / t.z;
+	float tz2 = tz * tz;
+	float tz3 = tz2 * tz;
+
+	// Gradients of loss w.r.t. transformed Gaussian mean t
+	float dL_dtx = x_grad_mul * -h_x * tz2 * dL_dJ02;
+	float dL_dty = y_grad_mul * -h_y * tz2 * dL_dJ12;
+	float dL_dtz = -h_x * tz2 * dL_dJ00 - h_y * tz2 * dL_dJ11 + (2 * h_x * t.x) * tz3 * dL_dJ02 + (2 * h_y * t.y) * tz3 * dL_dJ12;
+
+	// Account for transformation of mean to t
+	// t = transformPoint4x3(mean, view_matrix);
+	float3 dL_dmean = transformVec4x3Transpose({ dL_dtx, dL_dty, dL_dtz }, view_matrix);
+
+	// Gradients of loss w.r.t. Gaussian means, but only the portion
+	// that is caused because the mean affects the covariance matrix.
+	dL_dmeans[idx] = dL_dmean;
+}
+
+// Backward pass for the conversion of scale and rotation to a
+// 3D covariance matrix for each Gaussian.
+static void computeCov3D(int idx, const float3 scale, float mod, const float4 rot, const float* dL_dcov3Ds, float3* dL_dscales, float4* dL_drots)
+{
+	// Recompute (intermediate) results for the 3D covariance computation.
+	float r = rot.x;
+	float x = rot.y;
+	float y = rot.z;
+	float z = rot.w;
+
+	mat3 R = { {
+		{ 1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z), 2.f * (x * z + r * y) },
+		{ 2.f * (x * y + r * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - r * x) },
+		{ 2.f * (x * z - r * y), 2.f * (y * z + r * x), 1.f - 2.f * (x * x + y * y) } } };
+
+	float3 s = mod * scale;
+	mat3 S = { { { s.x, 0, 0 }, { 0, s.y, 0 }, { 0, 0, s.z } } };
+
+	mat3 M = S * R;
+
+	const float* dL_dcov3D = dL_dcov3Ds + 6 * idx;
+
+	// Convert per-element covariance loss gradients to matrix form
+	mat3 dL_dSigma = { {
+		{ dL_dcov3D[0], 0.5f * dL_dcov3D[1], 0.5f * dL_dcov3D[2] },
+		{ 0.5f * dL_dcov3D[1], dL_dcov3D[3], 0.5f * dL_dcov3D[4] },
+		{ 0.5f * dL_dcov3D[2], 0.5f * dL_dcov3D[4], dL_dcov3D[5] } } };
+
+	// Compute loss gradient w.r.t. matrix M
+	// dSigma_dM = 2 * M
+	mat3 dL_dM = M * dL_dSigma;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			dL_dM[i][j] *= 2.0f;
+
+	mat3 Rt = transpose(R);
+	mat3 dL_dMt = transpose(dL_dM);
+
+	// Gradients of loss w.r.t. scale
+	float3* dL_dscale = dL_dscales + idx;
+	dL_dscale->x = Rt[0][0] * dL_dMt[0][0] + Rt[0][1] * dL_dMt[0][1] + Rt[0][2] * dL_dMt[0][2];
+	dL_dscale->y = Rt[1][0] * dL_dMt[1][0] + Rt[1][1] * dL_dMt[1][1] + Rt[1][2] * dL_dMt[1][2];
+	dL_dscale->z = Rt[2][0] * dL_dMt[2][0] + Rt[2][1] * dL_dMt[2][1] + Rt[2][2] * dL_dMt[2][2];
+
+	for (int j = 0; j < 3; j++)
+	{
+		dL_dMt[0][j] *= s.x;
+		dL_dMt[1][j] *= s.y;
+		dL_dMt[2][j] *= s.z;
+	}
+
+	// Gradients of loss w.r.t. normalized quaternion
+	float4 dL_dq;
+	dL_dq.x = 2 * z * (dL_dMt[0][1] - dL_dMt[1][0]) + 2 * y * (dL_dMt[2][0] - dL_dMt[0][2]) + 2 * x * (dL_dMt[1][2] - dL_dMt[2][1]);
+	dL_dq.y = 2 * y * (dL_dMt[1][0] + dL_dMt[0][1]) + 2 * z * (dL_dMt[2][0] + dL_dMt[0][2]) + 2 * r * (dL_dMt[1][2] - dL_dMt[2][1]) - 4 * x * (dL_dMt[2][2] + dL_dMt[1][1]);
+	dL_dq.z = 2 * x * (dL_dMt[1][0] + dL_dMt[0][1]) + 2 * r * (dL_dMt[2][0] - dL_dMt[0][2]) + 2 * z * (dL_dMt[1][2] + dL_dMt[2][1]) - 4 * y * (dL_dMt[2][2] + dL_dMt[0][0]);
+	dL_dq.w = 2 * r * (dL_dMt[0][1] - dL_dMt[1][0]) + 2 * x * (dL_dMt[2][0] + dL_dMt[0][2]) + 2 * y * (dL_dMt[1][2] + dL_dMt[2][1]) - 4 * z * (dL_dMt[1][1] + dL_dMt[0][0]);
+
+	// Gradients of loss w.r.t. unnormalized quaternion
+	dL_drots[idx] = dL_dq;
+}
+
+void BACKWARD::preprocess(
+	int P, int D, int M,
+	const float3* means,
+	const int* radii,
+	const float* shs,
+	const bool* clamped,
+	const float3* scales,
+	const float4* rotations,
+	const float scale_modifier,
+	const float* cov3Ds,
+	const float* view,
+	const float* proj,
+	const float focal_x, float focal_y,
+	const float tan_fovx, float tan_fovy,
+	const float3* campos,
+	const float3* dL_dmean2D,
+	const float* dL_dconics,
+	float3* dL_dmeans,
+	float* dL_dcolor,
+	float* dL_dcov3D,
+	float* dL_dsh,
+	float3* dL_dscale,
+	float4* dL_drot,
+	int num_threads)
+{
+	parallelFor(0, P, 1024, num_threads, [&](int idx)
+	{
+		if (!(radii[idx] > 0))
+			return;
+
+		// Propagate gradients for the path of 2D conic matrix computation.
+		// When done, loss gradient w.r.t. 3D means has been modified and
+		// gradient w.r.t. 3D covariance matrix has been computed.
+		computeCov2D(idx, means, cov3Ds, focal_x, focal_y, tan_fovx, tan_fovy, view, dL_dconics, dL_dmeans, dL_dcov3D);
+
+		float3 m = means[idx];
+
+		// Taking care of gradients from the screenspace points
+		float4 m_hom = transformPoint4x4(m, proj);
+		float m_w = 1.0f / (m_hom.w + 0.0000001f);
+
+		// Compute loss gradient w.r.t. 3D means due to gradients of 2D means
+		// from rendering procedure
+		float3 dL_dmean;
+		float mul1 = (proj[0] * m.x + proj[4] * m.y + proj[8] * m.z + proj[12]) * m_w * m_w;
+		float mul2 = (proj[1] * m.x + proj[5] * m.y + proj[9] * m.z + proj[13]) * m_w * m_w;
+		dL_dmean.x = (proj[0] * m_w - proj[3] * mul1) * dL_dmean2D[idx].x + (proj[1] * m_w - proj[3] * mul2) * dL_dmean2D[idx].y;
+		dL_dmean.y = (proj[4] * m_w - proj[7] * mul1) * dL_dmean2D[idx].x + (proj[5] * m_w - proj[7] * mul2) * dL_dmean2D[idx].y;
+		dL_dmean.z = (proj[8] * m_w - proj[11] * mul1) * dL_dmean2D[idx].x + (proj[9] * m_w - proj[11] * mul2) * dL_dmean2D[idx].y;
+
+		// That's the second part of the mean gradient. Previous computation
+		// of cov2D and following SH conversion also affects it.
+		dL_dmeans[idx] += dL_dmean;
+
+		// Compute gradient updates due to computing colors from SHs
+		if (shs)
+			computeColorFromSH(idx, D, M, means, *campos, shs, clamped, (const float3*)dL_dcolor, dL_dmeans, (float3*)dL_dsh);
+
+		// Compute gradient updates due to computing covariance from scale/rotation
+		if (scales)
+			computeCov3D(idx, scales[idx], scale_modifier, rotations[idx], dL_dcov3D, dL_dscale, dL_drot);
+	});
+}
+
+// Backward version of the rendering procedure for one tile. Traverses the
+// tile's Gaussians back to front and sums each Gaussian's gradient over the
+// tile's pixels into its own instance slot.
+static void renderTile(
+	const uint32_t tile_x, const uint32_t tile_y,
+	const dim3 grid,
+	const uint2* ranges,
+	const uint32_t* point_list,
+	int W, int H,
+	const float* bg_color,
+	const float2* points_xy_image,
+	const float4* conic_opacity,
+	const float* colors,
+	const float* final_Ts,
+	const uint32_t* n_contrib,
+	const float* dL_dpixels,
+	const int* radii,
+	const uint32_t* point_offsets,
+	float* instance_grads)
+{
+	const int pix_min_x = tile_x * BLOCK_X;
+	const int pix_min_y = tile_y * BLOCK_Y;
+	const uint2 range = ranges[tile_y * grid.x + tile_x];
+
+	alignas(64) float pixf_x[CPU_TILE_SIZE];
+	alignas(64) float pixf_y[CPU_TILE_SIZE];
+	alignas(64) float T[CPU_TILE_SIZE];
+	alignas(64) float T_final[CPU_TILE_SIZE];
+	alignas(64) uint32_t last_contributor[CPU_TILE_SIZE];
+	alignas(64) float dL_dpixel[NUM_CHANNELS][CPU_TILE_SIZE];
+	alignas(64) float bg_dot_dpixel[CPU_TILE_SIZE];
+	alignas(64) float accum_rec[NUM_CHANNELS][CPU_TILE_SIZE];
+	alignas(64) float last_color[NUM_CHANNELS][CPU_TILE_SIZE];
+	alignas(64) float last_alpha[CPU_TILE_SIZE];
+
+	// In the forward, we stored the final value for T, the
+	// product of all (1 - alpha) factors, and the ID of the last
+	// contributing Gaussian of each pixel.
+	uint32_t max_contributor = 0;
+	for (int i = 0; i < CPU_TILE_SIZE; i++)
+	{
+		const int px = pix_min_x + i % BLOCK_X;
+		const int py = pix_min_y + i / BLOCK_X;
+		const bool inside = px < W && py < H;
+		const int pix_id = W * py + px;
+		pixf_x[i] = (float)px;
+		pixf_y[i] = (float)py;
+		T_final[i] = inside ? final_Ts[pix_id] : 0;
+		T[i] = T_final[i];
+		last_contributor[i] = inside ? n_contrib[pix_id] : 0;
+		max_contributor = std::max(max_contributor, last_contributor[i]);
+		bg_dot_dpixel[i] = 0;
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+		{
+			dL_dpixel[ch][i] = inside ? dL_dpixels[ch * H * W + pix_id] : 0;
+			bg_dot_dpixel[i] += bg_color[ch] * dL_dpixel[ch][i];
+			accum_rec[ch][i] = 0;
+			last_color[ch][i] = 0;
+		}
+		last_alpha[i] = 0;
+	}
+
+	// Gradient of pixel coordinate w.r.t. normalized
+	// screen-space viewport corrdinates (-1 to 1)
+	const float ddelx_dx = 0.5 * W;
+	const float ddely_dy = 0.5 * H;
+
+	// Entries behind every pixel's last contributor are skipped anyway
+	const uint32_t num_entries = std::min(range.y - range.x, max_contributor);
+	for (uint32_t k = num_entries; k-- > 0;)
+	{
+		const uint32_t global_id = point_list[range.x + k];
+		const float2 xy = points_xy_image[global_id];
+		const float4 con_o = conic_opacity[global_id];
+		int row_begin, row_end;
+		if (!FORWARD::contributingRows(xy, con_o, pix_min_y, row_begin, row_end))
+			continue;
+
+		float c[NUM_CHANNELS];
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			c[ch] = colors[global_id * NUM_CHANNELS + ch];
+
+		float sum_dL_dcolor[NUM_CHANNELS] = { 0 };
+		float sum_dL_dmean2D_x = 0, sum_dL_dmean2D_y = 0;
+		float sum_dL_dconic_x = 0, sum_dL_dconic_y = 0, sum_dL_dconic_w = 0;
+		float sum_dL_dopacity = 0;
+
+		for (int i = row_begin * BLOCK_X; i < row_end * BLOCK_X; i++)
+		{
+			// Compute blending values, as before.
+			const float dx = xy.x - pixf_x[i];
+			const float dy = xy.y - pixf_y[i];
+			const float power = -0.5f * (con_o.x * dx * dx + con_o.z * dy * dy) - con_o.y * dx * dy;
+			const float G = std::exp(power);
+			const float alpha = std::min(0.99f, con_o.w * G);
+			const bool active = k < last_contributor[i] && power <= 0.0f && alpha >= 1.0f / 255.0f;
+
+			const float T_new = T[i] / (1.f - alpha);
+			const float dchannel_dcolor = alpha * T_new;
+
+			// Propagate gradients to per-Gaussian colors and keep
+			// gradients w.r.t. alpha (blending factor for a Gaussian/pixel
+			// pair).
+			float dL_dalpha = 0.0f;
+			for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			{
+				// Update last color (to be used in the next iteration)
+				const float accum = last_alpha[i] * last_color[ch][i] + (1.f - last_alpha[i]) * accum_rec[ch][i];
+				accum_rec[ch][i] = active ? accum : accum_rec[ch][i];
+				last_color[ch][i] = active ? c[ch] : last_color[ch][i];
+
+				dL_dalpha += (c[ch] - accum) * dL_dpixel[ch][i];
+				sum_dL_dcolor[ch] += active ? dchannel_dcolor * dL_dpixel[ch][i] : 0.0f;
+			}
+			dL_dalpha *= T_new;
+			// Account for fact that alpha also influences how much of
+			// the background color is added if nothing left to blend
+			dL_dalpha += (-T_final[i] / (1.f - alpha)) * bg_dot_dpixel[i];
+
+			// Update last alpha and transmittance (to be used in the next iteration)
+			last_alpha[i] = active ? alpha : last_alpha[i];
+			T[i] = active ? T_new : T[i];
+
+			// Helpful reusable temporary variables
+			const float dL_dG = con_o.w * dL_dalpha;
+			const float gdx = G * dx;
+			const float gdy = G * dy;
+			const float dG_ddelx = -gdx * con_o.x - gdy * con_o.y;
+			const float dG_ddely = -gdy * con_o.z - gdx * con_o.y;
+
+			// Gradients w.r.t. 2D mean position, 2D covariance (2x2 matrix,
+			// symmetric) and opacity of the Gaussian
+			sum_dL_dmean2D_x += active ? dL_dG * dG_ddelx * ddelx_dx : 0.0f;
+			sum_dL_dmean2D_y += active ? dL_dG * dG_ddely * ddely_dy : 0.0f;
+			sum_dL_dconic_x += active ? -0.5f * gdx * dx * dL_dG : 0.0f;
+			sum_dL_dconic_y += active ? -0.5f * gdx * dy * dL_dG : 0.0f;
+			sum_dL_dconic_w += active ? -0.5f * gdy * dy * dL_dG : 0.0f;
+			sum_dL_dopacity += active ? G * dL_dalpha : 0.0f;
+		}
+
+		// Locate this (Gaussian, tile) instance among the Gaussian's own tiles
+		uint2 rect_min, rect_max;
+		getRect(xy, radii[global_id], rect_min, rect_max, grid);
+		const uint32_t slot = (global_id == 0 ? 0 : point_offsets[global_id - 1])
+			+ (tile_y - rect_min.y) * (rect_max.x - rect_min.x) + (tile_x - rect_min.x);
+		float* grad = instance_grads + (size_t)slot * BACKWARD::INSTANCE_GRAD_SIZE;
+		grad[0] = sum_dL_dmean2D_x;
+		grad[1] = sum_dL_dmean2D_y;
+		grad[2] = sum_dL_dconic_x;
+		grad[3] = sum_dL_dconic_y;
+		grad[4] = sum_dL_dconic_w;
+		grad[5] = sum_dL_dopacity;
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			grad[6 + ch] = sum_dL_dcolor[ch];
+	}
+}
+
+void BACKWARD::render(
+	const dim3 grid,
+	const uint2* ranges,
+	const uint32_t* point_list,
+	int W, int H,
+	const float* bg_color,
+	const float2* means2D,
+	const float4* conic_opacity,
+	const float* colors,
+	const float* final_Ts,
+	const uint32_t* n_contrib,
+	const float* dL_dpixels,
+	const int* radii,
+	const uint32_t* point_offsets,
+	float* instance_grads,
+	int num_threads)
+{
+	parallelFor(0, grid.x * grid.y, 1, num_threads, [&](int tile)
+	{
+		renderTile(
+			tile % grid.x, tile / grid.x,
+			grid,
+			ranges,
+			point_list,
+			W, H,
+			bg_color,
+			means2D,
+			conic_opacity,
+			colors,
+			final_Ts,
+			n_contrib,
+			dL_dpixels,
+			radii,
+			point_offsets,
+			instance_grads);
+	});
+}
+
+void BACKWARD::reduce(
+	int P,
+	const int* radii,
+	const uint32_t* point_offsets,
+	const float* instance_grads,
+	float3* dL_dmean2D,
+	float4* dL_dconic2D,
+	float* dL_dopacity,
+	float* dL_dcolors,
+	int num_threads)
+{
+	parallelFor(0, P, 1024, num_threads, [&](int idx)
+	{
+		if (!(radii[idx] > 0))
+			return;
+		float sum[INSTANCE_GRAD_SIZE] = { 0 };
+		const uint32_t begin = (idx == 0 ? 0 : point_offsets[idx - 1]);
+		for (uint32_t slot = begin; slot < point_offsets[idx]; slot++)
+		{
+			const float* grad = instance_grads + (size_t)slot * INSTANCE_GRAD_SIZE;
+			for (int j = 0; j < INSTANCE_GRAD_SIZE; j++)
+				sum[j] += grad[j];
+		}
+		dL_dmean2D[idx].x = sum[0];
+		dL_dmean2D[idx].y = sum[1];
+		dL_dconic2D[idx].x = sum[2];
+		dL_dconic2D[idx].y = sum[3];
+		dL_dconic2D[idx].w = sum[4];
+		dL_dopacity[idx] = sum[5];
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			dL_dcolors[idx * NUM_CHANNELS + ch] = sum[6 + ch];
+	});
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ *
+ * This file is Derivative Works of Gaussian Splatting,
+ * created by Longwei Li, Huajian Huang, Hui Cheng and Sai-Kit Yeung in 2023,
+ * as part of Photo-SLAM.
+ */
+
+#ifndef CPU_RASTERIZER_BACKWARD_H_INCLUDED
+#define CPU_RASTERIZER_BACKWARD_H_INCLUDED
+
+#include "auxiliary.h"
+
+namespace CpuRasterizer
+{
+namespace BACKWARD
+{
+	// Per (Gaussian, tile) instance gradients written by render() and
+	// summed per Gaussian by reduce(): mean2D (2), conic (3), opacity (1), color (3)
+	constexpr int INSTANCE_GRAD_SIZE = 5 + 1 + NUM_CHANNELS;
+
+	void render(
+		const dim3 grid,
+		const uint2* ranges,
+		const uint32_t* point_list,
+		int W, int H,
+		const float* bg_color,
+		const float2* means2D,
+		const float4* conic_opacity,
+		const float* colors,
+		const float* final_Ts,
+		const uint32_t* n_contrib,
+		const float* dL_dpixels,
+		const int* radii,
+		const uint32_t* point_offsets,
+		float* instance_grads,
+		int num_threads);
+
+	void reduce(
+		int P,
+		const int* radii,
+		const uint32_t* point_offsets,
+		const float* instance_grads,
+		float3* dL_dmean2D,
+		float4* dL_dconic2D,
+		float* dL_dopacity,
+		float* dL_dcolors,
+		int num_threads);
+
+	void preprocess(
+		int P, int D, int M,
+		const float3* means,
+		const int* radii,
+		const float* shs,
+		const bool* clamped,
+		const float3* scales,
+		const float4* rotations,
+		const float scale_modifier,
+		const float* cov3Ds,
+		const float* view,
+		const float* proj,
+		const float focal_x, float focal_y,
+		const float tan_fovx, float tan_fovy,
+		const float3* campos,
+		const float3* dL_dmean2D,
+		const float* dL_dconics,
+		float3* dL_dmeans,
+		float* dL_dcolor,
+		float* dL_dcov3D,
+		float* dL_dsh,
+		float3* dL_dscale,
+		float4* dL_drot,
+		int num_threads);
+}
+}
+
+#endif
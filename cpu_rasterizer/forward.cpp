@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ *
+ * This file is Derivative Works of Gaussian Splatting,
+ * created by Longwei Li, Huajian Huang, Hui Cheng and Sai-Kit Yeung in 2023,
+ * as part of Photo-SLAM.
+ */
+
+#include <cstring>
+
+#include "forward.h"
+#include "auxiliary.h"
+
+namespace CpuRasterizer
+{
+
+// Forward method for converting the input spherical harmonics
+// coefficients of each Gaussian to a simple RGB color.
+static float3 computeColorFromSH(int idx, int deg, int max_coeffs, const float3* means, float3 campos, const float* shs, bool* clamped)
+{
+	float3 pos = means[idx];
+	float3 dir = pos - campos;
+	dir = dir * (1.0f / std::sqrt(dot(dir, dir)));
+
+	const float3* sh = ((const float3*)shs) + idx * max_coeffs;
+	float3 result = SH_C0 * sh[0];
+
+	if (deg > 0)
+	{
+		float x = dir.x;
+		float y = dir.y;
+		float z = dir.z;
+		result = result - SH_C1 * y * sh[1] + SH_C1 * z * sh[2] - SH_C1 * x * sh[3];
+
+		if (deg > 1)
+		{
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, yz = y * z, xz = x * z;
+			result = result +
+				SH_C2[0] * xy * sh[4] +
+				SH_C2[1] * yz * sh[5] +
+				SH_C2[2] * (2.0f * zz - xx - yy) * sh[6] +
+				SH_C2[3] * xz * sh[7] +
+				SH_C2[4] * (xx - yy) * sh[8];
+
+			if (deg > 2)
+			{
+				result = result +
+					SH_C3[0] * y * (3.0f * xx - yy) * sh[9] +
+					SH_C3[1] * xy * z * sh[10] +
+					SH_C3[2] * y * (4.0f * zz - xx - yy) * sh[11] +
+					SH_C3[3] * z * (2.0f * zz - 3.0f * xx - 3.0f * yy) * sh[12] +
+					SH_C3[4] * x * (4.0f * zz - xx - yy) * sh[13] +
+					SH_C3[5] * z * (xx - yy) * sh[14] +
+					SH_C3[6] * x * (xx - 3.0f * yy) * sh[15];
+			}
+		}
+	}
+	result += float3{ 0.5f, 0.5f, 0.5f };
+
+	// RGB colors are clamped to positive values. If values are
+	// clamped, we need to keep track of this for the backward pass.
+	clamped[3 * idx + 0] = (result.x < 0);
+	clamped[3 * idx + 1] = (result.y < 0);
+	clamped[3 * idx + 2] = (result.z < 0);
+	return { std::max(result.x, 0.0f), std::max(result.y, 0.0f), std::max(result.z, 0.0f) };
+}
+
+// Forward version of 2D covariance matrix computation
+static float3 computeCov2D(const float3& mean, float focal_x, float focal_y, float tan_fovx, float tan_fovy, const float* cov3D, const float* viewmatrix)
+{
+	float3 t = transformPoint4x3(mean, viewmatrix);
+
+	const float limx = 1.3f * tan_fovx;
+	const float limy = 1.3f * tan_fovy;
+	const float txtz = t.x / t.z;
+	const float tytz = t.y / t.z;
+	t.x = std::min(limx, std::max(-limx, txtz)) * t.z;
+	t.y = std::min(limy, std::max(-limy, tytz)) * t.z;
+
+	mat3 J = { {
+		{ focal_x / t.z, 0.0f, -(focal_x * t.x) / (t.z * t.z) },
+		{ 0.0f, focal_y / t.z, -(focal_y * t.y) / (t.z * t.z) },
+		{ 0, 0, 0 } } };
+
+	mat3 W = { {
+		{ viewmatrix[0], viewmatrix[4], viewmatrix[8] },
+		{ viewmatrix[1], viewmatrix[5], viewmatrix[9] },
+		{ viewmatrix[2], viewmatrix[6], viewmatrix[10] } } };
+
+	mat3 T = W * J;
+
+	mat3 Vrk = { {
+		{ cov3D[0], cov3D[1], cov3D[2] },
+		{ cov3D[1], cov3D[3], cov3D[4] },
+		{ cov3D[2], cov3D[4], cov3D[5] } } };
+
+	mat3 cov = transpose(T) * transpose(Vrk) * T;
+
+	// Apply low-pass filter: every Gaussian should be at least
+	// one pixel wide/high. Discard 3rd row and column.
+	cov[0][0] += 0.3f;
+	cov[1][1] += 0.3f;
+	return { float(cov[0][0]), float(cov[0][1]), float(cov[1][1]) };
+}
+
+// Forward method for converting scale and rotation properties of each
+// Gaussian to a 3D covariance matrix in world space.
+static void computeCov3D(const float3 scale, float mod, const float4 rot, float* cov3D)
+{
+	// Create scaling matrix
+	mat3 S = { { { mod * scale.x, 0, 0 }, { 0, mod * scale.y, 0 }, { 0, 0, mod * scale.z } } };
+
+	// The quaternion is normalized by GaussianModel::getRotationActivation
+	float r = rot.x;
+	float x = rot.y;
+	float y = rot.z;
+	float z = rot.w;
+
+	// Compute rotation matrix from quaternion
+	mat3 R = { {
+		{ 1.f - 2.f * (y * y + z * z), 2.f * (x * y - r * z), 2.f * (x * z + r * y) },
+		{ 2.f * (x * y + r * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - r * x) },
+		{ 2.f * (x * z - r * y), 2.f * (y * z + r * x), 1.f - 2.f * (x * x + y * y) } } };
+
+	mat3 M = S * R;
+
+	// Compute 3D world covariance matrix Sigma
+	mat3 Sigma = transpose(M) * M;
+
+	// Covariance is symmetric, only store upper right
+	cov3D[0] = Sigma[0][0];
+	cov3D[1] = Sigma[0][1];
+	cov3D[2] = Sigma[0][2];
+	cov3D[3] = Sigma[1][1];
+	cov3D[4] = Sigma[1][2];
+	cov3D[5] = Sigma[2][2];
+}
+
+void FORWARD::preprocess(int P, int D, int M,
+	const float* orig_points,
+	const float3* scales,
+	const float scale_modifier,
+	const float4* rotations,
+	const float* opacities,
+	const float* shs,
+	bool* clamped,
+	const float* cov3D_precomp,
+	const float* colors_precomp,
+	const float* viewmatrix,
+	const float* projmatrix,
+	const float3* cam_pos,
+	const int W, int H,
+	const float focal_x, float focal_y,
+	const float tan_fovx, float tan_fovy,
+	int* radii,
+	float2* points_xy_image,
+	float* depths,
+	float* cov3Ds,
+	float* rgb,
+	float4* conic_opacity,
+	const dim3 grid,
+	uint32_t* tiles_touched,
+	bool prefiltered,
+	int num_threads)
+{
+	parallelFor(0, P, 1024, num_threads, [&](int idx)
+	{
+		// Initialize radius and touched tiles to 0. If this isn't changed,
+		// this Gaussian will not be processed further.
+		radii[idx] = 0;
+		tiles_touched[idx] = 0;
+
+		// Perform near culling, quit if outside.
+		float3 p_view;
+		if (!in_frustum(idx, orig_points, viewmatrix, p_view))
+			return;
+
+		// Transform point by projecting
+		float3 p_orig = { orig_points[3 * idx], orig_points[3 * idx + 1], orig_points[3 * idx + 2] };
+		float4 p_hom = transformPoint4x4(p_orig, projmatrix);
+		float p_w = 1.0f / (p_hom.w + 0.0000001f);
+		float3 p_proj = { p_hom.x * p_w, p_hom.y * p_w, p_hom.z * p_w };
+
+		// If 3D covariance matrix is precomputed, use it, otherwise compute
+		// from scaling and rotation parameters.
+		const float* cov3D;
+		if (cov3D_precomp != nullptr)
+		{
+			cov3D = cov3D_precomp + idx * 6;
+		}
+		else
+		{
+			computeCov3D(scales[idx], scale_modifier, rotations[idx], cov3Ds + idx * 6);
+			cov3D = cov3Ds + idx * 6;
+		}
+
+		// Compute 2D screen-space covariance matrix
+		float3 cov = computeCov2D(p_orig, focal_x, focal_y, tan_fovx, tan_fovy, cov3D, viewmatrix);
+
+		// Invert covariance (EWA algorithm)
+		float det = (cov.x * cov.z - cov.y * cov.y);
+		if (det == 0.0f)
+			return;
+		float det_inv = 1.f / det;
+		float3 conic = { cov.z * det_inv, -cov.y * det_inv, cov.x * det_inv };
+
+		// Compute extent in screen space (by finding eigenvalues of
+		// 2D covariance matrix). Use extent to compute a bounding rectangle
+		// of screen-space tiles that this Gaussian overlaps with. Quit if
+		// rectangle covers 0 tiles.
+		float mid = 0.5f * (cov.x + cov.z);
+		float lambda1 = mid + std::sqrt(std::max(0.1f, mid * mid - det));
+		float lambda2 = mid - std::sqrt(std::max(0.1f, mid * mid - det));
+		float my_radius = std::ceil(3.f * std::sqrt(std::max(lambda1, lambda2)));
+		float2 point_image = { ndc2Pix(p_proj.x, W), ndc2Pix(p_proj.y, H) };
+		uint2 rect_min, rect_max;
+		getRect(point_image, my_radius, rect_min, rect_max, grid);
+		if ((rect_max.x - rect_min.x) * (rect_max.y - rect_min.y) == 0)
+			return;
+
+		// If colors have been precomputed, use them, otherwise convert
+		// spherical harmonics coefficients to RGB color.
+		if (colors_precomp == nullptr)
+		{
+			float3 result = computeColorFromSH(idx, D, M, (const float3*)orig_points, *cam_pos, shs, clamped);
+			rgb[idx * NUM_CHANNELS + 0] = result.x;
+			rgb[idx * NUM_CHANNELS + 1] = result.y;
+			rgb[idx * NUM_CHANNELS + 2] = result.z;
+		}
+
+		// Store some useful helper data for the next steps.
+		depths[idx] = p_view.z;
+		radii[idx] = my_radius;
+		points_xy_image[idx] = point_image;
+		// Inverse 2D covariance and opacity neatly pack into one float4
+		conic_opacity[idx] = { conic.x, conic.y, conic.z, opacities[idx] };
+		tiles_touched[idx] = (rect_max.y - rect_min.y) * (rect_max.x - rect_min.x);
+	});
+}
+
+void FORWARD::binning(int P,
+	const float2* points_xy_image,
+	const float* depths,
+	const int* radii,
+	const dim3 grid,
+	uint64_t* point_list_keys,
+	uint32_t* point_list,
+	uint2* ranges,
+	int num_threads)
+{
+	const int num_tiles = grid.x * grid.y;
+	std::vector<std::atomic<uint32_t>> cursor(num_tiles);
+	for (auto& c : cursor)
+		c.store(0, std::memory_order_relaxed);
+
+	// Count the Gaussians overlapping each tile
+	parallelFor(0, P, 4096, num_threads, [&](int idx)
+	{
+		if (radii[idx] <= 0)
+			return;
+		uint2 rect_min, rect_max;
+		getRect(points_xy_image[idx], radii[idx], rect_min, rect_max, grid);
+		for (uint32_t y = rect_min.y; y < rect_max.y; y++)
+			for (uint32_t x = rect_min.x; x < rect_max.x; x++)
+				cursor[y * grid.x + x].fetch_add(1, std::memory_order_relaxed);
+	});
+
+	// Tile ranges in the instance list from an exclusive scan of the counts
+	uint32_t offset = 0;
+	for (int tile = 0; tile < num_tiles; tile++)
+	{
+		uint32_t count = cursor[tile].load(std::memory_order_relaxed);
+		ranges[tile] = { offset, offset + count };
+		cursor[tile].store(offset, std::memory_order_relaxed);
+		offset += count;
+	}
+
+	// Scatter one | depth | Gaussian ID | key into each overlapped tile's range.
+	// Depths are positive after near culling, so their bit patterns sort
+	// like the floats; the ID breaks ties deterministically.
+	parallelFor(0, P, 4096, num_threads, [&](int idx)
+	{
+		if (radii[idx] <= 0)
+			return;
+		uint2 rect_min, rect_max;
+		getRect(points_xy_image[idx], radii[idx], rect_min, rect_max, grid);
+		uint32_t depth_bits;
+		std::memcpy(&depth_bits, &depths[idx], sizeof(uint32_t));
+		const uint64_t key = (((uint64_t)depth_bits) << 32) | (uint32_t)idx;
+		for (uint32_t y = rect_min.y; y < rect_max.y; y++)
+			for (uint32_t x = rect_min.x; x < rect_max.x; x++)
+				point_list_keys[cursor[y * grid.x + x].fetch_add(1, std::memory_order_relaxed)] = key;
+	});
+
+	// Sort every tile front to back independently
+	parallelFor(0, num_tiles, 1, num_threads, [&](int tile)
+	{
+		const uint2 range = ranges[tile];
+		std::sort(point_list_keys + range.x, point_list_keys + range.y);
+		for (uint32_t i = range.x; i < range.y; i++)
+			point_list[i] = (uint32_t)point_list_keys[i];
+	});
+}
+
+// Rows [row_begin, row_end) of a tile that a Gaussian can reach with
+// alpha >= 1/255, i.e. where 0.5 * d^T conic d <= log(255 * opacity).
+// Returns false if the Gaussian cannot contribute to any pixel.
+bool FORWARD::contributingRows(const float2 xy, const float4 con_o, int pix_min_y, int& row_begin, int& row_end)
+{
+	row_begin = 0;
+	row_end = BLOCK_Y;
+	if (con_o.w < 1.0f / 255.0f)
+		return false;
+	const float det = con_o.x * con_o.z - con_o.y * con_o.y;
+	if (!(det > 0.0f))
+		return true;
+	const float var_y = con_o.x / det;
+	const float extent = std::sqrt(2.0f * std::log(255.0f * con_o.w) * var_y);
+	row_begin = std::max(0, (int)std::floor(xy.y - extent) - pix_min_y - 1);
+	row_end = std::min(BLOCK_Y, (int)std::ceil(xy.y + extent) - pix_min_y + 2);
+	return row_begin < row_end;
+}
+
+// Blend one tile. Pixels are kept in structure-of-arrays form so that the
+// inner loop over the tile's pixels is branch-free and vectorizes.
+static void renderTile(
+	const uint32_t tile_x, const uint32_t tile_y,
+	const dim3 grid,
+	const uint2* ranges,
+	const uint32_t* point_list,
+	int W, int H,
+	const float2* points_xy_image,
+	const float* features,
+	const float4* conic_opacity,
+	float* final_T,
+	uint32_t* n_contrib,
+	const float* bg_color,
+	float* out_color)
+{
+	const int pix_min_x = tile_x * BLOCK_X;
+	const int pix_min_y = tile_y * BLOCK_Y;
+	const uint2 range = ranges[tile_y * grid.x + tile_x];
+
+	alignas(64) float pixf_x[CPU_TILE_SIZE];
+	alignas(64) float pixf_y[CPU_TILE_SIZE];
+	alignas(64) float T[CPU_TILE_SIZE];
+	alignas(64) float C[NUM_CHANNELS][CPU_TILE_SIZE];
+	alignas(64) uint32_t last_contributor[CPU_TILE_SIZE];
+	alignas(64) uint32_t done[CPU_TILE_SIZE];
+
+	int num_inside = 0;
+	for (int i = 0; i < CPU_TILE_SIZE; i++)
+	{
+		const int px = pix_min_x + i % BLOCK_X;
+		const int py = pix_min_y + i / BLOCK_X;
+		pixf_x[i] = (float)px;
+		pixf_y[i] = (float)py;
+		T[i] = 1.0f;
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			C[ch][i] = 0.0f;
+		last_contributor[i] = 0;
+		// Pixels outside the image are done from the start
+		done[i] = (px < W && py < H) ? 0u : 1u;
+		num_inside += (done[i] == 0u);
+	}
+
+	for (uint32_t k = 0; range.x + k < range.y; k++)
+	{
+		// End if the entire tile is saturated
+		if ((k & 31u) == 0u)
+		{
+			int num_done = 0;
+			for (int i = 0; i < CPU_TILE_SIZE; i++)
+				num_done += done[i];
+			if (num_done == CPU_TILE_SIZE)
+				break;
+		}
+
+		const uint32_t coll_id = point_list[range.x + k];
+		const float2 xy = points_xy_image[coll_id];
+		const float4 con_o = conic_opacity[coll_id];
+		int row_begin, row_end;
+		if (!FORWARD::contributingRows(xy, con_o, pix_min_y, row_begin, row_end))
+			continue;
+
+		float feat[NUM_CHANNELS];
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			feat[ch] = features[coll_id * NUM_CHANNELS + ch];
+		const uint32_t contributor = k + 1;
+
+		for (int i = row_begin * BLOCK_X; i < row_end * BLOCK_X; i++)
+		{
+			// Resample using conic matrix (cf. "Surface
+			// Splatting" by Zwicker et al., 2001)
+			const float dx = xy.x - pixf_x[i];
+			const float dy = xy.y - pixf_y[i];
+			const float power = -0.5f * (con_o.x * dx * dx + con_o.z * dy * dy) - con_o.y * dx * dy;
+
+			// Eq. (2) from 3D Gaussian splatting paper.
+			const float alpha = std::min(0.99f, con_o.w * std::exp(power));
+			const bool valid = (done[i] == 0u) & (power <= 0.0f) & (alpha >= 1.0f / 255.0f);
+			const float test_T = T[i] * (1 - alpha);
+			const bool saturated = valid & (test_T < 0.0001f);
+			const bool blend = valid & !saturated;
+
+			// Eq. (3) from 3D Gaussian splatting paper.
+			const float weight = blend ? alpha * T[i] : 0.0f;
+			for (int ch = 0; ch < NUM_CHANNELS; ch++)
+				C[ch][i] += feat[ch] * weight;
+
+			T[i] = blend ? test_T : T[i];
+			last_contributor[i] = blend ? contributor : last_contributor[i];
+			done[i] = saturated ? 1u : done[i];
+		}
+	}
+
+	if (num_inside == 0)
+		return;
+	for (int i = 0; i < CPU_TILE_SIZE; i++)
+	{
+		const int px = pix_min_x + i % BLOCK_X;
+		const int py = pix_min_y + i / BLOCK_X;
+		if (px >= W || py >= H)
+			continue;
+		const int pix_id = W * py + px;
+		final_T[pix_id] = T[i];
+		n_contrib[pix_id] = last_contributor[i];
+		for (int ch = 0; ch < NUM_CHANNELS; ch++)
+			out_color[ch * H * W + pix_id] = C[ch][i] + T[i] * bg_color[ch];
+	}
+}
+
+void FORWARD::render(
+	const dim3 grid,
+	const uint2* ranges,
+	const uint32_t* point_list,
+	int W, int H,
+	const float2* means2D,
+	const float* colors,
+	const float4* conic_opacity,
+	float* final_T,
+	uint32_t* n_contrib,
+	const float* bg_color,
+	float* out_color,
+	int num_threads)
+{
+	parallelFor(0, grid.x * grid.y, 1, num_threads, [&](int tile)
+	{
+		renderTile(
+			tile % grid.x, tile / grid.x,
+			grid,
+			ranges,
+			point_list,
+			W, H,
+			means2D,
+			colors,
+			conic_opacity,
+			final_T,
+			n_contrib,
+			bg_color,
+			out_color);
+	});
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ *
+ * This file is Derivative Works of Gaussian Splatting,
+ * created by Longwei Li, Huajian Huang, Hui Cheng and Sai-Kit Yeung in 2023,
+ * as part of Photo-SLAM.
+ */
+
+#ifndef CPU_RASTERIZER_FORWARD_H_INCLUDED
+#define CPU_RASTERIZER_FORWARD_H_INCLUDED
+
+#include "auxiliary.h"
+
+namespace CpuRasterizer
+{
+namespace FORWARD
+{
+	// Perform initial steps for each Gaussian prior to rasterization.
+	void preprocess(int P, int D, int M,
+		const float* orig_points,
+		const float3* scales,
+		const float scale_modifier,
+		const float4* rotations,
+		const float* opacities,
+		const float* shs,
+		bool* clamped,
+		const float* cov3D_precomp,
+		const float* colors_precomp,
+		const float* viewmatrix,
+		const float* projmatrix,
+		const float3* cam_pos,
+		const int W, int H,
+		const float focal_x, float focal_y,
+		const float tan_fovx, float tan_fovy,
+		int* radii,
+		float2* points_xy_image,
+		float* depths,
+		float* cov3Ds,
+		float* colors,
+		float4* conic_opacity,
+		const dim3 grid,
+		uint32_t* tiles_touched,
+		bool prefiltered,
+		int num_threads);
+
+	// Bin the Gaussians into tiles and sort each tile's list by depth.
+	void binning(int P,
+		const float2* points_xy_image,
+		const float* depths,
+		const int* radii,
+		const dim3 grid,
+		uint64_t* point_list_keys,
+		uint32_t* point_list,
+		uint2* ranges,
+		int num_threads);
+
+	// Conservative range of tile rows a Gaussian can reach with alpha >= 1/255.
+	bool contributingRows(const float2 xy, const float4 con_o, int pix_min_y, int& row_begin, int& row_end);
+
+	// Main rasterization method.
+	void render(
+		const dim3 grid,
+		const uint2* ranges,
+		const uint32_t* point_list,
+		int W, int H,
+		const float2* points_xy_image,
+		const float* features,
+		const float4* conic_opacity,
+		float* final_T,
+		uint32_t* n_contrib,
+		const float* bg_color,
+		float* out_color,
+		int num_threads);
+}
+}
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "include/gaussian_chunk_pager.h"
+#include "include/gaussian_parameter_store.h"
+
+const std::size_t id_column = 22;
+
+/**
+ * @brief Per-Gaussian columns of GaussianModel around a corridor segment,
+ *        ids are kept in their own column to check the reloaded rows
+ */
+std::vector<torch::Tensor> makeSegment(
+    std::int64_t num_points, int segment, float segment_length, std::int64_t first_id)
+{
+    auto options = torch::TensorOptions().dtype(torch::kFloat);
+    torch::Tensor xyz = torch::rand({num_points, 3}, options) * torch::tensor({segment_length, 4.0f, 3.0f});
+    xyz.select(1, 0).add_(segment * segment_length);
+    std::vector<torch::Tensor> params = {
+        xyz,
+        torch::randn({num_points, 1, 3}, options),
+        torch::randn({num_points, 15, 3}, options),
+        torch::randn({num_points, 1}, options),
+        torch::randn({num_points, 3}, options),
+        torch::randn({num_points, 4}, options)
+    };
+    std::vector<torch::Tensor> columns = params;
+    for (int moment = 0; moment < 2; ++moment)
+        for (auto& param : params)
+            columns.emplace_back(torch::randn_like(param));
+    columns.emplace_back(torch::zeros({num_points}, options.dtype(torch::kInt32)));
+    columns.emplace_back(torch::zeros({num_points, 1}, options));
+    columns.emplace_back(torch::zeros({num_points, 1}, options));
+    columns.emplace_back(torch::zeros({num_points}, options));
+    columns.emplace_back(torch::arange(first_id, first_id + num_points, options.dtype(torch::kLong)));
+    return columns;
+}
+
+std::size_t residentBytes(const GaussianParameterStore& store)
+{
+    std::size_t num_bytes = 0;
+    for (std::size_t idx = 0; idx < store.numColumns(); ++idx) {
+        auto column = store.column(idx);
+        num_bytes += column.numel() * column.element_size();
+    }
+    return num_bytes;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 4)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [num_segments]"          /*1*/
+                  << " [points_per_segment]"    /*2*/
+                  << " [max_resident]"          /*3*/
+                  << std::endl;
+        return 1;
+    }
+    const int num_segments = argc > 1 ? std::stoi(argv[1]) : 40;
+    const std::int64_t points_per_segment = argc > 2 ? std::stoll(argv[2]) : 50000;
+    const std::int64_t max_resident = argc > 3 ? std::stoll(argv[3]) : 5 * points_per_segment;
+    const float segment_length = 4.0f;
+    const float keep_radius = 2.0f * segment_length;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "photo_slam_benchmark_chunks";
+    torch::manual_seed(0);
+
+    std::cout << "Corridor of " << num_segments << " segments of " << segment_length << " m, "
+              << points_per_segment << " points each, at most " << max_resident << " resident" << std::endl
+              << std::endl
+              << std::setw(10) << "segment"
+              << std::setw(12) << "resident"
+              << std::setw(12) << "on disk"
+              << std::setw(10) << "chunks"
+              << std::setw(14) << "paging ms" << std::endl;
+
+    GaussianParameterStore store;
+    std::vector<torch::Tensor> reference_xyz;
+    std::size_t peak_bytes = 0;
+    std::size_t all_resident_bytes = 0;
+    double max_paging_ms = 0.0;
+    {
+        GaussianChunkPager pager(directory, segment_length);
+        for (int segment = 0; segment < num_segments; ++segment) {
+            auto rows = makeSegment(points_per_segment, segment, segment_length, segment * points_per_segment);
+            if (segment == 0)
+                store.reset(rows);
+            else
+                store.append(rows);
+
+            // One training step over the resident rows, the paged ones must keep their values
+            torch::Tensor step = 0.001f * torch::ones({store.size(), 3});
+            store.assign(0, store.column(0) + step);
+            reference_xyz.emplace_back(rows[0]);
+            torch::Tensor all_xyz = torch::cat(reference_xyz, 0);
+            all_xyz.index_add_(0, store.column(id_column), step);
+            reference_xyz = {all_xyz};
+
+            // The camera walks down the corridor
+            torch::Tensor center = torch::tensor({(segment + 0.5f) * segment_length, 2.0f, 1.5f});
+            auto start = std::chrono::steady_clock::now();
+            pager.pageIn(store, center, keep_radius);
+            pager.pageOut(store, 0, center, keep_radius, max_resident);
+            auto end = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            max_paging_ms = std::max(max_paging_ms, ms);
+            peak_bytes = std::max(peak_bytes, residentBytes(store));
+
+            std::cout << std::setw(10) << segment
+                      << std::setw(12) << store.size()
+                      << std::setw(12) << pager.numPagedPoints()
+                      << std::setw(10) << pager.numPagedChunks()
+                      << std::setw(14) << std::fixed << std::setprecision(3) << ms << std::endl;
+        }
+
+        auto& stats = pager.stats();
+        std::cout << std::endl
+                  << "Paged out " << stats.num_points_out_ << " points in " << stats.num_chunks_out_ << " chunks, "
+                  << stats.bytes_written_ / (1024.0 * 1024.0) << " MB, " << stats.out_ms_ << " ms" << std::endl
+                  << "Paged in " << stats.num_points_in_ << " points in " << stats.num_chunks_in_ << " chunks, "
+                  << stats.bytes_read_ / (1024.0 * 1024.0) << " MB, " << stats.in_ms_ << " ms" << std::endl
+                  << "Slowest paging pass " << max_paging_ms << " ms" << std::endl;
+
+        pager.pageInAll(store);
+        all_resident_bytes = residentBytes(store);
+    }
+    std::cout << "Peak resident " << peak_bytes / (1024.0 * 1024.0) << " MB, all resident "
+              << all_resident_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+
+    // Every row is back, with the values it had when it was paged out
+    torch::Tensor ids = store.column(id_column);
+    torch::Tensor order = std::get<1>(ids.sort());
+    torch::Tensor xyz = store.column(0).index_select(0, order);
+    bool complete = store.size() == num_segments * points_per_segment
+                    && ids.index_select(0, order).equal(torch::arange(store.size(), ids.options()));
+    float max_diff = complete ? (xyz - reference_xyz[0]).abs().max().item<float>() : -1.0f;
+    std::cout << std::endl << store.size() << " points after paging everything back in, "
+              << (complete ? "ids complete" : "ids MISSING") << ", max |xyz - reference| "
+              << std::scientific << max_diff << std::endl;
+
+    return (complete && max_diff == 0.0f) ? 0 : 1;
+}
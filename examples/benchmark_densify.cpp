@@ -0,0 +1,145 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <torch/torch.h>
+
+#include "include/gaussian_model.h"
+#include "include/gaussian_parameters.h"
+
+const float max_grad = 0.0002f;
+const float min_opacity = 0.005f;
+const float extent = 4.0f;
+const int max_screen_size = 20;
+
+/**
+ * @brief Model of `num_points` random Gaussians with accumulated gradients,
+ *        of which about 10% qualify for densification and 5% for pruning
+ */
+std::shared_ptr<GaussianModel> makeModel(std::int64_t num_points, const std::string& device)
+{
+    GaussianModelParams model_params;
+    model_params.data_device_ = device;
+    auto model = std::make_shared<GaussianModel>(model_params);
+    model->active_sh_degree_ = 3;
+    model->spatial_lr_scale_ = extent;
+    auto options = torch::TensorOptions().dtype(torch::kFloat).device(model->device_type_);
+    model->xyz_ = torch::rand({num_points, 3}, options) * extent;
+    model->features_dc_ = torch::randn({num_points, 1, 3}, options);
+    model->features_rest_ = torch::zeros({num_points, 15, 3}, options);
+    // Around percent_dense * extent = 0.04, so that both clones and splits occur
+    model->scaling_ = torch::randn({num_points, 3}, options) * 0.5f - 3.9f;
+    model->rotation_ = torch::randn({num_points, 4}, options);
+    model->opacity_ = torch::randn({num_points, 1}, options) * 2.0f;
+    model->trainingSetup(GaussianOptimizationParams());
+
+    torch::NoGradGuard no_grad;
+    model->denom_.fill_(10.0f);
+    model->xyz_gradient_accum_.copy_(torch::rand({num_points, 1}, options) * 10.0f * max_grad / 0.9f);
+    model->opacity_.masked_fill_(torch::rand({num_points, 1}, options) < 0.05f, -10.0f);
+    return model;
+}
+
+/**
+ * @brief densifyAndPrune before the plan: clone, split, then prune, each a pass over the store
+ */
+void sequentialDensifyAndPrune(GaussianModel& model)
+{
+    auto grads = model.xyz_gradient_accum_ / model.denom_;
+    grads.index_put_({grads.isnan()}, 0.0f);
+    model.densifyAndClone(grads, max_grad, extent);
+    model.densifyAndSplit(grads, max_grad, extent);
+
+    auto prune_mask = (model.getOpacityActivation() < min_opacity).squeeze();
+    auto big_points_vs = model.max_radii2D_ > max_screen_size;
+    auto big_points_ws = std::get<0>(model.getScalingActivation().max(/*dim=*/1)) > 0.1f * extent;
+    prune_mask = torch::logical_or(torch::logical_or(prune_mask, big_points_vs), big_points_ws);
+    model.prunePoints(prune_mask);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [cpu|cuda]"          /*1*/
+                  << " [num_repeats]"       /*2*/
+                  << std::endl;
+        return 1;
+    }
+    std::string device = torch::cuda::is_available() ? "cuda" : "cpu";
+    if (argc > 1)
+        device = argv[1];
+    const int num_repeats = argc > 2 ? std::stoi(argv[2]) : 5;
+    const bool cuda = (device == "cuda");
+    auto synchronize = [cuda]() {
+        if (cuda)
+            torch::cuda::synchronize();
+    };
+
+    std::cout << "Densification on " << device << ", mean of " << num_repeats << " steps" << std::endl
+              << std::endl
+              << std::setw(12) << "gaussians"
+              << std::setw(14) << "after"
+              << std::setw(18) << "sequential ms"
+              << std::setw(14) << "planned ms"
+              << std::setw(14) << "plan ms" << std::endl;
+    for (std::int64_t num_points : {100000, 500000, 1000000, 3000000})
+    {
+        double ms[3] = {0.0, 0.0, 0.0};
+        std::int64_t num_after[2] = {0, 0};
+        for (int i = 0; i < num_repeats; ++i) {
+            for (int mode = 0; mode < 2; ++mode) {
+                torch::manual_seed(i);
+                auto model = makeModel(num_points, device);
+                synchronize();
+                auto start = std::chrono::steady_clock::now();
+                if (mode == 0) {
+                    sequentialDensifyAndPrune(*model);
+                }
+                else {
+                    auto plan = model->planDensification(max_grad, min_opacity, extent, max_screen_size);
+                    synchronize();
+                    ms[2] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    model->applyDensification(plan);
+                }
+                synchronize();
+                auto end = std::chrono::steady_clock::now();
+                ms[mode] += std::chrono::duration<double, std::milli>(end - start).count();
+                num_after[mode] = model->xyz_.size(0);
+            }
+        }
+        if (num_after[0] != num_after[1])
+            std::cerr << "Sequential and planned densification keep " << num_after[0]
+                      << " and " << num_after[1] << " points" << std::endl;
+        std::cout << std::setw(12) << num_points
+                  << std::setw(14) << num_after[1]
+                  << std::setw(18) << std::fixed << std::setprecision(3) << ms[0] / num_repeats
+                  << std::setw(14) << ms[1] / num_repeats
+                  << std::setw(14) << ms[2] / num_repeats << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/gaussian_keyframe.h"
+#include "include/keyframe_sampler.h"
+
+typedef std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> KeyframeMap;
+
+/**
+ * @brief The former sliding window picking: walk a shuffled index through the keyframe map
+ */
+class MapWalkSampler
+{
+public:
+    MapWalkSampler(KeyframeMap& keyframes) : keyframes_(keyframes), rng_(0)
+    {
+        shuffle_.resize(keyframes_.size());
+        std::iota(shuffle_.begin(), shuffle_.end(), 0);
+        std::shuffle(shuffle_.begin(), shuffle_.end(), rng_);
+    }
+
+    std::shared_ptr<GaussianKeyframe> useOne()
+    {
+        std::shared_ptr<GaussianKeyframe> viewpoint_cam = nullptr;
+        std::size_t start_shuffle_idx = shuffle_idx_;
+        do {
+            ++shuffle_idx_;
+            if (shuffle_idx_ >= shuffle_.size())
+                shuffle_idx_ = 0;
+            if (shuffle_idx_ == start_shuffle_idx)
+                for (auto& kfit : keyframes_)
+                    kfit.second->remaining_times_of_use_ += 1;
+            auto random_cam_it = keyframes_.begin();
+            for (std::size_t cam_idx = 0; cam_idx < shuffle_[shuffle_idx_]; ++cam_idx)
+                ++random_cam_it;
+            viewpoint_cam = (*random_cam_it).second;
+        } while (viewpoint_cam->remaining_times_of_use_ <= 0);
+        --(viewpoint_cam->remaining_times_of_use_);
+        return viewpoint_cam;
+    }
+
+protected:
+    KeyframeMap& keyframes_;
+    std::vector<std::size_t> shuffle_;
+    std::size_t shuffle_idx_ = 0;
+    std::mt19937 rng_;
+};
+
+/**
+ * @brief Keyframes of which only a small fraction still has times of use, as in long sequences
+ */
+KeyframeMap makeKeyframes(int num_keyframes, float available_ratio)
+{
+    KeyframeMap keyframes;
+    int num_available = std::max(1, static_cast<int>(num_keyframes * available_ratio));
+    for (int fid = 0; fid < num_keyframes; ++fid) {
+        auto pkf = std::make_shared<GaussianKeyframe>(fid, 0);
+        pkf->remaining_times_of_use_ = (fid % (num_keyframes / num_available) == 0) ? 2 : 0;
+        keyframes.emplace(fid, pkf);
+    }
+    return keyframes;
+}
+
+template <typename PickFunc>
+double nanosecondsPerPick(int num_picks, PickFunc pick)
+{
+    std::size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_picks; ++i)
+        checksum += pick()->fid_;
+    auto end = std::chrono::steady_clock::now();
+    if (checksum == static_cast<std::size_t>(-1))
+        std::cout << checksum << std::endl;
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_picks;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [num_picks]"    /*1*/
+                  << std::endl;
+        return 1;
+    }
+    const int num_picks = argc > 1 ? std::stoi(argv[1]) : 2000;
+    const float available_ratio = 0.05f;
+
+    std::cout << "Keyframe picking, " << available_ratio * 100 << "% of keyframes available, "
+              << num_picks << " picks" << std::endl;
+    std::cout << std::setw(12) << "keyframes"
+              << std::setw(16) << "map walk ns"
+              << std::setw(16) << "uniform ns"
+              << std::setw(16) << "weighted ns" << std::endl;
+
+    for (int num_keyframes : {1000, 10000, 50000})
+    {
+        KeyframeMap walk_keyframes = makeKeyframes(num_keyframes, available_ratio);
+        MapWalkSampler walk(walk_keyframes);
+        double walk_ns = nanosecondsPerPick(num_picks, [&]() { return walk.useOne(); });
+
+        double sampler_ns[2];
+        KeyframeSampler::Mode modes[2] = {KeyframeSampler::UNIFORM, KeyframeSampler::TIMES_OF_USE};
+        for (int m = 0; m < 2; ++m) {
+            KeyframeMap keyframes = makeKeyframes(num_keyframes, available_ratio);
+            KeyframeSampler sampler(0);
+            sampler.setMode(modes[m]);
+            for (auto& kfit : keyframes)
+                sampler.add(kfit.second);
+            sampler_ns[m] = nanosecondsPerPick(num_picks, [&]() { return sampler.useOne(); });
+        }
+
+        std::cout << std::setw(12) << num_keyframes
+                  << std::setw(16) << std::fixed << std::setprecision(1) << walk_ns
+                  << std::setw(16) << sampler_ns[0]
+                  << std::setw(16) << sampler_ns[1] << std::endl;
+    }
+
+    return 0;
+}
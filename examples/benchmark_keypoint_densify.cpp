@@ -0,0 +1,168 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "include/stereo_vision.h"
+
+/**
+ * @brief Keypoints of a synthetic keyframe: half with depth, the others
+ *        either near one of them (within a few pixels) or isolated
+ */
+struct SyntheticKeyframe
+{
+    SyntheticKeyframe(int64_t num_keypoints, int width, int height, torch::DeviceType device_type)
+        : width_(width)
+    {
+        int64_t num_with_depth = num_keypoints / 2;
+        int64_t num_near = (num_keypoints - num_with_depth) / 2;
+        int64_t num_isolated = num_keypoints - num_with_depth - num_near;
+        torch::Tensor size = torch::tensor({static_cast<float>(width - 1), static_cast<float>(height - 1)});
+        torch::Tensor with_depth = torch::rand({num_with_depth, 2}) * size;
+        torch::Tensor near = with_depth.index({torch::randint(num_with_depth, {num_near})})
+                             + 2.0f * torch::randn({num_near, 2});
+        torch::Tensor isolated = torch::rand({num_isolated, 2}) * size;
+        // Keypoints are at integer pixels plus subpixel refinement
+        torch::Tensor pixels = torch::cat({with_depth, near, isolated}, 0);
+        pixels = torch::min(torch::max(pixels, torch::zeros({2})), size);
+        torch::Tensor order = torch::randperm(num_keypoints);
+        kps_pixel_ = pixels.index({order}).contiguous().to(device_type);
+
+        torch::Tensor points = torch::randn({num_keypoints, 3});
+        points.select(1, 2).uniform_(0.5f, 5.0f);
+        points.select(1, 2).slice(0, num_with_depth).fill_(-1.0f);
+        kps_point_local_ = points.index({order}).contiguous().to(device_type);
+        kps_has3D_ = kps_point_local_.select(1, 2) > 0.0f;
+        colors_ = torch::rand({static_cast<int64_t>(width) * height, 3}).to(device_type);
+        intr_ = {600.0f, 600.0f, width / 2.0f, height / 2.0f};
+    }
+
+    torch::Tensor kps_pixel_, kps_has3D_, kps_point_local_, colors_;
+    std::vector<float> intr_;
+    int width_;
+};
+
+typedef std::function<std::tuple<torch::Tensor, torch::Tensor>(
+    torch::Tensor&, torch::Tensor&, torch::Tensor&, torch::Tensor&, float, std::vector<float>&, int)> Densify;
+
+double timeMs(SyntheticKeyframe& kf, float max_pixel_dist, const Densify& densify, int num_iters, bool cuda)
+{
+    double total_ms = 0.0;
+    for (int i = 0; i < num_iters + 1; ++i) {
+        if (cuda)
+            torch::cuda::synchronize();
+        auto start = std::chrono::steady_clock::now();
+        densify(kf.kps_pixel_, kf.kps_has3D_, kf.kps_point_local_, kf.colors_, max_pixel_dist, kf.intr_, kf.width_);
+        if (cuda)
+            torch::cuda::synchronize();
+        auto end = std::chrono::steady_clock::now();
+        // The first one warms up
+        if (i > 0)
+            total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    return total_ms / num_iters;
+}
+
+float maxDiff(const std::tuple<torch::Tensor, torch::Tensor>& a, const std::tuple<torch::Tensor, torch::Tensor>& b)
+{
+    if (std::get<0>(a).size(0) != std::get<0>(b).size(0))
+        return -1.0f;
+    if (std::get<0>(a).size(0) == 0)
+        return 0.0f;
+    float pt_diff = (std::get<0>(a).cpu() - std::get<0>(b).cpu()).abs().max().item<float>();
+    float color_diff = (std::get<1>(a).cpu() - std::get<1>(b).cpu()).abs().max().item<float>();
+    return std::max(pt_diff, color_diff);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [max_pixel_dist]"    /*1*/
+                  << " [num_iters]"         /*2*/
+                  << std::endl;
+        return 1;
+    }
+    // Squared, as Monocular.inactive_geo_densify_max_pixel_dist
+    const float max_pixel_dist = argc > 1 ? std::stof(argv[1]) : 16.0f;
+    const int num_iters = argc > 2 ? std::stoi(argv[2]) : 20;
+    const bool has_cuda = torch::cuda::is_available();
+    const int width = 1200, height = 680;
+
+    std::cout << "Monocular keypoint densification, " << width << "x" << height
+              << ", max squared pixel distance " << max_pixel_dist << std::endl << std::endl
+              << std::setw(10) << "keypoints"
+              << std::setw(12) << "densified"
+              << std::setw(16) << "CUDA all ms"
+              << std::setw(16) << "CUDA grid ms"
+              << std::setw(14) << "CPU grid ms"
+              << std::setw(18) << "max |grid - all|"
+              << std::setw(18) << "max |CPU - CUDA|" << std::endl;
+
+    torch::manual_seed(0);
+    for (int64_t num_keypoints : {1000, 2000, 4000, 8000, 16000}) {
+        SyntheticKeyframe kf_cpu(num_keypoints, width, height, torch::kCPU);
+        auto result_cpu = monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypointsCPU(
+            kf_cpu.kps_pixel_, kf_cpu.kps_has3D_, kf_cpu.kps_point_local_, kf_cpu.colors_,
+            max_pixel_dist, kf_cpu.intr_, kf_cpu.width_);
+        double cpu_ms = timeMs(kf_cpu, max_pixel_dist, monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypointsCPU, num_iters, false);
+
+        std::cout << std::setw(10) << num_keypoints
+                  << std::setw(12) << std::get<0>(result_cpu).size(0);
+        if (has_cuda) {
+            SyntheticKeyframe kf_cuda = kf_cpu;
+            kf_cuda.kps_pixel_ = kf_cpu.kps_pixel_.cuda();
+            kf_cuda.kps_has3D_ = kf_cpu.kps_has3D_.cuda();
+            kf_cuda.kps_point_local_ = kf_cpu.kps_point_local_.cuda();
+            kf_cuda.colors_ = kf_cpu.colors_.cuda();
+            auto result_all = monocularPinholeInactiveGeoDensifyBySearchingAllKeypoints(
+                kf_cuda.kps_pixel_, kf_cuda.kps_has3D_, kf_cuda.kps_point_local_, kf_cuda.colors_,
+                max_pixel_dist, kf_cuda.intr_, kf_cuda.width_);
+            auto result_grid = monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypoints(
+                kf_cuda.kps_pixel_, kf_cuda.kps_has3D_, kf_cuda.kps_point_local_, kf_cuda.colors_,
+                max_pixel_dist, kf_cuda.intr_, kf_cuda.width_);
+            double all_ms = timeMs(kf_cuda, max_pixel_dist, monocularPinholeInactiveGeoDensifyBySearchingAllKeypoints, num_iters, true);
+            double grid_ms = timeMs(kf_cuda, max_pixel_dist, monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypoints, num_iters, true);
+            std::cout << std::setw(16) << std::fixed << std::setprecision(3) << all_ms
+                      << std::setw(16) << grid_ms
+                      << std::setw(14) << cpu_ms
+                      << std::setw(18) << std::scientific << std::setprecision(2) << maxDiff(result_grid, result_all)
+                      << std::setw(18) << maxDiff(result_cpu, result_grid) << std::endl;
+        }
+        else {
+            std::cout << std::setw(16) << "-"
+                      << std::setw(16) << "-"
+                      << std::setw(14) << std::fixed << std::setprecision(3) << cpu_ms
+                      << std::setw(18) << "-"
+                      << std::setw(18) << "-" << std::endl;
+        }
+    }
+
+    return 0;
+}
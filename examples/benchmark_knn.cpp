@@ -0,0 +1,143 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <torch/torch.h>
+#include <ATen/Parallel.h>
+
+#include "include/gaussian_knn.h"
+#include "third_party/simple-knn/spatial.h"
+
+/**
+ * @brief Mean squared distance to the k nearest other points, by brute force
+ */
+torch::Tensor bruteForceMeanDist2(const torch::Tensor& points, std::int64_t num_queries, int k)
+{
+    torch::Tensor dist2 = torch::cdist(points.slice(0, 0, num_queries), points).pow(2);
+    dist2.diagonal().fill_(std::numeric_limits<float>::infinity());
+    return std::get<0>(dist2.topk(k, /*dim=*/1, /*largest=*/false)).mean(/*dim=*/1);
+}
+
+/**
+ * @brief Points sampled on a few planes of a room, like a reconstructed indoor scene
+ */
+torch::Tensor makeScene(std::int64_t num_points)
+{
+    torch::Tensor xyz = torch::rand({num_points, 3}) * torch::tensor({6.0f, 4.0f, 3.0f});
+    torch::Tensor wall = torch::randint(0, 3, {num_points});
+    xyz.select(1, 2).masked_fill_(wall == 0, 0.0f);
+    xyz.select(1, 0).masked_fill_(wall == 1, 0.0f);
+    xyz.select(1, 1).masked_fill_(wall == 2, 4.0f);
+    return xyz + 0.002f * torch::randn_like(xyz);
+}
+
+double timeMs(const std::function<void()>& run, bool cuda, int num_repeats = 3)
+{
+    run();
+    double total_ms = 0.0;
+    for (int i = 0; i < num_repeats; ++i) {
+        if (cuda)
+            torch::cuda::synchronize();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        if (cuda)
+            torch::cuda::synchronize();
+        auto end = std::chrono::steady_clock::now();
+        total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    return total_ms / num_repeats;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [max_num_points]"    /*1*/
+                  << " [num_threads]"       /*2*/
+                  << std::endl;
+        return 1;
+    }
+    const std::int64_t max_num_points = argc > 1 ? std::stoll(argv[1]) : 3000000;
+    if (argc > 2)
+        at::set_num_threads(std::stoi(argv[2]));
+    const bool has_cuda = torch::cuda::is_available();
+    torch::manual_seed(0);
+
+    std::cout << "KNN on " << at::get_num_threads() << " CPU threads"
+              << (has_cuda ? ", against distCUDA2" : ", CUDA not available") << std::endl;
+
+    // Exactness
+    {
+        const std::int64_t num_points = 5000;
+        torch::Tensor points = makeScene(num_points);
+        torch::Tensor reference = bruteForceMeanDist2(points, num_points, 3);
+        torch::Tensor cpu = knnMeanDist2CPU(points, num_points, 3);
+        std::cout << std::endl << num_points << " points, max relative error against brute force: cpu "
+                  << ((cpu - reference).abs() / reference.clamp_min(1e-12f)).max().item<float>();
+        if (has_cuda) {
+            torch::Tensor cuda = distCUDA2(points.cuda()).cpu();
+            std::cout << ", distCUDA2 " << ((cuda - reference).abs() / reference.clamp_min(1e-12f)).max().item<float>();
+        }
+        std::cout << std::endl;
+    }
+
+    // A sparse batch of new points among the existing Gaussians
+    {
+        const std::int64_t num_existing = std::min<std::int64_t>(max_num_points, 1000000);
+        const std::int64_t num_new = 2000;
+        torch::Tensor existing = makeScene(num_existing);
+        torch::Tensor batch = makeScene(num_new);
+        torch::Tensor alone = knnMeanDist2CPU(batch, num_new, 3).sqrt();
+        torch::Tensor among = knnMeanDist2CPU(torch::cat({batch, existing}), num_new, 3).sqrt();
+        std::cout << std::endl << num_new << " new points among " << num_existing
+                  << " Gaussians, median initial scale: batch only " << alone.median().item<float>()
+                  << ", with the existing " << among.median().item<float>() << std::endl;
+    }
+
+    // Throughput
+    std::cout << std::endl
+              << std::setw(12) << "points"
+              << std::setw(16) << "cpu ms"
+              << std::setw(16) << "distCUDA2 ms" << std::endl;
+    for (std::int64_t num_points : {100000, 1000000, 3000000})
+    {
+        if (num_points > max_num_points)
+            break;
+        torch::Tensor points = makeScene(num_points);
+        double cpu_ms = timeMs([&]() { knnMeanDist2CPU(points, num_points, 3); }, false);
+        std::cout << std::setw(12) << num_points
+                  << std::setw(16) << std::fixed << std::setprecision(3) << cpu_ms;
+        if (has_cuda) {
+            torch::Tensor cuda_points = points.cuda();
+            std::cout << std::setw(16) << timeMs([&]() { distCUDA2(cuda_points); }, true);
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "include/gaussian_optimizer.h"
+
+// Learning rates of the six Gaussian parameter groups with the default settings
+const std::vector<float> group_lrs = {0.00016f, 0.0025f, 0.0025f / 20.0f, 0.05f, 0.005f, 0.001f};
+
+std::vector<torch::Tensor> makeParams(std::int64_t num_points, int sh_degree, torch::DeviceType device_type)
+{
+    auto options = torch::TensorOptions().dtype(torch::kFloat).device(device_type);
+    int num_rest = (sh_degree + 1) * (sh_degree + 1) - 1;
+    return {
+        torch::randn({num_points, 3}, options),
+        torch::randn({num_points, 1, 3}, options),
+        torch::randn({num_points, num_rest, 3}, options),
+        torch::randn({num_points, 1}, options),
+        torch::randn({num_points, 3}, options),
+        torch::randn({num_points, 4}, options)
+    };
+}
+
+std::vector<torch::Tensor> cloneLeaves(const std::vector<torch::Tensor>& tensors)
+{
+    std::vector<torch::Tensor> leaves;
+    for (auto& tensor : tensors)
+        leaves.emplace_back(tensor.clone().requires_grad_());
+    return leaves;
+}
+
+/**
+ * @brief Quadratic pull towards the targets, seen only through the visible points like a rendered view
+ */
+void setGradients(
+    std::vector<torch::Tensor>& params,
+    const std::vector<torch::Tensor>& targets,
+    const torch::Tensor& visible)
+{
+    torch::NoGradGuard no_grad;
+    for (std::size_t g = 0; g < params.size(); ++g) {
+        auto shape = params[g].sizes().vec();
+        std::fill(shape.begin() + 1, shape.end(), 1);
+        params[g].mutable_grad() = 2.0f * (params[g] - targets[g]) * visible.to(torch::kFloat).view(shape);
+    }
+}
+
+double totalLoss(const std::vector<torch::Tensor>& params, const std::vector<torch::Tensor>& targets)
+{
+    torch::NoGradGuard no_grad;
+    double loss = 0.0;
+    for (std::size_t g = 0; g < params.size(); ++g)
+        loss += (params[g] - targets[g]).pow(2).sum().item<double>();
+    return loss / params[0].size(0);
+}
+
+/**
+ * @brief Stock torch::optim::Adam or GaussianAdam over the same six groups
+ */
+class Runner
+{
+public:
+    Runner(const std::vector<torch::Tensor>& init, int mode) : mode_(mode)
+    {
+        params_ = cloneLeaves(init);
+        if (mode_ == 0) {
+            torch::optim::AdamOptions adam_options;
+            adam_options.set_lr(group_lrs[0]);
+            adam_options.eps() = 1e-15;
+            stock_.reset(new torch::optim::Adam(std::vector<torch::Tensor>{params_[0]}, adam_options));
+            for (std::size_t g = 1; g < params_.size(); ++g) {
+                stock_->add_param_group(std::vector<torch::Tensor>{params_[g]});
+                stock_->param_groups()[g].options().set_lr(group_lrs[g]);
+            }
+        }
+        else {
+            std::vector<torch::Tensor> exp_avgs, exp_avg_sqs;
+            for (auto& param : params_) {
+                exp_avgs.emplace_back(torch::zeros_like(param));
+                exp_avg_sqs.emplace_back(torch::zeros_like(param));
+            }
+            fused_.reset(new GaussianAdam(0.9f, 0.999f, 1e-15f));
+            fused_->bind(params_, exp_avgs, exp_avg_sqs);
+            fused_->setSparse(mode_ == 2);
+            for (std::size_t g = 0; g < params_.size(); ++g)
+                fused_->setLearningRate(g, group_lrs[g]);
+        }
+    }
+
+    void step(const torch::Tensor& visible)
+    {
+        if (mode_ == 0) {
+            stock_->step();
+            stock_->zero_grad(true);
+        }
+        else {
+            fused_->step(visible);
+            fused_->zeroGrad();
+        }
+    }
+
+    std::vector<torch::Tensor> params_;
+
+protected:
+    int mode_;
+    std::unique_ptr<torch::optim::Adam> stock_;
+    std::unique_ptr<GaussianAdam> fused_;
+};
+
+const char* mode_names[3] = {"torch Adam", "fused", "fused sparse"};
+
+int main(int argc, char** argv)
+{
+    if (argc > 5)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [num_steps]"         /*1*/
+                  << " [visible_ratio]"     /*2*/
+                  << " [cpu|cuda]"          /*3*/
+                  << " [sh_degree]"         /*4*/
+                  << std::endl;
+        return 1;
+    }
+    const int num_steps = argc > 1 ? std::stoi(argv[1]) : 200;
+    const float visible_ratio = argc > 2 ? std::stof(argv[2]) : 0.25f;
+    torch::DeviceType device_type = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
+    if (argc > 3)
+        device_type = (std::string(argv[3]) == "cuda") ? torch::kCUDA : torch::kCPU;
+    // Stored SH degree, the model only holds the active bands
+    const int sh_degree = argc > 4 ? std::stoi(argv[4]) : 3;
+    auto synchronize = [device_type]() {
+        if (device_type == torch::kCUDA)
+            torch::cuda::synchronize();
+    };
+
+    std::cout << "Adam on " << (device_type == torch::kCUDA ? "cuda" : "cpu") << ", SH degree " << sh_degree
+              << ", " << visible_ratio * 100 << "% of the points visible per step" << std::endl;
+
+    // Convergence
+    {
+        const std::int64_t num_points = 100000;
+        torch::manual_seed(0);
+        auto init = makeParams(num_points, sh_degree, device_type);
+        std::vector<torch::Tensor> targets;
+        for (auto& param : init)
+            targets.emplace_back(param + 0.05f * torch::randn_like(param));
+        std::vector<torch::Tensor> visibles;
+        for (int i = 0; i < num_steps; ++i)
+            visibles.emplace_back(torch::rand({num_points}, torch::TensorOptions().device(device_type)) < visible_ratio);
+
+        std::cout << std::endl << num_points << " points, " << num_steps << " steps, initial loss "
+                  << totalLoss(init, targets) << std::endl;
+        std::cout << std::setw(16) << "optimizer"
+                  << std::setw(16) << "final loss"
+                  << std::setw(20) << "max |p - torch p|" << std::endl;
+        std::vector<torch::Tensor> reference;
+        for (int mode = 0; mode < 3; ++mode) {
+            Runner runner(init, mode);
+            for (int i = 0; i < num_steps; ++i) {
+                setGradients(runner.params_, targets, visibles[i]);
+                runner.step(visibles[i]);
+            }
+            if (mode == 0)
+                reference = runner.params_;
+            float max_diff = 0.0f;
+            for (std::size_t g = 0; g < reference.size(); ++g)
+                max_diff = std::max(max_diff, (runner.params_[g] - reference[g]).abs().max().item<float>());
+            std::cout << std::setw(16) << mode_names[mode]
+                      << std::setw(16) << std::scientific << std::setprecision(4) << totalLoss(runner.params_, targets)
+                      << std::setw(20) << max_diff << std::endl;
+        }
+    }
+
+    // Throughput
+    std::cout << std::endl
+              << std::setw(12) << "gaussians"
+              << std::setw(16) << "torch Adam ms"
+              << std::setw(16) << "fused ms"
+              << std::setw(16) << "sparse ms" << std::endl;
+    const int num_timed_steps = 20;
+    for (std::int64_t num_points : {100000, 1000000, 3000000})
+    {
+        auto init = makeParams(num_points, sh_degree, device_type);
+        torch::Tensor visible = torch::rand({num_points}, torch::TensorOptions().device(device_type)) < visible_ratio;
+        double ms[3];
+        for (int mode = 0; mode < 3; ++mode) {
+            Runner runner(init, mode);
+            // Fixed gradients, reattached before each timed step
+            setGradients(runner.params_, init, visible);
+            std::vector<torch::Tensor> grads;
+            for (auto& param : runner.params_)
+                grads.emplace_back(param.grad().clone());
+            double total_ms = 0.0;
+            for (int i = 0; i < num_timed_steps; ++i) {
+                for (std::size_t g = 0; g < grads.size(); ++g)
+                    runner.params_[g].mutable_grad() = grads[g];
+                synchronize();
+                auto start = std::chrono::steady_clock::now();
+                runner.step(visible);
+                synchronize();
+                auto end = std::chrono::steady_clock::now();
+                total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+            ms[mode] = total_ms / num_timed_steps;
+        }
+        std::cout << std::setw(12) << num_points
+                  << std::setw(16) << std::fixed << std::setprecision(3) << ms[0]
+                  << std::setw(16) << ms[1]
+                  << std::setw(16) << ms[2] << std::endl;
+    }
+
+    return 0;
+}
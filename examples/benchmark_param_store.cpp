@@ -0,0 +1,191 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "include/gaussian_parameter_store.h"
+
+/**
+ * @brief Per-Gaussian columns of GaussianModel: 6 parameters, their 2 Adam moments,
+ *        exist_since_iter_, xyz_gradient_accum_, denom_ and max_radii2D_
+ */
+std::vector<torch::Tensor> makeColumns(std::int64_t num_points, int sh_degree, torch::DeviceType device_type)
+{
+    auto options = torch::TensorOptions().dtype(torch::kFloat).device(device_type);
+    int num_rest = (sh_degree + 1) * (sh_degree + 1) - 1;
+    std::vector<torch::Tensor> params = {
+        torch::randn({num_points, 3}, options),
+        torch::randn({num_points, 1, 3}, options),
+        torch::zeros({num_points, num_rest, 3}, options),
+        torch::randn({num_points, 1}, options),
+        torch::randn({num_points, 3}, options),
+        torch::randn({num_points, 4}, options)
+    };
+    std::vector<torch::Tensor> columns = params;
+    for (int moment = 0; moment < 2; ++moment)
+        for (auto& param : params)
+            columns.emplace_back(torch::zeros_like(param));
+    columns.emplace_back(torch::zeros({num_points}, options.dtype(torch::kInt32)));
+    columns.emplace_back(torch::zeros({num_points, 1}, options));
+    columns.emplace_back(torch::zeros({num_points, 1}, options));
+    columns.emplace_back(torch::zeros({num_points}, options));
+    return columns;
+}
+
+/**
+ * @brief New rows as passed to densificationPostfix, moments and statistics left undefined
+ */
+std::vector<torch::Tensor> makeNewRows(std::int64_t num_new, int sh_degree, torch::DeviceType device_type)
+{
+    std::vector<torch::Tensor> rows = makeColumns(num_new, sh_degree, device_type);
+    for (std::size_t idx = 6; idx < rows.size(); ++idx)
+        if (idx != 18)
+            rows[idx] = torch::Tensor();
+    return rows;
+}
+
+/**
+ * @brief The former densificationPostfix: concatenate every column and recreate the statistics
+ */
+void legacyAppend(std::vector<torch::Tensor>& columns, std::vector<torch::Tensor>& rows)
+{
+    std::int64_t num_new = rows[0].size(0);
+    for (std::size_t idx = 0; idx < columns.size(); ++idx) {
+        auto shape = columns[idx].sizes().vec();
+        if (idx >= 19) {
+            shape[0] += num_new;
+            columns[idx] = torch::zeros(shape, columns[idx].options());
+        }
+        else if (rows[idx].defined())
+            columns[idx] = torch::cat({columns[idx], rows[idx]}, /*dim=*/0);
+        else {
+            shape[0] = num_new;
+            columns[idx] = torch::cat({columns[idx], torch::zeros(shape, columns[idx].options())}, /*dim=*/0);
+        }
+    }
+}
+
+/**
+ * @brief The former prunePoints: boolean-index every column
+ */
+void legacyPrune(std::vector<torch::Tensor>& columns, torch::Tensor& valid_mask)
+{
+    for (auto& column : columns)
+        column = column.index({valid_mask}).clone();
+}
+
+void storeAppend(GaussianParameterStore& store, std::vector<torch::Tensor>& rows)
+{
+    store.append(rows);
+    for (std::size_t idx = 19; idx < store.numColumns(); ++idx)
+        store.column(idx).zero_();
+}
+
+template <typename EventFunc>
+double millisecondsPerEvent(int num_events, torch::DeviceType device_type, EventFunc event)
+{
+    if (device_type == torch::kCUDA)
+        torch::cuda::synchronize();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_events; ++i)
+        event(i);
+    if (device_type == torch::kCUDA)
+        torch::cuda::synchronize();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / num_events;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 4)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [num_events]"    /*1*/
+                  << " [sh_degree]"     /*2*/
+                  << " [cpu|cuda]"      /*3*/
+                  << std::endl;
+        return 1;
+    }
+    const int num_events = argc > 1 ? std::stoi(argv[1]) : 20;
+    const int sh_degree = argc > 2 ? std::stoi(argv[2]) : 3;
+    torch::DeviceType device_type = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
+    if (argc > 3)
+        device_type = (std::string(argv[3]) == "cuda") ? torch::kCUDA : torch::kCPU;
+    // A Local BA adds the points of a new keyframe, densification then prunes a few
+    const double add_ratio = 0.005;
+    const double prune_ratio = 0.002;
+
+    std::cout << "Model growth on " << (device_type == torch::kCUDA ? "cuda" : "cpu")
+              << ", SH degree " << sh_degree << ", " << num_events << " events of +"
+              << add_ratio * 100 << "% / -" << prune_ratio * 100 << "% points" << std::endl;
+    std::cout << std::setw(12) << "gaussians"
+              << std::setw(16) << "append ms"
+              << std::setw(16) << "store append"
+              << std::setw(16) << "prune ms"
+              << std::setw(16) << "store prune"
+              << std::setw(10) << "reallocs" << std::endl;
+
+    for (std::int64_t num_points : {100000, 500000, 1000000, 2000000, 5000000})
+    {
+        const std::int64_t num_new = static_cast<std::int64_t>(num_points * add_ratio);
+        std::vector<std::vector<torch::Tensor>> new_rows;
+        for (int i = 0; i < num_events; ++i)
+            new_rows.emplace_back(makeNewRows(num_new, sh_degree, device_type));
+        // Pruning runs on the grown model, narrowed to its current size each time
+        torch::Tensor valid_mask = torch::rand(
+            {num_points + num_events * num_new}, torch::TensorOptions().device(device_type)) >= prune_ratio;
+
+        double legacy_append_ms, legacy_prune_ms, store_append_ms, store_prune_ms;
+        std::int64_t num_reallocations;
+        {
+            std::vector<torch::Tensor> columns = makeColumns(num_points, sh_degree, device_type);
+            legacy_append_ms = millisecondsPerEvent(num_events, device_type, [&](int i) {
+                legacyAppend(columns, new_rows[i]); });
+            legacy_prune_ms = millisecondsPerEvent(num_events, device_type, [&](int) {
+                torch::Tensor mask = valid_mask.narrow(0, 0, columns[0].size(0));
+                legacyPrune(columns, mask); });
+        }
+        {
+            GaussianParameterStore store;
+            store.reset(makeColumns(num_points, sh_degree, device_type));
+            std::int64_t initial_reallocations = store.numReallocations();
+            store_append_ms = millisecondsPerEvent(num_events, device_type, [&](int i) {
+                storeAppend(store, new_rows[i]); });
+            store_prune_ms = millisecondsPerEvent(num_events, device_type, [&](int) {
+                torch::Tensor mask = valid_mask.narrow(0, 0, store.size());
+                store.compact(mask); });
+            num_reallocations = store.numReallocations() - initial_reallocations;
+        }
+
+        std::cout << std::setw(12) << num_points
+                  << std::setw(16) << std::fixed << std::setprecision(2) << legacy_append_ms
+                  << std::setw(16) << store_append_ms
+                  << std::setw(16) << legacy_prune_ms
+                  << std::setw(16) << store_prune_ms
+                  << std::setw(10) << num_reallocations << std::endl;
+    }
+
+    return 0;
+}
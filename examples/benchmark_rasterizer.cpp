@@ -0,0 +1,178 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "include/gaussian_rasterizer.h"
+#include "cpu_rasterizer/rasterizer.h"
+
+/**
+ * @brief Synthetic scene of random Gaussians in front of an identity camera
+ */
+struct SyntheticScene
+{
+    SyntheticScene(int num_gaussians, int sh_degree, torch::DeviceType device_type)
+    {
+        auto options = torch::TensorOptions().dtype(torch::kFloat32);
+        torch::manual_seed(0);
+        auto depth = 2.0f + 6.0f * torch::rand({num_gaussians, 1}, options);
+        auto xy = (torch::rand({num_gaussians, 2}, options) * 2.0f - 1.0f) * depth * 0.6f;
+        means3D = torch::cat({xy, depth}, 1).to(device_type);
+        int num_coeffs = (sh_degree + 1) * (sh_degree + 1);
+        shs = (0.5f * torch::randn({num_gaussians, num_coeffs, 3}, options)).to(device_type);
+        opacities = (0.2f + 0.7f * torch::rand({num_gaussians, 1}, options)).to(device_type);
+        scales = (0.005f + 0.05f * torch::rand({num_gaussians, 3}, options)).to(device_type);
+        rotations = torch::nn::functional::normalize(
+            torch::randn({num_gaussians, 4}, options),
+            torch::nn::functional::NormalizeFuncOptions().dim(1)).to(device_type);
+    }
+
+    torch::Tensor means3D;
+    torch::Tensor shs;
+    torch::Tensor opacities;
+    torch::Tensor scales;
+    torch::Tensor rotations;
+};
+
+torch::Tensor projectionMatrix(float znear, float zfar, float tan_fovx, float tan_fovy)
+{
+    torch::Tensor P = torch::zeros({4, 4});
+    P.index({0, 0}) = 1.0f / tan_fovx;
+    P.index({1, 1}) = 1.0f / tan_fovy;
+    P.index({3, 2}) = 1.0f;
+    P.index({2, 2}) = zfar / (zfar - znear);
+    P.index({2, 3}) = -(zfar * znear) / (zfar - znear);
+    return P;
+}
+
+/**
+ * @brief Average milliseconds of one forward + backward pass through the rasterizer
+ */
+double benchmarkOnce(
+    const SyntheticScene& scene,
+    int width, int height, int sh_degree, int iterations,
+    torch::DeviceType device_type)
+{
+    const float tan_fovx = 0.6f, tan_fovy = tan_fovx * height / width;
+    torch::Tensor bg = torch::zeros({3}, torch::TensorOptions().device(device_type));
+    torch::Tensor viewmatrix = torch::eye(4).to(device_type);
+    torch::Tensor projmatrix = projectionMatrix(0.01f, 100.0f, tan_fovx, tan_fovy).transpose(0, 1).contiguous().to(device_type);
+    torch::Tensor campos = torch::zeros({3}, torch::TensorOptions().device(device_type));
+    GaussianRasterizationSettings raster_settings(
+        height, width, tan_fovx, tan_fovy, bg, 1.0f,
+        viewmatrix, projmatrix, sh_degree, campos, false);
+    GaussianRasterizer rasterizer(raster_settings);
+
+    torch::Tensor means3D = scene.means3D.clone().requires_grad_();
+    torch::Tensor shs = scene.shs.clone().requires_grad_();
+    torch::Tensor opacities = scene.opacities.clone().requires_grad_();
+    torch::Tensor scales = scene.scales.clone().requires_grad_();
+    torch::Tensor rotations = scene.rotations.clone().requires_grad_();
+    torch::Tensor target = torch::rand({3, height, width}).to(device_type);
+
+    auto step = [&]() {
+        torch::Tensor means2D = torch::zeros_like(means3D).requires_grad_();
+        auto rendered = rasterizer.forward(
+            means3D, means2D, opacities,
+            true, false, true, true, false,
+            shs, torch::Tensor(), scales, rotations, torch::Tensor());
+        torch::Tensor loss = (std::get<0>(rendered) - target).abs().mean();
+        loss.backward();
+    };
+
+    // Warm up the allocators
+    step();
+    if (device_type == torch::kCUDA)
+        torch::cuda::synchronize();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; ++it)
+        step();
+    if (device_type == torch::kCUDA)
+        torch::cuda::synchronize();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+void report(const std::string& backend, int num_gaussians, double ms)
+{
+    std::cout << std::setw(16) << backend
+              << std::setw(12) << num_gaussians
+              << std::setw(14) << std::fixed << std::setprecision(2) << ms
+              << std::setw(14) << std::fixed << std::setprecision(1) << 1000.0 / ms
+              << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 4)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [image_width]"    /*1*/
+                  << " [image_height]"   /*2*/
+                  << " [iterations]"     /*3*/
+                  << std::endl;
+        return 1;
+    }
+    const int width = argc > 1 ? std::stoi(argv[1]) : 640;
+    const int height = argc > 2 ? std::stoi(argv[2]) : 480;
+    const int iterations = argc > 3 ? std::stoi(argv[3]) : 10;
+    const int sh_degree = 3;
+
+    const int max_threads = CpuRasterizer::Rasterizer::numThreads();
+    std::vector<int> thread_counts = {1};
+    for (int n = 2; n < max_threads; n *= 2)
+        thread_counts.push_back(n);
+    if (max_threads > 1)
+        thread_counts.push_back(max_threads);
+
+    std::cout << "Forward + backward at " << width << "x" << height
+              << ", SH degree " << sh_degree << ", " << iterations << " iterations" << std::endl;
+    std::cout << std::setw(16) << "backend"
+              << std::setw(12) << "gaussians"
+              << std::setw(14) << "ms/iter"
+              << std::setw(14) << "iter/s" << std::endl;
+
+    for (int num_gaussians : {10000, 50000, 200000})
+    {
+        SyntheticScene cpu_scene(num_gaussians, sh_degree, torch::kCPU);
+        for (int num_threads : thread_counts)
+        {
+            CpuRasterizer::Rasterizer::setNumThreads(num_threads);
+            double ms = benchmarkOnce(cpu_scene, width, height, sh_degree, iterations, torch::kCPU);
+            report("cpu x" + std::to_string(num_threads), num_gaussians, ms);
+        }
+
+        if (torch::cuda::is_available())
+        {
+            SyntheticScene cuda_scene(num_gaussians, sh_degree, torch::kCUDA);
+            double ms = benchmarkOnce(cuda_scene, width, height, sh_degree, iterations, torch::kCUDA);
+            report("cuda", num_gaussians, ms);
+        }
+    }
+
+    return 0;
+}
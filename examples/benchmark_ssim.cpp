@@ -0,0 +1,136 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "include/loss_utils.h"
+
+/**
+ * @brief The former loss_utils::ssim: window rebuilt and five 11x11 grouped conv2d per call
+ */
+torch::Tensor legacySsim(torch::Tensor& img1, torch::Tensor& img2, torch::DeviceType device_type)
+{
+    const int window_size = 11;
+    auto channel = img1.size(-3);
+    auto window = loss_utils::create_window(window_size, channel, device_type);
+    window = window.type_as(img1);
+    return loss_utils::_ssim(img1, img2, window, window_size, channel);
+}
+
+/**
+ * @brief Loss value and gradient of a training step, 1 - SSIM
+ */
+template <typename SsimFunction>
+std::pair<float, torch::Tensor> lossAndGrad(
+    const torch::Tensor& render, torch::Tensor& gt, SsimFunction&& ssim)
+{
+    torch::Tensor image = render.detach().requires_grad_();
+    torch::Tensor loss = 1.0f - ssim(image, gt);
+    loss.backward();
+    return {loss.item<float>(), image.grad()};
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " [num_iters]"     /*1*/
+                  << " [cpu|cuda]"      /*2*/
+                  << std::endl;
+        return 1;
+    }
+    const int num_iters = argc > 1 ? std::stoi(argv[1]) : 50;
+    torch::DeviceType device_type = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
+    if (argc > 2)
+        device_type = (std::string(argv[2]) == "cuda") ? torch::kCUDA : torch::kCPU;
+    auto synchronize = [device_type]() {
+        if (device_type == torch::kCUDA)
+            torch::cuda::synchronize();
+    };
+    auto legacy = [device_type](torch::Tensor& img1, torch::Tensor& img2) { return legacySsim(img1, img2, device_type); };
+    auto fused = [device_type](torch::Tensor& img1, torch::Tensor& img2) { return loss_utils::ssim(img1, img2, device_type); };
+
+    std::cout << "SSIM loss forward + backward on " << (device_type == torch::kCUDA ? "cuda" : "cpu")
+              << ", " << num_iters << " iterations" << std::endl << std::endl
+              << std::setw(12) << "resolution"
+              << std::setw(14) << "conv2d ms"
+              << std::setw(14) << "fused ms"
+              << std::setw(14) << "eval ms"
+              << std::setw(14) << "|loss diff|"
+              << std::setw(14) << "max |grad|"
+              << std::setw(18) << "max |grad diff|" << std::endl;
+
+    torch::manual_seed(0);
+    const std::vector<std::pair<int, int>> resolutions = {{480, 640}, {680, 1200}, {1080, 1920}};
+    for (auto& resolution : resolutions) {
+        auto options = torch::TensorOptions().dtype(torch::kFloat).device(device_type);
+        torch::Tensor gt = torch::rand({3, resolution.first, resolution.second}, options);
+        torch::Tensor render = (gt + 0.1f * torch::randn_like(gt)).clamp(0.0f, 1.0f);
+
+        auto reference = lossAndGrad(render, gt, legacy);
+        auto result = lossAndGrad(render, gt, fused);
+        float loss_diff = std::abs(reference.first - result.first);
+        float grad_scale = reference.second.abs().max().item<float>();
+        float grad_diff = (reference.second - result.second).abs().max().item<float>();
+
+        double ms[3] = {0.0, 0.0, 0.0};
+        for (int mode = 0; mode < 3; ++mode) {
+            for (int i = 0; i < num_iters + 1; ++i) {
+                synchronize();
+                auto start = std::chrono::steady_clock::now();
+                if (mode == 0)
+                    lossAndGrad(render, gt, legacy);
+                else if (mode == 1)
+                    lossAndGrad(render, gt, fused);
+                else {
+                    // As renderAndRecordKeyframe, no gradient
+                    torch::NoGradGuard no_grad;
+                    fused(render, gt).item<float>();
+                }
+                synchronize();
+                auto end = std::chrono::steady_clock::now();
+                // The first one warms up
+                if (i > 0)
+                    ms[mode] += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+            ms[mode] /= num_iters;
+        }
+
+        std::cout << std::setw(12) << (std::to_string(resolution.second) + "x" + std::to_string(resolution.first))
+                  << std::setw(14) << std::fixed << std::setprecision(3) << ms[0]
+                  << std::setw(14) << ms[1]
+                  << std::setw(14) << ms[2]
+                  << std::setw(14) << std::scientific << std::setprecision(2) << loss_diff
+                  << std::setw(14) << grad_scale
+                  << std::setw(18) << grad_diff << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include <torch/torch.h>
+
+#include "include/gaussian_delta_log.h"
+
+std::uintmax_t directorySize(const std::filesystem::path& dir)
+{
+    std::uintmax_t size = 0;
+    for (auto& entry : std::filesystem::directory_iterator(dir))
+        if (entry.is_regular_file())
+            size += entry.file_size();
+    return size;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << std::endl
+                  << "Usage: " << argv[0]
+                  << " path_to_delta_directory"             /*1*/
+                  << " (optional)iteration"                 /*2*/
+                  << std::endl
+                  << "Folds every save up to the iteration (default: the last one) into a single base."
+                  << std::endl;
+        return 1;
+    }
+    std::filesystem::path delta_dir(argv[1]);
+    int iteration = (argc == 3) ? std::stoi(argv[2]) : -1;
+
+    auto iterations = GaussianDeltaLog::iterations(delta_dir);
+    if (iterations.empty()) {
+        std::cerr << "No saves in " << delta_dir << std::endl;
+        return 1;
+    }
+    std::cout << iterations.size() << " saves, iterations " << iterations.front()
+              << " to " << iterations.back() << ", " << directorySize(delta_dir) / (1 << 20) << " MB" << std::endl;
+
+    GaussianDeltaLog::compact(delta_dir, iteration);
+
+    iterations = GaussianDeltaLog::iterations(delta_dir);
+    std::cout << "Compacted to " << iterations.size() << " saves from iteration " << iterations.front()
+              << ", " << directorySize(delta_dir) / (1 << 20) << " MB" << std::endl;
+    return 0;
+}
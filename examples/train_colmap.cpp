@@ -139,10 +139,8 @@ void readColmapImagesBinary(
 
         cv::Mat image = cv::imread(image_path.string(), cv::ImreadModes::IMREAD_COLOR);
         cv::cvtColor(image, image, CV_BGR2RGB);
-        image.convertTo(image, CV_32FC3, 1.0f / 255.0f);
         cv::Mat imgRGB_undistorted;
         camera.undistortImage(image, imgRGB_undistorted);
-        new_kf->original_image_ = tensor_utils::cvMat2TorchTensor_Float32(image, pMapper->device_type_);
         //TODO: to fit to a size BUG (camera size != image size) in the gaussian splatting tandt dataset
         // new_kf->image_height_ = image.rows;
         // new_kf->image_width_ = image.cols;
@@ -238,7 +236,7 @@ void readColmapScene(std::shared_ptr<GaussianMapper> pMapper)
 
 int main(int argc, char** argv)
 {
-    if (argc != 4 && argc != 5)
+    if (argc < 4 || argc > 6)
     {
         std::cerr << std::endl
                   << "Usage: " << argv[0]
@@ -246,11 +244,12 @@ int main(int argc, char** argv)
                   << " path_to_colmap_data_directory/"       /*2*/
                   << " path_to_output_directory/"            /*3*/
                   << " (optional)no_viewer"                  /*4*/
+                  << " (optional)path_to_resume_checkpoint"  /*5*/
                   << std::endl;
         return 1;
     }
     bool use_viewer = true;
-    if (argc == 5)
+    if (argc >= 5)
         use_viewer = (std::string(argv[4]) == "no_viewer" ? false : true);
 
     std::string output_directory = std::string(argv[3]);
@@ -281,6 +280,8 @@ int main(int argc, char** argv)
     pGausMapper->setSensorType(MONOCULAR);
     pGausMapper->setColmapDataPath(argv[2]);
     readColmapScene(pGausMapper);
+    if (argc == 6)
+        pGausMapper->setResumeCheckpoint(argv[5]);
 
     // Create Gaussian Viewer
     std::thread viewer_thd;
@@ -27,13 +27,14 @@
 
 int main(int argc, char** argv)
 {
-    if (argc != 4)
+    if (argc != 4 && argc != 5)
     {
         std::cerr << std::endl
                   << "Usage: " << argv[0]
                   << " path_to_gaussian_mapping_settings"    /*1*/
                   << " path_to_camera_parameters"            /*2*/
-                  << " path_to_result_ply_file"              /*3*/
+                  << " path_to_result_ply|cgs|delta_dir"     /*3*/
+                  << " (optional)delta_iteration"            /*4*/
                   << std::endl;
         return 1;
     }
@@ -58,7 +59,12 @@ int main(int argc, char** argv)
     std::shared_ptr<GaussianMapper> pGausMapper =
         std::make_shared<GaussianMapper>(
             nullptr, gaussian_cfg_path, std::filesystem::path(), 0, device_type);
-    pGausMapper->loadPly(result_ply_path, camera_path);
+    if (std::filesystem::is_directory(result_ply_path))
+        pGausMapper->loadDeltaCheckpoint(result_ply_path, argc == 5 ? std::stoi(argv[4]) : -1, camera_path);
+    else if (result_ply_path.extension() == ".cgs")
+        pGausMapper->loadCompressed(result_ply_path, camera_path);
+    else
+        pGausMapper->loadPly(result_ply_path, camera_path);
 
     // Create Gaussian Viewer
     std::thread viewer_thd;
@@ -0,0 +1,58 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <torch/torch.h>
+
+#include <vector>
+
+#define ADAM_STEP_MAX_GROUPS 8
+
+/**
+ * @brief One parameter tensor of a fused Adam step, with its gradient and
+ *        moments, all contiguous float tensors of the same shape (num_points, ...)
+ */
+struct AdamStepGroup
+{
+    torch::Tensor param_;
+    torch::Tensor grad_;
+    torch::Tensor exp_avg_;
+    torch::Tensor exp_avg_sq_;
+    float lr_;
+    float bias_correction1_;
+    float bias_correction2_;
+};
+
+// Update all groups in place in a single pass, the same way as torch::optim::Adam
+// without weight decay. If `visible` is defined, only the points where it is true
+// are updated, the others keep their parameters and moments.
+
+void adamStepCUDA(
+    std::vector<AdamStepGroup>& groups,
+    const torch::Tensor& visible,
+    const float beta1,
+    const float beta2,
+    const float eps);
+
+void adamStepCPU(
+    std::vector<AdamStepGroup>& groups,
+    const torch::Tensor& visible,
+    const float beta1,
+    const float beta2,
+    const float eps);
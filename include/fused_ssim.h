@@ -0,0 +1,77 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <torch/torch.h>
+
+#include <vector>
+
+#define FUSED_SSIM_MAX_WINDOW 11
+
+/**
+ * @brief Normalized 1D Gaussian of the separable SSIM window, passed to the kernels by value
+ */
+struct SsimWindow
+{
+    float weights_[FUSED_SSIM_MAX_WINDOW];
+    int size_;
+};
+
+// Built once per window size, sigma 1.5 as in loss_utils::create_window
+const SsimWindow& ssimWindow(int window_size);
+
+// SSIM map of contiguous float images (num_planes, H, W), zero padded like the
+// grouped conv2d of loss_utils::_ssim. All five local moments are filtered in a
+// single separable pass. With `with_partials`, the derivatives of each SSIM value
+// w.r.t. mu1, E[img1^2] and E[img1 img2] are returned too, they are all the
+// backward needs: {ssim_map, d_mu1, d_sigma1_sq, d_sigma12}.
+
+std::vector<torch::Tensor> fusedSsimForwardCUDA(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const float C1,
+    const float C2,
+    const bool with_partials);
+
+std::vector<torch::Tensor> fusedSsimForwardCPU(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const float C1,
+    const float C2,
+    const bool with_partials);
+
+// Gradient w.r.t. img1 from the gradient of the SSIM map and the three partials
+// of the forward, img2 is taken as constant
+
+torch::Tensor fusedSsimBackwardCUDA(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const torch::Tensor& grad_map,
+    const std::vector<torch::Tensor>& partials);
+
+torch::Tensor fusedSsimBackwardCPU(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const torch::Tensor& grad_map,
+    const std::vector<torch::Tensor>& partials);
@@ -0,0 +1,66 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+/**
+ * @brief Versioned, columnar checkpoint of named tensors.
+ *
+ * The file is a header, a table of sections and then the raw bytes of every
+ * section at a page-aligned offset. Loading maps the file copy-on-write and
+ * hands out CPU tensors viewing the mapping, so nothing is parsed or copied
+ * until a tensor is moved to its device. The mapping lives as long as any of
+ * its tensors.
+ */
+class GaussianCheckpoint
+{
+public:
+    static constexpr std::uint32_t version_ = 1;
+    static constexpr std::uint64_t alignment_ = 4096;
+
+    void put(const std::string& name, const torch::Tensor& tensor);
+    void putInt(const std::string& name, std::int64_t value);
+    void putFloat(const std::string& name, double value);
+    void putString(const std::string& name, const std::string& value);
+
+    bool has(const std::string& name) const;
+    torch::Tensor get(const std::string& name) const;
+    std::int64_t getInt(const std::string& name) const;
+    double getFloat(const std::string& name) const;
+    std::string getString(const std::string& name) const;
+    std::vector<std::string> names() const;
+    std::size_t numBytes() const;
+
+    GaussianCheckpoint snapshot() const;
+
+    void save(const std::filesystem::path& path) const;
+    static GaussianCheckpoint load(const std::filesystem::path& path);
+
+protected:
+    std::map<std::string, torch::Tensor> sections_;
+};
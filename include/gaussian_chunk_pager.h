@@ -0,0 +1,101 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "gaussian_parameter_store.h"
+#include "gaussian_spatial_index.h"
+
+struct GaussianChunkPagerStats
+{
+    std::uint64_t num_chunks_out_ = 0;
+    std::uint64_t num_chunks_in_ = 0;
+    std::uint64_t num_points_out_ = 0;
+    std::uint64_t num_points_in_ = 0;
+    std::uint64_t bytes_written_ = 0;
+    std::uint64_t bytes_read_ = 0;
+    double out_ms_ = 0.0;  ///< total
+    double in_ms_ = 0.0;   ///< total
+};
+
+/**
+ * @brief Pages the rows of a GaussianParameterStore to disk by spatial chunk.
+ *
+ * The map is split into cubic chunks of `chunk_size` over the means. When the
+ * store holds more than a given number of rows, whole chunks are moved to disk,
+ * the farthest from a center first, with every column of their rows (parameters,
+ * Adam moments and statistics), so that reloading them resumes training exactly.
+ * Chunks within a radius of the center are never paged out.
+ *
+ * A chunk file uses the checkpoint container with one section per column.
+ * Columns whose row shape grew while the chunk was on disk (e.g. more SH bands)
+ * are zero-padded on reload. Not thread-safe, the store is only touched by the
+ * training thread.
+ */
+class GaussianChunkPager
+{
+public:
+    GaussianChunkPager(const std::filesystem::path& directory, float chunk_size);
+    ~GaussianChunkPager();
+
+    float chunkSize() const { return key_grid_.voxelSize(); }
+
+    std::int64_t pageOut(
+        GaussianParameterStore& store,
+        std::size_t xyz_column,
+        const torch::Tensor& center,
+        float keep_radius,
+        std::int64_t max_resident);
+    std::int64_t pageIn(
+        GaussianParameterStore& store,
+        const torch::Tensor& center,
+        float radius);
+    std::int64_t pageInAll(GaussianParameterStore& store);
+    torch::Tensor pagedColumn(std::size_t idx, const torch::Tensor& like) const;
+    std::vector<torch::Tensor> pagedColumns(const std::vector<torch::Tensor>& likes) const;
+
+    std::size_t numPagedChunks() const { return paged_.size(); }
+    std::int64_t numPagedPoints() const;
+    std::size_t pagedBytes() const;
+    const GaussianChunkPagerStats& stats() const { return stats_; }
+
+protected:
+    struct Chunk
+    {
+        std::filesystem::path path_;
+        std::int64_t num_points_ = 0;
+        std::size_t num_bytes_ = 0;
+        float center_[3] = {0.0f, 0.0f, 0.0f};  ///< mean of the points
+    };
+
+    std::int64_t pageIn(GaussianParameterStore& store, const std::vector<std::int64_t>& keys);
+
+protected:
+    std::filesystem::path directory_;
+    GaussianSpatialIndex key_grid_;  ///< only for the chunk keys
+    std::map<std::int64_t, Chunk> paged_;
+    GaussianChunkPagerStats stats_;
+};
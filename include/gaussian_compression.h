@@ -0,0 +1,104 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include <torch/torch.h>
+
+struct GaussianCompressionOptions
+{
+    int sh_codebook_size_ = 4096;        ///< 0: half precision without a codebook
+    int scaling_codebook_size_ = 4096;   ///< 0: half precision without a codebook
+    int rotation_codebook_size_ = 4096;  ///< 0: half precision without a codebook
+    int kmeans_iterations_ = 10;
+    std::uint64_t kmeans_seed_ = 0;     ///< seeds the k-means initialization, exports are reproducible
+};
+
+/**
+ * @brief Attribute rows shared through a codebook, or stored as half floats
+ *        when there is no codebook
+ */
+struct GaussianQuantizedAttribute
+{
+    torch::Tensor codebook_;  ///< (num_codes, ...) float, undefined without codebook
+    torch::Tensor values_;    ///< (N,) int16/int32 codes, or (N, ...) half
+
+    torch::Tensor decode() const;
+    std::size_t numBytes() const;
+};
+
+/**
+ * @brief Trained Gaussians in a compact, read-only form.
+ *
+ * The means stay float; DC colors and opacities are stored as half floats.
+ * The SH coefficients of the active bands, the scales and the rotations are
+ * vector quantized with k-means codebooks. Bands above the active SH degree
+ * do not contribute to rendering and are kept as half floats.
+ *
+ * The decode functions return the raw (pre-activation) float attributes, so
+ * a model can render from this form by decoding on the fly.
+ */
+class CompressedGaussians
+{
+public:
+    static std::shared_ptr<CompressedGaussians> compress(
+        const torch::Tensor& xyz,
+        const torch::Tensor& features_dc,
+        const torch::Tensor& features_rest,
+        const torch::Tensor& opacity,
+        const torch::Tensor& scaling,
+        const torch::Tensor& rotation,
+        int active_sh_degree,
+        int max_sh_degree,
+        const GaussianCompressionOptions& options = GaussianCompressionOptions());
+
+    void save(const std::filesystem::path& path) const;
+    static std::shared_ptr<CompressedGaussians> load(
+        const std::filesystem::path& path,
+        torch::DeviceType device_type);
+
+    std::int64_t numPoints() const { return xyz_.size(0); }
+    int activeShDegree() const { return active_sh_degree_; }
+    int maxShDegree() const { return max_sh_degree_; }
+
+    const torch::Tensor& xyz() const { return xyz_; }
+    torch::Tensor features() const;
+    torch::Tensor opacity() const;
+    torch::Tensor scaling() const;
+    torch::Tensor rotation() const;
+
+    std::size_t numBytes() const;
+    std::size_t decodedBytes() const;
+
+protected:
+    int active_sh_degree_ = 0;
+    int max_sh_degree_ = 0;
+
+    torch::Tensor xyz_;                             ///< (N, 3) float
+    torch::Tensor features_dc_;                     ///< (N, 1, 3) half
+    GaussianQuantizedAttribute features_active_;    ///< rest coefficients of the active bands
+    torch::Tensor features_inactive_;               ///< (N, M, 3) half, bands above the active degree
+    torch::Tensor opacity_;                         ///< (N, 1) half
+    GaussianQuantizedAttribute scaling_;
+    GaussianQuantizedAttribute rotation_;
+};
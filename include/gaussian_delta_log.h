@@ -0,0 +1,108 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+/**
+ * @brief The Gaussians and keyframe poses of one saved iteration,
+ *        on CPU with the rows sorted by Gaussian id
+ */
+struct GaussianDeltaState
+{
+    int iteration_ = -1;
+    int active_sh_degree_ = 0;
+    torch::Tensor ids_;                ///< (N,) int64, ascending
+    std::vector<torch::Tensor> params_; ///< xyz, features_dc, features_rest, opacity, scaling, rotation
+    std::map<std::size_t, std::array<double, 7>> poses_; ///< fid -> qw, qx, qy, qz, tx, ty, tz
+
+    void sortById();
+};
+
+/**
+ * @brief Append-only log of delta checkpoints in one directory.
+ *
+ * A base file holds a full state; every later segment only holds the
+ * Gaussians added, pruned and modified since the previous save, as ranges of
+ * Gaussian ids plus the rows of the added and modified ones, and the keyframe
+ * poses that changed. `manifest.txt` lists the files in save order, one
+ * `base|delta <iteration> <file>` line each, and is only ever appended to, so
+ * an interrupted save leaves the log readable up to the previous segment.
+ *
+ * Segments are diffed against the last written state, kept in host memory.
+ * A new base is written every `rebase_interval` segments, `compact()` folds a
+ * log into a single base so that earlier iterations can be dropped.
+ */
+class GaussianDeltaLog
+{
+public:
+    GaussianDeltaLog(std::filesystem::path log_dir, int rebase_interval = 50);
+
+    std::uint64_t reserve();
+    void append(std::uint64_t ticket, std::function<GaussianDeltaState()> make_state);
+
+    static std::vector<int> iterations(const std::filesystem::path& log_dir);
+    static GaussianDeltaState replay(const std::filesystem::path& log_dir, int iteration = -1);
+    static void compact(const std::filesystem::path& log_dir, int iteration = -1);
+
+    static const std::vector<std::string> param_names_;
+
+protected:
+    struct ManifestEntry
+    {
+        bool base_;
+        int iteration_;
+        std::string file_;
+    };
+
+    static std::vector<ManifestEntry> readManifest(const std::filesystem::path& log_dir);
+    static std::size_t nextSequence(const std::vector<ManifestEntry>& entries);
+    static void writeBase(const std::filesystem::path& path, const GaussianDeltaState& state);
+    static void writeDelta(
+        const std::filesystem::path& path,
+        const GaussianDeltaState& previous,
+        const GaussianDeltaState& current);
+    static void applyDelta(const std::filesystem::path& path, GaussianDeltaState& state);
+    static void appendToManifest(const std::filesystem::path& log_dir, const ManifestEntry& entry);
+
+protected:
+    std::filesystem::path log_dir_;
+    int rebase_interval_;
+    std::size_t num_files_ = 0; ///< next sequence number of the file names, so resumed sessions never overwrite
+    int num_deltas_since_base_ = 0;
+    GaussianDeltaState last_state_;
+    bool has_last_state_ = false;
+
+    std::atomic<std::uint64_t> next_ticket_{0};
+    std::uint64_t next_to_write_ = 0; ///< saves are written in the order they were reserved
+    std::mutex mutex_;
+    std::condition_variable cv_turn_;
+};
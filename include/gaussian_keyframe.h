@@ -32,6 +32,18 @@
 #include "general_utils.h"
 #include "graphics_utils.h"
 #include "tensor_utils.h"
+#include "keyframe_image_store.h"
+
+/**
+ * @brief Training inputs of one pyramid level, on the training device
+ */
+struct GaussianKeyframeTrainingLevel
+{
+    torch::Tensor gt_image_;  ///< float (3, H, W), only without an image store, see GaussianKeyframe::trainingImage
+    torch::Tensor mask_;      ///< undistortion mask of the camera, shared by its keyframes
+    int height_ = 0;
+    int width_ = 0;
+};
 
 class GaussianKeyframe
 {
@@ -76,9 +88,25 @@ public:
         float fovX,
         float fovY,
         torch::DeviceType device_type = torch::kCUDA);
+    static Eigen::Matrix4f projectionMatrix(
+        float znear,
+        float zfar,
+        float fovX,
+        float fovY);
 
     int getCurrentGausPyramidLevel();
 
+    torch::Tensor getOriginalImage(torch::DeviceType device_type);
+    torch::Tensor getGausPyramidOriginalImage(int level, torch::DeviceType device_type);
+
+    void buildTrainingBundle(
+        const std::vector<torch::Tensor>& level_masks,
+        torch::DeviceType device_type);
+    void releaseTrainingBundle();
+    bool hasTrainingLevel(int level) const;
+    const GaussianKeyframeTrainingLevel& trainingLevel(int level) const;
+    torch::Tensor trainingImage(int level, torch::DeviceType device_type);
+
 public:
     std::size_t fid_;
     int creation_iter_;
@@ -90,8 +118,7 @@ public:
     int camera_model_id_ = 0;
 
     std::string img_filename_;
-    cv::Mat img_undist_, img_auxiliary_undist_;
-    torch::Tensor original_image_; ///< image
+    cv::Mat img_undist_, img_auxiliary_undist_; ///< 8-bit RGB, auxiliary is depth for RGBD
     int image_width_;              ///< image
     int image_height_;             ///< image
 
@@ -99,7 +126,7 @@ public:
     std::vector<int> gaus_pyramid_times_of_use_;
     std::vector<std::size_t> gaus_pyramid_width_;            ///< gaus_pyramid image
     std::vector<std::size_t> gaus_pyramid_height_;           ///< gaus_pyramid image
-    std::vector<torch::Tensor> gaus_pyramid_original_image_; ///< gaus_pyramid image
+    std::shared_ptr<KeyframeImageStore> image_store_;        ///< gaus_pyramid image
     // Tensor gt_alpha_mask_;
 
     std::vector<float> intr_; ///< intrinsics
@@ -120,6 +147,8 @@ public:
     float zfar_ = 100.0f;
     float znear_ = 0.01f;
 
+    torch::DeviceType device_type_ = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU; ///< device of transform tensors
+
     Eigen::Vector3f trans_ = {0.0f, 0.0f, 0.0f};
     float scale_ = 1.0f;
 
@@ -128,9 +157,20 @@ public:
     torch::Tensor full_proj_transform_;     ///< transform tensors
     torch::Tensor camera_center_;           ///< transform tensors
 
+    /// Sub levels then full resolution, built at ingestion if the mapper keeps them on the device
+    std::vector<GaussianKeyframeTrainingLevel> training_bundle_;
+
     std::vector<Point2D> points2D_;
     std::vector<float> kps_pixel_;
     std::vector<float> kps_point_local_;
 
     bool done_inactive_geo_densify_ = false;
+
+protected:
+    bool transforms_computed_ = false;
+    Sophus::SE3d transforms_Tcw_;                       ///< pose of the current transform tensors
+    Eigen::Vector3f transforms_trans_;
+    float transforms_scale_ = 1.0f;
+    torch::DeviceType transforms_device_type_;
+    Eigen::Matrix4f projection_;                        ///< host copy of projection_matrix_, not transposed
 };
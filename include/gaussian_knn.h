@@ -0,0 +1,50 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+#include <torch/torch.h>
+
+#define GAUSSIAN_KNN_MAX_K 16
+
+/**
+ * @brief Mean squared distance of points to their k nearest neighbors, for the
+ *        initial scales of new Gaussians.
+ *
+ * Only the first `num_queries` rows of `points` (N, 3) are answered, but their
+ * neighbors are searched among all rows, so that new points can be followed by
+ * the existing Gaussians around them. A point is not its own neighbor; with
+ * fewer than k other points, the mean is over those found (0 if none).
+ *
+ * The CPU version is exact: the points are bucketed into a hashed uniform
+ * grid of about two points per cell, and every query searches rings of cells
+ * outward until no closer neighbor can remain. CUDA tensors go through the
+ * approximate distCUDA2 of simple-knn (k = 3 only).
+ */
+torch::Tensor knnMeanDist2(
+    const torch::Tensor& points,
+    std::int64_t num_queries = -1,
+    int k = 3);
+
+torch::Tensor knnMeanDist2CPU(
+    const torch::Tensor& points,
+    std::int64_t num_queries,
+    int k);
@@ -31,6 +31,11 @@
 #include <map>
 #include <random>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <unordered_set>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/cudaimgproc.hpp>
@@ -48,6 +53,8 @@
 #include "gaussian_keyframe.h"
 #include "gaussian_scene.h"
 #include "gaussian_trainer.h"
+#include "training_statistics.h"
+#include "persistence_writer.h"
 
 #define CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(dir)                                       \
     if (!dir.empty() && !std::filesystem::exists(dir))                                      \
@@ -76,6 +83,18 @@ enum SystemSensorType
     RGBD = 3
 };
 
+typedef ORB_SLAM3::MappingOperation::KeyFrameEntry MappingKeyframe;
+
+/**
+ * @brief A new keyframe prepared by an ingestion worker, waiting to be spliced into the scene
+ */
+struct IngestedKeyframe
+{
+    std::shared_ptr<GaussianKeyframe> pkf_;
+    torch::Tensor densify_points_; ///< inactive geometry densification candidates, world frame
+    torch::Tensor densify_colors_;
+};
+
 struct VariableParameters
 {
     float position_lr_init;
@@ -96,6 +115,28 @@ struct VariableParameters
     bool do_inactive_geo_densify;
 };
 
+/**
+ * @brief Immutable copy of the model published by the training thread for the viewer
+ */
+struct GaussianRenderSnapshot
+{
+    std::uint64_t version_ = 0;
+    int iteration_ = 0;
+    std::shared_ptr<GaussianModel> model_;
+};
+
+/**
+ * @brief What a periodic save reads, copied by the training thread for the persistence workers
+ */
+struct GaussianRecordSnapshot
+{
+    int iteration_ = 0;
+    std::shared_ptr<GaussianModel> model_;
+    std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> keyframes_;
+    std::map<camera_id_t, torch::Tensor> undistort_mask_;
+    std::size_t num_bytes_ = 0; ///< device memory held by the copied model
+};
+
 class GaussianMapper
 {
 public:
@@ -105,6 +146,7 @@ public:
         std::filesystem::path result_dir = "",
         int seed = 0,
         torch::DeviceType device_type = torch::kCUDA);
+    ~GaussianMapper();
 
     void readConfigFromFile(std::filesystem::path cfg_path);
 
@@ -121,6 +163,9 @@ public:
         const int height,
         const bool main_vision = false);
 
+    std::shared_ptr<const GaussianRenderSnapshot> renderSnapshot();
+    void requestRenderSnapshot();
+
     int getIteration();
     void increaseIteration(const int inc = 1);
 
@@ -134,6 +179,8 @@ public:
     int opacityResetInterval();
     float densifyGradThreshold();
     int densifyInterval();
+    int batchSize();
+    float imagesPerSecond();
     int newKeyframeTimesOfUse();
     int stableNumIterExistence();
     bool isKeepingTraining();
@@ -150,6 +197,7 @@ public:
     void setOpacityResetInterval(const int interval);
     void setDensifyGradThreshold(const float th);
     void setDensifyInterval(const int interval);
+    void setBatchSize(const int batch_size);
     void setNewKeyframeTimesOfUse(const int times);
     void setStableNumIterExistence(const int niter);
     void setKeepTraining(const bool keep);
@@ -164,6 +212,18 @@ public:
     void setSensorType(SystemSensorType sensor_type) { this->sensor_type_ = sensor_type; }
 
     void loadPly(std::filesystem::path ply_path, std::filesystem::path camera_path = "");
+    void loadCompressed(std::filesystem::path compressed_path, std::filesystem::path camera_path = "");
+    void loadDeltaCheckpoint(
+        std::filesystem::path delta_dir,
+        int iteration = -1,
+        std::filesystem::path camera_path = "");
+
+    void saveCheckpoint(std::filesystem::path checkpoint_path);
+    void saveDeltaCheckpoint();
+    void loadCheckpoint(std::filesystem::path checkpoint_path);
+    void setResumeCheckpoint(std::filesystem::path checkpoint_path) { this->resume_checkpoint_path_ = checkpoint_path; }
+
+    void waitForPersistence();
 
 protected:
     bool hasMetInitialMappingConditions();
@@ -171,36 +231,58 @@ protected:
 
     void combineMappingOperations();
 
-    void handleNewKeyframe(std::tuple<unsigned long,
-                                      unsigned long,
-                                      Sophus::SE3f,
-                                      cv::Mat,
-                                      bool,
-                                      cv::Mat,
-                                      std::vector<float>,
-                                      std::vector<float>,
-                                      std::string> &kf);
-    void generateKfidRandomShuffle();
+    void handleNewKeyframe(MappingKeyframe &kf);
+    void markKeyframeTakenIn(MappingKeyframe &kf);
+    std::shared_ptr<GaussianKeyframe> prepareNewKeyframe(MappingKeyframe &kf);
     std::shared_ptr<GaussianKeyframe> useOneRandomSlidingWindowKeyframe();
     std::shared_ptr<GaussianKeyframe> useOneRandomKeyframe();
     void increaseKeyframeTimesOfUse(std::shared_ptr<GaussianKeyframe> pkf, int times);
     void cullKeyframes();
+    void buildTrainingBundle(std::shared_ptr<GaussianKeyframe> pkf);
+
+    bool isPagingChunks() const { return chunk_size_ > 0.0f && max_resident_gaussians_ > 0; }
+    void restrictSamplingToResidentRegion();
+    void updateResidentChunks();
+    void pageInAllChunks();
 
+    torch::Tensor keypointPixelFlags(
+        std::shared_ptr<GaussianKeyframe> pkf,
+        int64_t num_pixels,
+        torch::Device device);
     void increasePcdByKeyframeInactiveGeoDensify(
         std::shared_ptr<GaussianKeyframe> pkf);
+    std::tuple<torch::Tensor, torch::Tensor> inactiveGeoDensifyPoints(
+        std::shared_ptr<GaussianKeyframe> pkf);
+    void cacheInactiveGeoDensifyPoints(
+        torch::Tensor& points,
+        torch::Tensor& colors);
+
+    void startIngestionWorkers();
+    void stopIngestionWorkers();
+    void ingestionWorkerLoop();
+    void submitNewKeyframe(MappingKeyframe &kf);
+    bool isIngestingKeyframe(unsigned long kfid);
+    void spliceIngestedKeyframes();
+    void waitForIngestion();
+
+    void publishRenderSnapshot();
 
     // bool needInterruptTraining();
     // void setInterruptTraining(const bool interrupt_training);
 
+    std::shared_ptr<GaussianRecordSnapshot> takeRecordSnapshot();
+
     void recordKeyframeRendered(
         torch::Tensor &rendered,
         torch::Tensor &ground_truth,
         unsigned long kfid,
+        int iteration,
         std::filesystem::path result_img_dir,
         std::filesystem::path result_gt_dir,
         std::filesystem::path result_loss_dir,
         std::string name_suffix = "");
     void renderAndRecordKeyframe(
+        const GaussianRecordSnapshot &snapshot,
         std::shared_ptr<GaussianKeyframe> pkf,
         float &dssim,
         float &psnr,
@@ -212,11 +294,22 @@ protected:
         std::string name_suffix = "");
     void renderAndRecordAllKeyframes(
         std::string name_suffix = "");
+    void writeAllKeyframesRecord(
+        const GaussianRecordSnapshot &snapshot,
+        std::string name_suffix = "");
 
     void savePly(std::filesystem::path result_dir);
-    void keyframesToJson(std::filesystem::path result_dir);
+    void writePly(
+        const GaussianRecordSnapshot &snapshot,
+        std::filesystem::path result_dir);
+    void keyframesToJson(
+        std::filesystem::path result_dir,
+        const std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> &keyframes);
     void saveModelParams(std::filesystem::path result_dir);
     void writeKeyframeUsedTimes(std::filesystem::path result_dir, std::string name_suffix = "");
+    static GaussianDeltaState deltaStateOf(const GaussianRecordSnapshot &snapshot);
+
+    void loadViewerCamera(std::filesystem::path camera_path);
 
 public:
     // Parameters
@@ -257,8 +350,6 @@ protected:
 
     // Data
     std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> viewpoint_sliding_window_;
-    std::vector<std::size_t> kfid_shuffle_;
-    std::size_t kfid_shuffle_idx_ = 0;
     std::map<std::size_t, int> kfs_used_times_;
 
     // Status
@@ -267,6 +358,9 @@ protected:
     bool stopped_;
     int iteration_;
     float ema_loss_for_log_;
+    float images_per_second_ = 0.0f;
+    std::shared_ptr<const GaussianRenderSnapshot> render_snapshot_; ///< swapped atomically
+    std::atomic<bool> render_snapshot_requested_{false};
     bool SLAM_ended_;
     bool loop_closure_iteration_;
     bool keep_training_ = false;
@@ -301,6 +395,7 @@ protected:
     int loop_closure_increased_times_of_use_;
 
     bool cull_keyframes_;
+    KeyframeSampler::Mode keyframe_sampling_mode_ = KeyframeSampler::UNIFORM;
     int stable_num_iter_existence_;
 
     bool do_gaus_pyramid_training_;
@@ -314,10 +409,51 @@ protected:
 
     int training_report_interval_;
     bool record_loop_ply_;
+    int training_stats_flush_interval_ = 0; ///< ms, 0: do not record training statistics
+    int training_stats_buffer_capacity_ = 4096;
+    TrainingStatistics training_stats_;
 
     int prune_big_point_after_iter_;
     float densify_min_opacity_ = 20;
 
+    int persistence_num_workers_ = 1; ///< 0: write synchronously on the training thread
+    int persistence_memory_budget_mb_ = 2048; ///< snapshots held by pending saves
+    PersistenceWriter persistence_writer_;
+
+    int delta_checkpoint_interval_ = 0; ///< 0: never
+    int delta_rebase_interval_ = 50; ///< deltas between two full bases, 0: never rebase
+    std::unique_ptr<GaussianDeltaLog> delta_log_;
+
+    int checkpoint_interval_ = 0; ///< 0: never
+    std::filesystem::path resume_checkpoint_path_; ///< empty: start from the initial point cloud
+
+    float chunk_size_ = 0.0f; ///< side of the paged map chunks, 0: keep the whole map resident
+    std::int64_t max_resident_gaussians_ = 0; ///< page chunks out above this, 0: never
+    float chunk_keep_radius_ = 10.0f; ///< chunks around the newest keyframe always stay resident
+    int chunk_paging_interval_ = 100;
+    std::unique_ptr<GaussianChunkPager> chunk_pager_;
+    torch::Tensor paging_center_;
+
+    float insertion_voxel_size_ = 0.0f; ///< new points in voxels of this size already holding Gaussians are dropped, 0: keep all
+
+    bool compressed_export_ = false; ///< also write a vector quantized model with each PLY
+    GaussianCompressionOptions compression_options_;
+
+    int render_snapshot_interval_ = 10; ///< min iterations between snapshots, 0: every requested iteration
+
+    // Keyframe ingestion
+    int num_ingestion_workers_ = 0; ///< 0: prepare new keyframes on the training thread
+    std::size_t ingestion_queue_capacity_ = 8;
+    std::shared_ptr<KeyframeImageStore> keyframe_image_store_ = std::make_shared<KeyframeImageStore>(); ///< pyramid levels of all keyframes
+    bool device_training_images_ = false; ///< keep the training levels of the keyframes on the device, within the pyramid cache budget
+    std::vector<std::thread> ingestion_workers_;
+    std::deque<MappingKeyframe> ingestion_queue_;
+    std::deque<IngestedKeyframe> ingestion_ready_;
+    std::unordered_set<unsigned long> ingestion_pending_kfids_;
+    std::map<unsigned long, Sophus::SE3f> ingestion_updated_poses_;
+    std::exception_ptr ingestion_error_;
+    bool ingestion_stop_ = false;
+
     // Tools
     std::random_device rd_;
 
@@ -325,4 +461,9 @@ protected:
     std::mutex mutex_status_;
     std::mutex mutex_settings_;
     std::mutex mutex_render_; ///< the model is suppose to be read-only from outside
+    std::mutex mutex_ingestion_;
+    std::mutex mutex_stereo_; ///< stereo matcher shared by ingestion workers
+    std::condition_variable cv_ingestion_queue_;
+    std::condition_variable cv_ingestion_space_;
+    std::condition_variable cv_ingestion_ready_;
 };
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include <filesystem>
 #include <fstream>
 #include <algorithm>
+#include <vector>
 
 #include <torch/torch.h>
 #include <c10/cuda/CUDACachingAllocator.h>
@@ -35,6 +36,14 @@
 #include "sh_utils.h"
 #include "tensor_utils.h"
 #include "gaussian_parameters.h"
+#include "gaussian_parameter_store.h"
+#include "gaussian_optimizer.h"
+#include "gaussian_checkpoint.h"
+#include "gaussian_delta_log.h"
+#include "gaussian_spatial_index.h"
+#include "gaussian_compression.h"
+#include "gaussian_chunk_pager.h"
+#include "gaussian_knn.h"
 
 #define GAUSSIAN_MODEL_TENSORS_TO_VEC                        \
     this->Tensor_vec_xyz_ = {this->xyz_};                    \
@@ -56,6 +65,39 @@
     this->denom_ = torch::empty(0, torch::TensorOptions().device(device_type));              \
     GAUSSIAN_MODEL_TENSORS_TO_VEC
 
+/**
+ * @brief Pose correction of a loop keyframe, for the points it sees
+ */
+struct GaussianLoopCorrection
+{
+    Sophus::SE3f diff_pose_;              ///< old to new world, translation already scaled
+    torch::Tensor world_view_transform_;  ///< of the keyframe before the correction
+    int creation_iter_;
+    std::int64_t num_points_;             ///< points in the model when the keyframe was reached
+};
+
+/**
+ * @brief Points handed to increasePcd, see GaussianModel::setInsertionVoxelSize()
+ */
+struct GaussianInsertionStats
+{
+    std::int64_t num_candidates_ = 0;
+    std::int64_t num_accepted_ = 0;
+    std::int64_t num_occupied_ = 0;  ///< dropped, their voxel already held a Gaussian
+    std::int64_t num_merged_ = 0;    ///< averaged with other candidates of their voxel
+};
+
+/**
+ * @brief Clone, split and prune decisions of one densification step
+ */
+struct GaussianDensificationPlan
+{
+    torch::Tensor remove_mask_;  ///< (num_points,) split or pruned
+    torch::Tensor parents_;      ///< (num_new,) point each new one is cloned or split from
+    torch::Tensor is_child_;     ///< (num_new,) split child, clone otherwise
+    int num_split_ = 2;          ///< children per split point
+};
+
 class GaussianModel
 {
 public:
@@ -66,9 +108,12 @@ public:
     torch::Tensor getRotationActivation();
     torch::Tensor getXYZ();
     torch::Tensor getFeatures();
+    torch::Tensor fullFeaturesRest();
     torch::Tensor getOpacityActivation();
     torch::Tensor getCovarianceActivation(int scaling_modifier = 1);
 
+    std::shared_ptr<GaussianModel> renderSnapshot();
+
     void oneUpShDegree();
     void setShDegree(const int sh);
 
@@ -77,7 +122,11 @@ public:
         const float spatial_lr_scale);
 
     void increasePcd(std::vector<float> points, std::vector<float> colors, const int iteration);
-    void increasePcd(torch::Tensor& new_point_cloud, torch::Tensor& new_colors, const int iteration);
+    void increasePcd(torch::Tensor& candidate_xyz, torch::Tensor& candidate_colors, const int iteration);
+
+    void setInsertionVoxelSize(const float voxel_size);
+    float insertionVoxelSize() const { return insertion_voxel_size_; }
+    const GaussianInsertionStats& insertionStats() const { return insertion_stats_; }
 
     void applyScaledTransformation(
         const float s = 1.0,
@@ -86,16 +135,26 @@ public:
         torch::Tensor& new_xyz,
         torch::Tensor& new_scaling);
 
-    void scaledTransformVisiblePointsOfKeyframe(
-        torch::Tensor& point_not_transformed_flags,
-        torch::Tensor& diff_pose,
-        torch::Tensor& kf_world_view_transform,
-        torch::Tensor& kf_full_proj_transform,
-        const int kf_creation_iter,
+    int applyLoopCorrections(
+        const std::vector<GaussianLoopCorrection>& corrections,
         const int stable_num_iter_existence,
-        int& num_transformed,
         const float scale = 1.0f);
 
+    void refreshSpatialIndex();
+    torch::Tensor pointsInFrustum(const torch::Tensor& viewmatrix, const float znear = 0.2f);
+    torch::Tensor pointsInBox(const torch::Tensor& box_min, const torch::Tensor& box_max);
+
+    std::int64_t pageOutChunks(
+        GaussianChunkPager& pager,
+        const torch::Tensor& center,
+        const float keep_radius,
+        const std::int64_t max_resident);
+    std::int64_t pageInChunks(
+        GaussianChunkPager& pager,
+        const torch::Tensor& center,
+        const float radius);
+    void appendPagedChunks(const GaussianChunkPager& pager);
+
     void trainingSetup(const GaussianOptimizationParams& training_args);
     float updateLearningRate(int step);
     void setPositionLearningRate(float position_lr);
@@ -135,6 +194,14 @@ public:
         float extent,
         int max_screen_size);
 
+    GaussianDensificationPlan planDensification(
+        float max_grad,
+        float min_opacity,
+        float extent,
+        int max_screen_size,
+        int N = 2);
+    void applyDensification(const GaussianDensificationPlan& plan);
+
     void addDensificationStats(
         torch::Tensor& viewspace_point_tensor,
         torch::Tensor& update_filter);
@@ -142,15 +209,39 @@ public:
 // void increasePointsIterationsOfExistence(const int i = 1);
 
     void loadPly(std::filesystem::path ply_path);
+    void loadDeltaState(const GaussianDeltaState& state);
     void savePly(std::filesystem::path result_path);
     void saveSparsePointsPly(std::filesystem::path result_path);
 
+    void saveCompressed(
+        std::filesystem::path result_path,
+        const GaussianCompressionOptions& options = GaussianCompressionOptions());
+    void loadCompressed(std::filesystem::path compressed_path);
+    bool isCompressed() const { return compressed_ != nullptr; }
+    std::size_t numBytes() const;
+
+    void saveCheckpoint(GaussianCheckpoint& checkpoint, const GaussianChunkPager* pager = nullptr);
+    void loadCheckpoint(
+        const GaussianCheckpoint& checkpoint,
+        const GaussianOptimizationParams& training_args);
+
     float percentDense();
     void setPercentDense(const float percent_dense);
 
 protected:
     float exponLrFunc(int step);
 
+    std::int64_t storedRestCoefficients();
+    void growShBands();
+
+    void suppressDuplicates(torch::Tensor& new_point_cloud, torch::Tensor& new_colors);
+    void appendSparsePoints(const torch::Tensor& new_point_cloud, const torch::Tensor& new_colors);
+    torch::Tensor meansAround(const torch::Tensor& points);
+
+    void resetParameterStore();
+    void bindParameterStore();
+    torch::Tensor newGaussianIds(std::int64_t num_points);
+
 public:
     torch::DeviceType device_type_;
 
@@ -159,7 +250,7 @@ public:
 
     torch::Tensor xyz_;
     torch::Tensor features_dc_;
-    torch::Tensor features_rest_;
+    torch::Tensor features_rest_;       ///< only the bands up to active_sh_degree_ are stored
     torch::Tensor scaling_;
     torch::Tensor rotation_;
     torch::Tensor opacity_;
@@ -167,6 +258,9 @@ public:
     torch::Tensor xyz_gradient_accum_;
     torch::Tensor denom_;
     torch::Tensor exist_since_iter_;
+    torch::Tensor gaussian_ids_;        ///< stable across densification and pruning, for delta checkpoints
+    torch::Tensor voxel_keys_;          ///< voxels of the means in spatial_index_, refreshed before queries
+    std::int64_t next_gaussian_id_ = 0;
 
     std::vector<torch::Tensor> Tensor_vec_xyz_,
                                Tensor_vec_feature_dc_,
@@ -175,13 +269,19 @@ public:
                                Tensor_vec_scaling_ ,
                                Tensor_vec_rotation_;
 
-    std::shared_ptr<torch::optim::Adam> optimizer_;
+    std::shared_ptr<GaussianAdam> optimizer_;
     float percent_dense_;
     float spatial_lr_scale_;
 
     torch::Tensor sparse_points_xyz_;
     torch::Tensor sparse_points_color_;
 
+    /**
+     * @brief Read-only quantized attributes, decoded by the getters on every call,
+     *        replace the parameter tensors (except xyz_) when set
+     */
+    std::shared_ptr<const CompressedGaussians> compressed_;
+
 protected:
     float lr_init_;
     float lr_final_;
@@ -190,4 +290,42 @@ protected:
     int max_steps_;
 
     std::mutex mutex_settings_;
+
+    /**
+     * @brief Backing of the parameters, their Adam moments and the per-point
+     *        statistics, so that densification and pruning keep them in place
+     */
+    GaussianParameterStore param_store_;
+    enum StoreColumn
+    {
+        STORE_PARAMS = 0,      ///< param_groups[0..5]
+        STORE_EXP_AVG = 6,     ///< exp_avg of param_groups[0..5]
+        STORE_EXP_AVG_SQ = 12, ///< exp_avg_sq of param_groups[0..5]
+        STORE_EXIST_SINCE_ITER = 18,
+        STORE_XYZ_GRADIENT_ACCUM = 19,
+        STORE_DENOM = 20,
+        STORE_MAX_RADII2D = 21,
+        STORE_GAUSSIAN_ID = 22,
+        STORE_VOXEL_KEY = 23,
+        STORE_NUM_COLUMNS = 24
+    };
+
+    /**
+     * @brief Voxel hash over the means for the frustum and region queries,
+     *        keyed by the STORE_VOXEL_KEY column
+     */
+    GaussianSpatialIndex spatial_index_;
+
+    /**
+     * @brief Voxel size of the duplicate check on insertion (0: off),
+     *        occupancy is keyed from the current means on every insertion
+     */
+    float insertion_voxel_size_ = 0.0f;
+    GaussianSpatialIndex occupancy_grid_;  ///< only used for its keys
+    GaussianInsertionStats insertion_stats_;
+
+    /**
+     * @brief Backing of sparse_points_xyz_ and sparse_points_color_
+     */
+    GaussianParameterStore sparse_store_;
 };
@@ -0,0 +1,72 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <torch/torch.h>
+
+/**
+ * @brief Adam for the per-Gaussian parameter groups.
+ *
+ * All groups are updated by one fused kernel (CUDA) or one parallel pass (CPU).
+ * The moments are plain tensors owned by the caller, indexed like the
+ * parameters, so they are simply rebound after the points are grown or pruned.
+ *
+ * In sparse mode, a step only touches the points marked visible, as the
+ * invisible ones have no gradient in this iteration; their moments are not
+ * decayed and their parameters do not drift by momentum.
+ */
+class GaussianAdam
+{
+public:
+    GaussianAdam(float beta1 = 0.9f, float beta2 = 0.999f, float eps = 1e-15f);
+
+    void bind(
+        const std::vector<torch::Tensor>& params,
+        const std::vector<torch::Tensor>& exp_avgs,
+        const std::vector<torch::Tensor>& exp_avg_sqs);
+
+    std::size_t numGroups() const { return params_.size(); }
+    torch::Tensor& param(std::size_t group) { return params_.at(group); }
+
+    void setLearningRate(std::size_t group, float lr);
+    float learningRate(std::size_t group) const;
+    std::int64_t stepCount(std::size_t group) const;
+    void setStepCount(std::size_t group, std::int64_t step);
+
+    void setSparse(bool sparse) { sparse_ = sparse; }
+    bool isSparse() const { return sparse_; }
+
+    void step(const torch::Tensor& visible = torch::Tensor());
+    void zeroGrad();
+
+protected:
+    float beta1_;
+    float beta2_;
+    float eps_;
+    bool sparse_ = false;
+
+    std::vector<torch::Tensor> params_;
+    std::vector<torch::Tensor> exp_avgs_;
+    std::vector<torch::Tensor> exp_avg_sqs_;
+    std::vector<float> lrs_;
+    std::vector<std::int64_t> steps_;
+};
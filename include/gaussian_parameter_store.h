@@ -0,0 +1,68 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <torch/torch.h>
+
+/**
+ * @brief Growable per-Gaussian storage.
+ *
+ * Every column is a backing tensor of `capacity()` rows of which the first
+ * `size()` are active; `column()` returns a view of the active rows, so
+ * in-place updates (e.g. by the optimizer) land in the backing storage.
+ *
+ * Appending only copies the new rows unless the capacity is exceeded, in which
+ * case it is doubled. Removing rows fills the holes below the new size with the
+ * surviving rows above it, so only as many rows move as were removed from the
+ * front part; row order is therefore not preserved by `compact()`.
+ */
+class GaussianParameterStore
+{
+public:
+    void reset(const std::vector<torch::Tensor>& columns, std::int64_t min_capacity = 0);
+    void clear();
+
+    std::int64_t size() const { return size_; }
+    std::int64_t capacity() const { return capacity_; }
+    std::size_t numColumns() const { return backing_.size(); }
+    std::int64_t numReallocations() const { return num_reallocations_; }
+
+    torch::Tensor column(std::size_t idx) const;
+
+    void reserve(std::int64_t capacity);
+    void append(const std::vector<torch::Tensor>& rows);
+    void replace(const torch::Tensor& remove_mask, const std::vector<torch::Tensor>& rows);
+    void assign(std::size_t idx, const torch::Tensor& values);
+    void resizeColumn(std::size_t idx, std::int64_t dim, std::int64_t new_size);
+    void compact(const torch::Tensor& valid_mask);
+
+protected:
+    void reallocate(std::int64_t capacity);
+    std::int64_t numNewRows(const std::vector<torch::Tensor>& rows) const;
+
+protected:
+    std::vector<torch::Tensor> backing_;
+    std::int64_t size_ = 0;
+    std::int64_t capacity_ = 0;
+    std::int64_t min_capacity_ = 0;
+    std::int64_t num_reallocations_ = 0;
+};
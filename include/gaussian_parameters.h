@@ -74,7 +74,9 @@ public:
         int opacity_reset_interval = 3000,
         int densify_from_iter = 500,
         int densify_until_iter = 15'000,
-        float densify_grad_threshold = 0.0002f);
+        float densify_grad_threshold = 0.0002f,
+        int batch_size = 1,
+        bool sparse_adam = false);
 
 public:
     int iterations_;
@@ -93,4 +95,6 @@ public:
     int densify_from_iter_;
     int densify_until_iter_;
     float densify_grad_threshold_;
+    int batch_size_; ///< keyframes rendered per optimizer step
+    bool sparse_adam_; ///< optimizer steps only update visible points
 };
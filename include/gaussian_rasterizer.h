@@ -20,6 +20,7 @@
 #include <torch/torch.h>
 
 #include "rasterize_points.h"
+#include "rasterize_points_cpu.h"
 #include "gaussian_model.h"
 
 struct GaussianRasterizationSettings
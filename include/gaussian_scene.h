@@ -32,6 +32,7 @@
 #include "gaussian_parameters.h"
 #include "gaussian_model.h"
 #include "gaussian_keyframe.h"
+#include "keyframe_sampler.h"
 
 class GaussianScene
 {
@@ -47,6 +48,7 @@ public:
     Camera& getCamera(camera_id_t cameraId);
 
     void addKeyframe(std::shared_ptr<GaussianKeyframe> new_kf, bool* shuffled);
+    void eraseKeyframe(std::size_t fid);
     std::shared_ptr<GaussianKeyframe> getKeyframe(std::size_t fid);
     std::map<std::size_t, std::shared_ptr<GaussianKeyframe>>& keyframes();
     std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> getAllKeyframes();
@@ -72,6 +74,7 @@ public:
 
     std::map<camera_id_t, Camera> cameras_;
     std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> keyframes_;
+    KeyframeSampler keyframe_sampler_; ///< training-thread view of keyframes_ for random picking
     std::map<point3D_id_t, Point3D> cached_point_cloud_;
 
 protected:
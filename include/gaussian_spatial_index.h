@@ -0,0 +1,86 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+#include <torch/torch.h>
+
+/**
+ * @brief Voxel hash over the Gaussian means.
+ *
+ * Every point has an int64 key of the voxel holding its mean; the keys are kept
+ * per row by the owner (a column of the parameter store), so densification and
+ * pruning carry them along. `build` sorts the keys into a table of occupied
+ * cells, and a query tests the cells, not the points, then expands the cells it
+ * keeps into point rows.
+ *
+ * Between builds the table stays usable: rows appended after it (new points)
+ * and rows marked moved are always returned as candidates. Reordering or
+ * removing rows needs `invalidate` and a new build.
+ *
+ * Queries return candidate rows, a superset of the exact answer, as long as
+ * the points have not moved out of their voxels since the build.
+ */
+class GaussianSpatialIndex
+{
+public:
+    void setVoxelSize(float voxel_size);
+    float voxelSize() const { return voxel_size_; }
+
+    torch::Tensor keysOf(const torch::Tensor& xyz) const;
+
+    void build(const torch::Tensor& keys);
+    void invalidate();
+    bool isValid() const { return valid_; }
+    std::int64_t numIndexed() const { return num_indexed_; }
+    std::int64_t numCells() const { return valid_ ? cell_keys_.size(0) : 0; }
+
+    void markMoved(const torch::Tensor& rows);
+    bool hasMoved() const { return moved_rows_.defined() && moved_rows_.size(0) > 0; }
+
+    torch::Tensor queryFrustum(
+        const torch::Tensor& viewmatrix,
+        float znear,
+        std::int64_t num_points) const;
+    torch::Tensor queryBox(
+        const torch::Tensor& box_min,
+        const torch::Tensor& box_max,
+        std::int64_t num_points) const;
+    torch::Tensor queryNeighborCells(
+        const torch::Tensor& keys,
+        std::int64_t num_points) const;
+
+protected:
+    torch::Tensor rowsOfCells(const torch::Tensor& cell_mask, std::int64_t num_points) const;
+
+protected:
+    float voxel_size_ = 1.0f;
+    bool valid_ = false;
+    std::int64_t num_indexed_ = 0;  ///< rows covered by the cell table
+
+    torch::Tensor sorted_rows_;     ///< (num_indexed,) rows ordered by key
+    torch::Tensor cell_keys_;       ///< (num_cells,) sorted
+    torch::Tensor cell_starts_;     ///< (num_cells,) into sorted_rows_
+    torch::Tensor cell_counts_;     ///< (num_cells,)
+    torch::Tensor cell_min_;        ///< (num_cells, 3) lower corner
+    torch::Tensor cell_unbounded_;  ///< (num_cells,) also holds the points beyond the key range
+    torch::Tensor moved_rows_;      ///< moved since the build
+};
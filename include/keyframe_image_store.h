@@ -0,0 +1,98 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include <torch/torch.h>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Shared cache of the downsampled training images of the keyframes.
+ *
+ * Keyframes keep their undistorted image in 8 bits and the pyramid levels
+ * are resized from it on first use, also in 8 bits. They are converted to
+ * float tensors only when a training step asks for them. The mapper may also
+ * keep float copies on the training device (`deviceLevel`), counted against
+ * the same budget. With a nonzero budget, the least recently used entries are
+ * evicted and made again the next time they are needed.
+ */
+class KeyframeImageStore
+{
+public:
+    KeyframeImageStore(std::size_t budget_bytes = 0);
+
+    void setBudget(std::size_t budget_bytes);
+    std::size_t budget();
+    std::size_t cachedBytes();
+    std::size_t numCachedLevels();
+
+    cv::Mat level(
+        std::size_t fid,
+        int level,
+        const cv::Mat& full_image,
+        const cv::Size& size);
+    torch::Tensor levelTensor(
+        std::size_t fid,
+        int level,
+        const cv::Mat& full_image,
+        const cv::Size& size,
+        torch::DeviceType device_type);
+    torch::Tensor deviceLevel(
+        std::size_t fid,
+        int level,
+        const cv::Mat& full_image,
+        const cv::Size& size,
+        torch::DeviceType device_type);
+
+    void erase(std::size_t fid);
+    void clear();
+
+    static cv::Mat toStorage(const cv::Mat& image);
+    static torch::Tensor toTensor(const cv::Mat& image, torch::DeviceType device_type);
+
+protected:
+    typedef std::tuple<std::size_t, int, bool/*float on the device*/> LevelKey;
+
+    struct CachedLevel
+    {
+        cv::Mat image_;
+        torch::Tensor tensor_;
+        std::list<LevelKey>::iterator lru_it_;
+
+        std::size_t numBytes() const;
+    };
+
+    void insert(const LevelKey& key, const cv::Mat& image, const torch::Tensor& tensor);
+    void evict();
+
+protected:
+    std::size_t budget_bytes_;   ///< 0: unlimited
+    std::size_t cached_bytes_ = 0;
+
+    std::list<LevelKey> lru_;    ///< most recently used first
+    std::map<LevelKey, CachedLevel> levels_;
+
+    std::mutex mutex_;
+};
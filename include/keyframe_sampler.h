@@ -0,0 +1,105 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "gaussian_keyframe.h"
+
+/**
+ * @brief Random keyframe picking for the training scheduler.
+ *
+ * Keyframes live in a dense table addressed by slot index, and the slots with
+ * remaining times of use are kept in an "available" set with O(1) insertion,
+ * removal and uniform picking. Weighted picking (by remaining times of use or
+ * by the last training loss) goes through a Fenwick tree over the slots, which
+ * is O(log n) per pick and per update.
+ *
+ * Excluded keyframes (e.g. views of paged out regions) keep their times of
+ * use but are left out of the available set until included again.
+ *
+ * Not thread-safe, it is meant to be used by the training thread only.
+ */
+class KeyframeSampler
+{
+public:
+    enum Mode
+    {
+        UNIFORM = 0,      ///< uniform over available keyframes
+        TIMES_OF_USE = 1, ///< proportional to remaining times of use
+        LOSS = 2          ///< proportional to the last training loss
+    };
+
+public:
+    KeyframeSampler(unsigned int seed = 0);
+
+    void seed(unsigned int seed);
+    void setMode(Mode mode);
+    Mode mode() const { return mode_; }
+
+    void add(std::shared_ptr<GaussianKeyframe> pkf);
+    void erase(std::size_t fid);
+    void clear();
+
+    std::size_t size() const { return keyframes_.size(); }
+    std::size_t numAvailable() const { return available_.size(); }
+    std::shared_ptr<GaussianKeyframe> at(std::size_t slot) const { return keyframes_[slot]; }
+
+    void increaseTimesOfUse(std::shared_ptr<GaussianKeyframe> pkf, int times);
+    void increaseAllTimesOfUse(int times);
+    void setLoss(std::size_t fid, float loss);
+    void setExcluded(std::size_t fid, bool excluded);
+    void includeAll();
+
+    std::shared_ptr<GaussianKeyframe> useOne();
+    std::shared_ptr<GaussianKeyframe> sampleAny();
+
+    std::string saveState() const;
+    bool loadState(const std::string& state);
+
+protected:
+    std::size_t pickAvailable();
+    bool isAvailable(std::size_t slot) const;
+    void refresh(std::size_t slot);
+    void setAvailable(std::size_t slot, bool available);
+    double weightOf(std::size_t slot) const;
+    void setWeight(std::size_t slot, double weight);
+    void rebuildWeights();
+
+protected:
+    Mode mode_ = UNIFORM;
+    std::mt19937 rng_;
+
+    std::vector<std::shared_ptr<GaussianKeyframe>> keyframes_;
+    std::unordered_map<std::size_t, std::size_t> slot_of_fid_;
+    std::vector<float> losses_;
+    std::vector<char> excluded_;
+
+    std::vector<std::size_t> available_;        ///< slots with remaining times of use
+    std::vector<std::ptrdiff_t> available_pos_; ///< position of each slot in available_, -1 if absent
+
+    std::vector<double> weights_;
+    std::vector<double> fenwick_; ///< 1-based partial sums of weights_
+
+    static constexpr float default_loss_ = 1.0f; ///< new keyframes are trained first
+};
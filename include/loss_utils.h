@@ -22,6 +22,8 @@
 
 #include <torch/torch.h>
 
+#include "fused_ssim.h"
+
 namespace loss_utils
 {
 
@@ -107,6 +109,67 @@ inline torch::Tensor _ssim(
         return ssim_map.mean(1).mean(1).mean(1);
 }
 
+/**
+ * @brief {ssim_map, d_mu1, d_sigma1_sq, d_sigma12} of images shaped (..., H, W)
+ *        by the fused separable filter, partials only if `with_partials`
+ */
+inline std::vector<torch::Tensor> fused_ssim(
+    const torch::Tensor &img1,
+    const torch::Tensor &img2,
+    int window_size,
+    bool with_partials)
+{
+    auto planes1 = img1.reshape({-1, img1.size(-2), img1.size(-1)}).to(torch::kFloat).contiguous();
+    auto planes2 = img2.reshape({-1, img2.size(-2), img2.size(-1)}).to(img1.device(), torch::kFloat).contiguous();
+    const SsimWindow& window = ssimWindow(window_size);
+    const float C1 = 0.01f * 0.01f;
+    const float C2 = 0.03f * 0.03f;
+    auto outputs = planes1.is_cuda() ? fusedSsimForwardCUDA(planes1, planes2, window, C1, C2, with_partials)
+                                     : fusedSsimForwardCPU(planes1, planes2, window, C1, C2, with_partials);
+    outputs[0] = outputs[0].view(img1.sizes());
+    return outputs;
+}
+
+/**
+ * @brief SSIM map with a hand-written backward, only img1 gets a gradient.
+ *        Keeps 3 maps for the backward instead of every intermediate of _ssim
+ */
+class FusedSsimFunction : public torch::autograd::Function<FusedSsimFunction>
+{
+public:
+    static torch::Tensor forward(
+        torch::autograd::AutogradContext *ctx,
+        torch::Tensor img1,
+        torch::Tensor img2,
+        int64_t window_size)
+    {
+        auto outputs = fused_ssim(img1, img2, window_size, true);
+        ctx->save_for_backward({img1, img2, outputs[1], outputs[2], outputs[3]});
+        ctx->saved_data["window_size"] = window_size;
+        return outputs[0];
+    }
+
+    static torch::autograd::tensor_list backward(
+        torch::autograd::AutogradContext *ctx,
+        torch::autograd::tensor_list grad_outputs)
+    {
+        auto saved = ctx->get_saved_variables();
+        auto& img1 = saved[0];
+        auto planes1 = img1.reshape({-1, img1.size(-2), img1.size(-1)}).to(torch::kFloat).contiguous();
+        auto planes2 = saved[1].reshape(planes1.sizes()).to(img1.device(), torch::kFloat).contiguous();
+        auto grad_map = grad_outputs[0].reshape(planes1.sizes()).to(torch::kFloat).contiguous();
+        std::vector<torch::Tensor> partials = {saved[2], saved[3], saved[4]};
+        const SsimWindow& window = ssimWindow(ctx->saved_data["window_size"].toInt());
+        auto grad_img1 = planes1.is_cuda() ? fusedSsimBackwardCUDA(planes1, planes2, window, grad_map, partials)
+                                           : fusedSsimBackwardCPU(planes1, planes2, window, grad_map, partials);
+        return {grad_img1.view(img1.sizes()).to(img1.scalar_type()), torch::Tensor(), torch::Tensor()};
+    }
+};
+
+/**
+ * @brief The window is cached and the images stay on their own device, `device_type` is only
+ *        used by the _ssim fallback for windows over FUSED_SSIM_MAX_WINDOW or a gt that needs a gradient
+ */
 inline torch::Tensor ssim(
     torch::Tensor &img1,
     torch::Tensor &img2,
@@ -114,13 +177,25 @@ inline torch::Tensor ssim(
     int window_size = 11,
     bool size_average = true)
 {
-    auto channel = img1.size(-3);
-    auto window = create_window(window_size, channel, device_type);
-
-    // window = window.to(img1.device());
-    window = window.type_as(img1);
+    const bool grad_enabled = torch::GradMode::is_enabled();
+    torch::Tensor ssim_map;
+    if (window_size > FUSED_SSIM_MAX_WINDOW || (grad_enabled && img2.requires_grad())) {
+        auto channel = img1.size(-3);
+        auto window = create_window(window_size, channel, device_type);
+        window = window.type_as(img1);
+        return _ssim(img1, img2, window, window_size, channel, size_average);
+    }
+    else if (grad_enabled && img1.requires_grad()) {
+        ssim_map = FusedSsimFunction::apply(img1, img2, window_size);
+    }
+    else {
+        ssim_map = fused_ssim(img1, img2, window_size, false)[0];
+    }
 
-    return _ssim(img1, img2, window, window_size, channel, size_average);
+    if (size_average)
+        return ssim_map.mean();
+    else
+        return ssim_map.mean(1).mean(1).mean(1);
 }
 
 }
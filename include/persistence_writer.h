@@ -0,0 +1,88 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Worker pool for the periodic saves (evaluation renders, PLY, checkpoints).
+ *
+ * The trainer takes a snapshot of what is to be written and submits a job
+ * holding it; encoding and file I/O then happen on the workers. The bytes
+ * held by queued and running jobs are bounded: when the budget is used up,
+ * `submit` waits for earlier jobs to finish instead of piling up snapshots.
+ * A single job larger than the budget is still accepted when nothing else is
+ * pending. Without workers, jobs run synchronously in `submit`.
+ */
+class PersistenceWriter
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    ~PersistenceWriter();
+
+    void start(int num_workers = 1, std::size_t memory_budget_bytes = 2048UL << 20);
+    void stop();
+
+    void submit(const std::string& name, std::size_t num_bytes, std::function<void()> job);
+    void wait();
+
+    std::uint64_t numCompleted();
+    std::uint64_t numFailed();
+    std::size_t pendingBytes();
+    double lastLatencyMs();
+
+protected:
+    struct Job
+    {
+        std::string name_;
+        std::size_t num_bytes_;
+        std::function<void()> job_;
+        Clock::time_point submit_time_;
+    };
+
+    void workerLoop();
+    void run(Job& job);
+
+protected:
+    std::size_t memory_budget_bytes_ = 2048UL << 20;
+    std::size_t pending_bytes_ = 0;  ///< queued and running jobs
+    std::size_t num_pending_ = 0;    ///< queued and running jobs
+    std::deque<Job> queue_;
+
+    std::uint64_t num_completed_ = 0;
+    std::uint64_t num_failed_ = 0;
+    double last_latency_ms_ = 0.0;   ///< submit to completion
+
+    bool stop_ = false;
+    bool running_ = false;           ///< jobs are queued for the workers, not run by the caller
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_job_;
+    std::condition_variable cv_done_;
+};
@@ -23,12 +23,44 @@
 #include <memory>
 #include <vector>
 
+// Camera frame points (num_pixels, 3) of the flattened `depth` where `mask` is set, zeros elsewhere
 torch::Tensor reprojectDepthPinhole(
     torch::Tensor& depth,
     torch::Tensor& mask,
     std::vector<float>& intr,
     int width);
 
+torch::Tensor reprojectDepthPinholeCPU(
+    torch::Tensor& depth,
+    torch::Tensor& mask,
+    std::vector<float>& intr,
+    int width);
+
+/**
+ * @brief Keypoints with depth bucketed into square pixel cells,
+ *        cell c holds sorted_ids_[cell_starts_[c], cell_starts_[c + 1])
+ */
+struct KeypointGrid
+{
+    torch::Tensor cell_starts_;  ///< int64 (num_cells + 1)
+    torch::Tensor sorted_ids_;   ///< int64 (num_points) ordered by cell, keypoints without depth last
+    int cols_ = 0;
+    int rows_ = 0;
+    float cell_size_ = 1.0f;
+};
+
+KeypointGrid buildKeypointGrid(
+    const torch::Tensor& kps_pixel,
+    const torch::Tensor& kps_has3D,
+    float radius,
+    int width,
+    int height);
+
+// Each keypoint without depth takes the depth of the nearest keypoint with depth
+// within sqrt(max_pixel_dist) pixels (ties to the lowest index), looked up in a
+// KeypointGrid, so a keyframe costs O(N) instead of O(N^2). Runs on the device of
+// kps_pixel; `colors` is the image as (height * width, 3).
+
 std::tuple<torch::Tensor, torch::Tensor>
 monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypoints(
     torch::Tensor& kps_pixel,
@@ -38,3 +70,24 @@ monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypoints(
     float max_pixel_dist,
     std::vector<float>& intr,
     int width);
+
+std::tuple<torch::Tensor, torch::Tensor>
+monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypointsCPU(
+    torch::Tensor& kps_pixel,
+    torch::Tensor& kps_has3D,
+    torch::Tensor& kps_point_local,
+    torch::Tensor& colors,
+    float max_pixel_dist,
+    std::vector<float>& intr,
+    int width);
+
+// The former CUDA search over every keypoint, kept as a reference
+std::tuple<torch::Tensor, torch::Tensor>
+monocularPinholeInactiveGeoDensifyBySearchingAllKeypoints(
+    torch::Tensor& kps_pixel,
+    torch::Tensor& kps_has3D,
+    torch::Tensor& kps_point_local,
+    torch::Tensor& colors,
+    float max_pixel_dist,
+    std::vector<float>& intr,
+    int width);
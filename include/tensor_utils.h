@@ -67,6 +67,29 @@ inline torch::Tensor cvMat2TorchTensor_Float32(
     return tensor.contiguous();
 }
 
+/**
+ * @brief Upload an 8-bit image as is and scale it to [0, 1] on the device
+ * 
+ * @param mat  {rows, cols, channels} of CV_8U
+ * @param device_type 
+ * @return torch::Tensor {channels, rows, cols} of float
+ */
+inline torch::Tensor cvMat8U2TorchTensor_Float32(
+    const cv::Mat& mat,
+    torch::DeviceType device_type)
+{
+    cv::Mat continuous_mat = mat.isContinuous() ? mat : mat.clone();
+    torch::Tensor mat_tensor = torch::from_blob(
+        continuous_mat.data, /*sizes=*/{continuous_mat.rows, continuous_mat.cols, continuous_mat.channels()}, torch::kUInt8);
+    // The float conversion makes a copy, so the tensor does not alias the mat even on CPU
+    torch::Tensor tensor = mat_tensor.to(device_type).to(torch::kFloat).div_(255.0f);
+    if (continuous_mat.channels() == 1)
+        tensor = tensor.squeeze(2);
+    else
+        tensor = tensor.permute({2, 0, 1});
+    return tensor.contiguous();
+}
+
 inline cv::Mat torchTensor2CvMat_Float32(torch::Tensor& tensor)
 {
     cv::Mat mat;
@@ -0,0 +1,83 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One trained view of one training iteration
+ */
+struct TrainingRecord
+{
+    int iteration_;
+    std::uint64_t keyframe_id_;
+    int pyramid_level_;
+    float loss_;
+    float iteration_time_ms_;
+    std::int64_t num_gaussians_;
+};
+
+/**
+ * @brief In-memory ring buffer of training records, appended to a CSV file
+ *        by a background writer so that no file I/O happens while training.
+ *
+ * When the writer falls behind and the buffer is full, the oldest records
+ * are dropped and counted rather than blocking the trainer.
+ */
+class TrainingStatistics
+{
+public:
+    ~TrainingStatistics();
+
+    void start(
+        std::filesystem::path csv_path,
+        std::size_t capacity = 4096,
+        int flush_interval_ms = 1000);
+    void stop();
+    bool isRecording();
+
+    void push(const TrainingRecord& record);
+    std::uint64_t numDropped();
+
+protected:
+    void writerLoop();
+    void flush(std::vector<TrainingRecord>& records);
+
+protected:
+    std::filesystem::path csv_path_;
+    std::ofstream out_stream_;
+    int flush_interval_ms_ = 1000;
+
+    std::vector<TrainingRecord> ring_;
+    std::size_t head_ = 0; ///< oldest record
+    std::size_t size_ = 0;
+    std::uint64_t num_dropped_ = 0;
+
+    bool recording_ = false;
+    bool stop_ = false;
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
@@ -0,0 +1,124 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "include/adam_step.h"
+
+#include <cmath>
+
+#include <cuda_runtime_api.h>
+#include <cuda.h>
+#include <cuda_runtime.h>
+#include <device_launch_parameters.h>
+#include <c10/cuda/CUDAStream.h>
+
+struct AdamGroupArgs
+{
+    float* param;
+    const float* grad;
+    float* exp_avg;
+    float* exp_avg_sq;
+    int64_t row_size;
+    int64_t offset;       // first element of this group in the flattened launch
+    float step_size;      // lr / bias_correction1
+    float bias_correction2_sqrt;
+};
+
+// Passed by value, so a single launch covers every group without a device copy
+struct AdamMultiArgs
+{
+    AdamGroupArgs groups[ADAM_STEP_MAX_GROUPS];
+    int num_groups;
+};
+
+__global__ void fused_adam_step(
+    const AdamMultiArgs args,
+    const int64_t num_elements,
+    const bool* visible,
+    const float beta1,
+    const float beta2,
+    const float eps)
+{
+    int64_t idx = static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (idx >= num_elements)
+        return;
+
+    int g = 0;
+    while (g + 1 < args.num_groups && idx >= args.groups[g + 1].offset)
+        ++g;
+    const AdamGroupArgs& group = args.groups[g];
+    int64_t i = idx - group.offset;
+    if (visible && !visible[i / group.row_size])
+        return;
+
+    float grad = group.grad[i];
+    float m = beta1 * group.exp_avg[i] + (1.0f - beta1) * grad;
+    float v = beta2 * group.exp_avg_sq[i] + (1.0f - beta2) * grad * grad;
+    group.exp_avg[i] = m;
+    group.exp_avg_sq[i] = v;
+    group.param[i] -= group.step_size * m / (sqrtf(v) / group.bias_correction2_sqrt + eps);
+}
+
+void adamStepCUDA(
+    std::vector<AdamStepGroup>& groups,
+    const torch::Tensor& visible,
+    const float beta1,
+    const float beta2,
+    const float eps)
+{
+    if (groups.empty())
+        return;
+    if (groups.size() > ADAM_STEP_MAX_GROUPS) {
+        AT_ERROR("adamStepCUDA supports at most ", ADAM_STEP_MAX_GROUPS, " groups");
+    }
+
+    // An empty model (fully pruned, paged out or not yet grown) has nothing to update
+    const int64_t num_rows = groups[0].param_.size(0);
+    if (num_rows == 0)
+        return;
+
+    AdamMultiArgs args;
+    args.num_groups = static_cast<int>(groups.size());
+    int64_t num_elements = 0;
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        auto& group = groups[g];
+        if (group.param_.size(0) != num_rows) {
+            AT_ERROR("adamStepCUDA needs the same number of points in every group");
+        }
+        args.groups[g].param = group.param_.data_ptr<float>();
+        args.groups[g].grad = group.grad_.data_ptr<float>();
+        args.groups[g].exp_avg = group.exp_avg_.data_ptr<float>();
+        args.groups[g].exp_avg_sq = group.exp_avg_sq_.data_ptr<float>();
+        args.groups[g].row_size = group.param_.numel() / num_rows;
+        args.groups[g].offset = num_elements;
+        args.groups[g].step_size = group.lr_ / group.bias_correction1_;
+        args.groups[g].bias_correction2_sqrt = std::sqrt(group.bias_correction2_);
+        num_elements += group.param_.numel();
+    }
+
+    if (num_elements == 0)
+        return;
+    const int threads = 256;
+    int64_t blocks = (num_elements + threads - 1) / threads;
+    fused_adam_step<<<blocks, threads, 0, c10::cuda::getCurrentCUDAStream()>>>(
+        args,
+        num_elements,
+        visible.defined() ? visible.data_ptr<bool>() : nullptr,
+        beta1,
+        beta2,
+        eps);
+}
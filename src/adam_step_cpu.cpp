@@ -0,0 +1,101 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "include/adam_step.h"
+
+#include <ATen/Parallel.h>
+
+#include <cmath>
+
+namespace
+{
+
+struct AdamRange
+{
+    float* param;
+    const float* grad;
+    float* exp_avg;
+    float* exp_avg_sq;
+    int64_t row_size;
+    float step_size;
+    float bias_correction2_sqrt;
+};
+
+inline void updateElements(
+    const AdamRange& group,
+    int64_t begin,
+    int64_t end,
+    const float beta1,
+    const float beta2,
+    const float eps)
+{
+    float* __restrict__ param = group.param;
+    const float* __restrict__ grad = group.grad;
+    float* __restrict__ exp_avg = group.exp_avg;
+    float* __restrict__ exp_avg_sq = group.exp_avg_sq;
+    for (int64_t i = begin; i < end; ++i) {
+        float m = beta1 * exp_avg[i] + (1.0f - beta1) * grad[i];
+        float v = beta2 * exp_avg_sq[i] + (1.0f - beta2) * grad[i] * grad[i];
+        exp_avg[i] = m;
+        exp_avg_sq[i] = v;
+        param[i] -= group.step_size * m / (std::sqrt(v) / group.bias_correction2_sqrt + eps);
+    }
+}
+
+}
+
+void adamStepCPU(
+    std::vector<AdamStepGroup>& groups,
+    const torch::Tensor& visible,
+    const float beta1,
+    const float beta2,
+    const float eps)
+{
+    if (groups.empty())
+        return;
+    const int64_t num_rows = groups[0].param_.size(0);
+
+    std::vector<AdamRange> ranges(groups.size());
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        auto& group = groups[g];
+        if (group.param_.size(0) != num_rows) {
+            AT_ERROR("adamStepCPU needs the same number of points in every group");
+        }
+        ranges[g].param = group.param_.data_ptr<float>();
+        ranges[g].grad = group.grad_.data_ptr<float>();
+        ranges[g].exp_avg = group.exp_avg_.data_ptr<float>();
+        ranges[g].exp_avg_sq = group.exp_avg_sq_.data_ptr<float>();
+        ranges[g].row_size = num_rows ? group.param_.numel() / num_rows : 0;
+        ranges[g].step_size = group.lr_ / group.bias_correction1_;
+        ranges[g].bias_correction2_sqrt = std::sqrt(group.bias_correction2_);
+    }
+    const bool* visible_ptr = visible.defined() ? visible.data_ptr<bool>() : nullptr;
+
+    // Every chunk of points goes through all groups at once
+    at::parallel_for(0, num_rows, 2048, [&](int64_t begin, int64_t end) {
+        for (auto& range : ranges) {
+            if (!visible_ptr) {
+                updateElements(range, begin * range.row_size, end * range.row_size, beta1, beta2, eps);
+                continue;
+            }
+            for (int64_t row = begin; row < end; ++row)
+                if (visible_ptr[row])
+                    updateElements(range, row * range.row_size, (row + 1) * range.row_size, beta1, beta2, eps);
+        }
+    });
+}
@@ -0,0 +1,262 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/fused_ssim.h"
+
+#include <cuda_runtime_api.h>
+#include <cuda.h>
+#include <cuda_runtime.h>
+#include <device_launch_parameters.h>
+#include <c10/cuda/CUDAStream.h>
+
+#define SSIM_BLOCK_X 16
+#define SSIM_BLOCK_Y 16
+#define SSIM_HALO (FUSED_SSIM_MAX_WINDOW / 2)
+#define SSIM_TILE_X (SSIM_BLOCK_X + 2 * SSIM_HALO)
+#define SSIM_TILE_Y (SSIM_BLOCK_Y + 2 * SSIM_HALO)
+
+// One block per 16x16 output tile of one plane: the tile and its halo are
+// loaded once to shared memory, filtered along the rows, then along the columns.
+
+__global__ void fused_ssim_forward(
+    const SsimWindow window,
+    const int height,
+    const int width,
+    const float* __restrict__ img1,
+    const float* __restrict__ img2,
+    const float C1,
+    const float C2,
+    float* __restrict__ ssim_map,
+    float* __restrict__ d_mu1,
+    float* __restrict__ d_sigma1_sq,
+    float* __restrict__ d_sigma12)
+{
+    __shared__ float tile[2][SSIM_TILE_Y][SSIM_TILE_X];
+    __shared__ float horizontal[5][SSIM_TILE_Y][SSIM_BLOCK_X];
+
+    const int radius = window.size_ / 2;
+    const int64_t plane_offset = static_cast<int64_t>(blockIdx.z) * height * width;
+    const int tile_i = blockIdx.y * SSIM_BLOCK_Y - SSIM_HALO;
+    const int tile_j = blockIdx.x * SSIM_BLOCK_X - SSIM_HALO;
+    const int thread_rank = threadIdx.y * SSIM_BLOCK_X + threadIdx.x;
+
+    for (int idx = thread_rank; idx < SSIM_TILE_Y * SSIM_TILE_X; idx += SSIM_BLOCK_X * SSIM_BLOCK_Y) {
+        const int li = idx / SSIM_TILE_X;
+        const int lj = idx % SSIM_TILE_X;
+        const int i = tile_i + li;
+        const int j = tile_j + lj;
+        const bool inside = i >= 0 && i < height && j >= 0 && j < width;
+        const int64_t g = plane_offset + static_cast<int64_t>(i) * width + j;
+        tile[0][li][lj] = inside ? img1[g] : 0.0f;
+        tile[1][li][lj] = inside ? img2[g] : 0.0f;
+    }
+    __syncthreads();
+
+    for (int li = threadIdx.y; li < SSIM_TILE_Y; li += SSIM_BLOCK_Y) {
+        float m[5] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (int k = -radius; k <= radius; ++k) {
+            const float w = window.weights_[k + radius];
+            const float x = tile[0][li][threadIdx.x + SSIM_HALO + k];
+            const float y = tile[1][li][threadIdx.x + SSIM_HALO + k];
+            m[0] += w * x;
+            m[1] += w * y;
+            m[2] += w * x * x;
+            m[3] += w * y * y;
+            m[4] += w * x * y;
+        }
+        for (int c = 0; c < 5; ++c)
+            horizontal[c][li][threadIdx.x] = m[c];
+    }
+    __syncthreads();
+
+    const int i = blockIdx.y * SSIM_BLOCK_Y + threadIdx.y;
+    const int j = blockIdx.x * SSIM_BLOCK_X + threadIdx.x;
+    if (i >= height || j >= width)
+        return;
+    float m[5] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int k = -radius; k <= radius; ++k) {
+        const float w = window.weights_[k + radius];
+        for (int c = 0; c < 5; ++c)
+            m[c] += w * horizontal[c][threadIdx.y + SSIM_HALO + k][threadIdx.x];
+    }
+
+    const float mu1 = m[0];
+    const float mu2 = m[1];
+    const float sigma1_sq = m[2] - mu1 * mu1;
+    const float sigma2_sq = m[3] - mu2 * mu2;
+    const float sigma12 = m[4] - mu1 * mu2;
+    const float A1 = 2.0f * mu1 * mu2 + C1;
+    const float A2 = 2.0f * sigma12 + C2;
+    const float B1 = mu1 * mu1 + mu2 * mu2 + C1;
+    const float B2 = sigma1_sq + sigma2_sq + C2;
+    const float ssim = (A1 * A2) / (B1 * B2);
+    const int64_t o = plane_offset + static_cast<int64_t>(i) * width + j;
+    ssim_map[o] = ssim;
+    if (d_mu1) {
+        d_mu1[o] = 2.0f * mu2 * (A2 - A1) / (B1 * B2) - 2.0f * mu1 * ssim * (1.0f / B1 - 1.0f / B2);
+        d_sigma1_sq[o] = -ssim / B2;
+        d_sigma12[o] = 2.0f * A1 / (B1 * B2);
+    }
+}
+
+__global__ void fused_ssim_backward(
+    const SsimWindow window,
+    const int height,
+    const int width,
+    const float* __restrict__ img1,
+    const float* __restrict__ img2,
+    const float* __restrict__ grad_map,
+    const float* __restrict__ d_mu1,
+    const float* __restrict__ d_sigma1_sq,
+    const float* __restrict__ d_sigma12,
+    float* __restrict__ grad_img1)
+{
+    __shared__ float tile[3][SSIM_TILE_Y][SSIM_TILE_X];
+    __shared__ float horizontal[3][SSIM_TILE_Y][SSIM_BLOCK_X];
+
+    const int radius = window.size_ / 2;
+    const int64_t plane_offset = static_cast<int64_t>(blockIdx.z) * height * width;
+    const int tile_i = blockIdx.y * SSIM_BLOCK_Y - SSIM_HALO;
+    const int tile_j = blockIdx.x * SSIM_BLOCK_X - SSIM_HALO;
+    const int thread_rank = threadIdx.y * SSIM_BLOCK_X + threadIdx.x;
+
+    // The filter is symmetric, so its adjoint is itself
+    for (int idx = thread_rank; idx < SSIM_TILE_Y * SSIM_TILE_X; idx += SSIM_BLOCK_X * SSIM_BLOCK_Y) {
+        const int li = idx / SSIM_TILE_X;
+        const int lj = idx % SSIM_TILE_X;
+        const int i = tile_i + li;
+        const int j = tile_j + lj;
+        const bool inside = i >= 0 && i < height && j >= 0 && j < width;
+        const int64_t g = plane_offset + static_cast<int64_t>(i) * width + j;
+        const float grad = inside ? grad_map[g] : 0.0f;
+        tile[0][li][lj] = inside ? grad * d_mu1[g] : 0.0f;
+        tile[1][li][lj] = inside ? grad * d_sigma1_sq[g] : 0.0f;
+        tile[2][li][lj] = inside ? grad * d_sigma12[g] : 0.0f;
+    }
+    __syncthreads();
+
+    for (int li = threadIdx.y; li < SSIM_TILE_Y; li += SSIM_BLOCK_Y) {
+        float b[3] = {0.0f, 0.0f, 0.0f};
+        for (int k = -radius; k <= radius; ++k) {
+            const float w = window.weights_[k + radius];
+            for (int c = 0; c < 3; ++c)
+                b[c] += w * tile[c][li][threadIdx.x + SSIM_HALO + k];
+        }
+        for (int c = 0; c < 3; ++c)
+            horizontal[c][li][threadIdx.x] = b[c];
+    }
+    __syncthreads();
+
+    const int i = blockIdx.y * SSIM_BLOCK_Y + threadIdx.y;
+    const int j = blockIdx.x * SSIM_BLOCK_X + threadIdx.x;
+    if (i >= height || j >= width)
+        return;
+    float b[3] = {0.0f, 0.0f, 0.0f};
+    for (int k = -radius; k <= radius; ++k) {
+        const float w = window.weights_[k + radius];
+        for (int c = 0; c < 3; ++c)
+            b[c] += w * horizontal[c][threadIdx.y + SSIM_HALO + k][threadIdx.x];
+    }
+    const int64_t o = plane_offset + static_cast<int64_t>(i) * width + j;
+    grad_img1[o] = b[0] + 2.0f * img1[o] * b[1] + img2[o] * b[2];
+}
+
+namespace
+{
+
+inline void checkPlanes(const torch::Tensor& img, const char* name)
+{
+    if (img.dim() != 3 || img.scalar_type() != torch::kFloat || !img.is_contiguous() || !img.is_cuda()) {
+        AT_ERROR("fused SSIM needs contiguous float (num_planes, H, W) CUDA images, got ", name, " ", img.sizes());
+    }
+}
+
+inline dim3 gridOf(const torch::Tensor& img)
+{
+    return dim3((img.size(2) + SSIM_BLOCK_X - 1) / SSIM_BLOCK_X,
+                (img.size(1) + SSIM_BLOCK_Y - 1) / SSIM_BLOCK_Y,
+                img.size(0));
+}
+
+}
+
+std::vector<torch::Tensor> fusedSsimForwardCUDA(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const float C1,
+    const float C2,
+    const bool with_partials)
+{
+    checkPlanes(img1, "img1");
+    checkPlanes(img2, "img2");
+    torch::Tensor ssim_map = torch::empty_like(img1);
+    torch::Tensor d_mu1, d_sigma1_sq, d_sigma12;
+    if (with_partials) {
+        d_mu1 = torch::empty_like(img1);
+        d_sigma1_sq = torch::empty_like(img1);
+        d_sigma12 = torch::empty_like(img1);
+    }
+    if (img1.numel() == 0)
+        return {ssim_map, d_mu1, d_sigma1_sq, d_sigma12};
+
+    fused_ssim_forward<<<gridOf(img1), dim3(SSIM_BLOCK_X, SSIM_BLOCK_Y), 0, c10::cuda::getCurrentCUDAStream()>>>(
+        window,
+        img1.size(1),
+        img1.size(2),
+        img1.data_ptr<float>(),
+        img2.data_ptr<float>(),
+        C1,
+        C2,
+        ssim_map.data_ptr<float>(),
+        with_partials ? d_mu1.data_ptr<float>() : nullptr,
+        with_partials ? d_sigma1_sq.data_ptr<float>() : nullptr,
+        with_partials ? d_sigma12.data_ptr<float>() : nullptr);
+    return {ssim_map, d_mu1, d_sigma1_sq, d_sigma12};
+}
+
+torch::Tensor fusedSsimBackwardCUDA(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const torch::Tensor& grad_map,
+    const std::vector<torch::Tensor>& partials)
+{
+    checkPlanes(img1, "img1");
+    checkPlanes(img2, "img2");
+    checkPlanes(grad_map, "grad_map");
+    for (auto& partial : partials)
+        checkPlanes(partial, "partial");
+    torch::Tensor grad_img1 = torch::empty_like(img1);
+    if (img1.numel() == 0)
+        return grad_img1;
+
+    fused_ssim_backward<<<gridOf(img1), dim3(SSIM_BLOCK_X, SSIM_BLOCK_Y), 0, c10::cuda::getCurrentCUDAStream()>>>(
+        window,
+        img1.size(1),
+        img1.size(2),
+        img1.data_ptr<float>(),
+        img2.data_ptr<float>(),
+        grad_map.data_ptr<float>(),
+        partials.at(0).data_ptr<float>(),
+        partials.at(1).data_ptr<float>(),
+        partials.at(2).data_ptr<float>(),
+        grad_img1.data_ptr<float>());
+    return grad_img1;
+}
@@ -0,0 +1,256 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/fused_ssim.h"
+
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+
+/**
+ * @brief out[j] += sum_k w[k] * in[j + k - radius] over a row, zero outside
+ */
+inline void filterRow(
+    const float* __restrict__ in,
+    float* __restrict__ out,
+    const int width,
+    const SsimWindow& window)
+{
+    const int radius = window.size_ / 2;
+    for (int k = -radius; k <= radius; ++k) {
+        const float w = window.weights_[k + radius];
+        const int begin = std::max(0, -k);
+        const int end = std::min(width, width - k);
+        for (int j = begin; j < end; ++j)
+            out[j] += w * in[j + k];
+    }
+}
+
+inline void checkPlanes(const torch::Tensor& img, const char* name)
+{
+    if (img.dim() != 3 || img.scalar_type() != torch::kFloat || !img.is_contiguous()) {
+        AT_ERROR("fused SSIM needs contiguous float (num_planes, H, W) images, got ", name, " ", img.sizes());
+    }
+}
+
+/**
+ * @brief Vertical pass of `num_maps` horizontally filtered maps for one row
+ */
+inline void filterColumn(
+    const float* const* maps,
+    float* const* out,
+    const int num_maps,
+    const int64_t plane_offset,
+    const int i,
+    const int height,
+    const int width,
+    const SsimWindow& window)
+{
+    const int radius = window.size_ / 2;
+    for (int c = 0; c < num_maps; ++c)
+        std::fill(out[c], out[c] + width, 0.0f);
+    for (int k = -radius; k <= radius; ++k) {
+        const int ii = i + k;
+        if (ii < 0 || ii >= height)
+            continue;
+        const float w = window.weights_[k + radius];
+        for (int c = 0; c < num_maps; ++c) {
+            const float* __restrict__ row = maps[c] + plane_offset + static_cast<int64_t>(ii) * width;
+            float* __restrict__ acc = out[c];
+            for (int j = 0; j < width; ++j)
+                acc[j] += w * row[j];
+        }
+    }
+}
+
+}
+
+const SsimWindow& ssimWindow(int window_size)
+{
+    if (window_size < 1 || window_size > FUSED_SSIM_MAX_WINDOW || window_size % 2 == 0) {
+        AT_ERROR("fused SSIM needs an odd window of at most ", FUSED_SSIM_MAX_WINDOW, ", got ", window_size);
+    }
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<SsimWindow>> windows;
+    std::unique_lock<std::mutex> lock(mutex);
+    auto& window = windows[window_size];
+    if (!window) {
+        window.reset(new SsimWindow());
+        window->size_ = window_size;
+        const float sigma = 1.5f;
+        float sum = 0.0f;
+        for (int x = 0; x < window_size; ++x) {
+            int temp = x - window_size / 2;
+            window->weights_[x] = std::exp(-temp * temp / (2.0f * sigma * sigma));
+            sum += window->weights_[x];
+        }
+        for (int x = 0; x < window_size; ++x)
+            window->weights_[x] /= sum;
+    }
+    return *window;
+}
+
+std::vector<torch::Tensor> fusedSsimForwardCPU(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const float C1,
+    const float C2,
+    const bool with_partials)
+{
+    checkPlanes(img1, "img1");
+    checkPlanes(img2, "img2");
+    const int64_t num_planes = img1.size(0);
+    const int height = img1.size(1);
+    const int width = img1.size(2);
+    const int64_t num_rows = num_planes * height;
+
+    // x, y, x^2, y^2, xy filtered along the rows
+    torch::Tensor horizontal = torch::empty({5, num_planes, height, width}, img1.options());
+    const float* x = img1.data_ptr<float>();
+    const float* y = img2.data_ptr<float>();
+    float* h = horizontal.data_ptr<float>();
+    const int64_t map_size = num_rows * width;
+    at::parallel_for(0, num_rows, 16, [&](int64_t begin, int64_t end) {
+        std::vector<float> products(3 * width);
+        for (int64_t row = begin; row < end; ++row) {
+            const float* xr = x + row * width;
+            const float* yr = y + row * width;
+            for (int j = 0; j < width; ++j) {
+                products[j] = xr[j] * xr[j];
+                products[width + j] = yr[j] * yr[j];
+                products[2 * width + j] = xr[j] * yr[j];
+            }
+            const float* ins[5] = {xr, yr, products.data(), products.data() + width, products.data() + 2 * width};
+            for (int c = 0; c < 5; ++c) {
+                float* out = h + c * map_size + row * width;
+                std::fill(out, out + width, 0.0f);
+                filterRow(ins[c], out, width, window);
+            }
+        }
+    });
+
+    torch::Tensor ssim_map = torch::empty_like(img1);
+    torch::Tensor d_mu1, d_sigma1_sq, d_sigma12;
+    if (with_partials) {
+        d_mu1 = torch::empty_like(img1);
+        d_sigma1_sq = torch::empty_like(img1);
+        d_sigma12 = torch::empty_like(img1);
+    }
+    float* s = ssim_map.data_ptr<float>();
+    float* dm = with_partials ? d_mu1.data_ptr<float>() : nullptr;
+    float* ds11 = with_partials ? d_sigma1_sq.data_ptr<float>() : nullptr;
+    float* ds12 = with_partials ? d_sigma12.data_ptr<float>() : nullptr;
+    at::parallel_for(0, num_rows, 16, [&](int64_t begin, int64_t end) {
+        std::vector<float> moments(5 * width);
+        float* out[5];
+        for (int c = 0; c < 5; ++c)
+            out[c] = moments.data() + c * width;
+        const float* maps[5];
+        for (int c = 0; c < 5; ++c)
+            maps[c] = h + c * map_size;
+        for (int64_t row = begin; row < end; ++row) {
+            const int64_t plane_offset = (row / height) * height * width;
+            filterColumn(maps, out, 5, plane_offset, row % height, height, width, window);
+            const int64_t o = row * width;
+            for (int j = 0; j < width; ++j) {
+                const float mu1 = out[0][j];
+                const float mu2 = out[1][j];
+                const float sigma1_sq = out[2][j] - mu1 * mu1;
+                const float sigma2_sq = out[3][j] - mu2 * mu2;
+                const float sigma12 = out[4][j] - mu1 * mu2;
+                const float A1 = 2.0f * mu1 * mu2 + C1;
+                const float A2 = 2.0f * sigma12 + C2;
+                const float B1 = mu1 * mu1 + mu2 * mu2 + C1;
+                const float B2 = sigma1_sq + sigma2_sq + C2;
+                const float ssim = (A1 * A2) / (B1 * B2);
+                s[o + j] = ssim;
+                if (dm) {
+                    dm[o + j] = 2.0f * mu2 * (A2 - A1) / (B1 * B2) - 2.0f * mu1 * ssim * (1.0f / B1 - 1.0f / B2);
+                    ds11[o + j] = -ssim / B2;
+                    ds12[o + j] = 2.0f * A1 / (B1 * B2);
+                }
+            }
+        }
+    });
+    return {ssim_map, d_mu1, d_sigma1_sq, d_sigma12};
+}
+
+torch::Tensor fusedSsimBackwardCPU(
+    const torch::Tensor& img1,
+    const torch::Tensor& img2,
+    const SsimWindow& window,
+    const torch::Tensor& grad_map,
+    const std::vector<torch::Tensor>& partials)
+{
+    checkPlanes(img1, "img1");
+    checkPlanes(img2, "img2");
+    checkPlanes(grad_map, "grad_map");
+    for (auto& partial : partials)
+        checkPlanes(partial, "partial");
+    const int64_t num_planes = img1.size(0);
+    const int height = img1.size(1);
+    const int width = img1.size(2);
+    const int64_t num_rows = num_planes * height;
+    const int64_t map_size = num_rows * width;
+
+    // The filter is symmetric, so its adjoint is itself
+    torch::Tensor horizontal = torch::empty({3, num_planes, height, width}, img1.options());
+    const float* g = grad_map.data_ptr<float>();
+    const float* p[3] = {partials.at(0).data_ptr<float>(), partials.at(1).data_ptr<float>(), partials.at(2).data_ptr<float>()};
+    float* h = horizontal.data_ptr<float>();
+    at::parallel_for(0, num_rows, 16, [&](int64_t begin, int64_t end) {
+        std::vector<float> weighted(width);
+        for (int64_t row = begin; row < end; ++row) {
+            const int64_t o = row * width;
+            for (int c = 0; c < 3; ++c) {
+                for (int j = 0; j < width; ++j)
+                    weighted[j] = g[o + j] * p[c][o + j];
+                float* out = h + c * map_size + o;
+                std::fill(out, out + width, 0.0f);
+                filterRow(weighted.data(), out, width, window);
+            }
+        }
+    });
+
+    torch::Tensor grad_img1 = torch::empty_like(img1);
+    const float* x = img1.data_ptr<float>();
+    const float* y = img2.data_ptr<float>();
+    float* dx = grad_img1.data_ptr<float>();
+    at::parallel_for(0, num_rows, 16, [&](int64_t begin, int64_t end) {
+        std::vector<float> blurred(3 * width);
+        float* out[3] = {blurred.data(), blurred.data() + width, blurred.data() + 2 * width};
+        const float* maps[3] = {h, h + map_size, h + 2 * map_size};
+        for (int64_t row = begin; row < end; ++row) {
+            const int64_t plane_offset = (row / height) * height * width;
+            filterColumn(maps, out, 3, plane_offset, row % height, height, width, window);
+            const int64_t o = row * width;
+            for (int j = 0; j < width; ++j)
+                dx[o + j] = out[0][j] + 2.0f * x[o + j] * out[1][j] + y[o + j] * out[2][j];
+        }
+    });
+    return grad_img1;
+}
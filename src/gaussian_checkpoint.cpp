@@ -0,0 +1,318 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/gaussian_checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+
+const char checkpoint_magic[8] = {'P', 'S', 'L', 'A', 'M', 'C', 'K', 'P'};
+constexpr int max_dims = 6;
+constexpr std::size_t name_capacity = 96;
+
+/**
+ * @brief Scalar types as stored on disk, independent of the torch enumeration
+ */
+enum DataType : std::int32_t
+{
+    DATA_FLOAT32 = 0,
+    DATA_FLOAT64 = 1,
+    DATA_FLOAT16 = 2,
+    DATA_INT64 = 3,
+    DATA_INT32 = 4,
+    DATA_INT16 = 5,
+    DATA_UINT8 = 6,
+    DATA_BOOL = 7
+};
+
+struct FileHeader
+{
+    char magic_[8];
+    std::uint32_t version_;
+    std::uint32_t num_sections_;
+    std::uint64_t table_offset_;
+    std::uint64_t file_size_;
+};
+
+struct SectionEntry
+{
+    char name_[name_capacity];
+    std::int32_t dtype_;
+    std::int32_t ndim_;
+    std::int64_t shape_[max_dims];
+    std::uint64_t offset_;
+    std::uint64_t nbytes_;
+};
+
+std::uint64_t alignUp(std::uint64_t offset)
+{
+    return (offset + GaussianCheckpoint::alignment_ - 1) / GaussianCheckpoint::alignment_ * GaussianCheckpoint::alignment_;
+}
+
+DataType toDataType(torch::ScalarType type)
+{
+    switch (type)
+    {
+    case torch::kFloat: return DATA_FLOAT32;
+    case torch::kDouble: return DATA_FLOAT64;
+    case torch::kHalf: return DATA_FLOAT16;
+    case torch::kLong: return DATA_INT64;
+    case torch::kInt: return DATA_INT32;
+    case torch::kShort: return DATA_INT16;
+    case torch::kByte: return DATA_UINT8;
+    case torch::kBool: return DATA_BOOL;
+    default:
+        throw std::runtime_error("[GaussianCheckpoint]Unsupported tensor type " + std::string(c10::toString(type)));
+    }
+}
+
+torch::ScalarType toScalarType(std::int32_t type)
+{
+    switch (type)
+    {
+    case DATA_FLOAT32: return torch::kFloat;
+    case DATA_FLOAT64: return torch::kDouble;
+    case DATA_FLOAT16: return torch::kHalf;
+    case DATA_INT64: return torch::kLong;
+    case DATA_INT32: return torch::kInt;
+    case DATA_INT16: return torch::kShort;
+    case DATA_UINT8: return torch::kByte;
+    case DATA_BOOL: return torch::kBool;
+    default:
+        throw std::runtime_error("[GaussianCheckpoint]Unknown section type " + std::to_string(type));
+    }
+}
+
+void writePadding(std::ofstream& out, std::uint64_t& position, std::uint64_t target)
+{
+    static const char zeros[GaussianCheckpoint::alignment_] = {};
+    while (position < target) {
+        std::uint64_t n = std::min<std::uint64_t>(target - position, GaussianCheckpoint::alignment_);
+        out.write(zeros, n);
+        position += n;
+    }
+}
+
+}
+
+void GaussianCheckpoint::put(const std::string& name, const torch::Tensor& tensor)
+{
+    if (name.empty() || name.size() >= name_capacity)
+        throw std::runtime_error("[GaussianCheckpoint]Invalid section name " + name);
+    if (tensor.dim() > max_dims)
+        throw std::runtime_error("[GaussianCheckpoint]Section " + name + " has too many dimensions");
+    toDataType(tensor.scalar_type());
+    sections_[name] = tensor;
+}
+
+void GaussianCheckpoint::putInt(const std::string& name, std::int64_t value)
+{
+    put(name, torch::full({1}, value, torch::TensorOptions().dtype(torch::kLong)));
+}
+
+void GaussianCheckpoint::putFloat(const std::string& name, double value)
+{
+    put(name, torch::full({1}, value, torch::TensorOptions().dtype(torch::kDouble)));
+}
+
+void GaussianCheckpoint::putString(const std::string& name, const std::string& value)
+{
+    torch::Tensor bytes = torch::empty({static_cast<std::int64_t>(value.size())}, torch::TensorOptions().dtype(torch::kByte));
+    std::memcpy(bytes.data_ptr(), value.data(), value.size());
+    put(name, bytes);
+}
+
+bool GaussianCheckpoint::has(const std::string& name) const
+{
+    return sections_.count(name) != 0;
+}
+
+torch::Tensor GaussianCheckpoint::get(const std::string& name) const
+{
+    auto it = sections_.find(name);
+    if (it == sections_.end())
+        throw std::runtime_error("[GaussianCheckpoint]Missing section " + name);
+    return it->second;
+}
+
+std::int64_t GaussianCheckpoint::getInt(const std::string& name) const
+{
+    return get(name).item<std::int64_t>();
+}
+
+double GaussianCheckpoint::getFloat(const std::string& name) const
+{
+    return get(name).item<double>();
+}
+
+std::string GaussianCheckpoint::getString(const std::string& name) const
+{
+    torch::Tensor bytes = get(name).to(torch::kCPU).contiguous();
+    return std::string(static_cast<const char*>(bytes.data_ptr()), bytes.numel());
+}
+
+std::vector<std::string> GaussianCheckpoint::names() const
+{
+    std::vector<std::string> names;
+    names.reserve(sections_.size());
+    for (auto& section : sections_)
+        names.emplace_back(section.first);
+    return names;
+}
+
+std::size_t GaussianCheckpoint::numBytes() const
+{
+    std::size_t num_bytes = 0;
+    for (auto& section : sections_)
+        num_bytes += section.second.numel() * section.second.element_size();
+    return num_bytes;
+}
+
+/**
+ * @brief Detached copies of every section, on their own devices, to be saved while training goes on
+ */
+GaussianCheckpoint GaussianCheckpoint::snapshot() const
+{
+    torch::NoGradGuard no_grad;
+    GaussianCheckpoint snapshot;
+    for (auto& section : sections_)
+        snapshot.sections_[section.first] = section.second.detach().clone();
+    return snapshot;
+}
+
+void GaussianCheckpoint::save(const std::filesystem::path& path) const
+{
+    std::vector<SectionEntry> table;
+    std::vector<torch::Tensor> data;
+    table.reserve(sections_.size());
+    data.reserve(sections_.size());
+    std::uint64_t offset = alignUp(sizeof(FileHeader) + sections_.size() * sizeof(SectionEntry));
+    for (auto& section : sections_) {
+        torch::Tensor tensor = section.second.detach().to(torch::kCPU).contiguous();
+        SectionEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        std::strncpy(entry.name_, section.first.c_str(), name_capacity - 1);
+        entry.dtype_ = toDataType(tensor.scalar_type());
+        entry.ndim_ = tensor.dim();
+        for (int d = 0; d < entry.ndim_; ++d)
+            entry.shape_[d] = tensor.size(d);
+        entry.offset_ = offset;
+        entry.nbytes_ = tensor.numel() * tensor.element_size();
+        offset = alignUp(offset + entry.nbytes_);
+        table.emplace_back(entry);
+        data.emplace_back(tensor);
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version_ = version_;
+    header.num_sections_ = table.size();
+    header.table_offset_ = sizeof(FileHeader);
+    header.file_size_ = offset;
+
+    // Written next to the target and renamed, so an interrupted save never leaves a truncated checkpoint
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        throw std::runtime_error("[GaussianCheckpoint]Cannot open " + tmp_path.string());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SectionEntry));
+    std::uint64_t position = sizeof(header) + table.size() * sizeof(SectionEntry);
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        writePadding(out, position, table[i].offset_);
+        out.write(static_cast<const char*>(data[i].data_ptr()), table[i].nbytes_);
+        position += table[i].nbytes_;
+    }
+    writePadding(out, position, header.file_size_);
+    out.close();
+    if (out.fail())
+        throw std::runtime_error("[GaussianCheckpoint]Failed to write " + tmp_path.string());
+    std::filesystem::rename(tmp_path, path);
+}
+
+GaussianCheckpoint GaussianCheckpoint::load(const std::filesystem::path& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("[GaussianCheckpoint]Cannot open " + path.string());
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0 || static_cast<std::uint64_t>(file_stat.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("[GaussianCheckpoint]Not a checkpoint: " + path.string());
+    }
+    std::uint64_t file_size = file_stat.st_size;
+    // Private and writable: tensors may be modified in place without touching the file
+    void* address = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+        throw std::runtime_error("[GaussianCheckpoint]Cannot map " + path.string());
+    std::shared_ptr<void> mapping(address, [file_size](void* p) { ::munmap(p, file_size); });
+    char* base = static_cast<char*>(address);
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic_, checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+        throw std::runtime_error("[GaussianCheckpoint]Not a checkpoint: " + path.string());
+    if (header.version_ > version_)
+        throw std::runtime_error("[GaussianCheckpoint]" + path.string() + " has version "
+                                 + std::to_string(header.version_) + ", newer than "
+                                 + std::to_string(version_));
+    if (header.file_size_ != file_size ||
+        header.table_offset_ + header.num_sections_ * sizeof(SectionEntry) > file_size)
+        throw std::runtime_error("[GaussianCheckpoint]Truncated checkpoint: " + path.string());
+
+    GaussianCheckpoint checkpoint;
+    for (std::uint32_t i = 0; i < header.num_sections_; ++i) {
+        SectionEntry entry;
+        std::memcpy(&entry, base + header.table_offset_ + i * sizeof(SectionEntry), sizeof(entry));
+        entry.name_[name_capacity - 1] = '\0';
+        std::string name(entry.name_);
+        if (entry.ndim_ < 0 || entry.ndim_ > max_dims ||
+            entry.offset_ % alignment_ != 0 ||
+            entry.offset_ + entry.nbytes_ > file_size)
+            throw std::runtime_error("[GaussianCheckpoint]Corrupted section " + name + " in " + path.string());
+
+        torch::ScalarType type = toScalarType(entry.dtype_);
+        std::vector<std::int64_t> shape(entry.shape_, entry.shape_ + entry.ndim_);
+        std::int64_t numel = 1;
+        for (auto size : shape)
+            numel *= size;
+        if (static_cast<std::uint64_t>(numel) * c10::elementSize(type) != entry.nbytes_)
+            throw std::runtime_error("[GaussianCheckpoint]Corrupted section " + name + " in " + path.string());
+
+        // Every view holds the mapping
+        checkpoint.sections_[name] = torch::from_blob(
+            base + entry.offset_, shape,
+            [mapping](void*) {},
+            torch::TensorOptions().dtype(type));
+    }
+    return checkpoint;
+}
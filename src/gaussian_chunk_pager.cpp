@@ -0,0 +1,312 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/gaussian_chunk_pager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include "include/gaussian_checkpoint.h"
+
+namespace
+{
+
+std::string columnName(std::size_t idx)
+{
+    return "column/" + std::to_string(idx);
+}
+
+/**
+ * @brief Zero-pad (or cut) the rows of `rows` to the row shape of `like`
+ */
+torch::Tensor fitRowShape(const torch::Tensor& rows, const torch::Tensor& like)
+{
+    if (rows.sizes().slice(1).equals(like.sizes().slice(1)))
+        return rows;
+    if (rows.dim() != like.dim())
+        throw std::runtime_error("[GaussianChunkPager]Paged column changed its number of dimensions");
+    auto shape = like.sizes().vec();
+    shape[0] = rows.size(0);
+    torch::Tensor fitted = torch::zeros(shape, rows.options());
+    torch::Tensor dst = fitted, src = rows;
+    for (int64_t dim = 1; dim < rows.dim(); ++dim) {
+        std::int64_t kept = std::min(rows.size(dim), like.size(dim));
+        dst = dst.narrow(dim, 0, kept);
+        src = src.narrow(dim, 0, kept);
+    }
+    dst.copy_(src);
+    return fitted;
+}
+
+double msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+GaussianChunkPager::GaussianChunkPager(const std::filesystem::path& directory, float chunk_size)
+    : directory_(directory)
+{
+    key_grid_.setVoxelSize(chunk_size);
+    std::filesystem::create_directories(directory_);
+}
+
+GaussianChunkPager::~GaussianChunkPager()
+{
+    // Chunk files only live for the session
+    std::error_code error;
+    for (auto& chunk : paged_)
+        std::filesystem::remove(chunk.second.path_, error);
+}
+
+/**
+ * @brief Move whole chunks to disk, the farthest from `center` first, until at most
+ *        `max_resident` rows remain or only chunks within `keep_radius` are left
+ *
+ * @return the number of rows paged out; the surviving rows are compacted, so row indices change
+ */
+std::int64_t GaussianChunkPager::pageOut(
+    GaussianParameterStore& store,
+    std::size_t xyz_column,
+    const torch::Tensor& center,
+    float keep_radius,
+    std::int64_t max_resident)
+{
+    torch::NoGradGuard no_grad;
+    if (store.size() <= max_resident)
+        return 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // Resident chunks, their sizes and distances from the center
+    torch::Tensor xyz = store.column(xyz_column);
+    torch::Tensor keys = key_grid_.keysOf(xyz);
+    auto unique = torch::_unique(keys, /*sorted=*/true, /*return_inverse=*/true);
+    torch::Tensor chunk_keys = std::get<0>(unique);
+    torch::Tensor inverse = std::get<1>(unique);
+    torch::Tensor counts = torch::bincount(inverse, /*weights=*/{}, chunk_keys.size(0));
+    torch::Tensor centers = torch::zeros({chunk_keys.size(0), 3}, xyz.options()).index_add_(0, inverse, xyz)
+                            / counts.unsqueeze(1).to(xyz.scalar_type());
+    torch::Tensor dists = (centers - center.to(xyz.device(), xyz.scalar_type()).view({1, 3})).norm(2, /*dim=*/1);
+    // Walked on the host, one copy each
+    torch::Tensor order = dists.argsort(/*dim=*/0, /*descending=*/true).cpu();
+    chunk_keys = chunk_keys.cpu();
+    counts = counts.to(torch::kCPU, torch::kLong);
+    dists = dists.to(torch::kCPU, torch::kFloat);
+    centers = centers.to(torch::kCPU, torch::kFloat);
+    auto order_a = order.accessor<std::int64_t, 1>();
+    auto chunk_keys_a = chunk_keys.accessor<std::int64_t, 1>();
+    auto counts_a = counts.accessor<std::int64_t, 1>();
+    auto dists_a = dists.accessor<float, 1>();
+    auto centers_a = centers.accessor<float, 2>();
+
+    std::vector<std::int64_t> out_keys;
+    std::vector<std::int64_t> out_slots;
+    std::int64_t num_resident = store.size();
+    for (std::int64_t i = 0; i < order_a.size(0) && num_resident > max_resident; ++i) {
+        std::int64_t slot = order_a[i];
+        if (dists_a[slot] <= keep_radius)
+            break;
+        out_keys.push_back(chunk_keys_a[slot]);
+        out_slots.push_back(slot);
+        num_resident -= counts_a[slot];
+    }
+    if (out_keys.empty())
+        return 0;
+
+    // Rows of the paged chunks, grouped by chunk
+    torch::Tensor out_keys_tensor = torch::tensor(out_keys, torch::TensorOptions().dtype(torch::kLong)).to(keys.device());
+    torch::Tensor out_mask = torch::isin(keys, out_keys_tensor);
+    torch::Tensor out_rows = out_mask.nonzero().squeeze(1);
+    torch::Tensor row_order = keys.index_select(0, out_rows).argsort();
+    out_rows = out_rows.index_select(0, row_order);
+    torch::Tensor sorted_keys = keys.index_select(0, out_rows).cpu();
+    auto sorted_keys_a = sorted_keys.accessor<std::int64_t, 1>();
+    std::vector<torch::Tensor> columns(store.numColumns());
+    for (std::size_t idx = 0; idx < columns.size(); ++idx)
+        columns[idx] = store.column(idx).index_select(0, out_rows).cpu();
+
+    std::int64_t begin = 0;
+    for (std::size_t c = 0; c < out_keys.size(); ++c) {
+        // Chunks are in key order in the sorted rows, not in distance order
+        std::int64_t key = sorted_keys_a[begin];
+        std::int64_t slot = out_slots[std::find(out_keys.begin(), out_keys.end(), key) - out_keys.begin()];
+        std::int64_t num_points = counts_a[slot];
+
+        GaussianCheckpoint checkpoint;
+        Chunk chunk;
+        chunk.path_ = directory_ / ("chunk_" + std::to_string(key) + ".bin");
+        chunk.num_points_ = num_points;
+        for (int k = 0; k < 3; ++k)
+            chunk.center_[k] = centers_a[slot][k];
+        auto paged = paged_.find(key);
+        GaussianCheckpoint former;
+        if (paged != paged_.end()) {
+            // Rows added to the region while it was on disk
+            former = GaussianCheckpoint::load(paged->second.path_);
+            std::int64_t n = paged->second.num_points_;
+            for (int k = 0; k < 3; ++k)
+                chunk.center_[k] = (chunk.center_[k] * num_points + paged->second.center_[k] * n) / (num_points + n);
+            chunk.num_points_ += n;
+        }
+        for (std::size_t idx = 0; idx < columns.size(); ++idx) {
+            torch::Tensor rows = columns[idx].narrow(0, begin, num_points);
+            if (paged != paged_.end())
+                rows = torch::cat({fitRowShape(former.get(columnName(idx)), rows), rows}, /*dim=*/0);
+            checkpoint.put(columnName(idx), rows);
+        }
+        checkpoint.save(chunk.path_);
+        chunk.num_bytes_ = checkpoint.numBytes();
+        stats_.bytes_written_ += chunk.num_bytes_;
+        paged_[key] = chunk;
+        begin += num_points;
+    }
+
+    store.compact(torch::logical_not(out_mask));
+
+    stats_.num_chunks_out_ += out_keys.size();
+    stats_.num_points_out_ += begin;
+    stats_.out_ms_ += msSince(start);
+    return begin;
+}
+
+/**
+ * @brief Reload the paged chunks whose points are centered within `radius` of `center`
+ *
+ * @return the number of rows appended to the store
+ */
+std::int64_t GaussianChunkPager::pageIn(
+    GaussianParameterStore& store,
+    const torch::Tensor& center,
+    float radius)
+{
+    torch::Tensor c = center.to(torch::kCPU, torch::kFloat).contiguous();
+    const float* p = c.data_ptr<float>();
+    std::vector<std::int64_t> keys;
+    for (auto& paged : paged_) {
+        const float* q = paged.second.center_;
+        float d2 = (q[0] - p[0]) * (q[0] - p[0]) + (q[1] - p[1]) * (q[1] - p[1]) + (q[2] - p[2]) * (q[2] - p[2]);
+        if (d2 <= radius * radius)
+            keys.push_back(paged.first);
+    }
+    return pageIn(store, keys);
+}
+
+std::int64_t GaussianChunkPager::pageInAll(GaussianParameterStore& store)
+{
+    std::vector<std::int64_t> keys;
+    for (auto& paged : paged_)
+        keys.push_back(paged.first);
+    return pageIn(store, keys);
+}
+
+std::int64_t GaussianChunkPager::pageIn(GaussianParameterStore& store, const std::vector<std::int64_t>& keys)
+{
+    torch::NoGradGuard no_grad;
+    if (keys.empty())
+        return 0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::vector<torch::Tensor>> column_parts(store.numColumns());
+    std::int64_t num_points = 0;
+    for (auto key : keys) {
+        Chunk& chunk = paged_.at(key);
+        GaussianCheckpoint checkpoint = GaussianCheckpoint::load(chunk.path_);
+        for (std::size_t idx = 0; idx < column_parts.size(); ++idx)
+            column_parts[idx].push_back(fitRowShape(checkpoint.get(columnName(idx)), store.column(idx)));
+        num_points += chunk.num_points_;
+        stats_.bytes_read_ += chunk.num_bytes_;
+    }
+    std::vector<torch::Tensor> rows(column_parts.size());
+    for (std::size_t idx = 0; idx < rows.size(); ++idx)
+        rows[idx] = torch::cat(column_parts[idx], /*dim=*/0);
+    store.append(rows);
+
+    // The appended rows are copies, the mappings can go
+    for (auto key : keys) {
+        std::error_code error;
+        std::filesystem::remove(paged_.at(key).path_, error);
+        paged_.erase(key);
+    }
+
+    stats_.num_chunks_in_ += keys.size();
+    stats_.num_points_in_ += num_points;
+    stats_.in_ms_ += msSince(start);
+    return num_points;
+}
+
+/**
+ * @brief Rows of column `idx` of all paged chunks, on the CPU, fitted to the row shape of `like`
+ */
+torch::Tensor GaussianChunkPager::pagedColumn(std::size_t idx, const torch::Tensor& like) const
+{
+    std::vector<torch::Tensor> parts;
+    for (auto& paged : paged_)
+        parts.push_back(fitRowShape(GaussianCheckpoint::load(paged.second.path_).get(columnName(idx)), like));
+    if (parts.empty()) {
+        auto shape = like.sizes().vec();
+        shape[0] = 0;
+        return torch::empty(shape, like.options().device(torch::kCPU));
+    }
+    return torch::cat(parts, /*dim=*/0);
+}
+
+/**
+ * @brief Rows of every column of all paged chunks, on the CPU, fitted to the row shapes of `likes`,
+ *        reading each chunk file once
+ */
+std::vector<torch::Tensor> GaussianChunkPager::pagedColumns(const std::vector<torch::Tensor>& likes) const
+{
+    std::vector<std::vector<torch::Tensor>> parts(likes.size());
+    for (auto& paged : paged_) {
+        GaussianCheckpoint checkpoint = GaussianCheckpoint::load(paged.second.path_);
+        for (std::size_t idx = 0; idx < likes.size(); ++idx)
+            parts[idx].push_back(fitRowShape(checkpoint.get(columnName(idx)), likes[idx]));
+    }
+    std::vector<torch::Tensor> columns(likes.size());
+    for (std::size_t idx = 0; idx < likes.size(); ++idx) {
+        if (parts[idx].empty()) {
+            auto shape = likes[idx].sizes().vec();
+            shape[0] = 0;
+            columns[idx] = torch::empty(shape, likes[idx].options().device(torch::kCPU));
+        }
+        else {
+            columns[idx] = torch::cat(parts[idx], /*dim=*/0);
+        }
+    }
+    return columns;
+}
+
+std::int64_t GaussianChunkPager::numPagedPoints() const
+{
+    std::int64_t num_points = 0;
+    for (auto& paged : paged_)
+        num_points += paged.second.num_points_;
+    return num_points;
+}
+
+std::size_t GaussianChunkPager::pagedBytes() const
+{
+    std::size_t num_bytes = 0;
+    for (auto& paged : paged_)
+        num_bytes += paged.second.num_bytes_;
+    return num_bytes;
+}
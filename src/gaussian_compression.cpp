@@ -0,0 +1,249 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/gaussian_compression.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <ATen/CPUGeneratorImpl.h>
+
+#include "include/gaussian_checkpoint.h"
+
+namespace
+{
+
+constexpr std::int64_t nearest_chunk_size = 16384;
+
+/**
+ * @brief Index of the nearest code of every row of `data` (N, D)
+ */
+torch::Tensor nearestCodes(const torch::Tensor& data, const torch::Tensor& codebook)
+{
+    torch::Tensor code_norms = codebook.pow(2).sum(/*dim=*/1);
+    torch::Tensor codes = torch::empty({data.size(0)}, data.options().dtype(torch::kLong));
+    for (std::int64_t begin = 0; begin < data.size(0); begin += nearest_chunk_size) {
+        std::int64_t end = std::min(begin + nearest_chunk_size, data.size(0));
+        torch::Tensor rows = data.slice(/*dim=*/0, begin, end);
+        // |x - c|^2 without the |x|^2 term, which is the same for every code
+        torch::Tensor dist = code_norms.unsqueeze(0) - 2.0f * rows.matmul(codebook.t());
+        codes.slice(/*dim=*/0, begin, end).copy_(dist.argmin(/*dim=*/1));
+    }
+    return codes;
+}
+
+/**
+ * @brief K-means over the rows of `data`, or half floats if `codebook_size` is 0
+ */
+GaussianQuantizedAttribute quantize(
+    const torch::Tensor& data,
+    int codebook_size,
+    int iterations,
+    at::Generator& generator)
+{
+    torch::NoGradGuard no_grad;
+    GaussianQuantizedAttribute attribute;
+    const std::int64_t num_rows = data.size(0);
+    const std::int64_t row_size = num_rows ? data.numel() / num_rows : 0;
+    if (codebook_size <= 0 || num_rows == 0 || row_size == 0) {
+        attribute.values_ = data.to(torch::kHalf).contiguous();
+        return attribute;
+    }
+
+    torch::Tensor rows = data.reshape({num_rows, row_size}).to(torch::kFloat);
+    const std::int64_t num_codes = std::min<std::int64_t>(codebook_size, num_rows);
+    // Seeded on the host from a generator of our own, the global one is shared with other threads
+    torch::Tensor seeds = torch::randperm(num_rows, generator, torch::TensorOptions().dtype(torch::kLong))
+                              .slice(0, 0, num_codes).to(rows.device());
+    torch::Tensor codebook = rows.index_select(0, seeds);
+    torch::Tensor codes;
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        codes = nearestCodes(rows, codebook);
+        torch::Tensor sums = torch::zeros_like(codebook).index_add_(0, codes, rows);
+        torch::Tensor counts = torch::zeros({num_codes}, rows.options()).index_add_(
+            0, codes, torch::ones({num_rows}, rows.options()));
+        // Empty clusters keep their code
+        codebook = torch::where(
+            (counts > 0).unsqueeze(1), sums / counts.clamp_min(1.0f).unsqueeze(1), codebook);
+    }
+    codes = nearestCodes(rows, codebook);
+
+    std::vector<std::int64_t> code_shape = data.sizes().vec();
+    code_shape[0] = num_codes;
+    attribute.codebook_ = codebook.view(code_shape).contiguous();
+    attribute.values_ = codes.to(num_codes <= 32768 ? torch::kShort : torch::kInt).contiguous();
+    return attribute;
+}
+
+void putAttribute(GaussianCheckpoint& checkpoint, const std::string& name, const GaussianQuantizedAttribute& attribute)
+{
+    if (attribute.codebook_.defined())
+        checkpoint.put(name + "/codebook", attribute.codebook_);
+    checkpoint.put(name + "/values", attribute.values_);
+}
+
+GaussianQuantizedAttribute getAttribute(
+    const GaussianCheckpoint& checkpoint,
+    const std::string& name,
+    torch::DeviceType device_type)
+{
+    GaussianQuantizedAttribute attribute;
+    if (checkpoint.has(name + "/codebook"))
+        attribute.codebook_ = checkpoint.get(name + "/codebook").to(device_type);
+    attribute.values_ = checkpoint.get(name + "/values").to(device_type);
+    return attribute;
+}
+
+std::size_t tensorBytes(const torch::Tensor& tensor)
+{
+    return tensor.defined() ? tensor.numel() * tensor.element_size() : 0;
+}
+
+}
+
+torch::Tensor GaussianQuantizedAttribute::decode() const
+{
+    if (!codebook_.defined())
+        return values_.to(torch::kFloat);
+    return codebook_.index_select(0, values_.to(torch::kInt));
+}
+
+std::size_t GaussianQuantizedAttribute::numBytes() const
+{
+    return tensorBytes(codebook_) + tensorBytes(values_);
+}
+
+/**
+ * @brief Quantize the raw (pre-activation) attributes of a trained model
+ */
+std::shared_ptr<CompressedGaussians> CompressedGaussians::compress(
+    const torch::Tensor& xyz,
+    const torch::Tensor& features_dc,
+    const torch::Tensor& features_rest,
+    const torch::Tensor& opacity,
+    const torch::Tensor& scaling,
+    const torch::Tensor& rotation,
+    int active_sh_degree,
+    int max_sh_degree,
+    const GaussianCompressionOptions& options)
+{
+    torch::NoGradGuard no_grad;
+    at::Generator generator = at::make_generator<at::CPUGeneratorImpl>(options.kmeans_seed_);
+    auto compressed = std::make_shared<CompressedGaussians>();
+    compressed->active_sh_degree_ = active_sh_degree;
+    compressed->max_sh_degree_ = max_sh_degree;
+    compressed->xyz_ = xyz.detach().to(torch::kFloat).contiguous();
+    compressed->features_dc_ = features_dc.detach().to(torch::kHalf).contiguous();
+    compressed->opacity_ = opacity.detach().to(torch::kHalf).contiguous();
+
+    const std::int64_t num_active_rest = (active_sh_degree + 1) * (active_sh_degree + 1) - 1;
+    torch::Tensor rest = features_rest.detach();
+    compressed->features_active_ = quantize(
+        rest.slice(/*dim=*/1, 0, num_active_rest), options.sh_codebook_size_, options.kmeans_iterations_, generator);
+    compressed->features_inactive_ = rest.slice(/*dim=*/1, num_active_rest).to(torch::kHalf).contiguous();
+
+    compressed->scaling_ = quantize(scaling.detach(), options.scaling_codebook_size_, options.kmeans_iterations_, generator);
+    compressed->rotation_ = quantize(
+        torch::nn::functional::normalize(rotation.detach()), options.rotation_codebook_size_, options.kmeans_iterations_, generator);
+    return compressed;
+}
+
+void CompressedGaussians::save(const std::filesystem::path& path) const
+{
+    GaussianCheckpoint checkpoint;
+    checkpoint.putString("compressed/format", "vq");
+    checkpoint.putInt("compressed/active_sh_degree", active_sh_degree_);
+    checkpoint.putInt("compressed/max_sh_degree", max_sh_degree_);
+    checkpoint.put("compressed/xyz", xyz_);
+    checkpoint.put("compressed/features_dc", features_dc_);
+    putAttribute(checkpoint, "compressed/features_active", features_active_);
+    checkpoint.put("compressed/features_inactive", features_inactive_);
+    checkpoint.put("compressed/opacity", opacity_);
+    putAttribute(checkpoint, "compressed/scaling", scaling_);
+    putAttribute(checkpoint, "compressed/rotation", rotation_);
+    checkpoint.save(path);
+}
+
+std::shared_ptr<CompressedGaussians> CompressedGaussians::load(
+    const std::filesystem::path& path,
+    torch::DeviceType device_type)
+{
+    GaussianCheckpoint checkpoint = GaussianCheckpoint::load(path);
+    if (!checkpoint.has("compressed/format") || checkpoint.getString("compressed/format") != "vq")
+        throw std::runtime_error("[CompressedGaussians]Not a compressed model: " + path.string());
+
+    auto compressed = std::make_shared<CompressedGaussians>();
+    compressed->active_sh_degree_ = checkpoint.getInt("compressed/active_sh_degree");
+    compressed->max_sh_degree_ = checkpoint.getInt("compressed/max_sh_degree");
+    compressed->xyz_ = checkpoint.get("compressed/xyz").to(device_type);
+    compressed->features_dc_ = checkpoint.get("compressed/features_dc").to(device_type);
+    compressed->features_active_ = getAttribute(checkpoint, "compressed/features_active", device_type);
+    compressed->features_inactive_ = checkpoint.get("compressed/features_inactive").to(device_type);
+    compressed->opacity_ = checkpoint.get("compressed/opacity").to(device_type);
+    compressed->scaling_ = getAttribute(checkpoint, "compressed/scaling", device_type);
+    compressed->rotation_ = getAttribute(checkpoint, "compressed/rotation", device_type);
+    return compressed;
+}
+
+/**
+ * @brief (N, (max_sh_degree + 1)^2, 3) SH coefficients, DC first
+ */
+torch::Tensor CompressedGaussians::features() const
+{
+    return torch::cat({
+        features_dc_.to(torch::kFloat),
+        features_active_.decode(),
+        features_inactive_.to(torch::kFloat)},
+        /*dim=*/1);
+}
+
+torch::Tensor CompressedGaussians::opacity() const
+{
+    return opacity_.to(torch::kFloat);
+}
+
+torch::Tensor CompressedGaussians::scaling() const
+{
+    return scaling_.decode();
+}
+
+torch::Tensor CompressedGaussians::rotation() const
+{
+    return rotation_.decode();
+}
+
+/**
+ * @brief Resident size of the compressed attributes
+ */
+std::size_t CompressedGaussians::numBytes() const
+{
+    return tensorBytes(xyz_) + tensorBytes(features_dc_) + features_active_.numBytes()
+           + tensorBytes(features_inactive_) + tensorBytes(opacity_) + scaling_.numBytes() + rotation_.numBytes();
+}
+
+/**
+ * @brief Size of the float attributes a render decodes, the same as the uncompressed model
+ */
+std::size_t CompressedGaussians::decodedBytes() const
+{
+    const std::int64_t num_coeffs =
+        (active_sh_degree_ + 1) * (active_sh_degree_ + 1) + features_inactive_.size(1);
+    return numPoints() * (3 + num_coeffs * 3 + 1 + 3 + 4) * sizeof(float);
+}
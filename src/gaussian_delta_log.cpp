@@ -0,0 +1,411 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/gaussian_delta_log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "include/gaussian_checkpoint.h"
+
+const std::vector<std::string> GaussianDeltaLog::param_names_ = {
+    "xyz", "features_dc", "features_rest", "opacity", "scaling", "rotation"};
+
+namespace
+{
+
+const char* manifest_name = "manifest.txt";
+
+/**
+ * @brief Ascending ids to (num_ranges, 2) rows of first id and count
+ */
+torch::Tensor idsToRanges(const torch::Tensor& sorted_ids)
+{
+    std::vector<std::int64_t> ranges;
+    auto ids = sorted_ids.accessor<std::int64_t, 1>();
+    for (std::int64_t i = 0; i < ids.size(0); ++i) {
+        std::size_t n = ranges.size();
+        if (n && ids[i] == ranges[n - 2] + ranges[n - 1])
+            ++ranges[n - 1];
+        else {
+            ranges.emplace_back(ids[i]);
+            ranges.emplace_back(1);
+        }
+    }
+    std::int64_t num_ranges = ranges.size() / 2;
+    return torch::from_blob(ranges.data(), {num_ranges, 2}, torch::kLong).clone();
+}
+
+torch::Tensor rangesToIds(const torch::Tensor& ranges_tensor)
+{
+    std::vector<std::int64_t> ids;
+    auto ranges = ranges_tensor.accessor<std::int64_t, 2>();
+    for (std::int64_t r = 0; r < ranges.size(0); ++r)
+        for (std::int64_t i = 0; i < ranges[r][1]; ++i)
+            ids.emplace_back(ranges[r][0] + i);
+    return torch::from_blob(ids.data(), {static_cast<std::int64_t>(ids.size())}, torch::kLong).clone();
+}
+
+void putPoses(
+    GaussianCheckpoint& checkpoint,
+    const std::map<std::size_t, std::array<double, 7>>& poses)
+{
+    std::int64_t num_poses = poses.size();
+    torch::Tensor fids = torch::empty({num_poses}, torch::kLong);
+    torch::Tensor values = torch::empty({num_poses, 7}, torch::kDouble);
+    auto fids_a = fids.accessor<std::int64_t, 1>();
+    auto values_a = values.accessor<double, 2>();
+    std::int64_t i = 0;
+    for (auto& pose : poses) {
+        fids_a[i] = pose.first;
+        for (int j = 0; j < 7; ++j)
+            values_a[i][j] = pose.second[j];
+        ++i;
+    }
+    checkpoint.put("keyframes/fid", fids);
+    checkpoint.put("keyframes/pose", values);
+}
+
+void getPoses(
+    const GaussianCheckpoint& checkpoint,
+    std::map<std::size_t, std::array<double, 7>>& poses)
+{
+    torch::Tensor fids = checkpoint.get("keyframes/fid");
+    torch::Tensor values = checkpoint.get("keyframes/pose");
+    auto fids_a = fids.accessor<std::int64_t, 1>();
+    auto values_a = values.accessor<double, 2>();
+    for (std::int64_t i = 0; i < fids.size(0); ++i) {
+        std::array<double, 7> pose;
+        for (int j = 0; j < 7; ++j)
+            pose[j] = values_a[i][j];
+        poses[fids_a[i]] = pose;
+    }
+}
+
+GaussianDeltaState loadBase(const std::filesystem::path& path)
+{
+    GaussianCheckpoint checkpoint = GaussianCheckpoint::load(path);
+    GaussianDeltaState state;
+    state.iteration_ = checkpoint.getInt("iteration");
+    state.active_sh_degree_ = checkpoint.getInt("active_sh_degree");
+    state.ids_ = checkpoint.get("ids");
+    for (auto& name : GaussianDeltaLog::param_names_)
+        state.params_.emplace_back(checkpoint.get("gaussians/" + name));
+    getPoses(checkpoint, state.poses_);
+    return state;
+}
+
+}
+
+void GaussianDeltaState::sortById()
+{
+    torch::Tensor order = std::get<1>(ids_.sort());
+    ids_ = ids_.index_select(0, order);
+    for (auto& param : params_)
+        param = param.index_select(0, order);
+}
+
+GaussianDeltaLog::GaussianDeltaLog(std::filesystem::path log_dir, int rebase_interval)
+    : log_dir_(log_dir), rebase_interval_(rebase_interval)
+{
+    if (!std::filesystem::exists(log_dir_) && !std::filesystem::create_directories(log_dir_))
+        throw std::runtime_error("[GaussianDeltaLog]Cannot create " + log_dir_.string());
+    num_files_ = nextSequence(readManifest(log_dir_));
+}
+
+/**
+ * @brief Take the next place in the write order, on the thread that takes the snapshots
+ */
+std::uint64_t GaussianDeltaLog::reserve()
+{
+    return next_ticket_++;
+}
+
+/**
+ * @brief Write the state made by `make_state` once all saves reserved before it are written,
+ *        as a base for the first save and every `rebase_interval_` saves, as a delta otherwise
+ */
+void GaussianDeltaLog::append(std::uint64_t ticket, std::function<GaussianDeltaState()> make_state)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_turn_.wait(lock, [this, ticket] { return next_to_write_ == ticket; });
+    try {
+        torch::NoGradGuard no_grad;
+        GaussianDeltaState state = make_state();
+        state.sortById();
+
+        // A compaction since the last save may have numbered a file past this session's
+        num_files_ = std::max(num_files_, nextSequence(readManifest(log_dir_)));
+        ManifestEntry entry;
+        entry.base_ = !has_last_state_ || (rebase_interval_ > 0 && num_deltas_since_base_ >= rebase_interval_);
+        entry.iteration_ = state.iteration_;
+        entry.file_ = std::to_string(num_files_) + (entry.base_ ? "_base_" : "_delta_")
+                      + std::to_string(state.iteration_) + ".ckpt";
+        if (entry.base_) {
+            writeBase(log_dir_ / entry.file_, state);
+            num_deltas_since_base_ = 0;
+        }
+        else {
+            writeDelta(log_dir_ / entry.file_, last_state_, state);
+            ++num_deltas_since_base_;
+        }
+        appendToManifest(log_dir_, entry);
+        ++num_files_;
+        last_state_ = std::move(state);
+        has_last_state_ = true;
+    }
+    catch (...) {
+        // A failed save is skipped, the next one is diffed against the last written state
+        ++next_to_write_;
+        cv_turn_.notify_all();
+        throw;
+    }
+    ++next_to_write_;
+    cv_turn_.notify_all();
+}
+
+std::vector<int> GaussianDeltaLog::iterations(const std::filesystem::path& log_dir)
+{
+    std::vector<int> iterations;
+    for (auto& entry : readManifest(log_dir))
+        iterations.emplace_back(entry.iteration_);
+    return iterations;
+}
+
+/**
+ * @brief The state of the last save at or before `iteration`, -1 for the last save
+ */
+GaussianDeltaState GaussianDeltaLog::replay(const std::filesystem::path& log_dir, int iteration)
+{
+    std::vector<ManifestEntry> entries = readManifest(log_dir);
+    int last = -1, base = -1;
+    for (int i = 0; i < static_cast<int>(entries.size()); ++i) {
+        if (iteration >= 0 && entries[i].iteration_ > iteration)
+            break;
+        last = i;
+        if (entries[i].base_)
+            base = i;
+    }
+    if (last < 0 || base < 0)
+        throw std::runtime_error("[GaussianDeltaLog]No save at or before iteration "
+                                 + std::to_string(iteration) + " in " + log_dir.string());
+
+    torch::NoGradGuard no_grad;
+    GaussianDeltaState state = loadBase(log_dir / entries[base].file_);
+    for (int i = base + 1; i <= last; ++i)
+        applyDelta(log_dir / entries[i].file_, state);
+    return state;
+}
+
+/**
+ * @brief Fold every save up to `iteration` into one base and delete the files no longer needed,
+ *        the saves after it stay replayable
+ */
+void GaussianDeltaLog::compact(const std::filesystem::path& log_dir, int iteration)
+{
+    std::vector<ManifestEntry> entries = readManifest(log_dir);
+    GaussianDeltaState state = replay(log_dir, iteration);
+
+    std::vector<ManifestEntry> compacted;
+    ManifestEntry base;
+    base.base_ = true;
+    base.iteration_ = state.iteration_;
+    base.file_ = std::to_string(nextSequence(entries)) + "_base_" + std::to_string(state.iteration_) + ".ckpt";
+    writeBase(log_dir / base.file_, state);
+    compacted.emplace_back(base);
+    for (auto& entry : entries)
+        if (entry.iteration_ > state.iteration_)
+            compacted.emplace_back(entry);
+
+    // Swap the manifest atomically before deleting anything
+    std::filesystem::path manifest_path = log_dir / manifest_name;
+    std::filesystem::path tmp_path = manifest_path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::out | std::ios::trunc);
+        if (!out.is_open())
+            throw std::runtime_error("[GaussianDeltaLog]Cannot write " + tmp_path.string());
+        for (auto& entry : compacted)
+            out << (entry.base_ ? "base " : "delta ") << entry.iteration_ << " " << entry.file_ << "\n";
+        if (!out)
+            throw std::runtime_error("[GaussianDeltaLog]Cannot write " + tmp_path.string());
+    }
+    std::filesystem::rename(tmp_path, manifest_path);
+
+    std::set<std::string> kept;
+    for (auto& entry : compacted)
+        kept.insert(entry.file_);
+    for (auto& entry : entries)
+        if (!kept.count(entry.file_))
+            std::filesystem::remove(log_dir / entry.file_);
+}
+
+std::vector<GaussianDeltaLog::ManifestEntry> GaussianDeltaLog::readManifest(const std::filesystem::path& log_dir)
+{
+    std::vector<ManifestEntry> entries;
+    std::ifstream in(log_dir / manifest_name);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream line_stream(line);
+        std::string kind;
+        ManifestEntry entry;
+        // A line cut short by an interrupted save ends the log
+        if (!(line_stream >> kind >> entry.iteration_ >> entry.file_) || (kind != "base" && kind != "delta"))
+            break;
+        entry.base_ = (kind == "base");
+        entries.emplace_back(entry);
+    }
+    return entries;
+}
+
+/**
+ * @brief One past the highest sequence number prefixing a file in the manifest
+ */
+std::size_t GaussianDeltaLog::nextSequence(const std::vector<ManifestEntry>& entries)
+{
+    std::size_t next = 0;
+    for (auto& entry : entries) {
+        std::size_t digits = 0, sequence = 0;
+        while (digits < entry.file_.size() && std::isdigit(static_cast<unsigned char>(entry.file_[digits])))
+            sequence = sequence * 10 + (entry.file_[digits++] - '0');
+        if (digits)
+            next = std::max(next, sequence + 1);
+    }
+    return next;
+}
+
+void GaussianDeltaLog::writeBase(const std::filesystem::path& path, const GaussianDeltaState& state)
+{
+    GaussianCheckpoint checkpoint;
+    checkpoint.putInt("iteration", state.iteration_);
+    checkpoint.putInt("active_sh_degree", state.active_sh_degree_);
+    checkpoint.put("ids", state.ids_);
+    for (std::size_t g = 0; g < param_names_.size(); ++g)
+        checkpoint.put("gaussians/" + param_names_[g], state.params_[g]);
+    putPoses(checkpoint, state.poses_);
+    checkpoint.save(path);
+}
+
+/**
+ * @brief Rows of `current` that are new or differ in any value from `previous`,
+ *        the ids gone since, and the keyframe poses that changed
+ */
+void GaussianDeltaLog::writeDelta(
+    const std::filesystem::path& path,
+    const GaussianDeltaState& previous,
+    const GaussianDeltaState& current)
+{
+    GaussianCheckpoint checkpoint;
+    checkpoint.putInt("iteration", current.iteration_);
+    checkpoint.putInt("active_sh_degree", current.active_sh_degree_);
+
+    torch::Tensor in_previous = torch::isin(current.ids_, previous.ids_);
+    torch::Tensor added_rows = torch::logical_not(in_previous).nonzero().squeeze(1);
+    torch::Tensor pruned_ids = previous.ids_.masked_select(
+        torch::logical_not(torch::isin(previous.ids_, current.ids_)));
+
+    torch::Tensor common_rows = in_previous.nonzero().squeeze(1);
+    torch::Tensor previous_rows = torch::searchsorted(previous.ids_, current.ids_.index_select(0, common_rows));
+    torch::Tensor changed = torch::zeros({common_rows.size(0)}, torch::kBool);
+    for (std::size_t g = 0; g < param_names_.size(); ++g) {
+        torch::Tensor now = current.params_[g].index_select(0, common_rows).flatten(1);
+        torch::Tensor before = previous.params_[g].index_select(0, previous_rows).flatten(1);
+        changed.logical_or_(now.ne(before).any(1));
+    }
+    torch::Tensor modified_rows = common_rows.masked_select(changed);
+
+    checkpoint.put("pruned/ranges", idsToRanges(pruned_ids));
+    checkpoint.put("added/ranges", idsToRanges(current.ids_.index_select(0, added_rows)));
+    checkpoint.put("modified/ranges", idsToRanges(current.ids_.index_select(0, modified_rows)));
+    for (std::size_t g = 0; g < param_names_.size(); ++g) {
+        checkpoint.put("added/" + param_names_[g], current.params_[g].index_select(0, added_rows));
+        checkpoint.put("modified/" + param_names_[g], current.params_[g].index_select(0, modified_rows));
+    }
+
+    std::map<std::size_t, std::array<double, 7>> changed_poses;
+    for (auto& pose : current.poses_) {
+        auto it = previous.poses_.find(pose.first);
+        if (it == previous.poses_.end() || it->second != pose.second)
+            changed_poses.emplace(pose);
+    }
+    std::vector<std::int64_t> removed_fids;
+    for (auto& pose : previous.poses_)
+        if (!current.poses_.count(pose.first))
+            removed_fids.emplace_back(pose.first);
+    putPoses(checkpoint, changed_poses);
+    checkpoint.put("keyframes/removed_fid", torch::from_blob(
+        removed_fids.data(), {static_cast<std::int64_t>(removed_fids.size())}, torch::kLong).clone());
+
+    checkpoint.save(path);
+}
+
+void GaussianDeltaLog::applyDelta(const std::filesystem::path& path, GaussianDeltaState& state)
+{
+    GaussianCheckpoint delta = GaussianCheckpoint::load(path);
+    state.iteration_ = delta.getInt("iteration");
+    state.active_sh_degree_ = delta.getInt("active_sh_degree");
+
+    torch::Tensor pruned_ids = rangesToIds(delta.get("pruned/ranges"));
+    if (pruned_ids.size(0) > 0) {
+        torch::Tensor kept_rows = torch::logical_not(torch::isin(state.ids_, pruned_ids)).nonzero().squeeze(1);
+        state.ids_ = state.ids_.index_select(0, kept_rows);
+        for (auto& param : state.params_)
+            param = param.index_select(0, kept_rows);
+    }
+
+    torch::Tensor modified_ids = rangesToIds(delta.get("modified/ranges"));
+    if (modified_ids.size(0) > 0) {
+        torch::Tensor rows = torch::searchsorted(state.ids_, modified_ids).clamp_max(state.ids_.size(0) - 1);
+        if (state.ids_.size(0) == 0 || !state.ids_.index_select(0, rows).equal(modified_ids))
+            throw std::runtime_error("[GaussianDeltaLog]" + path.string() + " modifies unknown Gaussians");
+        for (std::size_t g = 0; g < param_names_.size(); ++g) {
+            // The rows may still view a mapped base file, which is mapped copy-on-write
+            state.params_[g].index_copy_(0, rows, delta.get("modified/" + param_names_[g]));
+        }
+    }
+
+    torch::Tensor added_ids = rangesToIds(delta.get("added/ranges"));
+    if (added_ids.size(0) > 0) {
+        state.ids_ = torch::cat({state.ids_, added_ids});
+        for (std::size_t g = 0; g < param_names_.size(); ++g)
+            state.params_[g] = torch::cat({state.params_[g], delta.get("added/" + param_names_[g])});
+        state.sortById();
+    }
+
+    torch::Tensor removed_fids = delta.get("keyframes/removed_fid");
+    auto removed_a = removed_fids.accessor<std::int64_t, 1>();
+    for (std::int64_t i = 0; i < removed_fids.size(0); ++i)
+        state.poses_.erase(removed_a[i]);
+    getPoses(delta, state.poses_);
+}
+
+void GaussianDeltaLog::appendToManifest(const std::filesystem::path& log_dir, const ManifestEntry& entry)
+{
+    std::ofstream out(log_dir / manifest_name, std::ios::out | std::ios::app);
+    if (!out.is_open())
+        throw std::runtime_error("[GaussianDeltaLog]Cannot append to " + (log_dir / manifest_name).string());
+    out << (entry.base_ ? "base " : "delta ") << entry.iteration_ << " " << entry.file_ << "\n";
+    out.flush();
+    if (!out)
+        throw std::runtime_error("[GaussianDeltaLog]Cannot append to " + (log_dir / manifest_name).string());
+}
@@ -18,6 +18,8 @@
 
 #include "include/gaussian_keyframe.h"
 
+#include <algorithm>
+
 void GaussianKeyframe::setPose(
     const double qw,
     const double qx,
@@ -116,29 +118,47 @@ void GaussianKeyframe::setPoint3DIdxForPoint2D(
     points2D_.at(point2D_idx).point3D_id_ = point3D_id;
 }
 
+/**
+ * @brief Transform tensors of the current pose, built on the host and uploaded in one copy.
+ *        Nothing is done while the pose, trans_ and scale_ are unchanged
+ */
 void GaussianKeyframe::computeTransformTensors()
 {
     if (this->set_pose_ && this->set_camera_) {
-        this->world_view_transform_ = tensor_utils::EigenMatrix2TorchTensor(
-            this->getWorld2View2(this->trans_, this->scale_),
-            torch::kCUDA
-        ).transpose(0, 1);
+        if (this->transforms_computed_ && this->set_projection_matrix_
+            && this->transforms_device_type_ == this->device_type_
+            && this->transforms_Tcw_.matrix3x4() == this->Tcw_.matrix3x4()
+            && this->transforms_trans_ == this->trans_ && this->transforms_scale_ == this->scale_)
+            return;
 
         if (!this->set_projection_matrix_) {
-            this->projection_matrix_ = this->getProjectionMatrix(
-                this->znear_,
-                this->zfar_,
-                this->FoVx_,
-                this->FoVy_,
-                torch::kCUDA
-            ).transpose(0, 1);
+            this->projection_ = projectionMatrix(this->znear_, this->zfar_, this->FoVx_, this->FoVy_);
             this->set_projection_matrix_ = true;
         }
+        Eigen::Matrix4f world_view = this->getWorld2View2(this->trans_, this->scale_);
+        Eigen::Matrix4f full_proj = this->projection_ * world_view;
+        Eigen::Vector3f camera_center = world_view.inverse().block<3, 1>(0, 3);
 
-        this->full_proj_transform_ = (this->world_view_transform_.unsqueeze(0).bmm(
-            this->projection_matrix_.unsqueeze(0))).squeeze(0);
+        // The column major storage of a matrix is its transpose in row major, as the tensors are kept
+        float host[16 * 3 + 3];
+        std::copy(world_view.data(), world_view.data() + 16, host);
+        std::copy(this->projection_.data(), this->projection_.data() + 16, host + 16);
+        std::copy(full_proj.data(), full_proj.data() + 16, host + 32);
+        std::copy(camera_center.data(), camera_center.data() + 3, host + 48);
+        torch::Tensor transforms = torch::from_blob(host, {16 * 3 + 3}, torch::kFloat).to(this->device_type_);
+        if (transforms.data_ptr() == host)
+            transforms = transforms.clone();
 
-        this->camera_center_ = this->world_view_transform_.inverse().index({3, torch::indexing::Slice(0, 3)});
+        this->world_view_transform_ = transforms.slice(0, 0, 16).view({4, 4});
+        this->projection_matrix_ = transforms.slice(0, 16, 32).view({4, 4});
+        this->full_proj_transform_ = transforms.slice(0, 32, 48).view({4, 4});
+        this->camera_center_ = transforms.slice(0, 48, 51);
+
+        this->transforms_Tcw_ = this->Tcw_;
+        this->transforms_trans_ = this->trans_;
+        this->transforms_scale_ = this->scale_;
+        this->transforms_device_type_ = this->device_type_;
+        this->transforms_computed_ = true;
     }
     else if (!this->set_pose_ && this->set_camera_) {
         std::cerr << "Could not compute transform tensors for keyframe " << this->fid_ << " because POSE is not set!" << std::endl;
@@ -180,6 +200,16 @@ GaussianKeyframe::getProjectionMatrix(
     float fovX,
     float fovY,
     torch::DeviceType device_type)
+{
+    return tensor_utils::EigenMatrix2TorchTensor(projectionMatrix(znear, zfar, fovX, fovY), device_type);
+}
+
+Eigen::Matrix4f
+GaussianKeyframe::projectionMatrix(
+    float znear,
+    float zfar,
+    float fovX,
+    float fovY)
 {
     float tanHalfFovY = std::tan(fovY / 2);
     float tanHalfFovX = std::tan(fovX / 2);
@@ -189,17 +219,18 @@ GaussianKeyframe::getProjectionMatrix(
     float right = tanHalfFovX * znear;
     float left = -right;
 
-    torch::Tensor P = torch::zeros({4, 4}, torch::TensorOptions().device(device_type));
+    Eigen::Matrix4f P;
+    P.setZero();
 
     float z_sign = 1.0f;
 
-    P.index({0, 0}) = 2.0 * znear / (right - left);
-    P.index({1, 1}) = 2.0 * znear / (top - bottom);
-    P.index({0, 2}) = (right + left) / (right - left);
-    P.index({1, 2}) = (top + bottom) / (top - bottom);
-    P.index({3, 2}) = z_sign;
-    P.index({2, 2}) = z_sign * zfar / (zfar - znear);
-    P.index({2, 3}) = -(zfar * znear) / (zfar - znear);
+    P(0, 0) = 2.0 * znear / (right - left);
+    P(1, 1) = 2.0 * znear / (top - bottom);
+    P(0, 2) = (right + left) / (right - left);
+    P(1, 2) = (top + bottom) / (top - bottom);
+    P(3, 2) = z_sign;
+    P(2, 2) = z_sign * zfar / (zfar - znear);
+    P(2, 3) = -(zfar * znear) / (zfar - znear);
     return P;
 }
 
@@ -214,3 +245,85 @@ int GaussianKeyframe::getCurrentGausPyramidLevel()
     // If all sub levels has been used up
     return num_gaus_pyramid_sub_levels_;
 }
+
+/**
+ * @brief Full resolution training image, converted to float on each call
+ */
+torch::Tensor GaussianKeyframe::getOriginalImage(torch::DeviceType device_type)
+{
+    return KeyframeImageStore::toTensor(img_undist_, device_type);
+}
+
+torch::Tensor GaussianKeyframe::getGausPyramidOriginalImage(int level, torch::DeviceType device_type)
+{
+    cv::Size size(gaus_pyramid_width_.at(level), gaus_pyramid_height_.at(level));
+    if (!image_store_) {
+        cv::Mat img_resized;
+        cv::resize(img_undist_, img_resized, size);
+        return KeyframeImageStore::toTensor(img_resized, device_type);
+    }
+    return image_store_->levelTensor(fid_, level, img_undist_, size, device_type);
+}
+
+/**
+ * @brief Keep every training level on the device with its mask, `level_masks` holds the
+ *        sub levels then the full resolution, levels without a mask are skipped. With an
+ *        image store the images are uploaded on first use and evicted within its budget,
+ *        without one they are converted once here.
+ */
+void GaussianKeyframe::buildTrainingBundle(
+    const std::vector<torch::Tensor>& level_masks,
+    torch::DeviceType device_type)
+{
+    training_bundle_.clear();
+    training_bundle_.resize(num_gaus_pyramid_sub_levels_ + 1);
+    for (int level = 0; level <= num_gaus_pyramid_sub_levels_; ++level) {
+        if (level >= static_cast<int>(level_masks.size()) || !level_masks[level].defined())
+            continue;
+        auto& training_level = training_bundle_[level];
+        if (level == num_gaus_pyramid_sub_levels_) {
+            training_level.height_ = image_height_;
+            training_level.width_ = image_width_;
+            if (!image_store_)
+                training_level.gt_image_ = KeyframeImageStore::toTensor(img_undist_, device_type);
+        }
+        else {
+            training_level.height_ = gaus_pyramid_height_.at(level);
+            training_level.width_ = gaus_pyramid_width_.at(level);
+            if (!image_store_) {
+                cv::Mat img_resized;
+                cv::resize(img_undist_, img_resized, cv::Size(training_level.width_, training_level.height_));
+                training_level.gt_image_ = KeyframeImageStore::toTensor(img_resized, device_type);
+            }
+        }
+        training_level.mask_ = level_masks[level].to(device_type);
+    }
+}
+
+void GaussianKeyframe::releaseTrainingBundle()
+{
+    training_bundle_.clear();
+}
+
+bool GaussianKeyframe::hasTrainingLevel(int level) const
+{
+    return level >= 0 && level < static_cast<int>(training_bundle_.size())
+           && training_bundle_[level].mask_.defined();
+}
+
+/**
+ * @brief Ground truth image of a training level, from the image store's device cache if there is one
+ */
+torch::Tensor GaussianKeyframe::trainingImage(int level, torch::DeviceType device_type)
+{
+    const GaussianKeyframeTrainingLevel& training_level = training_bundle_.at(level);
+    if (training_level.gt_image_.defined())
+        return training_level.gt_image_;
+    return image_store_->deviceLevel(
+        fid_, level, img_undist_, cv::Size(training_level.width_, training_level.height_), device_type);
+}
+
+const GaussianKeyframeTrainingLevel& GaussianKeyframe::trainingLevel(int level) const
+{
+    return training_bundle_.at(level);
+}
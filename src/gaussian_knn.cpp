@@ -0,0 +1,288 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/gaussian_knn.h"
+
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "third_party/simple-knn/spatial.h"
+
+namespace
+{
+
+// 20 bits per axis, cell coordinates in [0, CELL_RANGE)
+constexpr std::int64_t CELL_RANGE = 1LL << 20;
+
+/**
+ * @brief Uniform grid with the points sorted by cell,
+ *        the occupied cells are found through an open addressing table
+ */
+struct KnnGrid
+{
+    float origin_[3];
+    float cell_size_;
+    std::int64_t dims_[3];
+
+    torch::Tensor sorted_xyz_;   ///< (N, 3)
+    torch::Tensor sorted_ids_;   ///< (N,) rows of the sorted points
+    torch::Tensor cell_starts_;  ///< (num_cells + 1,) into the sorted points
+    std::int64_t num_cells_;
+
+    std::vector<std::int64_t> table_keys_;  ///< -1: empty slot
+    std::vector<std::int64_t> table_cells_;
+    std::uint64_t table_mask_;
+
+    static std::int64_t key(std::int64_t x, std::int64_t y, std::int64_t z)
+    {
+        return (x * CELL_RANGE + y) * CELL_RANGE + z;
+    }
+
+    static std::uint64_t hash(std::int64_t key)
+    {
+        std::uint64_t h = static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 32);
+    }
+
+    std::int64_t findCell(std::int64_t x, std::int64_t y, std::int64_t z) const
+    {
+        std::int64_t k = key(x, y, z);
+        for (std::uint64_t slot = hash(k) & table_mask_; ; slot = (slot + 1) & table_mask_) {
+            if (table_keys_[slot] == k)
+                return table_cells_[slot];
+            if (table_keys_[slot] < 0)
+                return -1;
+        }
+    }
+};
+
+/**
+ * @brief Cells of about two points each, the density being estimated on the
+ *        central 96% of the points so that a few outliers do not blow it up
+ */
+void buildGrid(KnnGrid& grid, const torch::Tensor& xyz)
+{
+    const std::int64_t N = xyz.size(0);
+    torch::Tensor lo = std::get<0>(xyz.min(/*dim=*/0));
+    torch::Tensor hi = std::get<0>(xyz.max(/*dim=*/0));
+    torch::Tensor sample = std::get<0>(xyz.slice(0, 0, N, std::max<std::int64_t>(1, N / 4096)).sort(/*dim=*/0));
+    const std::int64_t M = sample.size(0);
+    torch::Tensor spread = sample[(M - 1) * 98 / 100] - sample[(M - 1) * 2 / 100];
+
+    auto lo_a = lo.accessor<float, 1>();
+    auto hi_a = hi.accessor<float, 1>();
+    auto spread_a = spread.accessor<float, 1>();
+    float max_extent = 0.0f;
+    for (int a = 0; a < 3; ++a)
+        max_extent = std::max(max_extent, hi_a[a] - lo_a[a]);
+    if (!(max_extent > 0.0f))
+        max_extent = 1.0f;
+    double volume = 1.0;
+    for (int a = 0; a < 3; ++a)
+        volume *= std::max(spread_a[a], 1e-3f * max_extent);
+    grid.cell_size_ = std::max(
+        static_cast<float>(std::cbrt(2.0 * volume / N)),
+        max_extent / static_cast<float>(CELL_RANGE - 1));
+    for (int a = 0; a < 3; ++a) {
+        grid.origin_[a] = lo_a[a];
+        grid.dims_[a] = std::min<std::int64_t>(
+            CELL_RANGE, static_cast<std::int64_t>((hi_a[a] - lo_a[a]) / grid.cell_size_) + 1);
+    }
+
+    torch::Tensor coords = torch::floor((xyz - lo.view({1, 3})) / grid.cell_size_)
+                               .clamp(0, CELL_RANGE - 1).to(torch::kLong);
+    torch::Tensor keys = (coords.select(1, 0) * CELL_RANGE + coords.select(1, 1)) * CELL_RANGE + coords.select(1, 2);
+    auto sorted = keys.sort();
+    grid.sorted_ids_ = std::get<1>(sorted);
+    grid.sorted_xyz_ = xyz.index_select(0, grid.sorted_ids_).contiguous();
+    auto cells = torch::unique_consecutive(std::get<0>(sorted), /*return_inverse=*/false, /*return_counts=*/true);
+    torch::Tensor cell_keys = std::get<0>(cells).contiguous();
+    grid.num_cells_ = cell_keys.size(0);
+    grid.cell_starts_ = torch::cat({torch::zeros({1}, cell_keys.options()), std::get<2>(cells).cumsum(0)});
+
+    std::uint64_t table_size = 1;
+    while (table_size < 2 * static_cast<std::uint64_t>(grid.num_cells_))
+        table_size <<= 1;
+    grid.table_mask_ = table_size - 1;
+    grid.table_keys_.assign(table_size, -1);
+    grid.table_cells_.assign(table_size, -1);
+    const std::int64_t* cell_keys_ptr = cell_keys.data_ptr<std::int64_t>();
+    for (std::int64_t cell = 0; cell < grid.num_cells_; ++cell) {
+        std::uint64_t slot = KnnGrid::hash(cell_keys_ptr[cell]) & grid.table_mask_;
+        while (grid.table_keys_[slot] >= 0)
+            slot = (slot + 1) & grid.table_mask_;
+        grid.table_keys_[slot] = cell_keys_ptr[cell];
+        grid.table_cells_[slot] = cell;
+    }
+}
+
+inline void insertNeighbor(float* best, const int k, int& num_found, const float dist2)
+{
+    if (dist2 >= best[k - 1])
+        return;
+    int j = k - 1;
+    while (j > 0 && best[j - 1] > dist2) {
+        best[j] = best[j - 1];
+        --j;
+    }
+    best[j] = dist2;
+    num_found = std::min(k, num_found + 1);
+}
+
+inline void visitPoints(
+    const float* xyz,
+    const std::int64_t* ids,
+    std::int64_t begin,
+    std::int64_t end,
+    const float* q,
+    const std::int64_t self,
+    float* best,
+    const int k,
+    int& num_found)
+{
+    for (std::int64_t p = begin; p < end; ++p) {
+        if (ids[p] == self)
+            continue;
+        float dx = xyz[3 * p] - q[0];
+        float dy = xyz[3 * p + 1] - q[1];
+        float dz = xyz[3 * p + 2] - q[2];
+        insertNeighbor(best, k, num_found, dx * dx + dy * dy + dz * dz);
+    }
+}
+
+/**
+ * @brief Search the shells of cells at Chebyshev distance r = 0, 1, ... around the
+ *        cell of the query, until the k-th neighbor is closer than any point of the next shell
+ */
+float meanDist2OfPoint(const KnnGrid& grid, const float* q, const std::int64_t self, const int k)
+{
+    const float* xyz = grid.sorted_xyz_.data_ptr<float>();
+    const std::int64_t* ids = grid.sorted_ids_.data_ptr<std::int64_t>();
+    const std::int64_t* starts = grid.cell_starts_.data_ptr<std::int64_t>();
+    const std::int64_t num_points = grid.sorted_ids_.size(0);
+
+    float best[GAUSSIAN_KNN_MAX_K];
+    std::fill(best, best + k, FLT_MAX);
+    int num_found = 0;
+
+    std::int64_t c[3];
+    for (int a = 0; a < 3; ++a)
+        c[a] = std::min(grid.dims_[a] - 1, std::max<std::int64_t>(
+            0, static_cast<std::int64_t>((q[a] - grid.origin_[a]) / grid.cell_size_)));
+    const std::int64_t max_ring = std::max({grid.dims_[0], grid.dims_[1], grid.dims_[2]});
+
+    for (std::int64_t r = 0; r <= max_ring; ++r) {
+        // The shell has more cells than are occupied, scanning all the points is cheaper
+        if (r > 0 && 24 * r * r + 2 > grid.num_cells_) {
+            std::fill(best, best + k, FLT_MAX);
+            num_found = 0;
+            visitPoints(xyz, ids, 0, num_points, q, self, best, k, num_found);
+            break;
+        }
+        for (std::int64_t dx = -r; dx <= r; ++dx) {
+            std::int64_t x = c[0] + dx;
+            if (x < 0 || x >= grid.dims_[0])
+                continue;
+            for (std::int64_t dy = -r; dy <= r; ++dy) {
+                std::int64_t y = c[1] + dy;
+                if (y < 0 || y >= grid.dims_[1])
+                    continue;
+                // Inside the shell only the two z faces belong to it
+                bool on_edge = (dx == -r || dx == r || dy == -r || dy == r);
+                std::int64_t dz_step = on_edge ? 1 : 2 * r;
+                for (std::int64_t dz = -r; dz <= r; dz += dz_step) {
+                    std::int64_t z = c[2] + dz;
+                    if (z < 0 || z >= grid.dims_[2])
+                        continue;
+                    std::int64_t cell = grid.findCell(x, y, z);
+                    if (cell >= 0)
+                        visitPoints(xyz, ids, starts[cell], starts[cell + 1], q, self, best, k, num_found);
+                }
+            }
+        }
+        float reach = r * grid.cell_size_;
+        if (num_found == k && best[k - 1] <= reach * reach)
+            break;
+    }
+
+    if (num_found == 0)
+        return 0.0f;
+    float sum = 0.0f;
+    for (int j = 0; j < num_found; ++j)
+        sum += best[j];
+    return sum / num_found;
+}
+
+}
+
+torch::Tensor knnMeanDist2CPU(
+    const torch::Tensor& points,
+    std::int64_t num_queries,
+    int k)
+{
+    torch::NoGradGuard no_grad;
+    if (points.ndimension() != 2 || points.size(1) != 3)
+        throw std::runtime_error("[knnMeanDist2]Points must have dimensions (num_points, 3)");
+    if (k < 1 || k > GAUSSIAN_KNN_MAX_K)
+        throw std::runtime_error("[knnMeanDist2]k must be in [1, " + std::to_string(GAUSSIAN_KNN_MAX_K) + "]");
+    const std::int64_t N = points.size(0);
+    num_queries = std::min(num_queries, N);
+    torch::Tensor dist2 = torch::zeros({num_queries}, torch::TensorOptions().dtype(torch::kFloat));
+    if (num_queries <= 0)
+        return dist2;
+
+    KnnGrid grid;
+    buildGrid(grid, points.detach().to(torch::kCPU, torch::kFloat).contiguous());
+
+    const float* xyz = grid.sorted_xyz_.data_ptr<float>();
+    const std::int64_t* ids = grid.sorted_ids_.data_ptr<std::int64_t>();
+    float* out = dist2.data_ptr<float>();
+    // In cell order, so that neighboring queries share the cells they visit
+    at::parallel_for(0, N, 256, [&](std::int64_t begin, std::int64_t end) {
+        for (std::int64_t p = begin; p < end; ++p)
+            if (ids[p] < num_queries)
+                out[ids[p]] = meanDist2OfPoint(grid, xyz + 3 * p, ids[p], k);
+    });
+    return dist2;
+}
+
+torch::Tensor knnMeanDist2(
+    const torch::Tensor& points,
+    std::int64_t num_queries,
+    int k)
+{
+    torch::NoGradGuard no_grad;
+    if (num_queries < 0 || num_queries > points.size(0))
+        num_queries = points.size(0);
+    if (!points.is_cuda())
+        return knnMeanDist2CPU(points, num_queries, k);
+
+    if (k != 3)
+        throw std::runtime_error("[knnMeanDist2]distCUDA2 only averages over 3 neighbors");
+    if (num_queries == 0)
+        return torch::zeros({0}, points.options().dtype(torch::kFloat));
+    torch::Tensor dist2 = distCUDA2(points.detach().to(torch::kFloat).contiguous());
+    return num_queries == points.size(0) ? dist2 : dist2.narrow(0, 0, num_queries).contiguous();
+}
@@ -18,6 +18,9 @@
 
 #include "include/gaussian_mapper.h"
 
+#include <ATen/CPUGeneratorImpl.h>
+#include <ATen/cuda/CUDAGeneratorImpl.h>
+
 GaussianMapper::GaussianMapper(
     std::shared_ptr<ORB_SLAM3::System> pSLAM,
     std::filesystem::path gaussian_config_file_path,
@@ -58,6 +61,18 @@ GaussianMapper::GaussianMapper(
     config_file_path_ = gaussian_config_file_path;
     readConfigFromFile(gaussian_config_file_path);
 
+    // Per-iteration statistics, written in the background
+    if (!result_dir_.empty() && training_stats_flush_interval_ > 0)
+        training_stats_.start(
+            result_dir_ / "training_stats.csv",
+            training_stats_buffer_capacity_,
+            training_stats_flush_interval_);
+
+    // Periodic saves, written in the background
+    persistence_writer_.start(
+        persistence_num_workers_,
+        static_cast<std::size_t>(persistence_memory_budget_mb_) << 20);
+
     std::vector<float> bg_color;
     if (model_params_.white_background_)
         bg_color = {1.0f, 1.0f, 1.0f};
@@ -70,7 +85,10 @@ GaussianMapper::GaussianMapper(
 
     // Initialize scene and model
     gaussians_ = std::make_shared<GaussianModel>(model_params_);
+    gaussians_->setInsertionVoxelSize(insertion_voxel_size_);
     scene_ = std::make_shared<GaussianScene>(model_params_);
+    scene_->keyframe_sampler_.seed(seed);
+    scene_->keyframe_sampler_.setMode(keyframe_sampling_mode_);
 
     // Mode
     if (!pSLAM) {
@@ -229,6 +247,13 @@ GaussianMapper::GaussianMapper(
     }
 }
 
+GaussianMapper::~GaussianMapper()
+{
+    persistence_writer_.stop();
+    stopIngestionWorkers();
+    training_stats_.stop();
+}
+
 void GaussianMapper::readConfigFromFile(std::filesystem::path cfg_path)
 {
     cv::FileStorage settings_file(cfg_path.string().c_str(), cv::FileStorage::READ);
@@ -287,6 +312,28 @@ void GaussianMapper::readConfigFromFile(std::filesystem::path cfg_path)
         settings_file["Mapper.large_translation_threshold"].operator float();
     stable_num_iter_existence_ =
         settings_file["Mapper.stable_num_iter_existence"].operator int();
+    keyframe_sampling_mode_ = static_cast<KeyframeSampler::Mode>(
+        settings_file["Mapper.keyframe_sampling"].operator int());
+    num_ingestion_workers_ =
+        settings_file["Mapper.num_ingestion_workers"].operator int();
+    if (!settings_file["Mapper.ingestion_queue_capacity"].empty())
+        ingestion_queue_capacity_ = std::max(
+            1, settings_file["Mapper.ingestion_queue_capacity"].operator int());
+    if (!settings_file["Mapper.pyramid_cache_budget_mb"].empty())
+        keyframe_image_store_->setBudget(static_cast<std::size_t>(std::max(
+            0, settings_file["Mapper.pyramid_cache_budget_mb"].operator int())) << 20);
+    if (!settings_file["Mapper.device_training_images"].empty())
+        device_training_images_ = (settings_file["Mapper.device_training_images"].operator int()) != 0;
+    if (!settings_file["Mapper.chunk_size"].empty())
+        chunk_size_ = settings_file["Mapper.chunk_size"].operator float();
+    if (!settings_file["Mapper.max_resident_gaussians"].empty())
+        max_resident_gaussians_ = std::max(0, settings_file["Mapper.max_resident_gaussians"].operator int());
+    if (!settings_file["Mapper.chunk_keep_radius"].empty())
+        chunk_keep_radius_ = settings_file["Mapper.chunk_keep_radius"].operator float();
+    if (!settings_file["Mapper.chunk_paging_interval"].empty())
+        chunk_paging_interval_ = std::max(1, settings_file["Mapper.chunk_paging_interval"].operator int());
+    if (!settings_file["Mapper.insertion_voxel_size"].empty())
+        insertion_voxel_size_ = std::max(0.0f, settings_file["Mapper.insertion_voxel_size"].operator float());
 
     pipe_params_.convert_SHs_ =
         (settings_file["Pipeline.convert_SHs"].operator int()) != 0;
@@ -320,6 +367,34 @@ void GaussianMapper::readConfigFromFile(std::filesystem::path cfg_path)
         settings_file["Record.training_report_interval"].operator int();
     record_loop_ply_ =
         (settings_file["Record.record_loop_ply"].operator int()) != 0;
+    training_stats_flush_interval_ =
+        settings_file["Record.training_stats_flush_interval"].operator int();
+    if (!settings_file["Record.training_stats_buffer_capacity"].empty())
+        training_stats_buffer_capacity_ = std::max(
+            1, settings_file["Record.training_stats_buffer_capacity"].operator int());
+    if (!settings_file["Record.persistence_num_workers"].empty())
+        persistence_num_workers_ = std::max(
+            0, settings_file["Record.persistence_num_workers"].operator int());
+    if (!settings_file["Record.persistence_memory_budget_mb"].empty())
+        persistence_memory_budget_mb_ = std::max(
+            0, settings_file["Record.persistence_memory_budget_mb"].operator int());
+    if (!settings_file["Record.delta_checkpoint_interval"].empty())
+        delta_checkpoint_interval_ =
+            settings_file["Record.delta_checkpoint_interval"].operator int();
+    if (!settings_file["Record.delta_rebase_interval"].empty())
+        delta_rebase_interval_ =
+            settings_file["Record.delta_rebase_interval"].operator int();
+    if (!settings_file["Record.checkpoint_interval"].empty())
+        checkpoint_interval_ =
+            settings_file["Record.checkpoint_interval"].operator int();
+    if (!settings_file["Record.compressed_export"].empty())
+        compressed_export_ = (settings_file["Record.compressed_export"].operator int()) != 0;
+    if (!settings_file["Record.compressed_sh_codebook_size"].empty())
+        compression_options_.sh_codebook_size_ =
+            settings_file["Record.compressed_sh_codebook_size"].operator int();
+    if (!settings_file["Record.compressed_kmeans_seed"].empty())
+        compression_options_.kmeans_seed_ =
+            settings_file["Record.compressed_kmeans_seed"].operator int();
 
     // Optimization Parameters
     opt_params_.iterations_ =
@@ -340,6 +415,10 @@ void GaussianMapper::readConfigFromFile(std::filesystem::path cfg_path)
         settings_file["Optimization.scaling_lr"].operator float();
     opt_params_.rotation_lr_ =
         settings_file["Optimization.rotation_lr"].operator float();
+    opt_params_.batch_size_ =
+        settings_file["Optimization.batch_size"].operator int();
+    opt_params_.sparse_adam_ =
+        (settings_file["Optimization.sparse_adam"].operator int()) != 0;
 
     opt_params_.percent_dense_ =
         settings_file["Optimization.percent_dense"].operator float();
@@ -366,6 +445,9 @@ void GaussianMapper::readConfigFromFile(std::filesystem::path cfg_path)
         settings_file["GaussianViewer.image_scale"].operator float();
     rendered_image_viewer_scale_main_ =
         settings_file["GaussianViewer.image_scale_main"].operator float();
+    if (!settings_file["GaussianViewer.snapshot_interval"].empty())
+        render_snapshot_interval_ = std::max(
+            0, settings_file["GaussianViewer.snapshot_interval"].operator int());
 }
 
 void GaussianMapper::run()
@@ -398,6 +480,7 @@ void GaussianMapper::run()
                 }
                 for (const auto& pKF : vpKFs){
                     std::shared_ptr<GaussianKeyframe> new_kf = std::make_shared<GaussianKeyframe>(pKF->mnId, getIteration());
+                    new_kf->device_type_ = device_type_;
                     new_kf->zfar_ = z_far_;
                     new_kf->znear_ = z_near_;
                     // Pose
@@ -424,8 +507,6 @@ void GaussianMapper::run()
                         else
                             imgAux_undistorted = imgAux;
 
-                        new_kf->original_image_ =
-                            tensor_utils::cvMat2TorchTensor_Float32(imgRGB_undistorted, device_type_);
                         new_kf->img_filename_ = pKF->mNameFile;
                         new_kf->gaus_pyramid_height_ = camera.gaus_pyramid_height_;
                         new_kf->gaus_pyramid_width_ = camera.gaus_pyramid_width_;
@@ -436,6 +517,7 @@ void GaussianMapper::run()
                     }
                     new_kf->computeTransformTensors();
                     scene_->addKeyframe(new_kf, &kfid_shuffled_);
+                    pKF->mbSentToGaussianMapping = true;
 
                     increaseKeyframeTimesOfUse(new_kf, newKeyframeTimesOfUse());
 
@@ -445,40 +527,19 @@ void GaussianMapper::run()
                     pKF->GetKeypointInfo(pixels, pointsLocal);
                     new_kf->kps_pixel_ = std::move(pixels);
                     new_kf->kps_point_local_ = std::move(pointsLocal);
-                    new_kf->img_undist_ = imgRGB_undistorted;
+                    new_kf->img_undist_ = KeyframeImageStore::toStorage(imgRGB_undistorted);
                     new_kf->img_auxiliary_undist_ = imgAux_undistorted;
-                }
-            }
-
-            // Prepare multi resolution images for training
-            for (auto& kfit : scene_->keyframes()) {
-                auto pkf = kfit.second;
-                if (device_type_ == torch::kCUDA) {
-                    cv::cuda::GpuMat img_gpu;
-                    img_gpu.upload(pkf->img_undist_);
-                    pkf->gaus_pyramid_original_image_.resize(num_gaus_pyramid_sub_levels_);
-                    for (int l = 0; l < num_gaus_pyramid_sub_levels_; ++l) {
-                        cv::cuda::GpuMat img_resized;
-                        cv::cuda::resize(img_gpu, img_resized,
-                                        cv::Size(pkf->gaus_pyramid_width_[l], pkf->gaus_pyramid_height_[l]));
-                        pkf->gaus_pyramid_original_image_[l] =
-                            tensor_utils::cvGpuMat2TorchTensor_Float32(img_resized);
-                    }
-                }
-                else {
-                    pkf->gaus_pyramid_original_image_.resize(num_gaus_pyramid_sub_levels_);
-                    for (int l = 0; l < num_gaus_pyramid_sub_levels_; ++l) {
-                        cv::Mat img_resized;
-                        cv::resize(pkf->img_undist_, img_resized,
-                                cv::Size(pkf->gaus_pyramid_width_[l], pkf->gaus_pyramid_height_[l]));
-                        pkf->gaus_pyramid_original_image_[l] =
-                            tensor_utils::cvMat2TorchTensor_Float32(img_resized, device_type_);
-                    }
+                    // Multi resolution images for training are resized on first use
+                    new_kf->image_store_ = keyframe_image_store_;
+                    buildTrainingBundle(new_kf);
                 }
             }
 
             // Prepare for training
-            {
+            if (!resume_checkpoint_path_.empty()) {
+                loadCheckpoint(resume_checkpoint_path_);
+            }
+            else {
                 std::unique_lock<std::mutex> lock_render(mutex_render_);
                 scene_->cameras_extent_ = std::get<1>(scene_->getNerfppNorm());
                 gaussians_->createFromPcd(scene_->cached_point_cloud_, scene_->cameras_extent_);
@@ -503,6 +564,7 @@ void GaussianMapper::run()
     }
 
     // Second loop: Incremental gaussian mapping
+    startIngestionWorkers();
     int SLAM_stop_iter = 0;
     while (!isStopped()) {
         // Check conditions for incremental mapping
@@ -512,6 +574,9 @@ void GaussianMapper::run()
                 cullKeyframes();
         }
 
+        // Add keyframes prepared by the ingestion workers
+        spliceIngestedKeyframes();
+
         // Invoke training once
         trainForOneIteration();
 
@@ -523,6 +588,8 @@ void GaussianMapper::run()
         if (SLAM_ended_ || getIteration() >= opt_params_.iterations_)
             break;
     }
+    waitForIngestion();
+    stopIngestionWorkers();
 
     // Third loop: Tail gaussian optimization
     int densify_interval = densifyInterval();
@@ -536,50 +603,45 @@ void GaussianMapper::run()
     // Save and clear
     renderAndRecordAllKeyframes("_shutdown");
     savePly(result_dir_ / (std::to_string(getIteration()) + "_shutdown") / "ply");
+    if (checkpoint_interval_)
+        saveCheckpoint(result_dir_ / "checkpoints" / (std::to_string(getIteration()) + "_shutdown.ckpt"));
     writeKeyframeUsedTimes(result_dir_ / "used_times", "final");
+    waitForPersistence();
+    training_stats_.stop();
+
+    const auto& insertion_stats = gaussians_->insertionStats();
+    std::cout << "[Gaussian Mapper]Inserted " << insertion_stats.num_accepted_
+              << " of " << insertion_stats.num_candidates_ << " new points ("
+              << insertion_stats.num_occupied_ << " in occupied voxels, "
+              << insertion_stats.num_merged_ << " merged), "
+              << gaussians_->xyz_.size(0) << " Gaussians in the final model" << std::endl;
 
     signalStop();
 }
 
 void GaussianMapper::trainColmap()
 {
-    // Prepare multi resolution images for training
+    // Multi resolution images for training are resized on first use
     for (auto& kfit : scene_->keyframes()) {
         auto pkf = kfit.second;
         increaseKeyframeTimesOfUse(pkf, newKeyframeTimesOfUse());
-        if (device_type_ == torch::kCUDA) {
-            cv::cuda::GpuMat img_gpu;
-            img_gpu.upload(pkf->img_undist_);
-            pkf->gaus_pyramid_original_image_.resize(num_gaus_pyramid_sub_levels_);
-            for (int l = 0; l < num_gaus_pyramid_sub_levels_; ++l) {
-                cv::cuda::GpuMat img_resized;
-                cv::cuda::resize(img_gpu, img_resized,
-                                cv::Size(pkf->gaus_pyramid_width_[l], pkf->gaus_pyramid_height_[l]));
-                pkf->gaus_pyramid_original_image_[l] =
-                    tensor_utils::cvGpuMat2TorchTensor_Float32(img_resized);
-            }
-        }
-        else {
-            pkf->gaus_pyramid_original_image_.resize(num_gaus_pyramid_sub_levels_);
-            for (int l = 0; l < num_gaus_pyramid_sub_levels_; ++l) {
-                cv::Mat img_resized;
-                cv::resize(pkf->img_undist_, img_resized,
-                        cv::Size(pkf->gaus_pyramid_width_[l], pkf->gaus_pyramid_height_[l]));
-                pkf->gaus_pyramid_original_image_[l] =
-                    tensor_utils::cvMat2TorchTensor_Float32(img_resized, device_type_);
-            }
-        }
+        pkf->img_undist_ = KeyframeImageStore::toStorage(pkf->img_undist_);
+        pkf->image_store_ = keyframe_image_store_;
+        buildTrainingBundle(pkf);
     }
 
     // Prepare for training
-    {
+    if (!resume_checkpoint_path_.empty()) {
+        loadCheckpoint(resume_checkpoint_path_);
+    }
+    else {
         std::unique_lock<std::mutex> lock_render(mutex_render_);
         scene_->cameras_extent_ = std::get<1>(scene_->getNerfppNorm());
         gaussians_->createFromPcd(scene_->cached_point_cloud_, scene_->cameras_extent_);
         std::unique_lock<std::mutex> lock(mutex_settings_);
         gaussians_->trainingSetup(opt_params_);
-        this->initial_mapped_ = true;
     }
+    this->initial_mapped_ = true;
 
     // Main loop: gaussian splatting training
     while (!isStopped()) {
@@ -602,7 +664,11 @@ void GaussianMapper::trainColmap()
     // Save and clear
     renderAndRecordAllKeyframes("_shutdown");
     savePly(result_dir_ / (std::to_string(getIteration()) + "_shutdown") / "ply");
+    if (checkpoint_interval_)
+        saveCheckpoint(result_dir_ / "checkpoints" / (std::to_string(getIteration()) + "_shutdown.ckpt"));
     writeKeyframeUsedTimes(result_dir_ / "used_times", "final");
+    waitForPersistence();
+    training_stats_.stop();
 
     signalStop();
 }
@@ -616,35 +682,55 @@ void GaussianMapper::trainForOneIteration()
     increaseIteration(1);
     auto iter_start_timing = std::chrono::steady_clock::now();
 
-    // Pick a random Camera
-    std::shared_ptr<GaussianKeyframe> viewpoint_cam = useOneRandomSlidingWindowKeyframe();
-    if (!viewpoint_cam) {
-        increaseIteration(-1);
-        return;
-    }
-
-    writeKeyframeUsedTimes(result_dir_ / "used_times");
-
-    // if (isdoingInactiveGeoDensify() && !viewpoint_cam->done_inactive_geo_densify_)
-    //     increasePcdByKeyframeInactiveGeoDensify(viewpoint_cam);
+    if (isPagingChunks() && getIteration() % chunk_paging_interval_ == 0)
+        updateResidentChunks();
+
+    // Pick a mini-batch of random Cameras, each at its own pyramid level
+    int batch_size = std::max(1, batchSize());
+    std::vector<std::shared_ptr<GaussianKeyframe>> viewpoint_cams;
+    std::vector<int> image_heights, image_widths, training_levels;
+    std::vector<torch::Tensor> gt_images, masks;
+    std::vector<float> view_losses;
+    viewpoint_cams.reserve(batch_size);
+    for (int b = 0; b < batch_size; ++b) {
+        std::shared_ptr<GaussianKeyframe> viewpoint_cam = useOneRandomSlidingWindowKeyframe();
+        if (!viewpoint_cam)
+            break;
 
-    int training_level = num_gaus_pyramid_sub_levels_;
-    int image_height, image_width;
-    torch::Tensor gt_image, mask;
-    if (isdoingGausPyramidTraining())
-        training_level = viewpoint_cam->getCurrentGausPyramidLevel();
-    if (training_level == num_gaus_pyramid_sub_levels_) {
-        image_height = viewpoint_cam->image_height_;
-        image_width = viewpoint_cam->image_width_;
-        gt_image = viewpoint_cam->original_image_.cuda();
-        mask = undistort_mask_[viewpoint_cam->camera_id_];
+        // if (isdoingInactiveGeoDensify() && !viewpoint_cam->done_inactive_geo_densify_)
+        //     increasePcdByKeyframeInactiveGeoDensify(viewpoint_cam);
+
+        int training_level = num_gaus_pyramid_sub_levels_;
+        if (isdoingGausPyramidTraining())
+            training_level = viewpoint_cam->getCurrentGausPyramidLevel();
+        if (viewpoint_cam->hasTrainingLevel(training_level)) {
+            auto& level = viewpoint_cam->trainingLevel(training_level);
+            image_heights.push_back(level.height_);
+            image_widths.push_back(level.width_);
+            gt_images.push_back(viewpoint_cam->trainingImage(training_level, device_type_));
+            masks.push_back(level.mask_);
+        }
+        else if (training_level == num_gaus_pyramid_sub_levels_) {
+            image_heights.push_back(viewpoint_cam->image_height_);
+            image_widths.push_back(viewpoint_cam->image_width_);
+            gt_images.push_back(viewpoint_cam->getOriginalImage(device_type_));
+            masks.push_back(undistort_mask_[viewpoint_cam->camera_id_]);
+        }
+        else {
+            image_heights.push_back(viewpoint_cam->gaus_pyramid_height_[training_level]);
+            image_widths.push_back(viewpoint_cam->gaus_pyramid_width_[training_level]);
+            gt_images.push_back(viewpoint_cam->getGausPyramidOriginalImage(training_level, device_type_));
+            masks.push_back(scene_->cameras_.at(viewpoint_cam->camera_id_).gaus_pyramid_undistort_mask_[training_level]);
+        }
+        viewpoint_cams.push_back(viewpoint_cam);
+        training_levels.push_back(training_level);
     }
-    else {
-        image_height = viewpoint_cam->gaus_pyramid_height_[training_level];
-        image_width = viewpoint_cam->gaus_pyramid_width_[training_level];
-        gt_image = viewpoint_cam->gaus_pyramid_original_image_[training_level].cuda();
-        mask = scene_->cameras_.at(viewpoint_cam->camera_id_).gaus_pyramid_undistort_mask_[training_level];
+    if (viewpoint_cams.empty()) {
+        increaseIteration(-1);
+        return;
     }
+    batch_size = viewpoint_cams.size();
+    std::shared_ptr<GaussianKeyframe> viewpoint_cam = viewpoint_cams.front();
 
     // Mutex lock for usage of the gaussian model
     std::unique_lock<std::mutex> lock_render(mutex_render_);
@@ -673,43 +759,45 @@ void GaussianMapper::trainForOneIteration()
     gaussians_->setScalingLearningRate(scalingLearningRate());
     gaussians_->setRotationLearningRate(rotationLearningRate());
 
-    // Render
-    auto render_pkg = GaussianRenderer::render(
-        viewpoint_cam,
-        image_height,
-        image_width,
-        gaussians_,
-        pipe_params_,
-        background_,
-        override_color_
-    );
-    auto rendered_image = std::get<0>(render_pkg);
-    auto viewspace_point_tensor = std::get<1>(render_pkg);
-    auto visibility_filter = std::get<2>(render_pkg);
-    auto radii = std::get<3>(render_pkg);
-
-    // Get rid of black edges caused by undistortion
-    torch::Tensor masked_image = rendered_image * mask;
-
-    // Loss
-    auto Ll1 = loss_utils::l1_loss(masked_image, gt_image);
+    // Render every view and accumulate its gradients. Each view is
+    // backpropagated right away so only one graph is alive at a time.
+    // Losses are summed rather than averaged to keep the screen-space
+    // gradients used for densification on the single-view scale.
     float lambda_dssim = lambdaDssim();
-    auto loss = (1.0 - lambda_dssim) * Ll1
-                + lambda_dssim * (1.0 - loss_utils::ssim(masked_image, gt_image, device_type_));
-    loss.backward();
-
-    torch::cuda::synchronize();
+    torch::Tensor Ll1, loss, masked_image;
+    torch::Tensor visible; // points seen by any view of the batch, for sparse Adam
+    std::vector<torch::Tensor> batch_view_losses; // read back once after the batch
+    batch_view_losses.reserve(batch_size);
+    float batch_loss = 0.0f;
+    bool update_densification_stats = getIteration() < opt_params_.densify_until_iter_;
+    for (int b = 0; b < batch_size; ++b) {
+        auto render_pkg = GaussianRenderer::render(
+            viewpoint_cams[b],
+            image_heights[b],
+            image_widths[b],
+            gaussians_,
+            pipe_params_,
+            background_,
+            override_color_
+        );
+        auto rendered_image = std::get<0>(render_pkg);
+        auto viewspace_point_tensor = std::get<1>(render_pkg);
+        auto visibility_filter = std::get<2>(render_pkg);
+        auto radii = std::get<3>(render_pkg);
 
-    {
-        torch::NoGradGuard no_grad;
-        ema_loss_for_log_ = 0.4f * loss.item().toFloat() + 0.6 * ema_loss_for_log_;
+        // Get rid of black edges caused by undistortion
+        masked_image = rendered_image * masks[b];
 
-        if (keyframe_record_interval_ &&
-            getIteration() % keyframe_record_interval_ == 0)
-            recordKeyframeRendered(masked_image, gt_image, viewpoint_cam->fid_, result_dir_, result_dir_, result_dir_);
+        // Loss
+        Ll1 = loss_utils::l1_loss(masked_image, gt_images[b]);
+        loss = (1.0 - lambda_dssim) * Ll1
+               + lambda_dssim * (1.0 - loss_utils::ssim(masked_image, gt_images[b], device_type_));
+        loss.backward();
 
-        // Densification
-        if (getIteration() < opt_params_.densify_until_iter_) {
+        torch::NoGradGuard no_grad;
+        batch_view_losses.push_back(loss.detach());
+        visible = visible.defined() ? torch::logical_or(visible, visibility_filter) : visibility_filter;
+        if (update_densification_stats) {
             // Keep track of max radii in image-space for pruning
             gaussians_->max_radii2D_.index_put_(
                 {visibility_filter},
@@ -717,7 +805,40 @@ void GaussianMapper::trainForOneIteration()
                             radii.index({visibility_filter})));
             // if (!isdoingGausPyramidTraining() || training_level < num_gaus_pyramid_sub_levels_)
                 gaussians_->addDensificationStats(viewspace_point_tensor, visibility_filter);
+        }
+    }
+
+    if (device_type_ == torch::kCUDA)
+        torch::cuda::synchronize();
 
+    {
+        torch::NoGradGuard no_grad;
+        torch::Tensor batch_view_losses_host = torch::stack(batch_view_losses).to(torch::kCPU, torch::kFloat);
+        auto view_loss_values = batch_view_losses_host.accessor<float, 1>();
+        for (int b = 0; b < batch_size; ++b) {
+            float view_loss = view_loss_values[b];
+            batch_loss += view_loss;
+            view_losses.push_back(view_loss);
+            scene_->keyframe_sampler_.setLoss(viewpoint_cams[b]->fid_, view_loss);
+        }
+        ema_loss_for_log_ = 0.4f * batch_loss / batch_size + 0.6 * ema_loss_for_log_;
+
+        if (keyframe_record_interval_ &&
+            getIteration() % keyframe_record_interval_ == 0) {
+            torch::Tensor rendered = masked_image.detach().clone();
+            torch::Tensor ground_truth = gt_images.back();
+            unsigned long kfid = viewpoint_cams.back()->fid_;
+            int iteration = getIteration();
+            persistence_writer_.submit(
+                "keyframe " + std::to_string(kfid) + " render at iteration " + std::to_string(iteration),
+                2 * rendered.numel() * rendered.element_size(),
+                [this, rendered, ground_truth, kfid, iteration]() mutable {
+                    recordKeyframeRendered(rendered, ground_truth, kfid, iteration, result_dir_, result_dir_, result_dir_);
+                });
+        }
+
+        // Densification
+        if (update_densification_stats) {
             if ((getIteration() > opt_params_.densify_from_iter_) &&
                 (getIteration() % densifyInterval()== 0)) {
                 int size_threshold = (getIteration() > prune_big_point_after_iter_) ? 20 : 0;
@@ -738,9 +859,29 @@ void GaussianMapper::trainForOneIteration()
         auto iter_end_timing = std::chrono::steady_clock::now();
         auto iter_time = std::chrono::duration_cast<std::chrono::milliseconds>(
                         iter_end_timing - iter_start_timing).count();
+        auto iter_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        iter_end_timing - iter_start_timing).count();
+        float images_per_second = batch_size * 1e6f / std::max<int64_t>(iter_time_us, 1);
+        {
+            std::unique_lock<std::mutex> lock_status(mutex_status_);
+            images_per_second_ = images_per_second;
+        }
+        if (training_stats_.isRecording()) {
+            std::int64_t num_gaussians = gaussians_->xyz_.size(0);
+            for (int b = 0; b < batch_size; ++b)
+                training_stats_.push({
+                    getIteration(),
+                    viewpoint_cams[b]->fid_,
+                    training_levels[b],
+                    view_losses[b],
+                    iter_time_us / 1000.0f,
+                    num_gaussians});
+        }
 
         // Log and save
-        if (training_report_interval_ && (getIteration() % training_report_interval_ == 0))
+        if (training_report_interval_ && (getIteration() % training_report_interval_ == 0)) {
+            std::cout << "[Gaussian Mapper]Batch of " << batch_size << " images, "
+                      << images_per_second << " images/s" << std::endl;
             GaussianTrainer::trainingReport(
                 getIteration(),
                 opt_params_.iterations_,
@@ -754,6 +895,7 @@ void GaussianMapper::trainForOneIteration()
                 pipe_params_,
                 background_
             );
+        }
         if ((all_keyframes_record_interval_ && getIteration() % all_keyframes_record_interval_ == 0)
             // || loop_closure_iteration_
             )
@@ -767,9 +909,16 @@ void GaussianMapper::trainForOneIteration()
 
         // Optimizer step
         if (getIteration() < opt_params_.iterations_) {
-            gaussians_->optimizer_->step();
-            gaussians_->optimizer_->zero_grad(true);
+            gaussians_->optimizer_->step(visible);
+            gaussians_->optimizer_->zeroGrad();
         }
+
+        if (checkpoint_interval_ && getIteration() % checkpoint_interval_ == 0)
+            saveCheckpoint(result_dir_ / "checkpoints" / (std::to_string(getIteration()) + ".ckpt"));
+        if (delta_checkpoint_interval_ && getIteration() % delta_checkpoint_interval_ == 0)
+            saveDeltaCheckpoint();
+
+        publishRenderSnapshot();
     }
 }
 
@@ -840,7 +989,18 @@ void GaussianMapper::combineMappingOperations()
                     // Give local BA keyframes times of use
                     increaseKeyframeTimesOfUse(pkf, local_BA_increased_times_of_use_);
                 }
-                else {
+                else if (!ingestion_workers_.empty()) {
+                    // Still being prepared: keep the latest pose for splicing,
+                    // otherwise hand it over to the ingestion workers
+                    if (isIngestingKeyframe(kfid)) {
+                        std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+                        ingestion_updated_poses_[kfid] = std::get<2>(kf);
+                    }
+                    else if (!ORB_SLAM3::MappingOperation::isPoseOnly(kf)) {
+                        submitNewKeyframe(kf);
+                    }
+                }
+                else if (!ORB_SLAM3::MappingOperation::isPoseOnly(kf)) {
                     handleNewKeyframe(kf);
                 }
             }
@@ -864,32 +1024,25 @@ void GaussianMapper::combineMappingOperations()
             std::cout << "[Gaussian Mapper]Loop Closure Detected."
                       << std::endl;
 
+            // Loop correction transforms existing points and poses, so every
+            // keyframe in flight must be part of the scene beforehand
+            waitForIngestion();
+
             // Get the loop keyframe scale modification factor
             float loop_kf_scale = opr.mfScale;
 
             // Get new keyframes (scaled transformation applied in ORB-SLAM3)
             auto& associated_kfs = opr.associatedKeyFrames();
-            // Mark the transformed points to avoid transforming more than once
-            torch::Tensor point_not_transformed_flags =
-                torch::full(
-                    {gaussians_->xyz_.size(0)},
-                    true,
-                    torch::TensorOptions().device(device_type_).dtype(torch::kBool));
             if (record_loop_ply_)
                 savePly(result_dir_ / (std::to_string(getIteration()) + "_0_before_loop_correction"));
-            int num_transformed = 0;
+            // Corrections of the loop keyframes, applied to the model at once
+            // so that each point is transformed only by the first keyframe seeing it
+            std::vector<GaussianLoopCorrection> loop_corrections;
             // Add keyframes to the scene
             for (auto& kf : associated_kfs) {
                 // Keyframe Id
                 auto kfid = std::get<0>(kf);
                 std::shared_ptr<GaussianKeyframe> pkf = scene_->getKeyframe(kfid);
-                // In case new points are added in handleNewKeyframe()
-                int64_t num_new_points = gaussians_->xyz_.size(0) - point_not_transformed_flags.size(0);
-                if (num_new_points > 0)
-                    point_not_transformed_flags = torch::cat({
-                        point_not_transformed_flags,
-                        torch::full({num_new_points}, true, point_not_transformed_flags.options())},
-                        /*dim=*/0);
                 // If kf is already in the scene, evaluate the change in pose,
                 // if too large we perform loop correction on its visible model points.
                 // If not in the scene, create a new one.
@@ -911,21 +1064,13 @@ void GaussianMapper::combineMappingOperations()
                             diff_pose.translation() -= inv_pose.translation(); // t = (R_new * t_old + t_new) - t_new
                             diff_pose.translation() *= loop_kf_scale;          // t = s * (R_new * t_old)
                             diff_pose.translation() += inv_pose.translation(); // t = (s * R_new * t_old) + t_new
-                            torch::Tensor diff_pose_tensor =
-                                tensor_utils::EigenMatrix2TorchTensor(
-                                    diff_pose.matrix(), device_type_).transpose(0, 1);
-                            {
-                                std::unique_lock<std::mutex> lock_render(mutex_render_);
-                                gaussians_->scaledTransformVisiblePointsOfKeyframe(
-                                    point_not_transformed_flags,
-                                    diff_pose_tensor,
-                                    pkf->world_view_transform_,
-                                    pkf->full_proj_transform_,
-                                    pkf->creation_iter_,
-                                    stableNumIterExistence(),
-                                    num_transformed,
-                                    loop_kf_scale); // selected xyz *= s
-                            }
+                            // Points added in handleNewKeyframe() up to here are corrected as well
+                            GaussianLoopCorrection correction;
+                            correction.diff_pose_ = diff_pose;
+                            correction.world_view_transform_ = pkf->world_view_transform_;
+                            correction.creation_iter_ = pkf->creation_iter_;
+                            correction.num_points_ = gaussians_->xyz_.size(0);
+                            loop_corrections.emplace_back(std::move(correction));
                             // Give loop keyframes times of use
                             increaseKeyframeTimesOfUse(pkf, loop_closure_increased_times_of_use_);
 // renderAndRecordKeyframe(pkf, result_dir_, "_1_after_loop_transforming_points");
@@ -938,10 +1083,19 @@ void GaussianMapper::combineMappingOperations()
                     pkf->computeTransformTensors();
 // if (std::get<4>(kf)) renderAndRecordKeyframe(pkf, result_dir_, "_2_after_pose_correction");
                 }
-                else {
+                else if (!ORB_SLAM3::MappingOperation::isPoseOnly(kf)) {
                     handleNewKeyframe(kf);
                 }
             }
+            if (!loop_corrections.empty()) {
+                std::unique_lock<std::mutex> lock_render(mutex_render_);
+                // The paged out points have to be corrected as well
+                pageInAllChunks();
+                int num_transformed = gaussians_->applyLoopCorrections(
+                    loop_corrections, stableNumIterExistence(), loop_kf_scale); // selected xyz *= s
+                std::cout << "[Gaussian Mapper]Loop correction transformed " << num_transformed
+                          << " points of " << loop_corrections.size() << " keyframes" << std::endl;
+            }
             if (record_loop_ply_)
                 savePly(result_dir_ / (std::to_string(getIteration()) + "_1_after_loop_correction"));
 // keyframesToJson(result_dir_ / (std::to_string(getIteration()) + "_0_before_loop_correction"));
@@ -967,6 +1121,7 @@ void GaussianMapper::combineMappingOperations()
         {
             std::cout << "[Gaussian Mapper]Scale refinement Detected. Transforming all kfs and points..."
                       << std::endl;
+            waitForIngestion();
 
             float s = opr.mfScale;
             Sophus::SE3f& T = opr.mT;
@@ -1011,19 +1166,32 @@ void GaussianMapper::combineMappingOperations()
     }
 }
 
-void GaussianMapper::handleNewKeyframe(
-    std::tuple< unsigned long/*Id*/,
-                unsigned long/*CameraId*/,
-                Sophus::SE3f/*pose*/,
-                cv::Mat/*image*/,
-                bool/*isLoopClosure*/,
-                cv::Mat/*auxiliaryImage*/,
-                std::vector<float>,
-                std::vector<float>,
-                std::string> &kf)
+void GaussianMapper::handleNewKeyframe(MappingKeyframe &kf)
+{
+    std::shared_ptr<GaussianKeyframe> pkf = prepareNewKeyframe(kf);
+
+    // Add the new keyframe to the scene
+    scene_->addKeyframe(pkf, &kfid_shuffled_);
+    markKeyframeTakenIn(kf);
+
+    // Give new keyframes times of use and add it to the training sliding window
+    increaseKeyframeTimesOfUse(pkf, newKeyframeTimesOfUse());
+
+    // Get dense point cloud from the new keyframe to accelerate training
+    if (isdoingInactiveGeoDensify())
+        increasePcdByKeyframeInactiveGeoDensify(pkf);
+}
+
+/**
+ * @brief Undistort the images of a new keyframe and build its training tensors,
+ *        without touching the scene or the model so it may run on any thread
+ */
+std::shared_ptr<GaussianKeyframe>
+GaussianMapper::prepareNewKeyframe(MappingKeyframe &kf)
 {
     std::shared_ptr<GaussianKeyframe> pkf =
         std::make_shared<GaussianKeyframe>(std::get<0>(kf), getIteration());
+    pkf->device_type_ = device_type_;
     pkf->zfar_ = z_far_;
     pkf->znear_ = z_near_;
     // Pose
@@ -1050,8 +1218,6 @@ void GaussianMapper::handleNewKeyframe(
         else
             imgAux_undistorted = imgAux;
 
-        pkf->original_image_ =
-            tensor_utils::cvMat2TorchTensor_Float32(imgRGB_undistorted, device_type_);
         pkf->img_filename_ = std::get<8>(kf);
         pkf->gaus_pyramid_height_ = camera.gaus_pyramid_height_;
         pkf->gaus_pyramid_width_ = camera.gaus_pyramid_width_;
@@ -1060,138 +1226,216 @@ void GaussianMapper::handleNewKeyframe(
     catch (std::out_of_range) {
         throw std::runtime_error("[GaussianMapper::combineMappingOperations]KeyFrame Camera not found!");
     }
-    // Add the new keyframe to the scene
     pkf->computeTransformTensors();
-    scene_->addKeyframe(pkf, &kfid_shuffled_);
 
-    // Give new keyframes times of use and add it to the training sliding window
-    increaseKeyframeTimesOfUse(pkf, newKeyframeTimesOfUse());
-
-    // Get dense point cloud from the new keyframe to accelerate training
-    pkf->img_undist_ = imgRGB_undistorted;
+    pkf->img_undist_ = KeyframeImageStore::toStorage(imgRGB_undistorted);
     pkf->img_auxiliary_undist_ = imgAux_undistorted;
     pkf->kps_pixel_ = std::move(std::get<6>(kf));
     pkf->kps_point_local_ = std::move(std::get<7>(kf));
-    if (isdoingInactiveGeoDensify())
-        increasePcdByKeyframeInactiveGeoDensify(pkf);
 
-    // Prepare multi resolution images for training
-    if (device_type_ == torch::kCUDA) {
-        cv::cuda::GpuMat img_gpu;
-        img_gpu.upload(pkf->img_undist_);
-        pkf->gaus_pyramid_original_image_.resize(num_gaus_pyramid_sub_levels_);
-        for (int l = 0; l < num_gaus_pyramid_sub_levels_; ++l) {
-            cv::cuda::GpuMat img_resized;
-            cv::cuda::resize(img_gpu, img_resized,
-                                cv::Size(pkf->gaus_pyramid_width_[l], pkf->gaus_pyramid_height_[l]));
-            pkf->gaus_pyramid_original_image_[l] =
-                tensor_utils::cvGpuMat2TorchTensor_Float32(img_resized);
-        }
+    // Multi resolution images for training are resized on first use
+    pkf->image_store_ = keyframe_image_store_;
+    buildTrainingBundle(pkf);
+    return pkf;
+}
+
+void GaussianMapper::startIngestionWorkers()
+{
+    if (num_ingestion_workers_ <= 0 || !ingestion_workers_.empty())
+        return;
+    {
+        std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+        ingestion_stop_ = false;
     }
-    else {
-        pkf->gaus_pyramid_original_image_.resize(num_gaus_pyramid_sub_levels_);
-        for (int l = 0; l < num_gaus_pyramid_sub_levels_; ++l) {
-            cv::Mat img_resized;
-            cv::resize(pkf->img_undist_, img_resized,
-                        cv::Size(pkf->gaus_pyramid_width_[l], pkf->gaus_pyramid_height_[l]));
-            pkf->gaus_pyramid_original_image_[l] =
-                tensor_utils::cvMat2TorchTensor_Float32(img_resized, device_type_);
-        }
+    for (int i = 0; i < num_ingestion_workers_; ++i)
+        ingestion_workers_.emplace_back(&GaussianMapper::ingestionWorkerLoop, this);
+}
+
+void GaussianMapper::stopIngestionWorkers()
+{
+    {
+        std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+        ingestion_stop_ = true;
     }
+    cv_ingestion_queue_.notify_all();
+    cv_ingestion_space_.notify_all();
+    for (auto& worker : ingestion_workers_)
+        if (worker.joinable())
+            worker.join();
+    ingestion_workers_.clear();
 }
 
-void GaussianMapper::generateKfidRandomShuffle()
+/**
+ * @brief Producer/consumer loop of an ingestion worker: takes new keyframes
+ *        from the bounded queue and prepares them off the training thread
+ */
+void GaussianMapper::ingestionWorkerLoop()
 {
-// if (viewpoint_sliding_window_.empty())
-//     return;
+    while (true) {
+        MappingKeyframe kf;
+        {
+            std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+            cv_ingestion_queue_.wait(lock_ingestion, [this] {
+                return ingestion_stop_ || !ingestion_queue_.empty(); });
+            if (ingestion_queue_.empty())
+                return;
+            kf = std::move(ingestion_queue_.front());
+            ingestion_queue_.pop_front();
+        }
+        cv_ingestion_space_.notify_one();
+
+        IngestedKeyframe ingested;
+        try {
+            ingested.pkf_ = prepareNewKeyframe(kf);
+            if (isdoingInactiveGeoDensify())
+                std::tie(ingested.densify_points_, ingested.densify_colors_) =
+                    inactiveGeoDensifyPoints(ingested.pkf_);
+        }
+        catch (...) {
+            std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+            ingestion_error_ = std::current_exception();
+            ingestion_pending_kfids_.erase(std::get<0>(kf));
+            cv_ingestion_ready_.notify_all();
+            continue;
+        }
 
-// std::size_t sliding_window_size = viewpoint_sliding_window_.size();
-// kfid_shuffle_.resize(sliding_window_size);
-// std::iota(kfid_shuffle_.begin(), kfid_shuffle_.end(), 0);
-// std::mt19937 g(rd_());
-// std::shuffle(kfid_shuffle_.begin(), kfid_shuffle_.end(), g);
+        {
+            std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+            ingestion_ready_.emplace_back(std::move(ingested));
+        }
+        cv_ingestion_ready_.notify_all();
+    }
+}
 
-    if (scene_->keyframes().empty())
+/**
+ * @brief Queue a new keyframe for the ingestion workers, blocking while the queue is full
+ */
+void GaussianMapper::submitNewKeyframe(MappingKeyframe &kf)
+{
+    std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+    cv_ingestion_space_.wait(lock_ingestion, [this] {
+        return ingestion_stop_ || ingestion_queue_.size() < ingestion_queue_capacity_; });
+    if (ingestion_stop_)
         return;
+    ingestion_pending_kfids_.insert(std::get<0>(kf));
+    markKeyframeTakenIn(kf);
+    ingestion_queue_.emplace_back(std::move(kf));
+    lock_ingestion.unlock();
+    cv_ingestion_queue_.notify_one();
+}
 
-    std::size_t nkfs = scene_->keyframes().size();
-    kfid_shuffle_.resize(nkfs);
-    std::iota(kfid_shuffle_.begin(), kfid_shuffle_.end(), 0);
-    std::mt19937 g(rd_());
-    std::shuffle(kfid_shuffle_.begin(), kfid_shuffle_.end(), g);
+/**
+ * @brief Later mapping operations only carry the pose of a keyframe the mapper has
+ */
+void GaussianMapper::markKeyframeTakenIn(MappingKeyframe &kf)
+{
+    if (ORB_SLAM3::KeyFrame* pKF = std::get<9>(kf))
+        pKF->mbSentToGaussianMapping = true;
+}
 
-    kfid_shuffled_ = true;
+bool GaussianMapper::isIngestingKeyframe(unsigned long kfid)
+{
+    std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+    return ingestion_pending_kfids_.count(kfid) != 0;
+}
+
+/**
+ * @brief Add the keyframes and densification points prepared so far to the scene and the model
+ */
+void GaussianMapper::spliceIngestedKeyframes()
+{
+    std::deque<IngestedKeyframe> ready;
+    std::map<unsigned long, Sophus::SE3f> updated_poses;
+    {
+        std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+        if (ingestion_error_) {
+            auto error = ingestion_error_;
+            ingestion_error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+        ready.swap(ingestion_ready_);
+        for (auto& ingested : ready) {
+            auto kfid = ingested.pkf_->fid_;
+            ingestion_pending_kfids_.erase(kfid);
+            auto pose_it = ingestion_updated_poses_.find(kfid);
+            if (pose_it != ingestion_updated_poses_.end()) {
+                updated_poses.insert(*pose_it);
+                ingestion_updated_poses_.erase(pose_it);
+            }
+        }
+    }
+
+    for (auto& ingested : ready) {
+        auto& pkf = ingested.pkf_;
+
+        // Local BA refined the pose while the keyframe was being prepared
+        auto pose_it = updated_poses.find(pkf->fid_);
+        if (pose_it != updated_poses.end()) {
+            Sophus::SE3f& pose = pose_it->second;
+            Sophus::SE3f correction = pose.inverse() * pkf->getPosef();
+            pkf->setPose(
+                pose.unit_quaternion().cast<double>(),
+                pose.translation().cast<double>());
+            pkf->computeTransformTensors();
+            if (ingested.densify_points_.defined() && ingested.densify_points_.size(0) > 0) {
+                torch::NoGradGuard no_grad;
+                torch::Tensor correction_tensor =
+                    tensor_utils::EigenMatrix2TorchTensor(
+                        correction.matrix(), device_type_).transpose(0, 1);
+                transformPoints(ingested.densify_points_, correction_tensor);
+            }
+        }
+
+        pkf->creation_iter_ = getIteration();
+        scene_->addKeyframe(pkf, &kfid_shuffled_);
+        increaseKeyframeTimesOfUse(pkf, newKeyframeTimesOfUse());
+
+        if (ingested.densify_points_.defined()) {
+            pkf->done_inactive_geo_densify_ = true;
+            cacheInactiveGeoDensifyPoints(ingested.densify_points_, ingested.densify_colors_);
+        }
+    }
+}
+
+/**
+ * @brief Block until every submitted keyframe is prepared, then splice them all
+ */
+void GaussianMapper::waitForIngestion()
+{
+    if (ingestion_workers_.empty())
+        return;
+    {
+        std::unique_lock<std::mutex> lock_ingestion(mutex_ingestion_);
+        cv_ingestion_ready_.wait(lock_ingestion, [this] {
+            return ingestion_error_ || ingestion_ready_.size() >= ingestion_pending_kfids_.size(); });
+    }
+    spliceIngestedKeyframes();
 }
 
 std::shared_ptr<GaussianKeyframe>
 GaussianMapper::useOneRandomSlidingWindowKeyframe()
 {
-// auto t1 = std::chrono::steady_clock::now();
-    if (scene_->keyframes().empty())
+    // Random available keyframe, all keyframes get 1 more time of use if none is available
+    std::shared_ptr<GaussianKeyframe> viewpoint_cam = scene_->keyframe_sampler_.useOne();
+    if (!viewpoint_cam)
         return nullptr;
 
-    if (!kfid_shuffled_)
-        generateKfidRandomShuffle();
-
-    std::shared_ptr<GaussianKeyframe> viewpoint_cam = nullptr;
-    int random_cam_idx;
-
-    if (kfid_shuffled_) {
-        int start_shuffle_idx = kfid_shuffle_idx_;
-        do {
-            // Next shuffled idx
-            ++kfid_shuffle_idx_;
-            if (kfid_shuffle_idx_ >= kfid_shuffle_.size())
-                kfid_shuffle_idx_ = 0;
-            // Add 1 time of use to all kfs if they are all unavalible
-            if (kfid_shuffle_idx_ == start_shuffle_idx)
-                for (auto& kfit : scene_->keyframes())
-                    increaseKeyframeTimesOfUse(kfit.second, 1);
-            // Get viewpoint kf
-            random_cam_idx = kfid_shuffle_[kfid_shuffle_idx_];
-            auto random_cam_it = scene_->keyframes().begin();
-            for (int cam_idx = 0; cam_idx < random_cam_idx; ++cam_idx)
-                ++random_cam_it;
-            viewpoint_cam = (*random_cam_it).second;
-        } while (viewpoint_cam->remaining_times_of_use_ <= 0);
-    }
-
     // Count used times
-    auto viewpoint_fid = viewpoint_cam->fid_;
-    if (kfs_used_times_.find(viewpoint_fid) == kfs_used_times_.end())
-        kfs_used_times_[viewpoint_fid] = 1;
-    else
-        ++kfs_used_times_[viewpoint_fid];
-    
-    // Handle times of use
-    --(viewpoint_cam->remaining_times_of_use_);
+    ++kfs_used_times_[viewpoint_cam->fid_];
 
-// auto t2 = std::chrono::steady_clock::now();
-// auto t21 = std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count();
-// std::cout<<t21 <<" ns"<<std::endl;
     return viewpoint_cam;
 }
 
 std::shared_ptr<GaussianKeyframe>
 GaussianMapper::useOneRandomKeyframe()
 {
-    if (scene_->keyframes().empty())
-        return nullptr;
-
     // Get randomly
-    int nkfs = static_cast<int>(scene_->keyframes().size());
-    int random_cam_idx = std::rand() / ((RAND_MAX + 1u) / nkfs);
-    auto random_cam_it = scene_->keyframes().begin();
-    for (int cam_idx = 0; cam_idx < random_cam_idx; ++cam_idx)
-        ++random_cam_it;
-    std::shared_ptr<GaussianKeyframe> viewpoint_cam = (*random_cam_it).second;
+    std::shared_ptr<GaussianKeyframe> viewpoint_cam = scene_->keyframe_sampler_.sampleAny();
+    if (!viewpoint_cam)
+        return nullptr;
 
     // Count used times
-    auto viewpoint_fid = viewpoint_cam->fid_;
-    if (kfs_used_times_.find(viewpoint_fid) == kfs_used_times_.end())
-        kfs_used_times_[viewpoint_fid] = 1;
-    else
-        ++kfs_used_times_[viewpoint_fid];
+    ++kfs_used_times_[viewpoint_cam->fid_];
 
     return viewpoint_cam;
 }
@@ -1200,7 +1444,96 @@ void GaussianMapper::increaseKeyframeTimesOfUse(
     std::shared_ptr<GaussianKeyframe> pkf,
     int times)
 {
-    pkf->remaining_times_of_use_ += times;
+    scene_->keyframe_sampler_.increaseTimesOfUse(pkf, times);
+}
+
+/**
+ * @brief Views of paged out regions would pull the resident points towards them, so only the
+ *        keyframes near the resident region are sampled, or all of them if none is near
+ */
+void GaussianMapper::restrictSamplingToResidentRegion()
+{
+    auto& sampler = scene_->keyframe_sampler_;
+    if (!chunk_pager_ || chunk_pager_->numPagedChunks() == 0 || !paging_center_.defined() || sampler.size() == 0) {
+        sampler.includeAll();
+        return;
+    }
+
+    // One copy to the host for all keyframes
+    std::vector<torch::Tensor> camera_centers;
+    camera_centers.reserve(sampler.size());
+    for (std::size_t slot = 0; slot < sampler.size(); ++slot)
+        camera_centers.push_back(sampler.at(slot)->camera_center_.view({3}));
+    torch::Tensor dists = (torch::stack(camera_centers) - paging_center_.view({1, 3})).norm(2, /*dim=*/1)
+                              .to(torch::kCPU, torch::kFloat);
+    auto dists_a = dists.accessor<float, 1>();
+    std::size_t num_near = 0;
+    for (std::size_t slot = 0; slot < sampler.size(); ++slot)
+        num_near += (dists_a[slot] <= chunk_keep_radius_);
+    if (num_near == 0) {
+        sampler.includeAll();
+        return;
+    }
+    // Excluding does not reorder the slots
+    for (std::size_t slot = 0; slot < sampler.size(); ++slot)
+        sampler.setExcluded(sampler.at(slot)->fid_, dists_a[slot] > chunk_keep_radius_);
+}
+
+/**
+ * @brief Keep the map chunks around the newest keyframe resident and
+ *        page the farthest ones out while above the cap
+ */
+void GaussianMapper::updateResidentChunks()
+{
+    if (scene_->keyframes().empty())
+        return;
+    if (!chunk_pager_)
+        chunk_pager_ = std::make_unique<GaussianChunkPager>(result_dir_ / "chunks", chunk_size_);
+    paging_center_ = scene_->keyframes().rbegin()->second->camera_center_.clone();
+
+    std::unique_lock<std::mutex> lock_render(mutex_render_);
+    std::int64_t num_in = gaussians_->pageInChunks(*chunk_pager_, paging_center_, chunk_keep_radius_);
+    std::int64_t num_out = gaussians_->pageOutChunks(
+        *chunk_pager_, paging_center_, chunk_keep_radius_, max_resident_gaussians_);
+    restrictSamplingToResidentRegion();
+    if (num_in || num_out) {
+        auto& stats = chunk_pager_->stats();
+        std::cout << "[Gaussian Mapper]Paged in " << num_in << " and out " << num_out << " points, "
+                  << gaussians_->xyz_.size(0) << " resident, " << chunk_pager_->numPagedPoints() << " in "
+                  << chunk_pager_->numPagedChunks() << " chunks on disk ("
+                  << chunk_pager_->pagedBytes() / (1024.0 * 1024.0) << " MB); total "
+                  << stats.out_ms_ << " ms out, " << stats.in_ms_ << " ms in" << std::endl;
+    }
+}
+
+/**
+ * @brief Bring the whole map back, between iterations, with mutex_render_ held or from the training thread
+ */
+void GaussianMapper::pageInAllChunks()
+{
+    if (chunk_pager_) {
+        gaussians_->pageInChunks(*chunk_pager_, torch::Tensor(), -1.0f);
+        restrictSamplingToResidentRegion();
+    }
+}
+
+/**
+ * @brief Keep the training levels of a new keyframe on the device, instead of converting them every iteration
+ */
+void GaussianMapper::buildTrainingBundle(std::shared_ptr<GaussianKeyframe> pkf)
+{
+    if (!device_training_images_)
+        return;
+    std::vector<torch::Tensor> level_masks;
+    try {
+        level_masks = scene_->cameras_.at(pkf->camera_id_).gaus_pyramid_undistort_mask_;
+        level_masks.resize(pkf->num_gaus_pyramid_sub_levels_);
+        level_masks.push_back(undistort_mask_.at(pkf->camera_id_));
+    }
+    catch (std::out_of_range) {
+        throw std::runtime_error("[GaussianMapper::buildTrainingBundle]KeyFrame Camera not found!");
+    }
+    pkf->buildTrainingBundle(level_masks, device_type_);
 }
 
 void GaussianMapper::cullKeyframes()
@@ -1218,14 +1551,57 @@ void GaussianMapper::cullKeyframes()
     }
 
     for (auto& kfid : kfids_to_erase) {
-        scene_->keyframes().erase(kfid);
+        scene_->keyframes().at(kfid)->releaseTrainingBundle();
+        scene_->eraseKeyframe(kfid);
+        keyframe_image_store_->erase(kfid);
     }
 }
 
+/**
+ * @brief Flags of the (num_pixels) flattened image set at the keypoints of `pkf`, in one scatter
+ */
+torch::Tensor GaussianMapper::keypointPixelFlags(
+    std::shared_ptr<GaussianKeyframe> pkf,
+    int64_t num_pixels,
+    torch::Device device)
+{
+    torch::Tensor flags = torch::zeros({num_pixels}, torch::TensorOptions().dtype(torch::kBool).device(device));
+    int64_t num_kps = pkf->kps_pixel_.size() / 2;
+    if (num_kps == 0)
+        return flags;
+    // Truncated to the pixel like static_cast<int>
+    torch::Tensor kps_pixel = torch::from_blob(
+        pkf->kps_pixel_.data(), {num_kps, 2}, torch::TensorOptions().dtype(torch::kFloat32)).to(torch::kLong);
+    torch::Tensor idx = kps_pixel.select(1, 0) + kps_pixel.select(1, 1) * pkf->image_width_;
+    idx = idx.index({torch::logical_and(idx >= 0, idx < num_pixels)});
+    return flags.index_fill_(0, idx.to(device), true);
+}
+
 void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
     std::shared_ptr<GaussianKeyframe> pkf)
 {
 // auto start_timing = std::chrono::steady_clock::now();
+    auto points = inactiveGeoDensifyPoints(pkf);
+    pkf->done_inactive_geo_densify_ = true;
+    cacheInactiveGeoDensifyPoints(std::get<0>(points), std::get<1>(points));
+
+// auto end_timing = std::chrono::steady_clock::now();
+// auto completion_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+//                 end_timing - start_timing).count();
+// std::cout << "[Gaussian Mapper]increasePcdByKeyframeInactiveGeoDensify() takes "
+//             << completion_time
+//             << " ms"
+//             << std::endl;
+}
+
+/**
+ * @brief Dense points of a keyframe in the world frame, computed from its
+ *        keypoints and stereo/depth images. Does not touch the model.
+ */
+std::tuple<torch::Tensor, torch::Tensor>
+GaussianMapper::inactiveGeoDensifyPoints(
+    std::shared_ptr<GaussianKeyframe> pkf)
+{
     torch::NoGradGuard no_grad;
 
     Sophus::SE3f Twc = pkf->getPosef().inverse();
@@ -1246,9 +1622,7 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
         torch::Tensor kps_has3D_tensor = torch::where(
             kps_point_local_tensor.index({torch::indexing::Slice(), 2}) > 0.0f, true, false);
 
-        cv::cuda::GpuMat rgb_gpu;
-        rgb_gpu.upload(pkf->img_undist_);
-        torch::Tensor colors = tensor_utils::cvGpuMat2TorchTensor_Float32(rgb_gpu);
+        torch::Tensor colors = KeyframeImageStore::toTensor(pkf->img_undist_, device_type_);
         colors = colors.permute({1, 2, 0}).flatten(0, 1).contiguous();
 
         auto result =
@@ -1262,15 +1636,7 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
             tensor_utils::EigenMatrix2TorchTensor(
                 Twc.matrix(), device_type_).transpose(0, 1);
         transformPoints(points3D_valid, Twc_tensor);
-        // Add new points to the cache
-        if (depth_cached_ == 0) {
-            depth_cache_points_ = points3D_valid;
-            depth_cache_colors_ = colors_valid;
-        }
-        else {
-            depth_cache_points_ = torch::cat({depth_cache_points_, points3D_valid}, /*dim=*/0);
-            depth_cache_colors_ = torch::cat({depth_cache_colors_, colors_valid}, /*dim=*/0);
-        }
+        return std::make_tuple(points3D_valid, colors_valid);
 // savePly(result_dir_ / (std::to_string(getIteration()) + "_" + std::to_string(pkf->fid_) + "_1_after_inactive_geo_densify"));
     }
     break;
@@ -1283,17 +1649,16 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
         rgb_left_gpu.upload(pkf->img_undist_);
         rgb_right_gpu.upload(pkf->img_auxiliary_undist_);
 
-        // From CV_32FC3 to CV_32FC1
+        // From CV_8UC3 to CV_8UC1
         cv::cuda::cvtColor(rgb_left_gpu, gray_left_gpu, cv::COLOR_RGB2GRAY);
         cv::cuda::cvtColor(rgb_right_gpu, gray_right_gpu, cv::COLOR_RGB2GRAY);
 
-        // From CV_32FC1 to CV_8UC1
-        gray_left_gpu.convertTo(gray_left_gpu, CV_8UC1, 255.0);
-        gray_right_gpu.convertTo(gray_right_gpu, CV_8UC1, 255.0);
-
         // Compute disparity
         cv::cuda::GpuMat cv_disp;
-        stereo_cv_sgm_->compute(gray_left_gpu, gray_right_gpu, cv_disp);
+        {
+            std::unique_lock<std::mutex> lock_stereo(mutex_stereo_);
+            stereo_cv_sgm_->compute(gray_left_gpu, gray_right_gpu, cv_disp);
+        }
         cv_disp.convertTo(cv_disp, CV_32F, 1.0 / 16.0);
 
         // Reproject to get 3D points
@@ -1305,47 +1670,11 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
         disp = disp.flatten(0, 1).contiguous();
         torch::Tensor points3D = tensor_utils::cvGpuMat2TorchTensor_Float32(cv_points3D);
         points3D = points3D.permute({1, 2, 0}).flatten(0, 1).contiguous();
-        torch::Tensor colors = tensor_utils::cvGpuMat2TorchTensor_Float32(rgb_left_gpu);
+        torch::Tensor colors = KeyframeImageStore::toTensor(pkf->img_undist_, device_type_);
         colors = colors.permute({1, 2, 0}).flatten(0, 1).contiguous();
     
         // Clear undisired and unreliable stereo points
-        torch::Tensor point_valid_flags = torch::full(
-            {disp.size(0)}, false, torch::TensorOptions().dtype(torch::kBool).device(device_type_));
-        int nkps_twice = pkf->kps_pixel_.size();
-        int width = pkf->image_width_;
-        for (int kpidx = 0; kpidx < nkps_twice; kpidx += 2) {
-            int idx = static_cast<int>(/*u*/pkf->kps_pixel_[kpidx]) + static_cast<int>(/*v*/pkf->kps_pixel_[kpidx + 1]) * width;
-            // int u = static_cast<int>(/*u*/pkf->kps_pixel_[kpidx]);
-            // if (u < 0.3 * width || u > 0.7 * width)
-            point_valid_flags[idx] = true;
-            // idx += width;
-            // if (idx < disp.size(0)) {
-            //     point_valid_flags[idx - 3] = true;
-            //     point_valid_flags[idx - 2] = true;
-            //     point_valid_flags[idx - 1] = true;
-            //     point_valid_flags[idx] = true;
-            // }
-            // idx -= (2 * width);
-            // if (idx > 0) {
-            //     point_valid_flags[idx] = true;
-            //     point_valid_flags[idx + 1] = true;
-            //     point_valid_flags[idx + 2] = true;
-            //     point_valid_flags[idx + 3] = true;
-            // }
-            // idx += width;
-            // idx += 3;
-            // if (idx < disp.size(0)) {
-            //     point_valid_flags[idx] = true;
-            //     point_valid_flags[idx - 1] = true;
-            //     point_valid_flags[idx - 2] = true;
-            // }
-            // idx -= 6;
-            // if (idx > 0) {
-            //     point_valid_flags[idx] = true;
-            //     point_valid_flags[idx + 1] = true;
-            //     point_valid_flags[idx + 2] = true;
-            // }
-        }
+        torch::Tensor point_valid_flags = keypointPixelFlags(pkf, disp.size(0), disp.device());
         point_valid_flags = torch::logical_and(
             point_valid_flags,
             torch::where(disp > static_cast<float>(stereo_cv_sgm_->getMinDisparity()), true, false));
@@ -1362,40 +1691,21 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
                 Twc.matrix(), device_type_).transpose(0, 1);
         transformPoints(points3D_valid, Twc_tensor);
 
-        // Add new points to the cache
-        if (depth_cached_ == 0) {
-            depth_cache_points_ = points3D_valid;
-            depth_cache_colors_ = colors_valid;
-        }
-        else {
-            depth_cache_points_ = torch::cat({depth_cache_points_, points3D_valid}, /*dim=*/0);
-            depth_cache_colors_ = torch::cat({depth_cache_colors_, colors_valid}, /*dim=*/0);
-        }
+        return std::make_tuple(points3D_valid, colors_valid);
 // savePly(result_dir_ / (std::to_string(getIteration()) + "_" + std::to_string(pkf->fid_) + "_1_after_inactive_geo_densify"));
     }
     break;
     case RGBD:
     {
 // savePly(result_dir_ / (std::to_string(getIteration()) + "_" + std::to_string(pkf->fid_) + "_0_before_inactive_geo_densify"));
-        cv::cuda::GpuMat img_rgb_gpu, img_depth_gpu;
-        img_rgb_gpu.upload(pkf->img_undist_);
-        img_depth_gpu.upload(pkf->img_auxiliary_undist_);
-
-        // From cv::cuda::GpuMat to torch::Tensor
-        torch::Tensor rgb = tensor_utils::cvGpuMat2TorchTensor_Float32(img_rgb_gpu);
+        // From cv::Mat to torch::Tensor, on either device
+        torch::Tensor rgb = KeyframeImageStore::toTensor(pkf->img_undist_, device_type_);
         rgb = rgb.permute({1, 2, 0}).flatten(0, 1).contiguous();
-        torch::Tensor depth = tensor_utils::cvGpuMat2TorchTensor_Float32(img_depth_gpu);
+        torch::Tensor depth = tensor_utils::cvMat2TorchTensor_Float32(pkf->img_auxiliary_undist_, device_type_);
         depth = depth.flatten(0, 1).contiguous();
 
         // To clear undisired and unreliable depth
-        torch::Tensor point_valid_flags = torch::full(
-            {depth.size(0)}, false/*true*/, torch::TensorOptions().dtype(torch::kBool).device(device_type_));
-        int nkps_twice = pkf->kps_pixel_.size();
-        int width = pkf->image_width_;
-        for (int kpidx = 0; kpidx < nkps_twice; kpidx += 2) {
-            int idx = static_cast<int>(/*u*/pkf->kps_pixel_[kpidx]) + static_cast<int>(/*v*/pkf->kps_pixel_[kpidx + 1]) * width;
-            point_valid_flags[idx] = true;
-        }
+        torch::Tensor point_valid_flags = keypointPixelFlags(pkf, depth.size(0), depth.device());
         point_valid_flags = torch::logical_and(
             point_valid_flags,
             torch::where(depth > RGBD_min_depth_, true, false));
@@ -1436,15 +1746,7 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
                 Twc.matrix(), device_type_).transpose(0, 1);
         transformPoints(points3D_valid, Twc_tensor);
 
-        // Add new points to the cache
-        if (depth_cached_ == 0) {
-            depth_cache_points_ = points3D_valid;
-            depth_cache_colors_ = colors_valid;
-        }
-        else {
-            depth_cache_points_ = torch::cat({depth_cache_points_, points3D_valid}, /*dim=*/0);
-            depth_cache_colors_ = torch::cat({depth_cache_colors_, colors_valid}, /*dim=*/0);
-        }
+        return std::make_tuple(points3D_valid, colors_valid);
 // savePly(result_dir_ / (std::to_string(getIteration()) + "_" + std::to_string(pkf->fid_) + "_1_after_inactive_geo_densify"));
     }
     break;
@@ -1454,24 +1756,30 @@ void GaussianMapper::increasePcdByKeyframeInactiveGeoDensify(
     }
     break;
     }
+}
 
-    pkf->done_inactive_geo_densify_ = true;
+void GaussianMapper::cacheInactiveGeoDensifyPoints(
+    torch::Tensor& points,
+    torch::Tensor& colors)
+{
+    // Add new points to the cache
+    if (depth_cached_ == 0) {
+        depth_cache_points_ = points;
+        depth_cache_colors_ = colors;
+    }
+    else {
+        depth_cache_points_ = torch::cat({depth_cache_points_, points}, /*dim=*/0);
+        depth_cache_colors_ = torch::cat({depth_cache_colors_, colors}, /*dim=*/0);
+    }
     ++depth_cached_;
 
     if (depth_cached_ >= max_depth_cached_) {
         depth_cached_ = 0;
         // Add new points to the model
+        torch::NoGradGuard no_grad;
         std::unique_lock<std::mutex> lock_render(mutex_render_);
         gaussians_->increasePcd(depth_cache_points_, depth_cache_colors_, getIteration());
     }
-
-// auto end_timing = std::chrono::steady_clock::now();
-// auto completion_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-//                 end_timing - start_timing).count();
-// std::cout << "[Gaussian Mapper]increasePcdByKeyframeInactiveGeoDensify() takes "
-//             << completion_time
-//             << " ms"
-//             << std::endl;
 }
 
 // bool GaussianMapper::needInterruptTraining()
@@ -1490,6 +1798,7 @@ void GaussianMapper::recordKeyframeRendered(
         torch::Tensor &rendered,
         torch::Tensor &ground_truth,
         unsigned long kfid,
+        int iteration,
         std::filesystem::path result_img_dir,
         std::filesystem::path result_gt_dir,
         std::filesystem::path result_loss_dir,
@@ -1499,14 +1808,14 @@ void GaussianMapper::recordKeyframeRendered(
         auto image_cv = tensor_utils::torchTensor2CvMat_Float32(rendered);
         cv::cvtColor(image_cv, image_cv, CV_RGB2BGR);
         image_cv.convertTo(image_cv, CV_8UC3, 255.0f);
-        cv::imwrite(result_img_dir / (std::to_string(getIteration()) + "_" + std::to_string(kfid) + name_suffix + ".jpg"), image_cv);
+        cv::imwrite(result_img_dir / (std::to_string(iteration) + "_" + std::to_string(kfid) + name_suffix + ".jpg"), image_cv);
     }
 
     if (record_ground_truth_image_) {
         auto gt_image_cv = tensor_utils::torchTensor2CvMat_Float32(ground_truth);
         cv::cvtColor(gt_image_cv, gt_image_cv, CV_RGB2BGR);
         gt_image_cv.convertTo(gt_image_cv, CV_8UC3, 255.0f);
-        cv::imwrite(result_gt_dir / (std::to_string(getIteration()) + "_" + std::to_string(kfid) + name_suffix + "_gt.jpg"), gt_image_cv);
+        cv::imwrite(result_gt_dir / (std::to_string(iteration) + "_" + std::to_string(kfid) + name_suffix + "_gt.jpg"), gt_image_cv);
     }
 
     if (record_loss_image_) {
@@ -1514,7 +1823,7 @@ void GaussianMapper::recordKeyframeRendered(
         auto loss_image_cv = tensor_utils::torchTensor2CvMat_Float32(loss_tensor);
         cv::cvtColor(loss_image_cv, loss_image_cv, CV_RGB2BGR);
         loss_image_cv.convertTo(loss_image_cv, CV_8UC3, 255.0f);
-        cv::imwrite(result_loss_dir / (std::to_string(getIteration()) + "_" + std::to_string(kfid) + name_suffix + "_loss.jpg"), loss_image_cv);
+        cv::imwrite(result_loss_dir / (std::to_string(iteration) + "_" + std::to_string(kfid) + name_suffix + "_loss.jpg"), loss_image_cv);
     }
 }
 
@@ -1524,9 +1833,13 @@ cv::Mat GaussianMapper::renderFromPose(
     const int height,
     const bool main_vision)
 {
-    if (!initial_mapped_ || getIteration() <= 0)
+    // Render from the latest snapshot so that training is never blocked
+    requestRenderSnapshot();
+    std::shared_ptr<const GaussianRenderSnapshot> snapshot = renderSnapshot();
+    if (!snapshot)
         return cv::Mat(height, width, CV_32FC3, cv::Vec3f(0.0f, 0.0f, 0.0f));
     std::shared_ptr<GaussianKeyframe> pkf = std::make_shared<GaussianKeyframe>();
+    pkf->device_type_ = device_type_;
     pkf->zfar_ = z_far_;
     pkf->znear_ = z_near_;
     // Pose
@@ -1544,20 +1857,17 @@ cv::Mat GaussianMapper::renderFromPose(
         throw std::runtime_error("[GaussianMapper::renderFromPose]KeyFrame Camera not found!");
     }
 
-    std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> render_pkg;
-    {
-        std::unique_lock<std::mutex> lock_render(mutex_render_);
-        // Render
-        render_pkg = GaussianRenderer::render(
-            pkf,
-            height,
-            width,
-            gaussians_,
-            pipe_params_,
-            background_,
-            override_color_
-        );
-    }
+    // Render
+    torch::NoGradGuard no_grad;
+    auto render_pkg = GaussianRenderer::render(
+        pkf,
+        height,
+        width,
+        snapshot->model_,
+        pipe_params_,
+        background_,
+        override_color_
+    );
 
     // Result
     torch::Tensor masked_image;
@@ -1568,7 +1878,72 @@ cv::Mat GaussianMapper::renderFromPose(
     return tensor_utils::torchTensor2CvMat_Float32(masked_image);
 }
 
+std::shared_ptr<const GaussianRenderSnapshot> GaussianMapper::renderSnapshot()
+{
+    return std::atomic_load(&render_snapshot_);
+}
+
+/**
+ * @brief Ask the training thread for a fresh snapshot, published within `render_snapshot_interval_` iterations
+ */
+void GaussianMapper::requestRenderSnapshot()
+{
+    render_snapshot_requested_ = true;
+}
+
+/**
+ * @brief Copy the model for the readers if one asked for it and the last copy is old enough.
+ *        Called on the training thread between optimizer steps. Readers keep the snapshot
+ *        they hold alive, so a new one never disturbs a render in progress.
+ */
+void GaussianMapper::publishRenderSnapshot()
+{
+    if (!initial_mapped_ || !render_snapshot_requested_)
+        return;
+    std::shared_ptr<const GaussianRenderSnapshot> last = std::atomic_load(&render_snapshot_);
+    if (last && getIteration() - last->iteration_ < render_snapshot_interval_)
+        return;
+    render_snapshot_requested_ = false;
+
+    // Both threads use the default stream, so readers are ordered after these copies
+    std::shared_ptr<GaussianRenderSnapshot> snapshot = std::make_shared<GaussianRenderSnapshot>();
+    snapshot->version_ = last ? last->version_ + 1 : 1;
+    snapshot->iteration_ = getIteration();
+    snapshot->model_ = gaussians_->renderSnapshot();
+    std::atomic_store(&render_snapshot_, std::shared_ptr<const GaussianRenderSnapshot>(std::move(snapshot)));
+}
+
+/**
+ * @brief Copy what the periodic saves read, on the training thread.
+ *        The keyframe copies are shallow, as poses and transform tensors are replaced rather than written in place.
+ */
+std::shared_ptr<GaussianRecordSnapshot> GaussianMapper::takeRecordSnapshot()
+{
+    std::shared_ptr<GaussianRecordSnapshot> snapshot = std::make_shared<GaussianRecordSnapshot>();
+    snapshot->iteration_ = getIteration();
+    snapshot->model_ = gaussians_->renderSnapshot();
+    if (chunk_pager_)
+        snapshot->model_->appendPagedChunks(*chunk_pager_);
+    for (auto& kfit : scene_->keyframes())
+        snapshot->keyframes_.emplace(kfit.first, std::make_shared<GaussianKeyframe>(*kfit.second));
+    snapshot->undistort_mask_ = undistort_mask_;
+
+    for (const auto& tensor : {snapshot->model_->xyz_, snapshot->model_->features_dc_, snapshot->model_->features_rest_,
+                         snapshot->model_->opacity_, snapshot->model_->scaling_, snapshot->model_->rotation_})
+        snapshot->num_bytes_ += tensor.numel() * tensor.element_size();
+    return snapshot;
+}
+
+/**
+ * @brief Block until the periodic saves submitted so far are on disk
+ */
+void GaussianMapper::waitForPersistence()
+{
+    persistence_writer_.wait();
+}
+
 void GaussianMapper::renderAndRecordKeyframe(
+    const GaussianRecordSnapshot &snapshot,
     std::shared_ptr<GaussianKeyframe> pkf,
     float &dssim,
     float &psnr,
@@ -1584,30 +1959,46 @@ void GaussianMapper::renderAndRecordKeyframe(
         pkf,
         pkf->image_height_,
         pkf->image_width_,
-        gaussians_,
+        snapshot.model_,
         pipe_params_,
         background_,
         override_color_
     );
     auto rendered_image = std::get<0>(render_pkg);
-    torch::Tensor masked_image = rendered_image * undistort_mask_[pkf->camera_id_];
-    torch::cuda::synchronize();
+    torch::Tensor masked_image = rendered_image * snapshot.undistort_mask_.at(pkf->camera_id_);
+    if (device_type_ == torch::kCUDA)
+        torch::cuda::synchronize();
     auto end_timing = std::chrono::steady_clock::now();
     auto render_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_timing - start_timing).count();
     render_time = 1e-6 * render_time_ns;
-    auto gt_image = pkf->original_image_;
+    auto gt_image = pkf->getOriginalImage(device_type_);
 
     dssim = loss_utils::ssim(masked_image, gt_image, device_type_).item().toFloat();
     psnr = loss_utils::psnr(masked_image, gt_image).item().toFloat();
     psnr_gs = loss_utils::psnr_gaussian_splatting(masked_image, gt_image).item().toFloat();
 
-    recordKeyframeRendered(masked_image, gt_image, pkf->fid_, result_img_dir, result_gt_dir, result_loss_dir, name_suffix);    
+    recordKeyframeRendered(masked_image, gt_image, pkf->fid_, snapshot.iteration_, result_img_dir, result_gt_dir, result_loss_dir, name_suffix);
 }
 
+/**
+ * @brief Render and evaluate every keyframe of this iteration on the persistence workers
+ */
 void GaussianMapper::renderAndRecordAllKeyframes(
     std::string name_suffix)
 {
-    std::filesystem::path result_dir = result_dir_ / (std::to_string(getIteration()) + name_suffix);
+    std::shared_ptr<GaussianRecordSnapshot> snapshot = takeRecordSnapshot();
+    persistence_writer_.submit(
+        "keyframe renders of iteration " + std::to_string(snapshot->iteration_) + name_suffix,
+        snapshot->num_bytes_,
+        [this, snapshot, name_suffix]() { writeAllKeyframesRecord(*snapshot, name_suffix); });
+}
+
+void GaussianMapper::writeAllKeyframesRecord(
+    const GaussianRecordSnapshot &snapshot,
+    std::string name_suffix)
+{
+    torch::NoGradGuard no_grad;
+    std::filesystem::path result_dir = result_dir_ / (std::to_string(snapshot.iteration_) + name_suffix);
     CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(result_dir)
 
     std::filesystem::path image_dir = result_dir / "image";
@@ -1639,39 +2030,257 @@ void GaussianMapper::renderAndRecordAllKeyframes(
     std::ofstream out_psnr_gs(psnr_gs_path);
     out_psnr_gs << "##[Gaussian Mapper]keyframe id, psnr_gaussian_splatting" << std::endl;
 
-    std::size_t nkfs = scene_->keyframes().size();
-    auto kfit = scene_->keyframes().begin();
     float dssim, psnr, psnr_gs;
     double render_time;
-    for (std::size_t i = 0; i < nkfs; ++i) {
-        renderAndRecordKeyframe((*kfit).second, dssim, psnr, psnr_gs, render_time, image_dir, image_gt_dir, image_loss_dir);
-        out_time << (*kfit).first << " " << std::fixed << std::setprecision(8) << render_time << std::endl;
-
-        out_dssim   << (*kfit).first << " " << std::fixed << std::setprecision(10) << dssim   << std::endl;
-        out_psnr    << (*kfit).first << " " << std::fixed << std::setprecision(10) << psnr    << std::endl;
-        out_psnr_gs << (*kfit).first << " " << std::fixed << std::setprecision(10) << psnr_gs << std::endl;
+    for (auto& kfit : snapshot.keyframes_) {
+        renderAndRecordKeyframe(snapshot, kfit.second, dssim, psnr, psnr_gs, render_time, image_dir, image_gt_dir, image_loss_dir);
+        out_time << kfit.first << " " << std::fixed << std::setprecision(8) << render_time << std::endl;
 
-        ++kfit;
+        out_dssim   << kfit.first << " " << std::fixed << std::setprecision(10) << dssim   << std::endl;
+        out_psnr    << kfit.first << " " << std::fixed << std::setprecision(10) << psnr    << std::endl;
+        out_psnr_gs << kfit.first << " " << std::fixed << std::setprecision(10) << psnr_gs << std::endl;
     }
 }
 
+/**
+ * @brief Export the model of this iteration on the persistence workers
+ */
 void GaussianMapper::savePly(std::filesystem::path result_dir)
+{
+    std::shared_ptr<GaussianRecordSnapshot> snapshot = takeRecordSnapshot();
+    persistence_writer_.submit(
+        result_dir.string(),
+        snapshot->num_bytes_,
+        [this, snapshot, result_dir]() { writePly(*snapshot, result_dir); });
+}
+
+void GaussianMapper::writePly(
+    const GaussianRecordSnapshot &snapshot,
+    std::filesystem::path result_dir)
 {
     CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(result_dir)
-    keyframesToJson(result_dir);
+    keyframesToJson(result_dir, snapshot.keyframes_);
     saveModelParams(result_dir);
 
     std::filesystem::path ply_dir = result_dir / "point_cloud";
     CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(ply_dir)
 
-    ply_dir = ply_dir / ("iteration_" + std::to_string(getIteration()));
+    ply_dir = ply_dir / ("iteration_" + std::to_string(snapshot.iteration_));
     CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(ply_dir)
 
-    gaussians_->savePly(ply_dir / "point_cloud.ply");
-    gaussians_->saveSparsePointsPly(result_dir / "input.ply");
+    snapshot.model_->savePly(ply_dir / "point_cloud.ply");
+    if (compressed_export_)
+        snapshot.model_->saveCompressed(ply_dir / "point_cloud.cgs", compression_options_);
+    snapshot.model_->saveSparsePointsPly(result_dir / "input.ply");
+}
+
+/**
+ * @brief Everything training needs to continue from this iteration,
+ *        copied on the training thread between iterations and written by the persistence workers
+ */
+void GaussianMapper::saveCheckpoint(std::filesystem::path checkpoint_path)
+{
+    CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(checkpoint_path.parent_path())
+
+    // With the Adam moments and statistics of the paged out points, read from disk so they stay paged out
+    GaussianCheckpoint checkpoint;
+    gaussians_->saveCheckpoint(checkpoint, chunk_pager_.get());
+    checkpoint.putInt("mapper/iteration", getIteration());
+    checkpoint.putInt("mapper/default_sh", default_sh_);
+    checkpoint.putFloat("mapper/ema_loss", ema_loss_for_log_);
+    checkpoint.putFloat("scene/cameras_extent", scene_->cameras_extent_);
+
+    // Keyframes
+    auto& keyframes = scene_->keyframes();
+    const std::int64_t num_kfs = keyframes.size();
+    const std::int64_t num_levels = kf_gaus_pyramid_times_of_use_.size();
+    torch::Tensor fids = torch::empty({num_kfs}, torch::kInt64);
+    torch::Tensor camera_ids = torch::empty({num_kfs}, torch::kInt64);
+    torch::Tensor poses = torch::empty({num_kfs, 7}, torch::kFloat64);
+    torch::Tensor remaining_times_of_use = torch::empty({num_kfs}, torch::kInt64);
+    torch::Tensor used_times = torch::empty({num_kfs}, torch::kInt64);
+    torch::Tensor pyramid_times_of_use = torch::zeros({num_kfs, num_levels}, torch::kInt32);
+    auto fids_a = fids.accessor<std::int64_t, 1>();
+    auto camera_ids_a = camera_ids.accessor<std::int64_t, 1>();
+    auto poses_a = poses.accessor<double, 2>();
+    auto remaining_a = remaining_times_of_use.accessor<std::int64_t, 1>();
+    auto used_a = used_times.accessor<std::int64_t, 1>();
+    auto pyramid_a = pyramid_times_of_use.accessor<int, 2>();
+    std::int64_t i = 0;
+    for (auto& kfit : keyframes) {
+        auto& pkf = kfit.second;
+        fids_a[i] = pkf->fid_;
+        camera_ids_a[i] = pkf->camera_id_;
+        poses_a[i][0] = pkf->R_quaternion_.w();
+        poses_a[i][1] = pkf->R_quaternion_.x();
+        poses_a[i][2] = pkf->R_quaternion_.y();
+        poses_a[i][3] = pkf->R_quaternion_.z();
+        poses_a[i][4] = pkf->t_.x();
+        poses_a[i][5] = pkf->t_.y();
+        poses_a[i][6] = pkf->t_.z();
+        remaining_a[i] = pkf->remaining_times_of_use_;
+        auto used_it = kfs_used_times_.find(pkf->fid_);
+        used_a[i] = (used_it == kfs_used_times_.end()) ? 0 : used_it->second;
+        for (std::int64_t l = 0; l < num_levels && l < static_cast<std::int64_t>(pkf->gaus_pyramid_times_of_use_.size()); ++l)
+            pyramid_a[i][l] = pkf->gaus_pyramid_times_of_use_[l];
+        ++i;
+    }
+    checkpoint.put("keyframes/fid", fids);
+    checkpoint.put("keyframes/camera_id", camera_ids);
+    checkpoint.put("keyframes/pose", poses);
+    checkpoint.put("keyframes/remaining_times_of_use", remaining_times_of_use);
+    checkpoint.put("keyframes/used_times", used_times);
+    checkpoint.put("keyframes/gaus_pyramid_times_of_use", pyramid_times_of_use);
+    checkpoint.putString("scene/keyframe_sampler", scene_->keyframe_sampler_.saveState());
+
+    // Random states
+    {
+        auto generator = at::detail::getDefaultCPUGenerator();
+        std::lock_guard<std::mutex> lock(generator.mutex());
+        checkpoint.put("rng/cpu", generator.get_state());
+    }
+    if (device_type_ == torch::kCUDA) {
+        auto generator = at::cuda::detail::getDefaultCUDAGenerator();
+        std::lock_guard<std::mutex> lock(generator.mutex());
+        checkpoint.put("rng/cuda", generator.get_state());
+    }
+
+    std::shared_ptr<GaussianCheckpoint> snapshot = std::make_shared<GaussianCheckpoint>(checkpoint.snapshot());
+    persistence_writer_.submit(
+        checkpoint_path.string(),
+        snapshot->numBytes(),
+        [snapshot, checkpoint_path]() { snapshot->save(checkpoint_path); });
 }
 
-void GaussianMapper::keyframesToJson(std::filesystem::path result_dir)
+/**
+ * @brief Continue training from a checkpoint instead of the initial point cloud,
+ *        keyframe states are restored for the keyframes already in the scene
+ */
+void GaussianMapper::loadCheckpoint(std::filesystem::path checkpoint_path)
+{
+    GaussianCheckpoint checkpoint = GaussianCheckpoint::load(checkpoint_path);
+    {
+        std::unique_lock<std::mutex> lock_render(mutex_render_);
+        std::unique_lock<std::mutex> lock(mutex_settings_);
+        gaussians_->loadCheckpoint(checkpoint, opt_params_);
+    }
+    {
+        std::unique_lock<std::mutex> lock_status(mutex_status_);
+        iteration_ = checkpoint.getInt("mapper/iteration");
+    }
+    default_sh_ = checkpoint.getInt("mapper/default_sh");
+    ema_loss_for_log_ = checkpoint.getFloat("mapper/ema_loss");
+    scene_->cameras_extent_ = checkpoint.getFloat("scene/cameras_extent");
+
+    // Keyframes
+    torch::Tensor fids = checkpoint.get("keyframes/fid");
+    torch::Tensor poses = checkpoint.get("keyframes/pose");
+    torch::Tensor remaining_times_of_use = checkpoint.get("keyframes/remaining_times_of_use");
+    torch::Tensor used_times = checkpoint.get("keyframes/used_times");
+    torch::Tensor pyramid_times_of_use = checkpoint.get("keyframes/gaus_pyramid_times_of_use");
+    auto fids_a = fids.accessor<std::int64_t, 1>();
+    auto poses_a = poses.accessor<double, 2>();
+    auto remaining_a = remaining_times_of_use.accessor<std::int64_t, 1>();
+    auto used_a = used_times.accessor<std::int64_t, 1>();
+    auto pyramid_a = pyramid_times_of_use.accessor<int, 2>();
+    bool same_keyframes = (fids.size(0) == static_cast<std::int64_t>(scene_->keyframes().size()));
+    for (std::int64_t i = 0; i < fids.size(0); ++i) {
+        std::size_t fid = fids_a[i];
+        auto pkf = scene_->getKeyframe(fid);
+        if (!pkf) {
+            same_keyframes = false;
+            continue;
+        }
+        pkf->setPose(
+            poses_a[i][0], poses_a[i][1], poses_a[i][2], poses_a[i][3],
+            poses_a[i][4], poses_a[i][5], poses_a[i][6]);
+        pkf->computeTransformTensors();
+        pkf->remaining_times_of_use_ = remaining_a[i];
+        for (std::int64_t l = 0; l < pyramid_times_of_use.size(1) && l < static_cast<std::int64_t>(pkf->gaus_pyramid_times_of_use_.size()); ++l)
+            pkf->gaus_pyramid_times_of_use_[l] = pyramid_a[i][l];
+        kfs_used_times_[fid] = used_a[i];
+    }
+    if (!same_keyframes || !scene_->keyframe_sampler_.loadState(checkpoint.getString("scene/keyframe_sampler"))) {
+        std::cout << "[Gaussian Mapper]Keyframes differ from the checkpoint, keyframe sampling restarts" << std::endl;
+        scene_->keyframe_sampler_.increaseAllTimesOfUse(0);
+    }
+
+    // Random states
+    if (checkpoint.has("rng/cpu")) {
+        auto generator = at::detail::getDefaultCPUGenerator();
+        std::lock_guard<std::mutex> lock(generator.mutex());
+        generator.set_state(checkpoint.get("rng/cpu").clone());
+    }
+    if (device_type_ == torch::kCUDA && checkpoint.has("rng/cuda")) {
+        auto generator = at::cuda::detail::getDefaultCUDAGenerator();
+        std::lock_guard<std::mutex> lock(generator.mutex());
+        generator.set_state(checkpoint.get("rng/cuda").clone());
+    }
+
+    std::cout << "[Gaussian Mapper]Resumed from " << checkpoint_path
+              << " at iteration " << getIteration() << std::endl;
+}
+
+/**
+ * @brief Append what changed since the last delta checkpoint to result_dir/delta
+ */
+void GaussianMapper::saveDeltaCheckpoint()
+{
+    if (!delta_log_)
+        delta_log_ = std::make_unique<GaussianDeltaLog>(result_dir_ / "delta", delta_rebase_interval_);
+    std::shared_ptr<GaussianRecordSnapshot> snapshot = takeRecordSnapshot();
+    std::uint64_t ticket = delta_log_->reserve();
+    persistence_writer_.submit(
+        "delta checkpoint of iteration " + std::to_string(snapshot->iteration_),
+        snapshot->num_bytes_,
+        [this, snapshot, ticket]() {
+            delta_log_->append(ticket, [snapshot]() { return deltaStateOf(*snapshot); });
+        });
+}
+
+GaussianDeltaState GaussianMapper::deltaStateOf(const GaussianRecordSnapshot &snapshot)
+{
+    GaussianDeltaState state;
+    state.iteration_ = snapshot.iteration_;
+    state.active_sh_degree_ = snapshot.model_->active_sh_degree_;
+    state.ids_ = snapshot.model_->gaussian_ids_.to(torch::kCPU);
+    // The rest SH coefficients at full width, so the rows of every delta line up
+    for (const auto& param : {snapshot.model_->xyz_, snapshot.model_->features_dc_, snapshot.model_->fullFeaturesRest(),
+                        snapshot.model_->opacity_, snapshot.model_->scaling_, snapshot.model_->rotation_})
+        state.params_.emplace_back(param.to(torch::kCPU));
+    for (auto& kfit : snapshot.keyframes_) {
+        auto& pkf = kfit.second;
+        state.poses_[kfit.first] = {
+            pkf->R_quaternion_.w(), pkf->R_quaternion_.x(), pkf->R_quaternion_.y(), pkf->R_quaternion_.z(),
+            pkf->t_.x(), pkf->t_.y(), pkf->t_.z()};
+    }
+    return state;
+}
+
+/**
+ * @brief View the model replayed from a delta checkpoint log at `iteration`, -1 for the last save
+ */
+void GaussianMapper::loadDeltaCheckpoint(
+    std::filesystem::path delta_dir,
+    int iteration,
+    std::filesystem::path camera_path)
+{
+    GaussianDeltaState state = GaussianDeltaLog::replay(delta_dir, iteration);
+    this->gaussians_->loadDeltaState(state);
+    std::cout << "[Gaussian Mapper]Replayed " << delta_dir << " to iteration " << state.iteration_
+              << ", " << state.ids_.size(0) << " Gaussians" << std::endl;
+    loadViewerCamera(camera_path);
+
+    // Ready
+    this->initial_mapped_ = true;
+    increaseIteration();
+    requestRenderSnapshot();
+    publishRenderSnapshot();
+}
+
+void GaussianMapper::keyframesToJson(
+    std::filesystem::path result_dir,
+    const std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> &keyframes)
 {
     CHECK_DIRECTORY_AND_CREATE_IF_NOT_EXISTS(result_dir)
 
@@ -1686,7 +2295,7 @@ void GaussianMapper::keyframesToJson(std::filesystem::path result_dir)
     const std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
 
     int i = 0;
-    for (const auto& kfit : scene_->keyframes()) {
+    for (const auto& kfit : keyframes) {
         const auto pkf = kfit.second;
         Eigen::Matrix4f Rt;
         Rt.setZero();
@@ -1833,6 +2442,16 @@ int GaussianMapper::densifyInterval()
     std::unique_lock<std::mutex> lock(mutex_settings_);
     return opt_params_.densification_interval_;
 }
+int GaussianMapper::batchSize()
+{
+    std::unique_lock<std::mutex> lock(mutex_settings_);
+    return opt_params_.batch_size_;
+}
+float GaussianMapper::imagesPerSecond()
+{
+    std::unique_lock<std::mutex> lock(mutex_status_);
+    return images_per_second_;
+}
 int GaussianMapper::newKeyframeTimesOfUse()
 {
     std::unique_lock<std::mutex> lock(mutex_settings_);
@@ -1910,6 +2529,11 @@ void GaussianMapper::setDensifyInterval(const int interval)
     std::unique_lock<std::mutex> lock(mutex_settings_);
     opt_params_.densification_interval_ = interval;
 }
+void GaussianMapper::setBatchSize(const int batch_size)
+{
+    std::unique_lock<std::mutex> lock(mutex_settings_);
+    opt_params_.batch_size_ = batch_size;
+}
 void GaussianMapper::setNewKeyframeTimesOfUse(const int times)
 {
     std::unique_lock<std::mutex> lock(mutex_settings_);
@@ -1982,7 +2606,29 @@ void GaussianMapper::setVaribleParameters(const VariableParameters &params)
 void GaussianMapper::loadPly(std::filesystem::path ply_path, std::filesystem::path camera_path)
 {
     this->gaussians_->loadPly(ply_path);
+    loadViewerCamera(camera_path);
+
+    // Ready
+    this->initial_mapped_ = true;
+    increaseIteration();
+    requestRenderSnapshot();
+    publishRenderSnapshot();
+}
 
+void GaussianMapper::loadCompressed(std::filesystem::path compressed_path, std::filesystem::path camera_path)
+{
+    this->gaussians_->loadCompressed(compressed_path);
+    loadViewerCamera(camera_path);
+
+    // Ready
+    this->initial_mapped_ = true;
+    increaseIteration();
+    requestRenderSnapshot();
+    publishRenderSnapshot();
+}
+
+void GaussianMapper::loadViewerCamera(std::filesystem::path camera_path)
+{
     // Camera
     if (!camera_path.empty() && std::filesystem::exists(camera_path)) {
         cv::FileStorage camera_file(camera_path.string().c_str(), cv::FileStorage::READ);
@@ -2049,8 +2695,4 @@ void GaussianMapper::loadPly(std::filesystem::path ply_path, std::filesystem::pa
         }
         this->scene_->addCamera(camera);
     }
-
-    // Ready
-    this->initial_mapped_ = true;
-    increaseIteration();
 }
\ No newline at end of file
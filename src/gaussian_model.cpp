@@ -47,11 +47,15 @@ GaussianModel::GaussianModel(const GaussianModelParams &model_params)
 
 torch::Tensor GaussianModel::getScalingActivation()
 {
+    if (this->compressed_)
+        return torch::exp(this->compressed_->scaling());
     return torch::exp(this->scaling_);
 }
 
 torch::Tensor GaussianModel::getRotationActivation()
 {
+    if (this->compressed_)
+        return torch::nn::functional::normalize(this->compressed_->rotation());
     return torch::nn::functional::normalize(this->rotation_);
 }
 
@@ -62,18 +66,38 @@ torch::Tensor GaussianModel::getXYZ()
 
 torch::Tensor GaussianModel::getFeatures()
 {
-    return torch::cat({this->features_dc_.clone(), this->features_rest_.clone()}, /*dim=*/1);
+    if (this->compressed_)
+        return this->compressed_->features();
+    // cat already returns a new tensor
+    return torch::cat({this->features_dc_, this->features_rest_}, /*dim=*/1);
+}
+
+/**
+ * @brief The rest SH coefficients padded with zeros to `max_sh_degree_`, for the file formats
+ */
+torch::Tensor GaussianModel::fullFeaturesRest()
+{
+    const std::int64_t num_rest = (this->max_sh_degree_ + 1) * (this->max_sh_degree_ + 1) - 1;
+    torch::Tensor features_rest = this->features_rest_.detach();
+    if (features_rest.size(1) >= num_rest)
+        return features_rest;
+    return torch::cat({
+        features_rest,
+        torch::zeros({features_rest.size(0), num_rest - features_rest.size(1), 3}, features_rest.options())},
+        /*dim=*/1);
 }
 
 torch::Tensor GaussianModel::getOpacityActivation()
 {
+    if (this->compressed_)
+        return torch::sigmoid(this->compressed_->opacity());
     return torch::sigmoid(this->opacity_);
 }
 
 torch::Tensor GaussianModel::getCovarianceActivation(int scaling_modifier)
 {
     // build_rotation
-    auto r = this->rotation_;
+    auto r = this->compressed_ ? this->compressed_->rotation() : this->rotation_;
     auto R = general_utils::build_rotation(r);
 
     // build_scaling_rotation(scaling_modifier * scaling(Activation), rotation(_))
@@ -100,15 +124,82 @@ torch::Tensor GaussianModel::getCovarianceActivation(int scaling_modifier)
     return symm_uncertainty;
 }
 
+/**
+ * @brief Detached copy of the parameters used for rendering, which training never writes to
+ */
+std::shared_ptr<GaussianModel> GaussianModel::renderSnapshot()
+{
+    torch::NoGradGuard no_grad;
+    std::shared_ptr<GaussianModel> snapshot = std::make_shared<GaussianModel>(this->max_sh_degree_);
+    snapshot->device_type_ = this->device_type_;
+    snapshot->active_sh_degree_ = this->active_sh_degree_;
+    if (this->compressed_) {
+        // Never written after loading
+        snapshot->compressed_ = this->compressed_;
+        snapshot->xyz_ = this->xyz_;
+        return snapshot;
+    }
+    snapshot->xyz_ = this->xyz_.detach().clone();
+    snapshot->features_dc_ = this->features_dc_.detach().clone();
+    snapshot->features_rest_ = this->features_rest_.detach().clone();
+    snapshot->opacity_ = this->opacity_.detach().clone();
+    snapshot->scaling_ = this->scaling_.detach().clone();
+    snapshot->rotation_ = this->rotation_.detach().clone();
+    if (this->gaussian_ids_.defined())
+        snapshot->gaussian_ids_ = this->gaussian_ids_.clone();
+    // The sparse points are only ever replaced, never written in place
+    snapshot->sparse_points_xyz_ = this->sparse_points_xyz_;
+    snapshot->sparse_points_color_ = this->sparse_points_color_;
+    return snapshot;
+}
+
 void GaussianModel::oneUpShDegree()
 {
     if (this->active_sh_degree_ < this->max_sh_degree_)
         this->active_sh_degree_ += 1;
+    growShBands();
 }
 
 void GaussianModel::setShDegree(const int sh)
 {
     this->active_sh_degree_ = (sh > this->max_sh_degree_ ? this->max_sh_degree_ : sh);
+    growShBands();
+}
+
+/**
+ * @brief Number of rest SH coefficients per point in features_rest_
+ */
+std::int64_t GaussianModel::storedRestCoefficients()
+{
+    if (this->features_rest_.defined() && this->features_rest_.dim() == 3)
+        return this->features_rest_.size(1);
+    return (this->active_sh_degree_ + 1) * (this->active_sh_degree_ + 1) - 1;
+}
+
+/**
+ * @brief Allocate the SH bands up to the active degree, with zero coefficients and moments
+ */
+void GaussianModel::growShBands()
+{
+    torch::NoGradGuard no_grad;
+    const std::int64_t num_rest = (this->active_sh_degree_ + 1) * (this->active_sh_degree_ + 1) - 1;
+    if (this->compressed_ || storedRestCoefficients() >= num_rest)
+        return;
+
+    if (param_store_.numColumns() == 0) {
+        // Not training
+        this->features_rest_ = torch::cat({
+            this->features_rest_.detach(),
+            torch::zeros({this->features_rest_.size(0), num_rest - storedRestCoefficients(), 3},
+                         this->features_rest_.options())},
+            /*dim=*/1);
+        this->Tensor_vec_feature_rest_ = {this->features_rest_};
+        return;
+    }
+    param_store_.resizeColumn(STORE_PARAMS + 2, /*dim=*/1, num_rest);
+    param_store_.resizeColumn(STORE_EXP_AVG + 2, /*dim=*/1, num_rest);
+    param_store_.resizeColumn(STORE_EXP_AVG_SQ + 2, /*dim=*/1, num_rest);
+    bindParameterStore();
 }
 
 void GaussianModel::createFromPcd(
@@ -136,9 +227,10 @@ void GaussianModel::createFromPcd(
     }
 
     torch::Tensor fused_color = sh_utils::RGB2SH(color);
-    auto temp = this->max_sh_degree_ + 1;
+    // Only the active SH bands are stored, see growShBands()
+    auto num_coeffs = 1 + storedRestCoefficients();
     torch::Tensor features = torch::zeros(
-        {fused_color.size(0), 3, temp * temp},
+        {fused_color.size(0), 3, num_coeffs},
         torch::TensorOptions().dtype(torch::kFloat).device(device_type_));
     features.index(
         {torch::indexing::Slice(),
@@ -152,7 +244,7 @@ void GaussianModel::createFromPcd(
     // std::cout << "[Gaussian Model]Number of points at initialization : " << fused_point_cloud.size(0) << std::endl;
 
     torch::Tensor point_cloud_copy = fused_point_cloud.clone();
-    torch::Tensor dist2 = torch::clamp_min(distCUDA2(point_cloud_copy), 0.0000001);
+    torch::Tensor dist2 = torch::clamp_min(knnMeanDist2(point_cloud_copy), 0.0000001);
     torch::Tensor scales = torch::log(torch::sqrt(dist2));
     auto scales_ndimension = scales.ndimension();
     scales = scales.unsqueeze(scales_ndimension).repeat({1, 3});
@@ -192,122 +284,42 @@ void GaussianModel::createFromPcd(
 
 void GaussianModel::increasePcd(std::vector<float> points, std::vector<float> colors, const int iteration)
 {
-// auto time1 = std::chrono::steady_clock::now();
     assert(points.size() == colors.size());
     assert(points.size() % 3 == 0);
-    auto num_new_points = static_cast<int>(points.size() / 3);
-    if (num_new_points == 0)
+    if (points.empty())
         return;
 
-    torch::Tensor new_point_cloud = torch::from_blob(
-        points.data(), {num_new_points, 3},
-        torch::TensorOptions().dtype(torch::kFloat32)).to(device_type_);
-        // torch::zeros({num_new_points, 3}, xyz_.options());
-    torch::Tensor new_colors = torch::from_blob(
-        colors.data(), {num_new_points, 3},
-        torch::TensorOptions().dtype(torch::kFloat32)).to(device_type_);
-        // torch::zeros({num_new_points, 3}, xyz_.options());
-
-    if (sparse_points_xyz_.size(0) == 0) {
-        sparse_points_xyz_ = new_point_cloud;
-        sparse_points_color_ = new_colors;
-    }
-    else {
-        sparse_points_xyz_ = torch::cat({sparse_points_xyz_, new_point_cloud}, /*dim=*/0);
-        sparse_points_color_ = torch::cat({sparse_points_color_, new_colors}, /*dim=*/0);
-    }
-
-    torch::Tensor new_fused_colors = sh_utils::RGB2SH(new_colors);
-    auto temp = this->max_sh_degree_ + 1;
-    torch::Tensor features = torch::zeros(
-        {new_fused_colors.size(0), 3, temp * temp},
-        torch::TensorOptions().dtype(torch::kFloat).device(device_type_));
-    features.index(
-        {torch::indexing::Slice(),
-         torch::indexing::Slice(0, 3),
-         0}) = new_fused_colors;
-    features.index(
-        {torch::indexing::Slice(),
-         torch::indexing::Slice(3, features.size(1)),
-         torch::indexing::Slice(1, features.size(2))}) = 0.0f;
-
-    // std::cout << "[Gaussian Model]Number of points increase : "
-    //           << num_new_points << std::endl;
-
-    torch::Tensor dist2 = torch::clamp_min(
-        distCUDA2(new_point_cloud.clone()), 0.0000001);
-    torch::Tensor scales = torch::log(torch::sqrt(dist2));
-    auto scales_ndimension = scales.ndimension();
-    scales = scales.unsqueeze(scales_ndimension).repeat({1, 3});
-    torch::Tensor rots = torch::zeros(
-        {new_point_cloud.size(0), 4},
-         torch::TensorOptions().device(device_type_));
-    rots.index({torch::indexing::Slice(), 0}) = 1;
-    torch::Tensor opacities = general_utils::inverse_sigmoid(
-        0.1f * torch::ones(
-                   {new_point_cloud.size(0), 1},
-                   torch::TensorOptions().dtype(torch::kFloat).device(device_type_)));
-
-    torch::Tensor new_exist_since_iter = torch::full(
-        {new_point_cloud.size(0)},
-        iteration,
-        torch::TensorOptions().dtype(torch::kInt32).device(device_type_));
-
-    auto new_xyz = new_point_cloud;
-    auto new_features_dc = features.index({torch::indexing::Slice(),
-                                                    torch::indexing::Slice(),
-                                                    torch::indexing::Slice(0, 1)})
-                                        .transpose(1, 2)
-                                        .contiguous();
-    auto new_features_rest = features.index({torch::indexing::Slice(),
-                                                      torch::indexing::Slice(),
-                                                      torch::indexing::Slice(1, features.size(2))})
-                                          .transpose(1, 2)
-                                          .contiguous();
-    auto new_opacities = opacities;
-    auto new_scaling = scales;
-    auto new_rotation = rots;
-
-// auto time2 = std::chrono::steady_clock::now();
-// auto time = std::chrono::duration_cast<std::chrono::milliseconds>(time2-time1).count();
-// std::cout << "increasePcd(umap) preparation time: " << time << " ms" <<std::endl;
-
-    densificationPostfix(
-        new_xyz,
-        new_features_dc,
-        new_features_rest,
-        new_opacities,
-        new_scaling,
-        new_rotation,
-        new_exist_since_iter
-    );
-
-    c10::cuda::CUDACachingAllocator::emptyCache();
-// auto time3 = std::chrono::steady_clock::now();
-// time = std::chrono::duration_cast<std::chrono::milliseconds>(time3-time2).count();
-// std::cout << "increasePcd(umap) postfix time: " << time << " ms" <<std::endl;
+    torch::Tensor new_point_cloud = torch::tensor(points, torch::TensorOptions().dtype(torch::kFloat32))
+                                        .view({-1, 3}).to(device_type_);
+    torch::Tensor new_colors = torch::tensor(colors, torch::TensorOptions().dtype(torch::kFloat32))
+                                   .view({-1, 3}).to(device_type_);
+    increasePcd(new_point_cloud, new_colors, iteration);
 }
 
-void GaussianModel::increasePcd(torch::Tensor& new_point_cloud, torch::Tensor& new_colors, const int iteration)
+void GaussianModel::increasePcd(torch::Tensor& candidate_xyz, torch::Tensor& candidate_colors, const int iteration)
 {
 // auto time1 = std::chrono::steady_clock::now();
+    torch::Tensor new_point_cloud = candidate_xyz.detach();
+    torch::Tensor new_colors = candidate_colors.detach();
     auto num_new_points = new_point_cloud.size(0);
     if (num_new_points == 0)
         return;
 
-    if (sparse_points_xyz_.size(0) == 0) {
-        sparse_points_xyz_ = new_point_cloud;
-        sparse_points_color_ = new_colors;
-    }
-    else {
-        sparse_points_xyz_ = torch::cat({sparse_points_xyz_, new_point_cloud}, /*dim=*/0);
-        sparse_points_color_ = torch::cat({sparse_points_color_, new_colors}, /*dim=*/0);
+    insertion_stats_.num_candidates_ += num_new_points;
+    if (insertion_voxel_size_ > 0.0f) {
+        suppressDuplicates(new_point_cloud, new_colors);
+        num_new_points = new_point_cloud.size(0);
+        if (num_new_points == 0)
+            return;
     }
+    insertion_stats_.num_accepted_ += num_new_points;
+    appendSparsePoints(new_point_cloud, new_colors);
 
     torch::Tensor new_fused_colors = sh_utils::RGB2SH(new_colors);
-    auto temp = this->max_sh_degree_ + 1;
+    // Only the active SH bands are stored, see growShBands()
+    auto num_coeffs = 1 + storedRestCoefficients();
     torch::Tensor features = torch::zeros(
-        {new_fused_colors.size(0), 3, temp * temp},
+        {new_fused_colors.size(0), 3, num_coeffs},
         torch::TensorOptions().dtype(torch::kFloat).device(device_type_));
     features.index(
         {torch::indexing::Slice(),
@@ -321,8 +333,10 @@ void GaussianModel::increasePcd(torch::Tensor& new_point_cloud, torch::Tensor& n
     // std::cout << "[Gaussian Model]Number of points increase : "
     //           << num_new_points << std::endl;
 
+    // The existing Gaussians around a sparse batch are its nearest neighbors as well
     torch::Tensor dist2 = torch::clamp_min(
-        distCUDA2(new_point_cloud.clone()), 0.0000001);
+        knnMeanDist2(torch::cat({new_point_cloud, meansAround(new_point_cloud)}, /*dim=*/0), num_new_points),
+        0.0000001);
     torch::Tensor scales = torch::log(torch::sqrt(dist2));
     auto scales_ndimension = scales.ndimension();
     scales = scales.unsqueeze(scales_ndimension).repeat({1, 3});
@@ -369,13 +383,84 @@ void GaussianModel::increasePcd(torch::Tensor& new_point_cloud, torch::Tensor& n
         new_exist_since_iter
     );
 
-    c10::cuda::CUDACachingAllocator::emptyCache();
-
 // auto time3 = std::chrono::steady_clock::now();
 // time = std::chrono::duration_cast<std::chrono::milliseconds>(time3-time2).count();
 // std::cout << "increasePcd(tensor) postfix time: " << time << " ms" <<std::endl;
 }
 
+void GaussianModel::setInsertionVoxelSize(const float voxel_size)
+{
+    insertion_voxel_size_ = std::max(0.0f, voxel_size);
+    if (insertion_voxel_size_ > 0.0f)
+        occupancy_grid_.setVoxelSize(insertion_voxel_size_);
+}
+
+/**
+ * @brief Drop the candidates whose voxel already holds a Gaussian,
+ *        and average those sharing a free voxel into one point
+ */
+void GaussianModel::suppressDuplicates(torch::Tensor& new_point_cloud, torch::Tensor& new_colors)
+{
+    torch::NoGradGuard no_grad;
+    auto sorted = occupancy_grid_.keysOf(new_point_cloud).sort();
+    torch::Tensor order = std::get<1>(sorted);
+    auto cells = torch::unique_consecutive(std::get<0>(sorted), /*return_inverse=*/true, /*return_counts=*/true);
+    torch::Tensor cell_keys = std::get<0>(cells);
+    torch::Tensor cell_of_sorted = std::get<1>(cells);
+    torch::Tensor cell_counts = std::get<2>(cells);
+    auto num_cells = cell_keys.size(0);
+
+    // Keyed from the current means, which densification and the optimizer keep moving,
+    // and looked up among the candidate cells rather than sorting all of them
+    torch::Tensor is_free = torch::ones({num_cells}, cell_keys.options().dtype(torch::kBool));
+    if (num_cells > 0 && this->xyz_.size(0) > 0) {
+        torch::Tensor keys = occupancy_grid_.keysOf(this->xyz_);
+        torch::Tensor pos = torch::searchsorted(cell_keys, keys).clamp_max(num_cells - 1);
+        torch::Tensor hit = cell_keys.index_select(0, pos) == keys;
+        is_free.index_fill_(0, pos.masked_select(hit), false);
+    }
+
+    torch::Tensor weights = cell_counts.to(torch::kFloat).unsqueeze(1);
+    torch::Tensor cell_xyz = torch::zeros({num_cells, 3}, new_point_cloud.options())
+                                 .index_add_(0, cell_of_sorted, new_point_cloud.index_select(0, order)) / weights;
+    torch::Tensor cell_colors = torch::zeros({num_cells, 3}, new_colors.options())
+                                    .index_add_(0, cell_of_sorted, new_colors.index_select(0, order)) / weights;
+
+    auto num_candidates = new_point_cloud.size(0);
+    auto num_in_free_cells = cell_counts.masked_select(is_free).sum().item<std::int64_t>();
+    new_point_cloud = cell_xyz.index({is_free});
+    new_colors = cell_colors.index({is_free});
+    insertion_stats_.num_occupied_ += num_candidates - num_in_free_cells;
+    insertion_stats_.num_merged_ += num_in_free_cells - new_point_cloud.size(0);
+}
+
+/**
+ * @brief Means of the Gaussians in the spatial index cells holding `points` and the ring around them,
+ *        a batch spread over the scene does not pull in everything between its points
+ */
+torch::Tensor GaussianModel::meansAround(const torch::Tensor& points)
+{
+    torch::NoGradGuard no_grad;
+    if (this->xyz_.size(0) == 0 || points.size(0) == 0)
+        return torch::empty({0, 3}, points.options());
+    refreshSpatialIndex();
+    torch::Tensor rows = spatial_index_.queryNeighborCells(spatial_index_.keysOf(points), this->xyz_.size(0));
+    return this->xyz_.detach().index_select(0, rows);
+}
+
+/**
+ * @brief Grow the sparse points in place, see GaussianParameterStore
+ */
+void GaussianModel::appendSparsePoints(const torch::Tensor& new_point_cloud, const torch::Tensor& new_colors)
+{
+    if (sparse_store_.numColumns() == 0)
+        sparse_store_.reset({new_point_cloud, new_colors});
+    else
+        sparse_store_.append({new_point_cloud, new_colors});
+    sparse_points_xyz_ = sparse_store_.column(0);
+    sparse_points_color_ = sparse_store_.column(1);
+}
+
 void GaussianModel::applyScaledTransformation(
     const float s,
     const Sophus::SE3f T)
@@ -411,96 +496,212 @@ void GaussianModel::scaledTransformationPostfix(
 
     this->Tensor_vec_xyz_ = {this->xyz_};
     this->Tensor_vec_scaling_ = {this->scaling_};
+
+    spatial_index_.invalidate();
 }
 
-void GaussianModel::scaledTransformVisiblePointsOfKeyframe(
-    torch::Tensor& point_not_transformed_flags,
-    torch::Tensor& diff_pose,
-    torch::Tensor& kf_world_view_transform,
-    torch::Tensor& kf_full_proj_transform,
-    const int kf_creation_iter,
+/**
+ * @brief Apply the pose corrections of the loop keyframes in one pass.
+ *
+ * Each unstable point in front of a corrected keyframe is governed by the first
+ * such keyframe in `corrections`, as if the keyframes were handled one by one
+ * and transformed points were skipped afterwards. Only the moved rows are
+ * written and only their Adam moments are restarted.
+ *
+ * @return the number of transformed points
+ */
+int GaussianModel::applyLoopCorrections(
+    const std::vector<GaussianLoopCorrection>& corrections,
     const int stable_num_iter_existence,
-    int& num_transformed,
     const float scale)
 {
     torch::NoGradGuard no_grad;
-
-    torch::Tensor points = this->getXYZ();
-    torch::Tensor rots = this->getRotationActivation();
-    // torch::Tensor scales = this->scaling_;// * scale;
-
-    torch::Tensor point_unstable_flags = torch::where(
-        torch::abs(this->exist_since_iter_ - kf_creation_iter) < stable_num_iter_existence,
-        true,
-        false);
-
-    scaleAndTransformThenMarkVisiblePoints(
-        points,
-        rots,
-        point_not_transformed_flags,
-        point_unstable_flags,
-        diff_pose,
-        kf_world_view_transform,
-        kf_full_proj_transform,
-        num_transformed,
-        scale
-    );
-
-// torch::Tensor point_cloud_copy = points.clone();
-// torch::Tensor dist2 = torch::clamp_min(distCUDA2(point_cloud_copy), 0.0000001);
-// torch::Tensor scales = torch::log(torch::sqrt(dist2));
-// auto scales_ndimension = scales.ndimension();
-// scales = scales.unsqueeze(scales_ndimension).repeat({1, 3});
-
-    // Postfix
+    const std::int64_t num_corrections = corrections.size();
+    if (num_corrections == 0)
+        return 0;
+    refreshSpatialIndex();
+
+    // Governing keyframe of every point, `num_corrections` for none;
+    // filled from the last keyframe so that the first one wins
+    auto long_options = torch::TensorOptions().dtype(torch::kLong).device(device_type_);
+    torch::Tensor governing = torch::full({this->xyz_.size(0)}, num_corrections, long_options);
+    for (std::int64_t k = num_corrections - 1; k >= 0; --k) {
+        auto& correction = corrections[k];
+        torch::Tensor view = correction.world_view_transform_.to(device_type_, torch::kFloat);
+        torch::Tensor rows = spatial_index_.queryFrustum(view, 0.2f, correction.num_points_);
+        // Same test as in_frustum() of the rasterizer
+        torch::Tensor z = this->xyz_.index_select(0, rows).matmul(view.index({torch::indexing::Slice(0, 3), 2}))
+                          + view.index({3, 2});
+        torch::Tensor unstable =
+            torch::abs(this->exist_since_iter_.index_select(0, rows) - correction.creation_iter_)
+            < stable_num_iter_existence;
+        governing.index_fill_(0, rows.masked_select(torch::logical_and(z > 0.2f, unstable)), k);
+    }
+    torch::Tensor moved_rows = (governing < num_corrections).nonzero().squeeze(1);
+    const std::int64_t num_moved = moved_rows.size(0);
+    if (num_moved == 0)
+        return 0;
+    torch::Tensor kf_of_row = governing.index_select(0, moved_rows);
+
+    // Per keyframe rotation, translation and rotation quaternion (w, x, y, z)
+    std::vector<float> rotations, translations, quaternions;
+    for (auto& correction : corrections) {
+        Eigen::Matrix<float, 3, 3, Eigen::RowMajor> R = correction.diff_pose_.rotationMatrix();
+        Eigen::Vector3f t = correction.diff_pose_.translation();
+        Eigen::Quaternionf q = correction.diff_pose_.unit_quaternion();
+        rotations.insert(rotations.end(), R.data(), R.data() + 9);
+        translations.insert(translations.end(), t.data(), t.data() + 3);
+        quaternions.insert(quaternions.end(), {q.w(), q.x(), q.y(), q.z()});
+    }
+    torch::Tensor R = torch::tensor(rotations).view({num_corrections, 3, 3}).to(device_type_).index_select(0, kf_of_row);
+    torch::Tensor t = torch::tensor(translations).view({num_corrections, 3}).to(device_type_).index_select(0, kf_of_row);
+    torch::Tensor q = torch::tensor(quaternions).view({num_corrections, 4}).to(device_type_).index_select(0, kf_of_row);
+
+    // p <- R * (s * p) + t
+    torch::Tensor points = this->xyz_.index_select(0, moved_rows) * scale;
+    points = R.bmm(points.unsqueeze(2)).squeeze(2) + t;
+
+    // q <- q_diff * q
+    torch::Tensor rots = torch::nn::functional::normalize(this->rotation_.index_select(0, moved_rows));
+    auto w1 = q.select(1, 0), x1 = q.select(1, 1), y1 = q.select(1, 2), z1 = q.select(1, 3);
+    auto w2 = rots.select(1, 0), x2 = rots.select(1, 1), y2 = rots.select(1, 2), z2 = rots.select(1, 3);
+    rots = torch::stack({
+        w1 * w2 - x1 * x2 - y1 * y2 - z1 * z2,
+        w1 * x2 + x1 * w2 + y1 * z2 - z1 * y2,
+        w1 * y2 - x1 * z2 + y1 * w2 + z1 * x2,
+        w1 * z2 + x1 * y2 - y1 * x2 + z1 * w2}, /*dim=*/1);
+
+    // Postfix, in place for the moved rows only
     // ==================================
     // param_groups[0] = xyz_
-    // param_groups[1] = feature_dc_
-    // param_groups[2] = feature_rest_
-    // param_groups[3] = opacity_
-    // param_groups[4] = scaling_
     // param_groups[5] = rotation_
     // ==================================
-    torch::Tensor optimizable_xyz = this->replaceTensorToOptimizer(points, 0);
-    // torch::Tensor optimizable_scaling = this->replaceTensorToOptimizer(scales, 4);
-    torch::Tensor optimizable_rots = this->replaceTensorToOptimizer(rots, 5);
+    this->xyz_.index_copy_(0, moved_rows, points);
+    this->rotation_.index_copy_(0, moved_rows, rots);
+    for (int group_idx : {0, 5}) {
+        param_store_.column(STORE_EXP_AVG + group_idx).index_fill_(0, moved_rows, 0.0f);
+        param_store_.column(STORE_EXP_AVG_SQ + group_idx).index_fill_(0, moved_rows, 0.0f);
+    }
+    spatial_index_.markMoved(moved_rows);
 
-    this->xyz_ = optimizable_xyz;
-    // this->scaling_ = optimizable_scaling;
-    this->rotation_ = optimizable_rots;
+    return static_cast<int>(num_moved);
+}
 
-    this->Tensor_vec_xyz_ = {this->xyz_};
-    // this->Tensor_vec_scaling_ = {this->scaling_};
-    this->Tensor_vec_rotation_ = {this->rotation_};
+/**
+ * @brief Bring the voxel keys up to date with the means, rebuilding the index if any point changed voxel
+ */
+void GaussianModel::refreshSpatialIndex()
+{
+    torch::NoGradGuard no_grad;
+    torch::Tensor keys = spatial_index_.keysOf(this->xyz_);
+    if (spatial_index_.isValid() && !spatial_index_.hasMoved()
+        && spatial_index_.numIndexed() == keys.size(0) && torch::equal(keys, this->voxel_keys_))
+        return;
+    param_store_.assign(STORE_VOXEL_KEY, keys);
+    spatial_index_.build(this->voxel_keys_);
 }
 
-void GaussianModel::trainingSetup(const GaussianOptimizationParams& training_args)
+/**
+ * @brief Rows of the points in front of the near plane of a view (transposed world to view matrix)
+ */
+torch::Tensor GaussianModel::pointsInFrustum(const torch::Tensor& viewmatrix, const float znear)
 {
-    setPercentDense(training_args.percent_dense_);
-    this->xyz_gradient_accum_ = torch::zeros({this->getXYZ().size(0), 1}, torch::TensorOptions().device(device_type_));
-    this->denom_ = torch::zeros({this->getXYZ().size(0), 1}, torch::TensorOptions().device(device_type_));
+    torch::NoGradGuard no_grad;
+    refreshSpatialIndex();
+    torch::Tensor rows = spatial_index_.queryFrustum(viewmatrix, znear, this->xyz_.size(0));
+    torch::Tensor view = viewmatrix.to(this->xyz_.device(), torch::kFloat);
+    torch::Tensor z = this->xyz_.index_select(0, rows).matmul(view.index({torch::indexing::Slice(0, 3), 2}))
+                      + view.index({3, 2});
+    return rows.masked_select(z > znear);
+}
 
-    torch::optim::AdamOptions adam_options;
-    adam_options.set_lr(0.0);
-    adam_options.eps() = 1e-15;
+/**
+ * @brief Rows of the points inside the axis-aligned box [box_min, box_max]
+ */
+torch::Tensor GaussianModel::pointsInBox(const torch::Tensor& box_min, const torch::Tensor& box_max)
+{
+    torch::NoGradGuard no_grad;
+    refreshSpatialIndex();
+    torch::Tensor rows = spatial_index_.queryBox(box_min, box_max, this->xyz_.size(0));
+    torch::Tensor points = this->xyz_.index_select(0, rows);
+    torch::Tensor lo = box_min.to(points.device(), torch::kFloat).view({1, 3});
+    torch::Tensor hi = box_max.to(points.device(), torch::kFloat).view({1, 3});
+    return rows.masked_select(torch::logical_and(points >= lo, points <= hi).all(/*dim=*/1));
+}
 
-    this->optimizer_.reset(new torch::optim::Adam(Tensor_vec_xyz_, adam_options));
-    optimizer_->param_groups()[0].options().set_lr(training_args.position_lr_init_ * this->spatial_lr_scale_);
+/**
+ * @brief Page the chunks farthest from `center` to disk while more than `max_resident` points are resident
+ */
+std::int64_t GaussianModel::pageOutChunks(
+    GaussianChunkPager& pager,
+    const torch::Tensor& center,
+    const float keep_radius,
+    const std::int64_t max_resident)
+{
+    std::int64_t num_points = pager.pageOut(param_store_, STORE_PARAMS + 0, center, keep_radius, max_resident);
+    if (num_points) {
+        bindParameterStore();
+        // Rows were moved into the holes
+        spatial_index_.invalidate();
+    }
+    return num_points;
+}
 
-    optimizer_->add_param_group(Tensor_vec_feature_dc_);
-    optimizer_->param_groups()[1].options().set_lr(training_args.feature_lr_);
+/**
+ * @brief Reload the paged chunks within `radius` of `center`, all of them if `radius` is negative
+ */
+std::int64_t GaussianModel::pageInChunks(
+    GaussianChunkPager& pager,
+    const torch::Tensor& center,
+    const float radius)
+{
+    std::int64_t num_points = radius < 0.0f
+                              ? pager.pageInAll(param_store_)
+                              : pager.pageIn(param_store_, center, radius);
+    if (num_points)
+        bindParameterStore();
+    return num_points;
+}
 
-    optimizer_->add_param_group(Tensor_vec_feature_rest_);
-    optimizer_->param_groups()[2].options().set_lr(training_args.feature_lr_ / 20.0);
+/**
+ * @brief Add the paged points to a render snapshot, so that exports see the whole map
+ */
+void GaussianModel::appendPagedChunks(const GaussianChunkPager& pager)
+{
+    torch::NoGradGuard no_grad;
+    if (pager.numPagedChunks() == 0)
+        return;
+    std::vector<torch::Tensor*> params = {
+        &this->xyz_, &this->features_dc_, &this->features_rest_,
+        &this->opacity_, &this->scaling_, &this->rotation_};
+    for (int group_idx = 0; group_idx < 6; ++group_idx) {
+        torch::Tensor& param = *params[group_idx];
+        param = torch::cat({param, pager.pagedColumn(STORE_PARAMS + group_idx, param).to(param.device())}, /*dim=*/0);
+    }
+    if (this->gaussian_ids_.defined())
+        this->gaussian_ids_ = torch::cat({
+            this->gaussian_ids_,
+            pager.pagedColumn(STORE_GAUSSIAN_ID, this->gaussian_ids_).to(this->gaussian_ids_.device())},
+            /*dim=*/0);
+    GAUSSIAN_MODEL_TENSORS_TO_VEC
+}
 
-    optimizer_->add_param_group(Tensor_vec_opacity_);
-    optimizer_->param_groups()[3].options().set_lr(training_args.opacity_lr_);
+void GaussianModel::trainingSetup(const GaussianOptimizationParams& training_args)
+{
+    setPercentDense(training_args.percent_dense_);
+    this->xyz_gradient_accum_ = torch::zeros({this->getXYZ().size(0), 1}, torch::TensorOptions().device(device_type_));
+    this->denom_ = torch::zeros({this->getXYZ().size(0), 1}, torch::TensorOptions().device(device_type_));
 
-    optimizer_->add_param_group(Tensor_vec_scaling_);
-    optimizer_->param_groups()[4].options().set_lr(training_args.scaling_lr_);
+    this->optimizer_.reset(new GaussianAdam(0.9f, 0.999f, 1e-15f));
+    this->optimizer_->setSparse(training_args.sparse_adam_);
+    resetParameterStore();
 
-    optimizer_->add_param_group(Tensor_vec_rotation_);
-    optimizer_->param_groups()[5].options().set_lr(training_args.rotation_lr_);
+    optimizer_->setLearningRate(0, training_args.position_lr_init_ * this->spatial_lr_scale_);
+    optimizer_->setLearningRate(1, training_args.feature_lr_);
+    optimizer_->setLearningRate(2, training_args.feature_lr_ / 20.0);
+    optimizer_->setLearningRate(3, training_args.opacity_lr_);
+    optimizer_->setLearningRate(4, training_args.scaling_lr_);
+    optimizer_->setLearningRate(5, training_args.rotation_lr_);
 
     // get_expon_lr_func
     lr_init_ = training_args.position_lr_init_ * this->spatial_lr_scale_;
@@ -519,7 +720,7 @@ float GaussianModel::updateLearningRate(int step)
     //             param_group['lr'] = lr
     //             return lr
     float lr = this->exponLrFunc(step);
-    optimizer_->param_groups()[0].options().set_lr(lr); // Tensor_vec_xyz_
+    optimizer_->setLearningRate(0, lr); // Tensor_vec_xyz_
     return lr;
 }
 
@@ -533,24 +734,24 @@ float GaussianModel::updateLearningRate(int step)
 // ==================================
 void GaussianModel::setPositionLearningRate(float position_lr)
 {
-    optimizer_->param_groups()[0].options().set_lr(position_lr * this->spatial_lr_scale_);
+    optimizer_->setLearningRate(0, position_lr * this->spatial_lr_scale_);
 }
 void GaussianModel::setFeatureLearningRate(float feature_lr)
 {
-    optimizer_->param_groups()[1].options().set_lr(feature_lr);
-    optimizer_->param_groups()[2].options().set_lr(feature_lr / 20.0);
+    optimizer_->setLearningRate(1, feature_lr);
+    optimizer_->setLearningRate(2, feature_lr / 20.0);
 }
 void GaussianModel::setOpacityLearningRate(float opacity_lr)
 {
-    optimizer_->param_groups()[3].options().set_lr(opacity_lr);
+    optimizer_->setLearningRate(3, opacity_lr);
 }
 void GaussianModel::setScalingLearningRate(float scaling_lr)
 {
-    optimizer_->param_groups()[4].options().set_lr(scaling_lr);
+    optimizer_->setLearningRate(4, scaling_lr);
 }
 void GaussianModel::setRotationLearningRate(float rot_lr)
 {
-    optimizer_->param_groups()[5].options().set_lr(rot_lr);
+    optimizer_->setLearningRate(5, rot_lr);
 }
 
 void GaussianModel::resetOpacity()
@@ -566,22 +767,14 @@ void GaussianModel::resetOpacity()
 
 torch::Tensor GaussianModel::replaceTensorToOptimizer(torch::Tensor& tensor, int tensor_idx)
 {
-    auto& param = this->optimizer_->param_groups()[tensor_idx].params()[0];
-    auto& state = optimizer_->state();
-    auto key = c10::guts::to_string(param.unsafeGetTensorImpl());
-    auto& stored_state = static_cast<torch::optim::AdamParamState&>(*state[key]);
-    auto new_state = std::make_unique<torch::optim::AdamParamState>();
-    new_state->step(stored_state.step());
-    new_state->exp_avg(torch::zeros_like(tensor));
-    new_state->exp_avg_sq(torch::zeros_like(tensor));
-    // new_state->max_exp_avg_sq(stored_state.max_exp_avg_sq().clone()); // needed only when options.amsgrad(true), which is false by default
-
-    state.erase(key);
-    param = tensor.requires_grad_();
-    key = c10::guts::to_string(param.unsafeGetTensorImpl());
-    state[key] = std::move(new_state);
-
-    auto optimizable_tensors = param;
+    // Overwrite the parameter in place and restart its moments, keeping the step
+    param_store_.assign(STORE_PARAMS + tensor_idx, tensor);
+    param_store_.column(STORE_EXP_AVG + tensor_idx).zero_();
+    param_store_.column(STORE_EXP_AVG_SQ + tensor_idx).zero_();
+
+    // The gradient belongs to the former values
+    auto optimizable_tensors = this->optimizer_->param(tensor_idx);
+    optimizable_tensors.mutable_grad().reset();
     return optimizable_tensors;
 }
 
@@ -589,56 +782,12 @@ void GaussianModel::prunePoints(torch::Tensor& mask)
 {
     auto valid_points_mask = ~mask;
 
-    // _prune_optimizer
-    std::vector<torch::Tensor> optimizable_tensors(6);
-    auto& param_groups = this->optimizer_->param_groups();
-    auto& state = this->optimizer_->state();
-    for (int group_idx = 0; group_idx < 6; ++group_idx) {
-        auto& param = param_groups[group_idx].params()[0];
-        auto key = c10::guts::to_string(param.unsafeGetTensorImpl());
-        if (state.find(key) != state.end()) {
-            auto& stored_state = static_cast<torch::optim::AdamParamState&>(*state[key]);
-            auto new_state = std::make_unique<torch::optim::AdamParamState>();
-            new_state->step(stored_state.step());
-            new_state->exp_avg(stored_state.exp_avg().index({valid_points_mask}).clone());
-            new_state->exp_avg_sq(stored_state.exp_avg_sq().index({valid_points_mask}).clone());
-            // new_state->max_exp_avg_sq(stored_state.max_exp_avg_sq().clone()); // needed only when options.amsgrad(true), which is false by default
-
-            state.erase(key);
-            param = param.index({valid_points_mask}).requires_grad_();
-            key = c10::guts::to_string(param.unsafeGetTensorImpl());
-            state[key] = std::move(new_state);
-            optimizable_tensors[group_idx] = param;
-        }
-        else {
-            param = param.index({valid_points_mask}).requires_grad_();
-            optimizable_tensors[group_idx] = param;
-        }
-    }
-
-    // ==================================
-    // param_groups[0] = xyz_
-    // param_groups[1] = feature_dc_
-    // param_groups[2] = feature_rest_
-    // param_groups[3] = opacity_
-    // param_groups[4] = scaling_
-    // param_groups[5] = rotation_
-    // ==================================
-    this->xyz_ = optimizable_tensors[0];
-    this->features_dc_ = optimizable_tensors[1];
-    this->features_rest_ = optimizable_tensors[2];
-    this->opacity_ = optimizable_tensors[3];
-    this->scaling_ = optimizable_tensors[4];
-    this->rotation_ = optimizable_tensors[5];
-
-    GAUSSIAN_MODEL_TENSORS_TO_VEC
-
-    this->exist_since_iter_ = this->exist_since_iter_.index({valid_points_mask});
-
-    this->xyz_gradient_accum_ = this->xyz_gradient_accum_.index({valid_points_mask});
-
-    this->denom_ = this->denom_.index({valid_points_mask});
-    this->max_radii2D_ = this->max_radii2D_.index({valid_points_mask});
+    // _prune_optimizer, the surviving points are compacted in place along with
+    // their Adam moments and statistics
+    param_store_.compact(valid_points_mask);
+    bindParameterStore();
+    // Rows were moved into the holes
+    spatial_index_.invalidate();
 }
 
 void GaussianModel::densificationPostfix(
@@ -650,67 +799,24 @@ void GaussianModel::densificationPostfix(
     torch::Tensor& new_rotation,
     torch::Tensor& new_exist_since_iter)
 {
-    // cat_tensors_to_optimizer
-    std::vector<torch::Tensor> optimizable_tensors(6);
-    std::vector<torch::Tensor> tensors_dict = {
-        new_xyz,
-        new_features_dc,
-        new_features_rest,
-        new_opacities,
-        new_scaling,
-        new_rotation
-    };
-    auto& param_groups = this->optimizer_->param_groups();
-    auto& state = this->optimizer_->state();
-    for (int group_idx = 0; group_idx < 6; ++group_idx) {
-        auto& group = param_groups[group_idx];
-        assert(group.params().size() == 1);
-        auto& extension_tensor = tensors_dict[group_idx];
-        auto& param = group.params()[0];
-        auto key = c10::guts::to_string(param.unsafeGetTensorImpl());
-        if (state.find(key) != state.end()) {
-            auto& stored_state = static_cast<torch::optim::AdamParamState&>(*state[key]);
-            auto new_state = std::make_unique<torch::optim::AdamParamState>();
-            new_state->step(stored_state.step());
-            new_state->exp_avg(torch::cat({stored_state.exp_avg().clone(), torch::zeros_like(extension_tensor)}, /*dim=*/0));
-            new_state->exp_avg_sq(torch::cat({stored_state.exp_avg_sq().clone(), torch::zeros_like(extension_tensor)}, /*dim=*/0));
-            // new_state->max_exp_avg_sq(stored_state.max_exp_avg_sq().clone());  // needed only when options.amsgrad(true), which is false by default
-
-            state.erase(key);
-            param = torch::cat({param, extension_tensor}, /*dim=*/0).requires_grad_();
-            key = c10::guts::to_string(param.unsafeGetTensorImpl());
-            state[key] = std::move(new_state);
-
-            optimizable_tensors[group_idx] = param;
-        }
-        else {
-            param = torch::cat({param, extension_tensor}, /*dim=*/0).requires_grad_();
-            optimizable_tensors[group_idx] = param;
-        }
-    }
-
-    // ==================================
-    // param_groups[0] = xyz_
-    // param_groups[1] = feature_dc_
-    // param_groups[2] = feature_rest_
-    // param_groups[3] = opacity_
-    // param_groups[4] = scaling_
-    // param_groups[5] = rotation_
-    // ==================================
-    this->xyz_ = optimizable_tensors[0];
-    this->features_dc_ = optimizable_tensors[1];
-    this->features_rest_ = optimizable_tensors[2];
-    this->opacity_ = optimizable_tensors[3];
-    this->scaling_ = optimizable_tensors[4];
-    this->rotation_ = optimizable_tensors[5];
-
-    GAUSSIAN_MODEL_TENSORS_TO_VEC
+    // cat_tensors_to_optimizer, the moments and statistics of new points are zero
+    std::vector<torch::Tensor> new_rows(STORE_NUM_COLUMNS);
+    new_rows[STORE_PARAMS + 0] = new_xyz;
+    new_rows[STORE_PARAMS + 1] = new_features_dc;
+    new_rows[STORE_PARAMS + 2] = new_features_rest;
+    new_rows[STORE_PARAMS + 3] = new_opacities;
+    new_rows[STORE_PARAMS + 4] = new_scaling;
+    new_rows[STORE_PARAMS + 5] = new_rotation;
+    new_rows[STORE_EXIST_SINCE_ITER] = new_exist_since_iter;
+    new_rows[STORE_GAUSSIAN_ID] = newGaussianIds(new_xyz.size(0));
+    new_rows[STORE_VOXEL_KEY] = spatial_index_.keysOf(new_xyz);
+    param_store_.append(new_rows);
+    bindParameterStore();
 
-    this->exist_since_iter_ = torch::cat({this->exist_since_iter_, new_exist_since_iter}, /*dim=*/0);
-
-    this->xyz_gradient_accum_ = torch::zeros({this->getXYZ().size(0), 1}, torch::TensorOptions().device(device_type_));
-    this->denom_ = torch::zeros({this->getXYZ().size(0), 1}, torch::TensorOptions().device(device_type_));
-    this->max_radii2D_ = torch::zeros({this->getXYZ().size(0)}, torch::TensorOptions().device(device_type_));
+    torch::NoGradGuard no_grad;
+    this->xyz_gradient_accum_.zero_();
+    this->denom_.zero_();
+    this->max_radii2D_.zero_();
 }
 
 void GaussianModel::densifyAndSplit(
@@ -753,9 +859,10 @@ void GaussianModel::densifyAndSplit(
         new_exist_since_iter
     );
 
+    // The new points are known on the host, no need to count them on the device
     auto prune_filter = torch::cat({
         selected_pts_mask,
-        torch::zeros({(N * selected_pts_mask.sum()).item<int>()}, torch::TensorOptions().device(device_type_).dtype(torch::kBool))
+        torch::zeros({this->xyz_.size(0) - n_init_points}, torch::TensorOptions().device(device_type_).dtype(torch::kBool))
     });
     this->prunePoints(prune_filter);
 }
@@ -798,20 +905,95 @@ void GaussianModel::densifyAndPrune(
     float extent,
     int max_screen_size)
 {
+    GaussianDensificationPlan plan = planDensification(max_grad, min_opacity, extent, max_screen_size);
+    applyDensification(plan);
+}
+
+/**
+ * @brief Take the decisions of densifyAndClone, densifyAndSplit and the pruning
+ *        that follows them at once, on the current points
+ *
+ * A clone has the opacity and scale of its parent and a split child the
+ * opacity and 1 / (0.8 N) of the scale of its parent, so whether they would
+ * be pruned is known before they exist.
+ */
+GaussianDensificationPlan GaussianModel::planDensification(
+    float max_grad,
+    float min_opacity,
+    float extent,
+    int max_screen_size,
+    int N)
+{
+    torch::NoGradGuard no_grad;
     auto grads = this->xyz_gradient_accum_ / this->denom_;
     grads.index_put_({grads.isnan()}, 0.0f);
-    this->densifyAndClone(grads, max_grad, extent);
-    this->densifyAndSplit(grads, max_grad, extent);
-
-    auto prune_mask = (this->getOpacityActivation() < min_opacity).squeeze();
+    auto selected = torch::frobenius_norm(grads, /*dim=*/-1) >= max_grad;
+    auto max_scaling = std::get<0>(this->getScalingActivation().max(/*dim=*/1));
+    auto is_large = max_scaling > percentDense() * extent;
+    auto clone = torch::logical_and(selected, torch::logical_not(is_large));
+    auto split = torch::logical_and(selected, is_large);
+
+    // The densification resets max_radii2D_ before the pruning, so only the world-space size counts
+    auto prune_parent = (this->getOpacityActivation() < min_opacity).squeeze(-1);
+    auto prune_child = prune_parent;
     if (max_screen_size) {
-        auto big_points_vs = this->max_radii2D_ > max_screen_size;
-        auto big_points_ws = std::get<0>(this->getScalingActivation().max(/*dim=*/1)) > 0.1f * extent;
-        prune_mask = torch::logical_or(torch::logical_or(prune_mask, big_points_vs), big_points_ws);
+        prune_parent = torch::logical_or(prune_parent, max_scaling > 0.1f * extent);
+        prune_child = torch::logical_or(prune_child, max_scaling / (0.8f * N) > 0.1f * extent);
+    }
+
+    GaussianDensificationPlan plan;
+    plan.num_split_ = N;
+    plan.remove_mask_ = torch::logical_or(split, prune_parent);
+    auto num_copies = torch::logical_and(clone, torch::logical_not(prune_parent)).to(torch::kLong)
+                      + N * torch::logical_and(split, torch::logical_not(prune_child)).to(torch::kLong);
+    plan.parents_ = torch::repeat_interleave(num_copies);
+    plan.is_child_ = split.index_select(0, plan.parents_);
+    return plan;
+}
+
+/**
+ * @brief Materialize the clones and split children of a plan and drop the removed
+ *        points in one pass over the store, see GaussianParameterStore::replace()
+ */
+void GaussianModel::applyDensification(const GaussianDensificationPlan& plan)
+{
+    torch::NoGradGuard no_grad;
+    const torch::Tensor& parents = plan.parents_;
+    std::vector<torch::Tensor> new_rows(STORE_NUM_COLUMNS);
+    if (parents.size(0) > 0) {
+        auto scaling = this->getScalingActivation().index_select(0, parents);
+        auto rotation = this->rotation_.index_select(0, parents);
+        auto is_child = plan.is_child_.unsqueeze(1);
+        auto samples = at::normal(torch::zeros_like(scaling), scaling);
+        auto offsets = torch::bmm(general_utils::build_rotation(rotation), samples.unsqueeze(-1)).squeeze(-1);
+        auto new_xyz = this->xyz_.index_select(0, parents) + offsets * is_child;
+
+        new_rows[STORE_PARAMS + 0] = new_xyz;
+        new_rows[STORE_PARAMS + 1] = this->features_dc_.index_select(0, parents);
+        new_rows[STORE_PARAMS + 2] = this->features_rest_.index_select(0, parents);
+        new_rows[STORE_PARAMS + 3] = this->opacity_.index_select(0, parents);
+        new_rows[STORE_PARAMS + 4] = torch::where(
+            is_child,
+            torch::log(scaling / (0.8f * plan.num_split_)), // scaling_inverse_activation
+            this->scaling_.index_select(0, parents));
+        new_rows[STORE_PARAMS + 5] = rotation;
+        new_rows[STORE_EXIST_SINCE_ITER] = this->exist_since_iter_.index_select(0, parents);
+        new_rows[STORE_GAUSSIAN_ID] = newGaussianIds(parents.size(0));
+        new_rows[STORE_VOXEL_KEY] = spatial_index_.keysOf(new_xyz);
     }
-    this->prunePoints(prune_mask);
 
-    c10::cuda::CUDACachingAllocator::emptyCache(); // torch.cuda.empty_cache()
+    auto num_reallocations = param_store_.numReallocations();
+    param_store_.replace(plan.remove_mask_, new_rows);
+    bindParameterStore();
+    this->xyz_gradient_accum_.zero_();
+    this->denom_.zero_();
+    this->max_radii2D_.zero_();
+    // Rows were moved into the holes
+    spatial_index_.invalidate();
+
+    // Only a reallocation leaves large freed blocks in the cache
+    if (param_store_.numReallocations() != num_reallocations)
+        c10::cuda::CUDACachingAllocator::emptyCache(); // torch.cuda.empty_cache()
 }
 
 void GaussianModel::addDensificationStats(
@@ -837,6 +1019,7 @@ void GaussianModel::addDensificationStats(
 
 void GaussianModel::loadPly(std::filesystem::path ply_path)
 {
+    this->compressed_.reset();
     std::ifstream instream_binary(ply_path, std::ios::binary);
     if (!instream_binary.is_open() || instream_binary.fail())
         throw std::runtime_error("Fail to open ply file at " + ply_path.string());
@@ -953,13 +1136,38 @@ void GaussianModel::loadPly(std::filesystem::path ply_path)
     this->active_sh_degree_ = this->max_sh_degree_;
 }
 
+/**
+ * @brief Take the Gaussians replayed from a delta checkpoint log, for viewing
+ */
+void GaussianModel::loadDeltaState(const GaussianDeltaState& state)
+{
+    torch::NoGradGuard no_grad;
+    int n_f_rest = (max_sh_degree_ + 1) * (max_sh_degree_ + 1) - 1;
+    if (state.params_.size() != 6 || state.params_[2].size(1) != n_f_rest)
+        throw std::runtime_error("[GaussianModel::loadDeltaState]The saved SH degree differs from "
+                                 + std::to_string(this->max_sh_degree_));
+    this->xyz_ = state.params_[0].to(device_type_).contiguous();
+    this->features_dc_ = state.params_[1].to(device_type_).contiguous();
+    this->features_rest_ = state.params_[2].to(device_type_).contiguous();
+    this->opacity_ = state.params_[3].to(device_type_).contiguous();
+    this->scaling_ = state.params_[4].to(device_type_).contiguous();
+    this->rotation_ = state.params_[5].to(device_type_).contiguous();
+    this->gaussian_ids_ = state.ids_.to(device_type_);
+    this->next_gaussian_id_ = state.ids_.numel() ? state.ids_.max().item<std::int64_t>() + 1 : 0;
+
+    GAUSSIAN_MODEL_TENSORS_TO_VEC
+
+    this->active_sh_degree_ = state.active_sh_degree_;
+}
+
 void GaussianModel::savePly(std::filesystem::path result_path)
 {
     // Prepare data to write
     torch::Tensor xyz = this->xyz_.detach().cpu();
     torch::Tensor normals = torch::zeros_like(xyz);
     torch::Tensor f_dc = this->features_dc_.detach().transpose(1, 2).flatten(1).contiguous().cpu();
-    torch::Tensor f_rest = this->features_rest_.detach().transpose(1, 2).flatten(1).contiguous().cpu();
+    torch::Tensor features_rest = fullFeaturesRest();
+    torch::Tensor f_rest = features_rest.transpose(1, 2).flatten(1).contiguous().cpu();
     torch::Tensor opacities = this->opacity_.detach().cpu();
     torch::Tensor scale = this->scaling_.detach().cpu();
     torch::Tensor rotation = this->rotation_.detach().cpu();
@@ -998,14 +1206,14 @@ void GaussianModel::savePly(std::filesystem::path result_path)
         tinyply::Type::INVALID, 0);
 
     // f_rest
-    std::size_t n_f_rest = this->features_rest_.size(1) * this->features_rest_.size(2);
+    std::size_t n_f_rest = features_rest.size(1) * features_rest.size(2);
     std::vector<std::string> property_names_f_rest(n_f_rest);
     for (int i = 0; i < n_f_rest; ++i)
         property_names_f_rest[i] = "f_rest_" + std::to_string(i);
 
     result_file.add_properties_to_element(
         "vertex", property_names_f_rest,
-        tinyply::Type::FLOAT32, this->features_rest_.size(0),
+        tinyply::Type::FLOAT32, features_rest.size(0),
         reinterpret_cast<uint8_t*>(f_rest.data_ptr<float>()),
         tinyply::Type::INVALID, 0);
 
@@ -1087,6 +1295,172 @@ void GaussianModel::saveSparsePointsPly(std::filesystem::path result_path)
     fb_binary.close();
 }
 
+/**
+ * @brief Vector quantize the attributes and write them in the checkpoint container,
+ *        reporting the resident and per-render sizes before and after
+ */
+void GaussianModel::saveCompressed(
+    std::filesystem::path result_path,
+    const GaussianCompressionOptions& options)
+{
+    torch::NoGradGuard no_grad;
+    std::shared_ptr<CompressedGaussians> compressed = CompressedGaussians::compress(
+        this->xyz_, this->features_dc_, this->features_rest_,
+        this->opacity_, this->scaling_, this->rotation_,
+        this->active_sh_degree_, this->max_sh_degree_, options);
+    compressed->save(result_path);
+
+    const double mb = 1024.0 * 1024.0;
+    std::cout << "[Gaussian Mapper]Compressed " << compressed->numPoints() << " Gaussians from "
+              << numBytes() / mb << " MB to " << compressed->numBytes() / mb << " MB resident, "
+              << compressed->decodedBytes() / mb << " MB decoded per render, to " << result_path << std::endl;
+}
+
+/**
+ * @brief Render from a compressed model, decoding the attributes on the fly
+ */
+void GaussianModel::loadCompressed(std::filesystem::path compressed_path)
+{
+    this->compressed_ = CompressedGaussians::load(compressed_path, device_type_);
+    this->max_sh_degree_ = this->compressed_->maxShDegree();
+    this->active_sh_degree_ = this->compressed_->activeShDegree();
+    this->xyz_ = this->compressed_->xyz();
+    this->features_dc_ = torch::Tensor();
+    this->features_rest_ = torch::Tensor();
+    this->opacity_ = torch::Tensor();
+    this->scaling_ = torch::Tensor();
+    this->rotation_ = torch::Tensor();
+    GAUSSIAN_MODEL_TENSORS_TO_VEC
+
+    std::cout << "[Gaussian Mapper]Loaded " << this->compressed_->numPoints() << " compressed Gaussians, "
+              << this->compressed_->numBytes() / (1024.0 * 1024.0) << " MB resident" << std::endl;
+}
+
+/**
+ * @brief Resident size of the rendered attributes
+ */
+std::size_t GaussianModel::numBytes() const
+{
+    if (this->compressed_)
+        return this->compressed_->numBytes();
+    std::size_t num_bytes = 0;
+    for (const auto& tensor : {this->xyz_, this->features_dc_, this->features_rest_,
+                               this->opacity_, this->scaling_, this->rotation_})
+        if (tensor.defined())
+            num_bytes += tensor.numel() * tensor.element_size();
+    return num_bytes;
+}
+
+namespace
+{
+
+const char* group_names[6] = {"xyz", "features_dc", "features_rest", "opacity", "scaling", "rotation"};
+
+}
+
+/**
+ * @brief Everything needed to resume training: the parameters, their Adam
+ *        moments and steps, and the per-point densification statistics
+ */
+void GaussianModel::saveCheckpoint(GaussianCheckpoint& checkpoint, const GaussianChunkPager* pager)
+{
+    torch::NoGradGuard no_grad;
+    checkpoint.putInt("gaussians/active_sh_degree", this->active_sh_degree_);
+    checkpoint.putInt("gaussians/max_sh_degree", this->max_sh_degree_);
+    checkpoint.putFloat("gaussians/spatial_lr_scale", this->spatial_lr_scale_);
+    checkpoint.putFloat("gaussians/percent_dense", this->percentDense());
+
+    std::vector<torch::Tensor> columns(param_store_.numColumns());
+    for (std::size_t idx = 0; idx < columns.size(); ++idx)
+        columns[idx] = param_store_.column(idx);
+    if (pager && pager->numPagedChunks() > 0) {
+        // The paged rows are joined on the host, straight from their chunk files
+        std::vector<torch::Tensor> paged = pager->pagedColumns(columns);
+        for (std::size_t idx = 0; idx < columns.size(); ++idx)
+            columns[idx] = torch::cat({columns[idx].to(torch::kCPU), paged[idx]}, /*dim=*/0);
+    }
+
+    std::vector<float> lrs(6);
+    std::vector<std::int64_t> steps(6);
+    for (int group_idx = 0; group_idx < 6; ++group_idx) {
+        std::string name = group_names[group_idx];
+        checkpoint.put("gaussians/" + name, columns[STORE_PARAMS + group_idx]);
+        checkpoint.put("adam/exp_avg/" + name, columns[STORE_EXP_AVG + group_idx]);
+        checkpoint.put("adam/exp_avg_sq/" + name, columns[STORE_EXP_AVG_SQ + group_idx]);
+        lrs[group_idx] = optimizer_->learningRate(group_idx);
+        steps[group_idx] = optimizer_->stepCount(group_idx);
+    }
+    checkpoint.put("adam/lr", torch::tensor(lrs, torch::kFloat));
+    checkpoint.put("adam/step", torch::tensor(steps, torch::kLong));
+
+    checkpoint.put("gaussians/exist_since_iter", columns[STORE_EXIST_SINCE_ITER]);
+    checkpoint.put("densify/xyz_gradient_accum", columns[STORE_XYZ_GRADIENT_ACCUM]);
+    checkpoint.put("densify/denom", columns[STORE_DENOM]);
+    checkpoint.put("densify/max_radii2D", columns[STORE_MAX_RADII2D]);
+    checkpoint.put("gaussians/id", columns[STORE_GAUSSIAN_ID]);
+    checkpoint.putInt("gaussians/next_id", this->next_gaussian_id_);
+
+    if (this->sparse_points_xyz_.defined()) {
+        checkpoint.put("sparse/xyz", this->sparse_points_xyz_);
+        checkpoint.put("sparse/color", this->sparse_points_color_);
+    }
+}
+
+/**
+ * @brief Replace the model and its optimizer by a checkpoint, with the
+ *        learning rate schedule of `training_args`
+ */
+void GaussianModel::loadCheckpoint(
+    const GaussianCheckpoint& checkpoint,
+    const GaussianOptimizationParams& training_args)
+{
+    torch::NoGradGuard no_grad;
+    if (checkpoint.getInt("gaussians/max_sh_degree") != this->max_sh_degree_)
+        throw std::runtime_error("[GaussianModel::loadCheckpoint]Checkpoint SH degree "
+                                 + std::to_string(checkpoint.getInt("gaussians/max_sh_degree"))
+                                 + " differs from " + std::to_string(this->max_sh_degree_));
+    this->active_sh_degree_ = checkpoint.getInt("gaussians/active_sh_degree");
+    this->spatial_lr_scale_ = checkpoint.getFloat("gaussians/spatial_lr_scale");
+
+    // The mapped tensors are only copied once, into the parameter store
+    this->xyz_ = checkpoint.get("gaussians/xyz").to(device_type_);
+    this->features_dc_ = checkpoint.get("gaussians/features_dc").to(device_type_);
+    this->features_rest_ = checkpoint.get("gaussians/features_rest").to(device_type_);
+    this->opacity_ = checkpoint.get("gaussians/opacity").to(device_type_);
+    this->scaling_ = checkpoint.get("gaussians/scaling").to(device_type_);
+    this->rotation_ = checkpoint.get("gaussians/rotation").to(device_type_);
+    this->exist_since_iter_ = checkpoint.get("gaussians/exist_since_iter").to(device_type_);
+    this->max_radii2D_ = checkpoint.get("densify/max_radii2D").to(device_type_);
+    if (checkpoint.has("gaussians/id")) {
+        this->gaussian_ids_ = checkpoint.get("gaussians/id").to(device_type_);
+        this->next_gaussian_id_ = checkpoint.getInt("gaussians/next_id");
+    }
+    else {
+        this->gaussian_ids_ = torch::Tensor();
+    }
+    sparse_store_.clear();
+    if (checkpoint.has("sparse/xyz"))
+        appendSparsePoints(
+            checkpoint.get("sparse/xyz").to(device_type_),
+            checkpoint.get("sparse/color").to(device_type_));
+
+    trainingSetup(training_args);
+    setPercentDense(checkpoint.getFloat("gaussians/percent_dense"));
+    // Copied straight from the mapping into the store
+    param_store_.assign(STORE_XYZ_GRADIENT_ACCUM, checkpoint.get("densify/xyz_gradient_accum"));
+    param_store_.assign(STORE_DENOM, checkpoint.get("densify/denom"));
+
+    torch::Tensor lrs = checkpoint.get("adam/lr");
+    torch::Tensor steps = checkpoint.get("adam/step");
+    for (int group_idx = 0; group_idx < 6; ++group_idx) {
+        std::string name = group_names[group_idx];
+        param_store_.assign(STORE_EXP_AVG + group_idx, checkpoint.get("adam/exp_avg/" + name));
+        param_store_.assign(STORE_EXP_AVG_SQ + group_idx, checkpoint.get("adam/exp_avg_sq/" + name));
+        optimizer_->setLearningRate(group_idx, lrs[group_idx].item<float>());
+        optimizer_->setStepCount(group_idx, steps[group_idx].item<std::int64_t>());
+    }
+}
+
 float GaussianModel::percentDense()
 {
     std::unique_lock<std::mutex> lock(mutex_settings_);
@@ -1128,4 +1502,100 @@ float GaussianModel::exponLrFunc(int step)
     float t = std::clamp(static_cast<float>(step) / max_steps_, 0.0f, 1.0f);
     float log_lerp = std::exp(std::log(lr_init_) * (1 - t) + std::log(lr_final_) * t);
     return delay_rate * log_lerp;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Move the parameters, moments and statistics into the store,
+ *        called once the optimizer is set up
+ */
+void GaussianModel::resetParameterStore()
+{
+    torch::NoGradGuard no_grad;
+    auto num_points = this->getXYZ().size(0);
+    if (!this->exist_since_iter_.defined() || this->exist_since_iter_.size(0) != num_points)
+        this->exist_since_iter_ = torch::zeros(
+            {num_points},
+            torch::TensorOptions().dtype(torch::kInt32).device(device_type_));
+    if (this->max_radii2D_.size(0) != num_points)
+        this->max_radii2D_ = torch::zeros({num_points}, torch::TensorOptions().device(device_type_));
+    if (!this->gaussian_ids_.defined() || this->gaussian_ids_.size(0) != num_points) {
+        this->next_gaussian_id_ = 0;
+        this->gaussian_ids_ = newGaussianIds(num_points);
+    }
+
+    std::vector<torch::Tensor> params = {
+        this->xyz_,
+        this->features_dc_,
+        this->features_rest_,
+        this->opacity_,
+        this->scaling_,
+        this->rotation_
+    };
+    std::vector<torch::Tensor> columns(STORE_NUM_COLUMNS);
+    for (int group_idx = 0; group_idx < 6; ++group_idx) {
+        columns[STORE_PARAMS + group_idx] = params[group_idx];
+        columns[STORE_EXP_AVG + group_idx] = torch::zeros_like(params[group_idx]);
+        columns[STORE_EXP_AVG_SQ + group_idx] = torch::zeros_like(params[group_idx]);
+    }
+    columns[STORE_EXIST_SINCE_ITER] = this->exist_since_iter_;
+    columns[STORE_XYZ_GRADIENT_ACCUM] = this->xyz_gradient_accum_;
+    columns[STORE_DENOM] = this->denom_;
+    columns[STORE_MAX_RADII2D] = this->max_radii2D_;
+    columns[STORE_GAUSSIAN_ID] = this->gaussian_ids_;
+    // About 32 voxels across the camera extent
+    spatial_index_.setVoxelSize(this->spatial_lr_scale_ > 0.0f ? this->spatial_lr_scale_ / 32.0f : 0.1f);
+    spatial_index_.invalidate();
+    columns[STORE_VOXEL_KEY] = spatial_index_.keysOf(this->xyz_);
+
+    param_store_.reset(columns);
+    bindParameterStore();
+}
+
+/**
+ * @brief Point the optimizer and the model tensors at the active rows of the store
+ */
+void GaussianModel::bindParameterStore()
+{
+    std::vector<torch::Tensor> optimizable_tensors(6), exp_avgs(6), exp_avg_sqs(6);
+    for (int group_idx = 0; group_idx < 6; ++group_idx) {
+        // A detached view is a leaf sharing the backing storage, so optimizer steps update it in place
+        optimizable_tensors[group_idx] =
+            param_store_.column(STORE_PARAMS + group_idx).detach().requires_grad_();
+        exp_avgs[group_idx] = param_store_.column(STORE_EXP_AVG + group_idx);
+        exp_avg_sqs[group_idx] = param_store_.column(STORE_EXP_AVG_SQ + group_idx);
+    }
+    this->optimizer_->bind(optimizable_tensors, exp_avgs, exp_avg_sqs);
+
+    // ==================================
+    // param_groups[0] = xyz_
+    // param_groups[1] = feature_dc_
+    // param_groups[2] = feature_rest_
+    // param_groups[3] = opacity_
+    // param_groups[4] = scaling_
+    // param_groups[5] = rotation_
+    // ==================================
+    this->xyz_ = optimizable_tensors[0];
+    this->features_dc_ = optimizable_tensors[1];
+    this->features_rest_ = optimizable_tensors[2];
+    this->opacity_ = optimizable_tensors[3];
+    this->scaling_ = optimizable_tensors[4];
+    this->rotation_ = optimizable_tensors[5];
+
+    GAUSSIAN_MODEL_TENSORS_TO_VEC
+
+    this->exist_since_iter_ = param_store_.column(STORE_EXIST_SINCE_ITER);
+    this->xyz_gradient_accum_ = param_store_.column(STORE_XYZ_GRADIENT_ACCUM);
+    this->denom_ = param_store_.column(STORE_DENOM);
+    this->max_radii2D_ = param_store_.column(STORE_MAX_RADII2D);
+    this->gaussian_ids_ = param_store_.column(STORE_GAUSSIAN_ID);
+    this->voxel_keys_ = param_store_.column(STORE_VOXEL_KEY);
+}
+
+torch::Tensor GaussianModel::newGaussianIds(std::int64_t num_points)
+{
+    torch::Tensor ids = torch::arange(
+        this->next_gaussian_id_, this->next_gaussian_id_ + num_points,
+        torch::TensorOptions().dtype(torch::kLong).device(device_type_));
+    this->next_gaussian_id_ += num_points;
+    return ids;
+}
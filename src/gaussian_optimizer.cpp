@@ -0,0 +1,124 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "include/gaussian_optimizer.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "include/adam_step.h"
+
+GaussianAdam::GaussianAdam(float beta1, float beta2, float eps)
+    : beta1_(beta1), beta2_(beta2), eps_(eps)
+{}
+
+/**
+ * @brief Point the groups at new parameter and moment tensors,
+ *        learning rates and step counts are kept
+ */
+void GaussianAdam::bind(
+    const std::vector<torch::Tensor>& params,
+    const std::vector<torch::Tensor>& exp_avgs,
+    const std::vector<torch::Tensor>& exp_avg_sqs)
+{
+    if (exp_avgs.size() != params.size() || exp_avg_sqs.size() != params.size())
+        throw std::runtime_error("[GaussianAdam]Every parameter needs both moments");
+    if (params.size() > ADAM_STEP_MAX_GROUPS)
+        throw std::runtime_error("[GaussianAdam]At most " + std::to_string(ADAM_STEP_MAX_GROUPS) + " groups");
+    for (std::size_t g = 0; g < params.size(); ++g) {
+        if (!params[g].is_contiguous() || params[g].scalar_type() != torch::kFloat)
+            throw std::runtime_error("[GaussianAdam]Parameters must be contiguous float tensors");
+        if (!exp_avgs[g].sizes().equals(params[g].sizes()) || !exp_avg_sqs[g].sizes().equals(params[g].sizes()))
+            throw std::runtime_error("[GaussianAdam]Moments must have the shape of their parameter");
+    }
+
+    params_ = params;
+    exp_avgs_ = exp_avgs;
+    exp_avg_sqs_ = exp_avg_sqs;
+    lrs_.resize(params_.size(), 0.0f);
+    steps_.resize(params_.size(), 0);
+}
+
+void GaussianAdam::setLearningRate(std::size_t group, float lr)
+{
+    lrs_.at(group) = lr;
+}
+
+float GaussianAdam::learningRate(std::size_t group) const
+{
+    return lrs_.at(group);
+}
+
+std::int64_t GaussianAdam::stepCount(std::size_t group) const
+{
+    return steps_.at(group);
+}
+
+void GaussianAdam::setStepCount(std::size_t group, std::int64_t step)
+{
+    steps_.at(group) = step;
+}
+
+/**
+ * @brief Update every group that has a gradient,
+ *        `visible` (num_points,) is only used in sparse mode
+ */
+void GaussianAdam::step(const torch::Tensor& visible)
+{
+    torch::NoGradGuard no_grad;
+    std::vector<AdamStepGroup> groups;
+    groups.reserve(params_.size());
+    for (std::size_t g = 0; g < params_.size(); ++g) {
+        auto& param = params_[g];
+        // Points grown or pruned since the backward pass have no gradient yet
+        if (!param.grad().defined())
+            continue;
+        ++steps_[g];
+        AdamStepGroup group;
+        group.param_ = param;
+        group.grad_ = param.grad().contiguous();
+        group.exp_avg_ = exp_avgs_[g];
+        group.exp_avg_sq_ = exp_avg_sqs_[g];
+        group.lr_ = lrs_[g];
+        group.bias_correction1_ = 1.0f - std::pow(beta1_, static_cast<float>(steps_[g]));
+        group.bias_correction2_ = 1.0f - std::pow(beta2_, static_cast<float>(steps_[g]));
+        groups.emplace_back(std::move(group));
+    }
+    if (groups.empty())
+        return;
+
+    torch::Tensor visible_mask;
+    if (sparse_ && visible.defined()) {
+        if (visible.size(0) != groups[0].param_.size(0))
+            throw std::runtime_error("[GaussianAdam]Visibility of " + std::to_string(visible.size(0))
+                                     + " points for " + std::to_string(groups[0].param_.size(0)) + " parameters");
+        visible_mask = visible.to(groups[0].param_.device(), torch::kBool).contiguous();
+    }
+
+    if (groups[0].param_.is_cuda())
+        adamStepCUDA(groups, visible_mask, beta1_, beta2_, eps_);
+    else
+        adamStepCPU(groups, visible_mask, beta1_, beta2_, eps_);
+}
+
+void GaussianAdam::zeroGrad()
+{
+    for (auto& param : params_)
+        param.mutable_grad().reset();
+}
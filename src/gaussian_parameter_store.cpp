@@ -0,0 +1,231 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "include/gaussian_parameter_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Take over the rows of `columns`, which must all have the same number of rows
+ */
+void GaussianParameterStore::reset(const std::vector<torch::Tensor>& columns, std::int64_t min_capacity)
+{
+    torch::NoGradGuard no_grad;
+    std::int64_t num_rows = columns.empty() ? 0 : columns[0].size(0);
+    for (auto& column : columns)
+        if (column.size(0) != num_rows)
+            throw std::runtime_error("[GaussianParameterStore]Columns have different numbers of rows");
+
+    min_capacity_ = min_capacity;
+    capacity_ = std::max(num_rows, min_capacity_);
+    size_ = num_rows;
+    backing_.clear();
+    for (auto& column : columns) {
+        auto shape = column.sizes().vec();
+        shape[0] = capacity_;
+        torch::Tensor backing = torch::empty(shape, column.options().requires_grad(false));
+        backing.narrow(0, 0, num_rows).copy_(column.detach());
+        backing_.emplace_back(std::move(backing));
+    }
+}
+
+void GaussianParameterStore::clear()
+{
+    backing_.clear();
+    size_ = 0;
+    capacity_ = 0;
+}
+
+torch::Tensor GaussianParameterStore::column(std::size_t idx) const
+{
+    return backing_.at(idx).narrow(0, 0, size_);
+}
+
+void GaussianParameterStore::reserve(std::int64_t capacity)
+{
+    if (capacity > capacity_)
+        reallocate(capacity);
+}
+
+/**
+ * @brief Append the same number of rows to every column,
+ *        an undefined tensor appends zeros to its column
+ */
+void GaussianParameterStore::append(const std::vector<torch::Tensor>& rows)
+{
+    torch::NoGradGuard no_grad;
+    std::int64_t num_new = numNewRows(rows);
+    if (num_new <= 0)
+        return;
+
+    if (size_ + num_new > capacity_)
+        reallocate(std::max(size_ + num_new, 2 * capacity_));
+
+    for (std::size_t idx = 0; idx < backing_.size(); ++idx) {
+        torch::Tensor dst = backing_[idx].narrow(0, size_, num_new);
+        if (rows[idx].defined())
+            dst.copy_(rows[idx].detach());
+        else
+            dst.zero_();
+    }
+    size_ += num_new;
+}
+
+/**
+ * @brief Remove the rows where `remove_mask` is true and add new ones in one pass.
+ *
+ * The new rows are written straight into the holes; only the new rows left
+ * over are appended, or only the holes left over are compacted, so every
+ * other row stays in place.
+ */
+void GaussianParameterStore::replace(const torch::Tensor& remove_mask, const std::vector<torch::Tensor>& rows)
+{
+    torch::NoGradGuard no_grad;
+    if (remove_mask.size(0) != size_)
+        throw std::runtime_error("[GaussianParameterStore]Mask of " + std::to_string(remove_mask.size(0))
+                                 + " rows for a store of " + std::to_string(size_));
+    std::int64_t num_new = std::max<std::int64_t>(0, numNewRows(rows));
+    torch::Tensor holes = remove_mask.to(torch::kBool).nonzero().squeeze(1);
+    std::int64_t num_holes = holes.size(0);
+
+    std::int64_t num_filled = std::min(num_holes, num_new);
+    if (num_filled > 0) {
+        torch::Tensor filled = holes.narrow(0, 0, num_filled);
+        for (std::size_t idx = 0; idx < backing_.size(); ++idx) {
+            torch::Tensor& backing = backing_[idx];
+            if (rows[idx].defined())
+                backing.index_copy_(0, filled, rows[idx].detach().narrow(0, 0, num_filled).to(backing.dtype()));
+            else
+                backing.index_fill_(0, filled, 0);
+        }
+    }
+
+    if (num_new > num_holes) {
+        std::vector<torch::Tensor> remaining(rows.size());
+        for (std::size_t idx = 0; idx < rows.size(); ++idx)
+            if (rows[idx].defined())
+                remaining[idx] = rows[idx].narrow(0, num_holes, num_new - num_holes);
+        append(remaining);
+    }
+    else if (num_holes > num_new) {
+        torch::Tensor valid = torch::ones({size_}, holes.options().dtype(torch::kBool));
+        valid.index_fill_(0, holes.narrow(0, num_new, num_holes - num_new), false);
+        compact(valid);
+    }
+}
+
+/**
+ * @brief Overwrite the active rows of one column
+ */
+void GaussianParameterStore::assign(std::size_t idx, const torch::Tensor& values)
+{
+    torch::NoGradGuard no_grad;
+    torch::Tensor dst = column(idx);
+    if (values.data_ptr() == dst.data_ptr())
+        return; // Already updated in place
+    dst.copy_(values.detach());
+}
+
+/**
+ * @brief Change the extent of dimension `dim` (> 0) of one column,
+ *        entries beyond the former extent are zero
+ */
+void GaussianParameterStore::resizeColumn(std::size_t idx, std::int64_t dim, std::int64_t new_size)
+{
+    torch::NoGradGuard no_grad;
+    torch::Tensor& old_backing = backing_.at(idx);
+    if (dim <= 0 || dim >= old_backing.dim())
+        throw std::runtime_error("[GaussianParameterStore]Only the row shape of a column can be resized");
+    auto shape = old_backing.sizes().vec();
+    std::int64_t kept = std::min(shape[dim], new_size);
+    shape[dim] = new_size;
+    torch::Tensor backing = torch::zeros(shape, old_backing.options());
+    backing.narrow(0, 0, size_).narrow(dim, 0, kept).copy_(
+        old_backing.narrow(0, 0, size_).narrow(dim, 0, kept));
+    old_backing = backing;
+}
+
+/**
+ * @brief Drop the rows where `valid_mask` is false.
+ *
+ * The removed rows below the new size are refilled with the surviving rows
+ * above it, in order, and the backing is shrunk to twice the size once it
+ * falls under a quarter of the capacity.
+ */
+void GaussianParameterStore::compact(const torch::Tensor& valid_mask)
+{
+    torch::NoGradGuard no_grad;
+    if (valid_mask.size(0) != size_)
+        throw std::runtime_error("[GaussianParameterStore]Mask of " + std::to_string(valid_mask.size(0))
+                                 + " rows for a store of " + std::to_string(size_));
+    torch::Tensor valid = valid_mask.to(torch::kBool);
+    std::int64_t new_size = valid.sum().item<std::int64_t>();
+    if (new_size == size_)
+        return;
+
+    if (new_size > 0) {
+        torch::Tensor holes = torch::logical_not(valid.narrow(0, 0, new_size)).nonzero().squeeze(1);
+        torch::Tensor movers = valid.narrow(0, new_size, size_ - new_size).nonzero().squeeze(1) + new_size;
+        if (holes.size(0) > 0) {
+            for (auto& backing : backing_) {
+                torch::Tensor moved = backing.index_select(0, movers);
+                backing.index_copy_(0, holes, moved);
+            }
+        }
+    }
+    size_ = new_size;
+
+    if (4 * size_ < capacity_ && capacity_ > min_capacity_)
+        reallocate(2 * size_);
+}
+
+void GaussianParameterStore::reallocate(std::int64_t capacity)
+{
+    torch::NoGradGuard no_grad;
+    capacity = std::max({capacity, size_, min_capacity_});
+    for (auto& backing : backing_) {
+        auto shape = backing.sizes().vec();
+        shape[0] = capacity;
+        torch::Tensor new_backing = torch::empty(shape, backing.options());
+        new_backing.narrow(0, 0, size_).copy_(backing.narrow(0, 0, size_));
+        backing = std::move(new_backing);
+    }
+    capacity_ = capacity;
+    ++num_reallocations_;
+}
+
+/**
+ * @brief Rows in the defined tensors of `rows`, -1 if none is defined
+ */
+std::int64_t GaussianParameterStore::numNewRows(const std::vector<torch::Tensor>& rows) const
+{
+    if (rows.size() != backing_.size())
+        throw std::runtime_error("[GaussianParameterStore]Appending " + std::to_string(rows.size())
+                                 + " columns to a store of " + std::to_string(backing_.size()));
+    std::int64_t num_new = -1;
+    for (auto& row : rows) {
+        if (!row.defined())
+            continue;
+        if (num_new >= 0 && row.size(0) != num_new)
+            throw std::runtime_error("[GaussianParameterStore]Appended columns have different numbers of rows");
+        num_new = row.size(0);
+    }
+    return num_new;
+}
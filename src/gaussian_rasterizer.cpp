@@ -22,7 +22,10 @@ GaussianRasterizer::markVisibleGaussians(
     // Mark visible points (based on frustum culling for camera) with a boolean
     torch::NoGradGuard no_grad;
     auto raster_settings = this->raster_settings_;
-    return markVisible(positions, raster_settings.viewmatrix_, raster_settings.projmatrix_);
+    if (positions.is_cuda())
+        return markVisible(positions, raster_settings.viewmatrix_, raster_settings.projmatrix_);
+    else
+        return markVisibleCPU(positions, raster_settings.viewmatrix_, raster_settings.projmatrix_);
 }
 
 torch::autograd::tensor_list
@@ -49,8 +52,9 @@ GaussianRasterizerFunction::forward(
     // torch::Tensor campos,
     // bool prefiltered)
 {
-    // Invoke C++/CUDA rasterizer
-    auto rasterization_result = RasterizeGaussiansCUDA(
+    // Invoke C++/CUDA rasterizer, or its CPU counterpart for tensors on the host
+    auto rasterize = means3D.is_cuda() ? RasterizeGaussiansCUDA : RasterizeGaussiansCPU;
+    auto rasterization_result = rasterize(
         raster_settings.bg_,
         means3D,
         colors_precomp,
@@ -133,7 +137,8 @@ GaussianRasterizerFunction::backward(
 
     // Compute gradients for relevant tensors by invoking backward method
     auto grad_out_color = grad_outputs[0];
-    auto rasterization_backward_result = RasterizeGaussiansBackwardCUDA(
+    auto rasterize_backward = means3D.is_cuda() ? RasterizeGaussiansBackwardCUDA : RasterizeGaussiansBackwardCPU;
+    auto rasterization_backward_result = rasterize_backward(
         bg,
         means3D,
         radii,
@@ -207,16 +212,17 @@ GaussianRasterizer::forward(
         throw std::runtime_error("Please provide exactly one of either scale/rotation pair or precomputed 3D covariance!");
 
     torch::TensorOptions options;
+    auto device = means3D.device();
     if (!has_shs)
-        shs = torch::tensor({}, options.device(torch::kCUDA));
+        shs = torch::tensor({}, options.device(device));
     if (!has_colors_precomp)
-        colors_precomp = torch::tensor({}, options.device(torch::kCUDA));
+        colors_precomp = torch::tensor({}, options.device(device));
     if (!has_scales)
-        scales = torch::tensor({}, options.device(torch::kCUDA));
+        scales = torch::tensor({}, options.device(device));
     if (!has_rotations)
-        rotations = torch::tensor({}, options.device(torch::kCUDA));
+        rotations = torch::tensor({}, options.device(device));
     if (!has_cov3D_precomp)
-        cov3D_precomp = torch::tensor({}, options.device(torch::kCUDA));
+        cov3D_precomp = torch::tensor({}, options.device(device));
 
     auto result = rasterizeGaussians(
         means3D,
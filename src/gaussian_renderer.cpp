@@ -34,12 +34,12 @@ GaussianRenderer::render(
 {
     /* Render the scene. 
 
-       Background tensor (bg_color) must be on GPU!
+       Background tensor (bg_color) must be on the same device as the model!
      */
 
     // Create zero tensor. We will use it to make pytorch return gradients of the 2D (screen-space) means
     auto screenspace_points = torch::zeros_like(pc->getXYZ(),
-        torch::TensorOptions().dtype(pc->getXYZ().dtype()).requires_grad(true).device(torch::kCUDA));
+        torch::TensorOptions().dtype(pc->getXYZ().dtype()).requires_grad(true).device(pc->getXYZ().device()));
     try {
         screenspace_points.retain_grad();
     }
@@ -104,9 +104,10 @@ GaussianRenderer::render(
     }
     else {
         if (pipe.convert_SHs_) {
-            int max_sh_degree = pc->max_sh_degree_ + 1;
-            torch::Tensor shs_view = pc->getFeatures().transpose(1, 2).view({-1, 3, max_sh_degree * max_sh_degree});
-            torch::Tensor dir_pp = (pc->getXYZ() - viewpoint_camera->camera_center_.repeat({pc->getFeatures().size(0), 1}));
+            // Only the bands up to the active degree may be stored
+            torch::Tensor features = pc->getFeatures();
+            torch::Tensor shs_view = features.transpose(1, 2).view({-1, 3, features.size(1)});
+            torch::Tensor dir_pp = (pc->getXYZ() - viewpoint_camera->camera_center_);
             auto dir_pp_normalized = dir_pp / torch::frobenius_norm(dir_pp, /*dim=*/{1}, /*keepdim=*/true);
             auto sh2rgb = sh_utils::eval_sh(pc->active_sh_degree_, shs_view, dir_pp_normalized);
             colors_precomp = torch::clamp_min(sh2rgb + 0.5, 0.0);
@@ -44,10 +44,18 @@ Camera& GaussianScene::getCamera(camera_id_t cameraId)
 void GaussianScene::addKeyframe(std::shared_ptr<GaussianKeyframe> new_kf, bool* shuffled)
 {
     std::unique_lock<std::mutex> lock_kfs(this->mutex_kfs_);
-    this->keyframes_.emplace(new_kf->fid_, new_kf);
+    if (this->keyframes_.emplace(new_kf->fid_, new_kf).second)
+        this->keyframe_sampler_.add(new_kf);
     *shuffled = false;
 }
 
+void GaussianScene::eraseKeyframe(std::size_t fid)
+{
+    std::unique_lock<std::mutex> lock_kfs(this->mutex_kfs_);
+    this->keyframes_.erase(fid);
+    this->keyframe_sampler_.erase(fid);
+}
+
 std::shared_ptr<GaussianKeyframe>
 GaussianScene::getKeyframe(std::size_t fid)
 {
@@ -0,0 +1,203 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/gaussian_spatial_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+// 21 bits per axis, voxel coordinates in [-KEY_RANGE, KEY_RANGE)
+constexpr std::int64_t KEY_RANGE = 1LL << 20;
+constexpr std::int64_t KEY_SHIFT_Y = 1LL << 21;
+constexpr std::int64_t KEY_SHIFT_X = 1LL << 42;
+
+torch::Tensor decodeKeys(const torch::Tensor& keys)
+{
+    torch::Tensor x = torch::div(keys, KEY_SHIFT_X, "floor");
+    torch::Tensor y = torch::div(keys - x * KEY_SHIFT_X, KEY_SHIFT_Y, "floor");
+    torch::Tensor z = keys - x * KEY_SHIFT_X - y * KEY_SHIFT_Y;
+    return torch::stack({x, y, z}, /*dim=*/1) - KEY_RANGE;
+}
+
+}
+
+void GaussianSpatialIndex::setVoxelSize(float voxel_size)
+{
+    if (!(voxel_size > 0.0f))
+        throw std::runtime_error("[GaussianSpatialIndex]Voxel size must be positive");
+    if (voxel_size != voxel_size_)
+        invalidate();
+    voxel_size_ = voxel_size;
+}
+
+/**
+ * @brief (N,) int64 keys of the voxels holding `xyz` (N, 3)
+ */
+torch::Tensor GaussianSpatialIndex::keysOf(const torch::Tensor& xyz) const
+{
+    torch::NoGradGuard no_grad;
+    torch::Tensor coords = torch::floor(xyz.detach().reshape({-1, 3}) / voxel_size_)
+                               .clamp(-KEY_RANGE, KEY_RANGE - 1)
+                               .to(torch::kLong) + KEY_RANGE;
+    return coords.select(1, 0) * KEY_SHIFT_X + coords.select(1, 1) * KEY_SHIFT_Y + coords.select(1, 2);
+}
+
+/**
+ * @brief Sort the rows by key into the table of occupied cells
+ */
+void GaussianSpatialIndex::build(const torch::Tensor& keys)
+{
+    torch::NoGradGuard no_grad;
+    auto sorted = keys.sort();
+    torch::Tensor sorted_keys = std::get<0>(sorted);
+    sorted_rows_ = std::get<1>(sorted);
+
+    auto cells = torch::unique_consecutive(sorted_keys, /*return_inverse=*/false, /*return_counts=*/true);
+    cell_keys_ = std::get<0>(cells);
+    cell_counts_ = std::get<2>(cells);
+    cell_starts_ = cell_counts_.cumsum(0) - cell_counts_;
+
+    torch::Tensor coords = decodeKeys(cell_keys_);
+    cell_min_ = coords.to(torch::kFloat) * voxel_size_;
+    cell_unbounded_ = torch::logical_or(coords == -KEY_RANGE, coords == KEY_RANGE - 1).any(/*dim=*/1);
+
+    num_indexed_ = keys.size(0);
+    moved_rows_ = torch::empty({0}, sorted_rows_.options());
+    valid_ = true;
+}
+
+void GaussianSpatialIndex::invalidate()
+{
+    valid_ = false;
+    num_indexed_ = 0;
+    sorted_rows_ = torch::Tensor();
+    cell_keys_ = torch::Tensor();
+    cell_starts_ = torch::Tensor();
+    cell_counts_ = torch::Tensor();
+    cell_min_ = torch::Tensor();
+    cell_unbounded_ = torch::Tensor();
+    moved_rows_ = torch::Tensor();
+}
+
+/**
+ * @brief The points of `rows` may have left their cells, keep them as candidates until the next build
+ */
+void GaussianSpatialIndex::markMoved(const torch::Tensor& rows)
+{
+    if (!valid_ || rows.numel() == 0)
+        return;
+    moved_rows_ = torch::cat({moved_rows_, rows.to(torch::kLong)}, /*dim=*/0);
+}
+
+/**
+ * @brief Candidate rows in front of the near plane of a view,
+ *        the same test as in_frustum() of the rasterizer
+ *
+ * @param viewmatrix (4, 4) world to view, transposed (p_view = [p, 1] * viewmatrix)
+ */
+torch::Tensor GaussianSpatialIndex::queryFrustum(
+    const torch::Tensor& viewmatrix,
+    float znear,
+    std::int64_t num_points) const
+{
+    if (!valid_)
+        throw std::runtime_error("[GaussianSpatialIndex]Query before build");
+    torch::NoGradGuard no_grad;
+    torch::Tensor view = viewmatrix.to(cell_min_.device(), torch::kFloat);
+    torch::Tensor w = view.index({torch::indexing::Slice(0, 3), 2});
+    // Farthest depth of each cell box: its center plus the half extent projected on the view axis
+    float half = 0.5f * voxel_size_;
+    torch::Tensor centers = cell_min_ + half;
+    torch::Tensor z_max = centers.matmul(w) + view.index({3, 2}) + half * w.abs().sum();
+    return rowsOfCells(torch::logical_or(z_max > znear, cell_unbounded_), num_points);
+}
+
+/**
+ * @brief Candidate rows inside the axis-aligned box [box_min, box_max]
+ */
+torch::Tensor GaussianSpatialIndex::queryBox(
+    const torch::Tensor& box_min,
+    const torch::Tensor& box_max,
+    std::int64_t num_points) const
+{
+    if (!valid_)
+        throw std::runtime_error("[GaussianSpatialIndex]Query before build");
+    torch::NoGradGuard no_grad;
+    torch::Tensor lo = box_min.to(cell_min_.device(), torch::kFloat).view({1, 3});
+    torch::Tensor hi = box_max.to(cell_min_.device(), torch::kFloat).view({1, 3});
+    torch::Tensor overlap = torch::logical_and(cell_min_ <= hi, cell_min_ + voxel_size_ >= lo).all(/*dim=*/1);
+    return rowsOfCells(torch::logical_or(overlap, cell_unbounded_), num_points);
+}
+
+/**
+ * @brief Candidate rows in the cells of `keys` and the ring of cells around them
+ */
+torch::Tensor GaussianSpatialIndex::queryNeighborCells(
+    const torch::Tensor& keys,
+    std::int64_t num_points) const
+{
+    if (!valid_)
+        throw std::runtime_error("[GaussianSpatialIndex]Query before build");
+    torch::NoGradGuard no_grad;
+    torch::Tensor centers = std::get<0>(torch::_unique(keys.to(cell_keys_.device(), torch::kLong), /*sorted=*/false));
+    torch::Tensor ring = torch::arange(-1, 2, centers.options());
+    torch::Tensor offsets = (ring.view({3, 1, 1}) * KEY_SHIFT_X
+                             + ring.view({1, 3, 1}) * KEY_SHIFT_Y
+                             + ring.view({1, 1, 3})).view({1, 27});
+    torch::Tensor wanted = (centers.unsqueeze(1) + offsets).view({-1});
+
+    torch::Tensor cell_mask = cell_unbounded_.clone();
+    if (cell_keys_.size(0) > 0) {
+        torch::Tensor pos = torch::searchsorted(cell_keys_, wanted).clamp_max(cell_keys_.size(0) - 1);
+        cell_mask.index_fill_(0, pos.masked_select(cell_keys_.index_select(0, pos) == wanted), true);
+    }
+    return rowsOfCells(cell_mask, num_points);
+}
+
+/**
+ * @brief Rows of the kept cells, plus the moved rows and those appended after the build,
+ *        restricted to the first `num_points` rows
+ */
+torch::Tensor GaussianSpatialIndex::rowsOfCells(const torch::Tensor& cell_mask, std::int64_t num_points) const
+{
+    torch::Tensor cells = cell_mask.nonzero().squeeze(1);
+    torch::Tensor counts = cell_counts_.index_select(0, cells);
+    torch::Tensor starts = cell_starts_.index_select(0, cells);
+
+    // Expand the [start, start + count) ranges of the kept cells into positions in sorted_rows_
+    torch::Tensor offsets = counts.cumsum(0) - counts;
+    torch::Tensor owner = torch::repeat_interleave(counts);
+    torch::Tensor positions = torch::arange(owner.size(0), owner.options())
+                              - offsets.index_select(0, owner) + starts.index_select(0, owner);
+    torch::Tensor rows = sorted_rows_.index_select(0, positions);
+
+    torch::Tensor appended = torch::arange(std::min(num_indexed_, num_points), num_points, rows.options());
+    torch::Tensor candidates = rows;
+    if (hasMoved()) {
+        // A moved row may also still be listed in its former cell
+        candidates = torch::cat({rows, moved_rows_}, /*dim=*/0);
+        candidates = std::get<0>(torch::_unique(candidates, /*sorted=*/true));
+    }
+    if (num_points < num_indexed_)
+        return candidates.masked_select(candidates < num_points);
+    return torch::cat({candidates, appended}, /*dim=*/0);
+}
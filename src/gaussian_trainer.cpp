@@ -52,14 +52,7 @@ void GaussianTrainer::trainingOnce(
             gaussians->oneUpShDegree();
 
         // Pick a random Camera
-        std::map<std::size_t, std::shared_ptr<GaussianKeyframe>> viewpoint_stack; // .empty() <=> None
-        if (viewpoint_stack.empty())
-            viewpoint_stack = scene->keyframes();
-        int random_cam_idx = std::rand() / ((RAND_MAX + 1u) / static_cast<int>(viewpoint_stack.size()));
-        auto random_cam_it = viewpoint_stack.begin();
-        for (int cam_idx = 0; cam_idx < random_cam_idx; ++cam_idx)
-            ++random_cam_it;
-        std::shared_ptr<GaussianKeyframe> viewpoint_cam = (*random_cam_it).second;
+        std::shared_ptr<GaussianKeyframe> viewpoint_cam = scene->keyframe_sampler_.sampleAny();
 
         // Render
         auto override_color = torch::empty(0, torch::TensorOptions().device(torch::kCUDA));
@@ -78,7 +71,7 @@ void GaussianTrainer::trainingOnce(
         auto radii = std::get<3>(render_pkg);
 
         // Loss
-        auto gt_image = viewpoint_cam->original_image_.cuda();
+        auto gt_image = viewpoint_cam->getOriginalImage(torch::kCUDA);
         auto Ll1 = loss_utils::l1_loss(image, gt_image);
         auto loss = (1.0 - opt.lambda_dssim_) * Ll1 + opt.lambda_dssim_ * (1.0 - loss_utils::ssim(image, gt_image));
         loss.backward();
@@ -127,8 +120,8 @@ void GaussianTrainer::trainingOnce(
 
             // Optimizer step
             if (iteration < opt.iterations_) {
-                gaussians->optimizer_->step();
-                gaussians->optimizer_->zero_grad(true);
+                gaussians->optimizer_->step(visibility_filter);
+                gaussians->optimizer_->zeroGrad();
             }
         }
     }
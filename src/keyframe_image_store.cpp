@@ -0,0 +1,219 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/keyframe_image_store.h"
+
+#include <limits>
+
+#include "include/tensor_utils.h"
+
+KeyframeImageStore::KeyframeImageStore(std::size_t budget_bytes)
+    : budget_bytes_(budget_bytes)
+{}
+
+void KeyframeImageStore::setBudget(std::size_t budget_bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    budget_bytes_ = budget_bytes;
+    evict();
+}
+
+std::size_t KeyframeImageStore::budget()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return budget_bytes_;
+}
+
+std::size_t KeyframeImageStore::cachedBytes()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cached_bytes_;
+}
+
+std::size_t KeyframeImageStore::numCachedLevels()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return levels_.size();
+}
+
+/**
+ * @brief The `level` of keyframe `fid` resized to `size`, in the type of `full_image`.
+ *        The returned mat stays valid after it is evicted.
+ */
+cv::Mat KeyframeImageStore::level(
+    std::size_t fid,
+    int level,
+    const cv::Mat& full_image,
+    const cv::Size& size)
+{
+    LevelKey key(fid, level, false);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = levels_.find(key);
+        if (it != levels_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru_it_);
+            return it->second.image_;
+        }
+    }
+
+    // Resize without holding the lock, the ingestion workers fill the store concurrently
+    cv::Mat image_resized;
+    cv::resize(full_image, image_resized, size);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = levels_.find(key);
+    if (it != levels_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it_);
+        return it->second.image_;
+    }
+    insert(key, image_resized, torch::Tensor());
+    return image_resized;
+}
+
+torch::Tensor KeyframeImageStore::levelTensor(
+    std::size_t fid,
+    int level,
+    const cv::Mat& full_image,
+    const cv::Size& size,
+    torch::DeviceType device_type)
+{
+    return toTensor(this->level(fid, level, full_image, size), device_type);
+}
+
+/**
+ * @brief Float tensor of the `level` of keyframe `fid` kept on the training device,
+ *        converted again from the 8-bit level once evicted. A level of the size of
+ *        `full_image` is converted from it directly.
+ */
+torch::Tensor KeyframeImageStore::deviceLevel(
+    std::size_t fid,
+    int level,
+    const cv::Mat& full_image,
+    const cv::Size& size,
+    torch::DeviceType device_type)
+{
+    LevelKey key(fid, level, true);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = levels_.find(key);
+        if (it != levels_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru_it_);
+            return it->second.tensor_;
+        }
+    }
+
+    cv::Mat image = (size == full_image.size()) ? full_image : this->level(fid, level, full_image, size);
+    torch::Tensor tensor = toTensor(image, device_type);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = levels_.find(key);
+    if (it != levels_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it_);
+        return it->second.tensor_;
+    }
+    insert(key, cv::Mat(), tensor);
+    return tensor;
+}
+
+void KeyframeImageStore::erase(std::size_t fid)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = levels_.lower_bound(LevelKey(fid, std::numeric_limits<int>::min(), false));
+    while (it != levels_.end() && std::get<0>(it->first) == fid) {
+        cached_bytes_ -= it->second.numBytes();
+        lru_.erase(it->second.lru_it_);
+        it = levels_.erase(it);
+    }
+}
+
+void KeyframeImageStore::clear()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    levels_.clear();
+    lru_.clear();
+    cached_bytes_ = 0;
+}
+
+/**
+ * @brief 8-bit copy of an RGB image, float images are taken to be in [0, 1]
+ */
+cv::Mat KeyframeImageStore::toStorage(const cv::Mat& image)
+{
+    if (image.empty() || image.depth() == CV_8U)
+        return image;
+    cv::Mat image_8u;
+    if (image.depth() == CV_16U)
+        image.convertTo(image_8u, CV_MAKETYPE(CV_8U, image.channels()), 255.0 / 65535.0);
+    else
+        image.convertTo(image_8u, CV_MAKETYPE(CV_8U, image.channels()), 255.0);
+    return image_8u;
+}
+
+/**
+ * @brief {channels, rows, cols} float tensor in [0, 1] of an 8-bit or float image
+ */
+torch::Tensor KeyframeImageStore::toTensor(const cv::Mat& image, torch::DeviceType device_type)
+{
+    if (image.depth() == CV_8U)
+        return tensor_utils::cvMat8U2TorchTensor_Float32(image, device_type);
+    cv::Mat image_float = image;
+    if (image.depth() != CV_32F)
+        image.convertTo(image_float, CV_MAKETYPE(CV_32F, image.channels()));
+    else if (!image.isContinuous())
+        image_float = image.clone();
+    return tensor_utils::cvMat2TorchTensor_Float32(image_float, device_type);
+}
+
+std::size_t KeyframeImageStore::CachedLevel::numBytes() const
+{
+    std::size_t num_bytes = image_.total() * image_.elemSize();
+    if (tensor_.defined())
+        num_bytes += tensor_.numel() * tensor_.element_size();
+    return num_bytes;
+}
+
+/**
+ * @brief Add an entry as the most recently used one. Requires the lock.
+ */
+void KeyframeImageStore::insert(const LevelKey& key, const cv::Mat& image, const torch::Tensor& tensor)
+{
+    lru_.push_front(key);
+    CachedLevel& cached = levels_[key];
+    cached.image_ = image;
+    cached.tensor_ = tensor;
+    cached.lru_it_ = lru_.begin();
+    cached_bytes_ += cached.numBytes();
+    evict();
+}
+
+/**
+ * @brief Drop the least recently used levels until the budget is met,
+ *        the level just inserted is always kept. Requires the lock.
+ */
+void KeyframeImageStore::evict()
+{
+    if (budget_bytes_ == 0)
+        return;
+    while (cached_bytes_ > budget_bytes_ && lru_.size() > 1) {
+        auto it = levels_.find(lru_.back());
+        cached_bytes_ -= it->second.numBytes();
+        levels_.erase(it);
+        lru_.pop_back();
+    }
+}
@@ -0,0 +1,377 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "include/keyframe_sampler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+KeyframeSampler::KeyframeSampler(unsigned int seed)
+    : rng_(seed)
+{}
+
+void KeyframeSampler::seed(unsigned int seed)
+{
+    rng_.seed(seed);
+}
+
+void KeyframeSampler::setMode(Mode mode)
+{
+    if (mode_ == mode)
+        return;
+    mode_ = mode;
+    rebuildWeights();
+}
+
+void KeyframeSampler::add(std::shared_ptr<GaussianKeyframe> pkf)
+{
+    auto it = slot_of_fid_.find(pkf->fid_);
+    if (it != slot_of_fid_.end()) {
+        // Replace the keyframe with the same id
+        keyframes_[it->second] = pkf;
+        refresh(it->second);
+        return;
+    }
+
+    std::size_t slot = keyframes_.size();
+    slot_of_fid_.emplace(pkf->fid_, slot);
+    keyframes_.emplace_back(pkf);
+    losses_.emplace_back(default_loss_);
+    excluded_.emplace_back(0);
+    available_pos_.emplace_back(-1);
+
+    // Append a Fenwick node covering (slot + 1 - lowbit, slot + 1]
+    std::size_t node = slot + 1;
+    std::size_t lowbit = node & (~node + 1);
+    double covered = 0.0;
+    for (std::size_t i = node - 1; i > node - lowbit; i -= i & (~i + 1))
+        covered += fenwick_[i];
+    weights_.emplace_back(0.0);
+    if (fenwick_.empty())
+        fenwick_.emplace_back(0.0);
+    fenwick_.emplace_back(covered);
+
+    refresh(slot);
+}
+
+void KeyframeSampler::erase(std::size_t fid)
+{
+    auto it = slot_of_fid_.find(fid);
+    if (it == slot_of_fid_.end())
+        return;
+    std::size_t slot = it->second;
+    std::size_t last = keyframes_.size() - 1;
+    slot_of_fid_.erase(it);
+
+    // Take the slot out of the available set and the weights
+    setAvailable(slot, false);
+    setWeight(slot, 0.0);
+
+    // Move the last keyframe into the freed slot
+    if (slot != last) {
+        keyframes_[slot] = keyframes_[last];
+        losses_[slot] = losses_[last];
+        excluded_[slot] = excluded_[last];
+        slot_of_fid_[keyframes_[slot]->fid_] = slot;
+        std::ptrdiff_t pos = available_pos_[last];
+        available_pos_[slot] = pos;
+        if (pos >= 0)
+            available_[pos] = slot;
+        setWeight(slot, weights_[last]);
+    }
+
+    // Dropping the last Fenwick node leaves all other partial sums valid
+    keyframes_.pop_back();
+    losses_.pop_back();
+    excluded_.pop_back();
+    available_pos_.pop_back();
+    weights_.pop_back();
+    fenwick_.pop_back();
+}
+
+void KeyframeSampler::clear()
+{
+    keyframes_.clear();
+    slot_of_fid_.clear();
+    losses_.clear();
+    excluded_.clear();
+    available_.clear();
+    available_pos_.clear();
+    weights_.clear();
+    fenwick_.clear();
+}
+
+void KeyframeSampler::increaseTimesOfUse(std::shared_ptr<GaussianKeyframe> pkf, int times)
+{
+    pkf->remaining_times_of_use_ += times;
+    auto it = slot_of_fid_.find(pkf->fid_);
+    if (it != slot_of_fid_.end() && keyframes_[it->second] == pkf)
+        refresh(it->second);
+}
+
+void KeyframeSampler::increaseAllTimesOfUse(int times)
+{
+    for (std::size_t slot = 0; slot < keyframes_.size(); ++slot) {
+        keyframes_[slot]->remaining_times_of_use_ += times;
+        setAvailable(slot, isAvailable(slot));
+    }
+    rebuildWeights();
+}
+
+void KeyframeSampler::setLoss(std::size_t fid, float loss)
+{
+    auto it = slot_of_fid_.find(fid);
+    if (it == slot_of_fid_.end())
+        return;
+    losses_[it->second] = loss;
+    if (mode_ == LOSS)
+        setWeight(it->second, weightOf(it->second));
+}
+
+/**
+ * @brief Leave a keyframe out of picking, or put it back, keeping its times of use
+ */
+void KeyframeSampler::setExcluded(std::size_t fid, bool excluded)
+{
+    auto it = slot_of_fid_.find(fid);
+    if (it == slot_of_fid_.end() || static_cast<bool>(excluded_[it->second]) == excluded)
+        return;
+    excluded_[it->second] = excluded;
+    refresh(it->second);
+}
+
+void KeyframeSampler::includeAll()
+{
+    for (std::size_t slot = 0; slot < keyframes_.size(); ++slot) {
+        if (excluded_[slot]) {
+            excluded_[slot] = 0;
+            refresh(slot);
+        }
+    }
+}
+
+/**
+ * @brief Pick an available keyframe and consume one of its times of use.
+ *        Like the sliding window, all keyframes get one more time of use
+ *        once none is left.
+ */
+std::shared_ptr<GaussianKeyframe> KeyframeSampler::useOne()
+{
+    if (keyframes_.empty())
+        return nullptr;
+    if (available_.empty())
+        increaseAllTimesOfUse(1);
+    if (available_.empty())
+        return nullptr;
+
+    std::size_t slot = pickAvailable();
+    std::shared_ptr<GaussianKeyframe> pkf = keyframes_[slot];
+    --(pkf->remaining_times_of_use_);
+    refresh(slot);
+    return pkf;
+}
+
+/**
+ * @brief Uniformly pick any keyframe, ignoring times of use
+ */
+std::shared_ptr<GaussianKeyframe> KeyframeSampler::sampleAny()
+{
+    if (keyframes_.empty())
+        return nullptr;
+    std::uniform_int_distribution<std::size_t> dist(0, keyframes_.size() - 1);
+    return keyframes_[dist(rng_)];
+}
+
+/**
+ * @brief Mode, random engine, slot order, losses and available order,
+ *        enough to pick the same keyframes again after loadState()
+ */
+std::string KeyframeSampler::saveState() const
+{
+    std::ostringstream out;
+    out << static_cast<int>(mode_) << " " << rng_ << " " << keyframes_.size();
+    for (std::size_t slot = 0; slot < keyframes_.size(); ++slot) {
+        // Losses as raw bits, to be restored exactly
+        std::uint32_t loss_bits;
+        std::memcpy(&loss_bits, &losses_[slot], sizeof(loss_bits));
+        out << " " << keyframes_[slot]->fid_ << " " << loss_bits;
+    }
+    out << " " << available_.size();
+    for (auto slot : available_)
+        out << " " << keyframes_[slot]->fid_;
+    return out.str();
+}
+
+/**
+ * @brief Restore a saveState() over the same set of keyframes, whose remaining
+ *        times of use must already be restored. Returns false and keeps the
+ *        current state if the keyframes differ.
+ */
+bool KeyframeSampler::loadState(const std::string& state)
+{
+    std::istringstream in(state);
+    int mode;
+    std::mt19937 rng;
+    std::size_t num_keyframes;
+    in >> mode >> rng >> num_keyframes;
+    if (!in || num_keyframes != keyframes_.size())
+        return false;
+
+    std::vector<std::shared_ptr<GaussianKeyframe>> keyframes(num_keyframes);
+    std::vector<float> losses(num_keyframes);
+    std::unordered_map<std::size_t, std::size_t> slot_of_fid;
+    for (std::size_t slot = 0; slot < num_keyframes; ++slot) {
+        std::size_t fid;
+        std::uint32_t loss_bits;
+        in >> fid >> loss_bits;
+        auto it = slot_of_fid_.find(fid);
+        if (!in || it == slot_of_fid_.end() || !slot_of_fid.emplace(fid, slot).second)
+            return false;
+        keyframes[slot] = keyframes_[it->second];
+        std::memcpy(&losses[slot], &loss_bits, sizeof(loss_bits));
+    }
+    std::size_t num_available;
+    in >> num_available;
+    if (!in || num_available > num_keyframes)
+        return false;
+    std::vector<std::size_t> available(num_available);
+    std::vector<std::ptrdiff_t> available_pos(num_keyframes, -1);
+    for (std::size_t pos = 0; pos < num_available; ++pos) {
+        std::size_t fid;
+        in >> fid;
+        auto it = slot_of_fid.find(fid);
+        if (!in || it == slot_of_fid.end() || available_pos[it->second] >= 0)
+            return false;
+        available[pos] = it->second;
+        available_pos[it->second] = pos;
+    }
+
+    mode_ = static_cast<Mode>(mode);
+    rng_ = rng;
+    keyframes_.swap(keyframes);
+    slot_of_fid_.swap(slot_of_fid);
+    losses_.swap(losses);
+    available_.swap(available);
+    available_pos_.swap(available_pos);
+    excluded_.assign(num_keyframes, 0);
+    weights_.assign(num_keyframes, 0.0);
+    rebuildWeights();
+    return true;
+}
+
+std::size_t KeyframeSampler::pickAvailable()
+{
+    if (mode_ != UNIFORM && !fenwick_.empty()) {
+        std::size_t n = keyframes_.size();
+        double total = 0.0;
+        for (std::size_t i = n; i > 0; i -= i & (~i + 1))
+            total += fenwick_[i];
+        if (total > 0.0) {
+            // Descend the Fenwick tree to the first slot whose prefix sum exceeds the target
+            double target = std::uniform_real_distribution<double>(0.0, total)(rng_);
+            std::size_t node = 0;
+            std::size_t step = 1;
+            while ((step << 1) <= n)
+                step <<= 1;
+            for (; step > 0; step >>= 1) {
+                if (node + step <= n && fenwick_[node + step] <= target) {
+                    node += step;
+                    target -= fenwick_[node];
+                }
+            }
+            // Guard against rounding in the partial sums
+            if (node < n && available_pos_[node] >= 0)
+                return node;
+        }
+    }
+
+    std::uniform_int_distribution<std::size_t> dist(0, available_.size() - 1);
+    return available_[dist(rng_)];
+}
+
+bool KeyframeSampler::isAvailable(std::size_t slot) const
+{
+    return keyframes_[slot]->remaining_times_of_use_ > 0 && !excluded_[slot];
+}
+
+/**
+ * @brief Update the availability and the weight of a slot after its keyframe changed
+ */
+void KeyframeSampler::refresh(std::size_t slot)
+{
+    setAvailable(slot, isAvailable(slot));
+    setWeight(slot, weightOf(slot));
+}
+
+/**
+ * @brief O(1) insertion into or swap-removal from the available set
+ */
+void KeyframeSampler::setAvailable(std::size_t slot, bool available)
+{
+    if (available && available_pos_[slot] < 0) {
+        available_pos_[slot] = available_.size();
+        available_.emplace_back(slot);
+    }
+    else if (!available && available_pos_[slot] >= 0) {
+        std::size_t moved = available_.back();
+        available_[available_pos_[slot]] = moved;
+        available_pos_[moved] = available_pos_[slot];
+        available_.pop_back();
+        available_pos_[slot] = -1;
+    }
+}
+
+double KeyframeSampler::weightOf(std::size_t slot) const
+{
+    if (available_pos_[slot] < 0)
+        return 0.0;
+    switch (mode_)
+    {
+    case TIMES_OF_USE:
+        return static_cast<double>(keyframes_[slot]->remaining_times_of_use_);
+    case LOSS:
+        return std::max(static_cast<double>(losses_[slot]), 1e-6);
+    default:
+        return 1.0;
+    }
+}
+
+void KeyframeSampler::setWeight(std::size_t slot, double weight)
+{
+    double delta = weight - weights_[slot];
+    if (delta == 0.0)
+        return;
+    weights_[slot] = weight;
+    for (std::size_t i = slot + 1; i < fenwick_.size(); i += i & (~i + 1))
+        fenwick_[i] += delta;
+}
+
+void KeyframeSampler::rebuildWeights()
+{
+    std::size_t n = keyframes_.size();
+    fenwick_.assign(n + 1, 0.0);
+    for (std::size_t slot = 0; slot < n; ++slot) {
+        weights_[slot] = weightOf(slot);
+        std::size_t node = slot + 1;
+        fenwick_[node] += weights_[slot];
+        std::size_t parent = node + (node & (~node + 1));
+        if (parent <= n)
+            fenwick_[parent] += fenwick_[node];
+    }
+}
@@ -79,6 +79,14 @@ void transformPoints(
     }
 
     const int P = points.size(0);
+    if (!points.is_cuda()) {
+        // p' = p R^T + t with `transformmatrix` stored transposed, as one GEMM
+        torch::Tensor matrix = transformmatrix.to(points.device(), torch::kFloat);
+        if (P != 0)
+            points = torch::addmm(matrix.index({3, torch::indexing::Slice(0, 3)}), points,
+                                  matrix.index({torch::indexing::Slice(0, 3), torch::indexing::Slice(0, 3)}));
+        return;
+    }
     torch::Tensor transformed_points = torch::zeros_like(points);
 
     if (P != 0) {
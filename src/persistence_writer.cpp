@@ -0,0 +1,171 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/persistence_writer.h"
+
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+PersistenceWriter::~PersistenceWriter()
+{
+    stop();
+}
+
+void PersistenceWriter::start(int num_workers, std::size_t memory_budget_bytes)
+{
+    stop();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        memory_budget_bytes_ = memory_budget_bytes;
+        stop_ = false;
+        running_ = num_workers > 0;
+    }
+    for (int i = 0; i < num_workers; ++i)
+        workers_.emplace_back(&PersistenceWriter::workerLoop, this);
+}
+
+/**
+ * @brief Finish every submitted job and join the workers
+ */
+void PersistenceWriter::stop()
+{
+    wait();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+        running_ = false;
+    }
+    cv_job_.notify_all();
+    for (auto& worker : workers_)
+        if (worker.joinable())
+            worker.join();
+    workers_.clear();
+}
+
+void PersistenceWriter::submit(const std::string& name, std::size_t num_bytes, std::function<void()> job)
+{
+    Job new_job{name, num_bytes, std::move(job), Clock::now()};
+    bool queued = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (running_) {
+            cv_done_.wait(lock, [this, num_bytes] {
+                return num_pending_ == 0 || pending_bytes_ + num_bytes <= memory_budget_bytes_; });
+            pending_bytes_ += num_bytes;
+            ++num_pending_;
+            queue_.emplace_back(std::move(new_job));
+            queued = true;
+        }
+    }
+    if (queued)
+        cv_job_.notify_one();
+    else
+        run(new_job);
+}
+
+/**
+ * @brief Block until every submitted job has finished
+ */
+void PersistenceWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_done_.wait(lock, [this] { return num_pending_ == 0; });
+}
+
+std::uint64_t PersistenceWriter::numCompleted()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return num_completed_;
+}
+
+std::uint64_t PersistenceWriter::numFailed()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return num_failed_;
+}
+
+std::size_t PersistenceWriter::pendingBytes()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return pending_bytes_;
+}
+
+double PersistenceWriter::lastLatencyMs()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return last_latency_ms_;
+}
+
+void PersistenceWriter::workerLoop()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_job_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        run(job);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pending_bytes_ -= job.num_bytes_;
+            --num_pending_;
+        }
+        cv_done_.notify_all();
+    }
+}
+
+void PersistenceWriter::run(Job& job)
+{
+    auto start_time = Clock::now();
+    bool failed = false;
+    try {
+        job.job_();
+    }
+    catch (const std::exception& e) {
+        failed = true;
+        std::cerr << "[Gaussian Mapper]Failed to write " << job.name_ << ": " << e.what() << std::endl;
+    }
+    // Release the snapshot before the bytes are returned to the budget
+    job.job_ = nullptr;
+    auto end_time = Clock::now();
+
+    double latency_ms = std::chrono::duration<double, std::milli>(end_time - job.submit_time_).count();
+    double queued_ms = std::chrono::duration<double, std::milli>(start_time - job.submit_time_).count();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (failed)
+            ++num_failed_;
+        else
+            ++num_completed_;
+        last_latency_ms_ = latency_ms;
+    }
+    if (!failed) {
+        std::ostringstream report;
+        report << "[Gaussian Mapper]Wrote " << job.name_ << " in " << std::fixed << std::setprecision(1)
+               << latency_ms << " ms (" << queued_ms << " ms queued)";
+        std::cout << report.str() << std::endl;
+    }
+}
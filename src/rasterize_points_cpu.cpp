@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2023, Inria
+ * GRAPHDECO research group, https://team.inria.fr/graphdeco
+ * All rights reserved.
+ *
+ * This software is free for non-commercial, research and evaluation use
+ * under the terms of the LICENSE.md file.
+ *
+ * For inquiries contact  george.drettakis@inria.fr
+ *
+ * This file is Derivative Works of Gaussian Splatting,
+ * created by Longwei Li, Huajian Huang, Hui Cheng and Sai-Kit Yeung in 2023,
+ * as part of Photo-SLAM.
+ */
+
+#include <torch/torch.h>
+#include <tuple>
+#include <functional>
+#include "cuda_rasterizer/config.h"
+#include "cpu_rasterizer/rasterizer.h"
+#include "include/rasterize_points_cpu.h"
+
+namespace {
+
+std::function<char*(size_t N)> resizeFunctional(torch::Tensor& t) {
+	auto lambda = [&t](size_t N) {
+		t.resize_({(long long)N});
+		return reinterpret_cast<char*>(t.contiguous().data_ptr());
+	};
+	return lambda;
+}
+
+// Contiguous float32 host copy (a no-op for tensors that already are)
+inline torch::Tensor hostFloat(const torch::Tensor& t)
+{
+	return t.to(torch::kCPU, torch::kFloat32).contiguous();
+}
+
+// Empty tensors stand for "not provided", as in the CUDA path
+template <typename T>
+inline T* optionalPtr(const torch::Tensor& t)
+{
+	return t.numel() == 0 ? nullptr : t.data_ptr<T>();
+}
+
+}
+
+std::tuple<int, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
+RasterizeGaussiansCPU(
+	const torch::Tensor& background,
+	const torch::Tensor& means3D,
+	const torch::Tensor& colors,
+	const torch::Tensor& opacity,
+	const torch::Tensor& scales,
+	const torch::Tensor& rotations,
+	const float scale_modifier,
+	const torch::Tensor& cov3D_precomp,
+	const torch::Tensor& viewmatrix,
+	const torch::Tensor& projmatrix,
+	const float tan_fovx,
+	const float tan_fovy,
+	const int image_height,
+	const int image_width,
+	const torch::Tensor& sh,
+	const int degree,
+	const torch::Tensor& campos,
+	const bool prefiltered)
+{
+  if (means3D.ndimension() != 2 || means3D.size(1) != 3) {
+    AT_ERROR("means3D must have dimensions (num_points, 3)");
+  }
+  if (means3D.is_cuda()) {
+    AT_ERROR("RasterizeGaussiansCPU expects means3D on the CPU");
+  }
+
+  const int P = means3D.size(0);
+  const int H = image_height;
+  const int W = image_width;
+
+  auto float_opts = means3D.options().dtype(torch::kFloat32);
+
+  torch::Tensor out_color = torch::full({NUM_CHANNELS, H, W}, 0.0, float_opts);
+  torch::Tensor radii = torch::full({P}, 0, means3D.options().dtype(torch::kInt32));
+
+  torch::TensorOptions options(torch::kByte);
+  torch::Tensor geomBuffer = torch::empty({0}, options.device(torch::kCPU));
+  torch::Tensor binningBuffer = torch::empty({0}, options.device(torch::kCPU));
+  torch::Tensor imgBuffer = torch::empty({0}, options.device(torch::kCPU));
+  std::function<char*(size_t)> geomFunc = resizeFunctional(geomBuffer);
+  std::function<char*(size_t)> binningFunc = resizeFunctional(binningBuffer);
+  std::function<char*(size_t)> imgFunc = resizeFunctional(imgBuffer);
+
+  int rendered = 0;
+  if(P != 0)
+  {
+	  int M = 0;
+	  if(sh.size(0) != 0)
+	  {
+		M = sh.size(1);
+	  }
+
+	  auto bg_ = hostFloat(background);
+	  auto means3D_ = means3D.contiguous();
+	  auto sh_ = sh.contiguous();
+	  auto colors_ = colors.contiguous();
+	  auto opacity_ = opacity.contiguous();
+	  auto scales_ = scales.contiguous();
+	  auto rotations_ = rotations.contiguous();
+	  auto cov3D_precomp_ = cov3D_precomp.contiguous();
+	  auto viewmatrix_ = hostFloat(viewmatrix);
+	  auto projmatrix_ = hostFloat(projmatrix);
+	  auto campos_ = hostFloat(campos);
+
+	  rendered = CpuRasterizer::Rasterizer::forward(
+		geomFunc,
+		binningFunc,
+		imgFunc,
+		P, degree, M,
+		bg_.data_ptr<float>(),
+		W, H,
+		means3D_.data_ptr<float>(),
+		optionalPtr<float>(sh_),
+		optionalPtr<float>(colors_),
+		opacity_.data_ptr<float>(),
+		optionalPtr<float>(scales_),
+		scale_modifier,
+		optionalPtr<float>(rotations_),
+		optionalPtr<float>(cov3D_precomp_),
+		viewmatrix_.data_ptr<float>(),
+		projmatrix_.data_ptr<float>(),
+		campos_.data_ptr<float>(),
+		tan_fovx,
+		tan_fovy,
+		prefiltered,
+		out_color.data_ptr<float>(),
+		radii.data_ptr<int>());
+  }
+  return std::make_tuple(rendered, out_color, radii, geomBuffer, binningBuffer, imgBuffer);
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
+RasterizeGaussiansBackwardCPU(
+	const torch::Tensor& background,
+	const torch::Tensor& means3D,
+	const torch::Tensor& radii,
+	const torch::Tensor& colors,
+	const torch::Tensor& scales,
+	const torch::Tensor& rotations,
+	const float scale_modifier,
+	const torch::Tensor& cov3D_precomp,
+	const torch::Tensor& viewmatrix,
+	const torch::Tensor& projmatrix,
+	const float tan_fovx,
+	const float tan_fovy,
+	const torch::Tensor& dL_dout_color,
+	const torch::Tensor& sh,
+	const int degree,
+	const torch::Tensor& campos,
+	const torch::Tensor& geomBuffer,
+	const int R,
+	const torch::Tensor& binningBuffer,
+	const torch::Tensor& imageBuffer)
+{
+  const int P = means3D.size(0);
+  const int H = dL_dout_color.size(1);
+  const int W = dL_dout_color.size(2);
+
+  int M = 0;
+  if(sh.size(0) != 0)
+  {
+	M = sh.size(1);
+  }
+
+  torch::Tensor dL_dmeans3D = torch::zeros({P, 3}, means3D.options());
+  torch::Tensor dL_dmeans2D = torch::zeros({P, 3}, means3D.options());
+  torch::Tensor dL_dcolors = torch::zeros({P, NUM_CHANNELS}, means3D.options());
+  torch::Tensor dL_dconic = torch::zeros({P, 2, 2}, means3D.options());
+  torch::Tensor dL_dopacity = torch::zeros({P, 1}, means3D.options());
+  torch::Tensor dL_dcov3D = torch::zeros({P, 6}, means3D.options());
+  torch::Tensor dL_dsh = torch::zeros({P, M, 3}, means3D.options());
+  torch::Tensor dL_dscales = torch::zeros({P, 3}, means3D.options());
+  torch::Tensor dL_drotations = torch::zeros({P, 4}, means3D.options());
+
+  if(P != 0)
+  {
+	  auto bg_ = hostFloat(background);
+	  auto means3D_ = means3D.contiguous();
+	  auto radii_ = radii.contiguous();
+	  auto sh_ = sh.contiguous();
+	  auto colors_ = colors.contiguous();
+	  auto scales_ = scales.contiguous();
+	  auto rotations_ = rotations.contiguous();
+	  auto cov3D_precomp_ = cov3D_precomp.contiguous();
+	  auto viewmatrix_ = hostFloat(viewmatrix);
+	  auto projmatrix_ = hostFloat(projmatrix);
+	  auto campos_ = hostFloat(campos);
+	  auto dL_dout_color_ = hostFloat(dL_dout_color);
+
+	  CpuRasterizer::Rasterizer::backward(P, degree, M, R,
+	  bg_.data_ptr<float>(),
+	  W, H,
+	  means3D_.data_ptr<float>(),
+	  optionalPtr<float>(sh_),
+	  optionalPtr<float>(colors_),
+	  optionalPtr<float>(scales_),
+	  scale_modifier,
+	  optionalPtr<float>(rotations_),
+	  optionalPtr<float>(cov3D_precomp_),
+	  viewmatrix_.data_ptr<float>(),
+	  projmatrix_.data_ptr<float>(),
+	  campos_.data_ptr<float>(),
+	  tan_fovx,
+	  tan_fovy,
+	  radii_.data_ptr<int>(),
+	  reinterpret_cast<char*>(geomBuffer.data_ptr()),
+	  reinterpret_cast<char*>(binningBuffer.data_ptr()),
+	  reinterpret_cast<char*>(imageBuffer.data_ptr()),
+	  dL_dout_color_.data_ptr<float>(),
+	  dL_dmeans2D.data_ptr<float>(),
+	  dL_dconic.data_ptr<float>(),
+	  dL_dopacity.data_ptr<float>(),
+	  dL_dcolors.data_ptr<float>(),
+	  dL_dmeans3D.data_ptr<float>(),
+	  dL_dcov3D.data_ptr<float>(),
+	  dL_dsh.data_ptr<float>(),
+	  dL_dscales.data_ptr<float>(),
+	  dL_drotations.data_ptr<float>());
+  }
+
+  return std::make_tuple(dL_dmeans2D, dL_dcolors, dL_dopacity, dL_dmeans3D, dL_dcov3D, dL_dsh, dL_dscales, dL_drotations);
+}
+
+torch::Tensor markVisibleCPU(
+		torch::Tensor& means3D,
+		torch::Tensor& viewmatrix,
+		torch::Tensor& projmatrix)
+{
+  const int P = means3D.size(0);
+
+  torch::Tensor present = torch::full({P}, false, means3D.options().dtype(at::kBool));
+
+  if(P != 0)
+  {
+	auto means3D_ = means3D.contiguous();
+	auto viewmatrix_ = hostFloat(viewmatrix);
+	auto projmatrix_ = hostFloat(projmatrix);
+	CpuRasterizer::Rasterizer::markVisible(P,
+		means3D_.data_ptr<float>(),
+		viewmatrix_.data_ptr<float>(),
+		projmatrix_.data_ptr<float>(),
+		present.data_ptr<bool>());
+  }
+
+  return present;
+}
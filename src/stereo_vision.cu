@@ -20,6 +20,7 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 
 #include <cuda_runtime_api.h>
@@ -83,7 +84,7 @@ __global__ void search_neighborhood_to_estimate_depth_and_reproject_pinhole(
     float u = pixels[pxidx];
     float v = pixels[pxidx + 1];
     int ptidx = idx * 3;
-    int pxidx_in_image = v * width + u;
+    int pxidx_in_image = (static_cast<int>(v) * width + static_cast<int>(u)) * 3;
 
     if (has3D[idx]) {
         point3D_result[ptidx] = point3D_orig[ptidx];
@@ -135,12 +136,96 @@ __global__ void search_neighborhood_to_estimate_depth_and_reproject_pinhole(
     }
 }
 
+__global__ void search_grid_to_estimate_depth_and_reproject_pinhole(
+    int N,
+    int width,
+    const float fx,
+    const float fy,
+    const float cx,
+    const float cy,
+    const float max_pixel_dist,
+    const float radius,
+    const int grid_cols,
+    const int grid_rows,
+    const float cell_size,
+    const int64_t* cell_starts,
+    const int64_t* sorted_ids,
+    const float* pixels,
+    const bool* has3D,
+    const float* point3D_orig,
+    const float* colors,
+    float* point3D_result,
+    float* colors_result)
+{
+    auto idx = cg::this_grid().thread_rank();
+    if (idx >= N)
+        return;
+
+    float u = pixels[idx * 2];
+    float v = pixels[idx * 2 + 1];
+    int ptidx = idx * 3;
+    int pxidx_in_image = (static_cast<int>(v) * width + static_cast<int>(u)) * 3;
+
+    float depth = -1.0f;
+    if (has3D[idx]) {
+        point3D_result[ptidx] = point3D_orig[ptidx];
+        point3D_result[ptidx + 1] = point3D_orig[ptidx + 1];
+        depth = point3D_orig[ptidx + 2];
+        point3D_result[ptidx + 2] = depth;
+    }
+    else {
+        // Only the cells overlapping the search radius
+        int cell_x0 = max(0, static_cast<int>(floorf((u - radius) / cell_size)));
+        int cell_x1 = min(grid_cols - 1, static_cast<int>(floorf((u + radius) / cell_size)));
+        int cell_y0 = max(0, static_cast<int>(floorf((v - radius) / cell_size)));
+        int cell_y1 = min(grid_rows - 1, static_cast<int>(floorf((v + radius) / cell_size)));
+        float min_dist = MAXFLOAT;
+        int64_t nearest = -1;
+        for (int cell_y = cell_y0; cell_y <= cell_y1; ++cell_y) {
+            for (int cell_x = cell_x0; cell_x <= cell_x1; ++cell_x) {
+                int cell = cell_y * grid_cols + cell_x;
+                for (int64_t s = cell_starts[cell]; s < cell_starts[cell + 1]; ++s) {
+                    int64_t i = sorted_ids[s];
+                    float u_uu = u - pixels[i * 2];
+                    float v_vv = v - pixels[i * 2 + 1];
+                    float dist = u_uu * u_uu + v_vv * v_vv;
+                    if (dist > max_pixel_dist || dist > min_dist || (dist == min_dist && i > nearest))
+                        continue;
+                    min_dist = dist;
+                    nearest = i;
+                }
+            }
+        }
+        if (nearest >= 0)
+            depth = point3D_orig[nearest * 3 + 2];
+
+        if (depth > 0.0f) {
+            float3 pt_result = reproject_depth_pinhole(
+                u, v, depth, fx, fy, cx, cy);
+            point3D_result[ptidx] = pt_result.x;
+            point3D_result[ptidx + 1] = pt_result.y;
+            point3D_result[ptidx + 2] = pt_result.z;
+        }
+        else {
+            point3D_result[ptidx + 2] = -1.0f;
+        }
+    }
+
+    if (depth > 0.0f) {
+        colors_result[ptidx] = colors[pxidx_in_image];
+        colors_result[ptidx + 1] = colors[pxidx_in_image + 1];
+        colors_result[ptidx + 2] = colors[pxidx_in_image + 2];
+    }
+}
+
 torch::Tensor reprojectDepthPinhole(
     torch::Tensor& depth,
     torch::Tensor& mask,
     std::vector<float>& intr,
     int width)
 {
+    if (!depth.is_cuda())
+        return reprojectDepthPinholeCPU(depth, mask, intr, width);
     if (depth.ndimension() != 1) {
         AT_ERROR("points must have dimensions (num_points)");
     }
@@ -178,6 +263,67 @@ monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypoints(
     float max_pixel_dist,
     std::vector<float>& intr,
     int width)
+{
+    if (!kps_pixel.is_cuda())
+        return monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypointsCPU(
+            kps_pixel, kps_has3D, kps_point_local, colors, max_pixel_dist, intr, width);
+
+    if (kps_pixel.ndimension() != 2 || kps_pixel.size(1) != 2)
+        AT_ERROR("kps_pixel must have dimensions (num_points, 2)");
+    if (kps_has3D.ndimension() != 1)
+        AT_ERROR("kps_has3D must have dimensions (num_points)");
+    if (kps_point_local.ndimension() != 2 || kps_point_local.size(1) != 3)
+        AT_ERROR("kps_point_local must have dimensions (num_points, 3)");
+
+    int N = kps_pixel.size(0);
+    torch::Tensor result_pt, result_color;
+
+    if (N != 0) {
+        result_pt = torch::zeros_like(kps_point_local);
+        result_color = torch::zeros_like(kps_point_local);
+
+        float fx = intr[0];
+        float fy = intr[1];
+        float cx = intr[2];
+        float cy = intr[3];
+
+        torch::Tensor pixels = kps_pixel.contiguous();
+        torch::Tensor has3D = kps_has3D.contiguous();
+        float radius = std::sqrt(std::max(max_pixel_dist, 0.0f));
+        KeypointGrid grid = buildKeypointGrid(pixels, has3D, radius, width, colors.size(0) / width);
+
+        search_grid_to_estimate_depth_and_reproject_pinhole<<<(N + 255) / 256, 256>>>(
+            N, width, fx, fy, cx, cy, max_pixel_dist, radius,
+            grid.cols_, grid.rows_, grid.cell_size_,
+            grid.cell_starts_.data_ptr<int64_t>(),
+            grid.sorted_ids_.data_ptr<int64_t>(),
+            pixels.data_ptr<float>(),
+            has3D.data_ptr<bool>(),
+            kps_point_local.contiguous().data_ptr<float>(),
+            colors.contiguous().data_ptr<float>(),
+            result_pt.contiguous().data_ptr<float>(),
+            result_color.contiguous().data_ptr<float>());
+
+        torch::Tensor depth_valid_flags = torch::where(result_pt.index({torch::indexing::Slice(), 2}) > 0.0f, true, false);
+        result_pt = result_pt.index({depth_valid_flags});
+        result_color = result_color.index({depth_valid_flags});
+    }
+
+    return std::make_tuple(result_pt, result_color);
+}
+
+/**
+ * @brief Every keypoint without depth scans all keypoints, O(N^2)
+ */
+std::tuple<torch::Tensor, torch::Tensor>
+monocularPinholeInactiveGeoDensifyBySearchingAllKeypoints(
+    torch::Tensor& kps_pixel,
+    torch::Tensor& kps_has3D,
+    torch::Tensor& kps_point_local,
+    torch::Tensor& colors,
+    float max_pixel_dist,
+    std::vector<float>& intr,
+    int width)
 {
     if (kps_pixel.ndimension() != 2 || kps_pixel.size(1) != 2)
         AT_ERROR("kps_pixel must have dimensions (num_points, 2)");
@@ -0,0 +1,211 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "include/stereo_vision.h"
+
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+torch::Tensor reprojectDepthPinholeCPU(
+    torch::Tensor& depth,
+    torch::Tensor& mask,
+    std::vector<float>& intr,
+    int width)
+{
+    if (depth.ndimension() != 1) {
+        AT_ERROR("points must have dimensions (num_points)");
+    }
+
+    const int64_t P = depth.size(0);
+    torch::Tensor points;
+
+    if (P != 0) {
+        torch::Tensor depth_host = depth.to(torch::kCPU, torch::kFloat).contiguous();
+        torch::Tensor mask_host = mask.to(torch::kCPU, torch::kBool).contiguous();
+        points = torch::empty({P, 3}, depth_host.options());
+
+        const float fx = intr[0];
+        const float fy = intr[1];
+        const float cx = intr[2];
+        const float cy = intr[3];
+        const float* depths = depth_host.data_ptr<float>();
+        const bool* valid = mask_host.data_ptr<bool>();
+        float* out = points.data_ptr<float>();
+        const int64_t height = (P + width - 1) / width;
+
+        // Branch-free rows so they vectorize, masked out pixels get zeros as in the CUDA kernel
+        at::parallel_for(0, height, 16, [&](int64_t begin, int64_t end) {
+            for (int64_t v = begin; v < end; ++v) {
+                const int64_t row = v * width;
+                const int64_t row_end = std::min<int64_t>(row + width, P);
+                for (int64_t idx = row; idx < row_end; ++idx) {
+                    const float d = valid[idx] ? depths[idx] : 0.0f;
+                    const float u = static_cast<float>(idx - row);
+                    out[idx * 3] = valid[idx] ? (u - cx) * d / fx : 0.0f;
+                    out[idx * 3 + 1] = valid[idx] ? (v - cy) * d / fy : 0.0f;
+                    out[idx * 3 + 2] = d;
+                }
+            }
+        });
+        points = points.to(depth.device());
+    }
+
+    return points;
+}
+
+/**
+ * @brief Cells are at least as large as the search radius, so a query visits at most 3x3 of them,
+ *        and large enough to hold about one keypoint each on average
+ */
+KeypointGrid buildKeypointGrid(
+    const torch::Tensor& kps_pixel,
+    const torch::Tensor& kps_has3D,
+    float radius,
+    int width,
+    int height)
+{
+    const int64_t N = kps_pixel.size(0);
+    KeypointGrid grid;
+    grid.cell_size_ = std::max({1.0f, radius,
+                                std::sqrt(static_cast<float>(width) * height / std::max<int64_t>(N, 1))});
+    grid.cols_ = std::max(1, static_cast<int>(std::ceil(width / grid.cell_size_)));
+    grid.rows_ = std::max(1, static_cast<int>(std::ceil(height / grid.cell_size_)));
+    const int64_t num_cells = static_cast<int64_t>(grid.cols_) * grid.rows_;
+
+    auto long_options = torch::TensorOptions().dtype(torch::kLong).device(kps_pixel.device());
+    torch::Tensor cells = (kps_pixel / grid.cell_size_).floor().to(torch::kLong);
+    torch::Tensor cell_x = cells.select(1, 0).clamp(0, grid.cols_ - 1);
+    torch::Tensor cell_y = cells.select(1, 1).clamp(0, grid.rows_ - 1);
+    // Keypoints without depth go to a last, never visited cell
+    torch::Tensor keys = torch::where(kps_has3D, cell_y * grid.cols_ + cell_x, torch::full_like(cell_x, num_cells));
+    auto sorted = torch::sort(keys, /*stable=*/true, /*dim=*/0, /*descending=*/false);
+    grid.sorted_ids_ = std::get<1>(sorted).contiguous();
+    grid.cell_starts_ = torch::searchsorted(std::get<0>(sorted), torch::arange(num_cells + 1, long_options)).contiguous();
+    return grid;
+}
+
+std::tuple<torch::Tensor, torch::Tensor>
+monocularPinholeInactiveGeoDensifyBySearchingNeighborhoodKeypointsCPU(
+    torch::Tensor& kps_pixel,
+    torch::Tensor& kps_has3D,
+    torch::Tensor& kps_point_local,
+    torch::Tensor& colors,
+    float max_pixel_dist,
+    std::vector<float>& intr,
+    int width)
+{
+    if (kps_pixel.ndimension() != 2 || kps_pixel.size(1) != 2)
+        AT_ERROR("kps_pixel must have dimensions (num_points, 2)");
+    if (kps_has3D.ndimension() != 1)
+        AT_ERROR("kps_has3D must have dimensions (num_points)");
+    if (kps_point_local.ndimension() != 2 || kps_point_local.size(1) != 3)
+        AT_ERROR("kps_point_local must have dimensions (num_points, 3)");
+
+    const int64_t N = kps_pixel.size(0);
+    torch::Tensor result_pt, result_color;
+    if (N == 0)
+        return std::make_tuple(result_pt, result_color);
+
+    torch::Tensor pixels_tensor = kps_pixel.to(torch::kCPU, torch::kFloat).contiguous();
+    torch::Tensor has3D_tensor = kps_has3D.to(torch::kCPU, torch::kBool).contiguous();
+    torch::Tensor points_tensor = kps_point_local.to(torch::kCPU, torch::kFloat).contiguous();
+    torch::Tensor colors_tensor = colors.to(torch::kCPU, torch::kFloat).contiguous();
+    result_pt = torch::zeros_like(points_tensor);
+    result_color = torch::zeros_like(points_tensor);
+
+    const float fx = intr[0];
+    const float fy = intr[1];
+    const float cx = intr[2];
+    const float cy = intr[3];
+    const float radius = std::sqrt(std::max(max_pixel_dist, 0.0f));
+    KeypointGrid grid = buildKeypointGrid(pixels_tensor, has3D_tensor, radius, width, colors_tensor.size(0) / width);
+
+    const int64_t* cell_starts = grid.cell_starts_.data_ptr<int64_t>();
+    const int64_t* sorted_ids = grid.sorted_ids_.data_ptr<int64_t>();
+    const float* pixels = pixels_tensor.data_ptr<float>();
+    const bool* has3D = has3D_tensor.data_ptr<bool>();
+    const float* point3D_orig = points_tensor.data_ptr<float>();
+    const float* image = colors_tensor.data_ptr<float>();
+    float* point3D_result = result_pt.data_ptr<float>();
+    float* colors_result = result_color.data_ptr<float>();
+
+    at::parallel_for(0, N, 256, [&](int64_t begin, int64_t end) {
+        for (int64_t idx = begin; idx < end; ++idx) {
+            const float u = pixels[idx * 2];
+            const float v = pixels[idx * 2 + 1];
+            const int64_t ptidx = idx * 3;
+            const int64_t pxidx_in_image = (static_cast<int64_t>(v) * width + static_cast<int>(u)) * 3;
+
+            float depth = -1.0f;
+            if (has3D[idx]) {
+                std::copy(point3D_orig + ptidx, point3D_orig + ptidx + 3, point3D_result + ptidx);
+                depth = point3D_orig[ptidx + 2];
+            }
+            else {
+                // Only the cells overlapping the search radius
+                const int cell_x0 = std::max(0, static_cast<int>(std::floor((u - radius) / grid.cell_size_)));
+                const int cell_x1 = std::min(grid.cols_ - 1, static_cast<int>(std::floor((u + radius) / grid.cell_size_)));
+                const int cell_y0 = std::max(0, static_cast<int>(std::floor((v - radius) / grid.cell_size_)));
+                const int cell_y1 = std::min(grid.rows_ - 1, static_cast<int>(std::floor((v + radius) / grid.cell_size_)));
+                float min_dist = std::numeric_limits<float>::max();
+                int64_t nearest = -1;
+                for (int cell_y = cell_y0; cell_y <= cell_y1; ++cell_y) {
+                    for (int cell_x = cell_x0; cell_x <= cell_x1; ++cell_x) {
+                        const int64_t cell = static_cast<int64_t>(cell_y) * grid.cols_ + cell_x;
+                        for (int64_t s = cell_starts[cell]; s < cell_starts[cell + 1]; ++s) {
+                            const int64_t i = sorted_ids[s];
+                            const float u_uu = u - pixels[i * 2];
+                            const float v_vv = v - pixels[i * 2 + 1];
+                            const float dist = u_uu * u_uu + v_vv * v_vv;
+                            if (dist > max_pixel_dist || dist > min_dist || (dist == min_dist && i > nearest))
+                                continue;
+                            min_dist = dist;
+                            nearest = i;
+                        }
+                    }
+                }
+                if (nearest >= 0)
+                    depth = point3D_orig[nearest * 3 + 2];
+
+                if (depth > 0.0f) {
+                    // Integer pixel coordinates, as reproject_depth_pinhole
+                    const int pu = static_cast<int>(u);
+                    const int pv = static_cast<int>(v);
+                    point3D_result[ptidx] = (pu - cx) * depth / fx;
+                    point3D_result[ptidx + 1] = (pv - cy) * depth / fy;
+                    point3D_result[ptidx + 2] = depth;
+                }
+                else {
+                    point3D_result[ptidx + 2] = -1.0f;
+                }
+            }
+
+            if (depth > 0.0f)
+                std::copy(image + pxidx_in_image, image + pxidx_in_image + 3, colors_result + ptidx);
+        }
+    });
+
+    torch::Tensor depth_valid_flags = result_pt.index({torch::indexing::Slice(), 2}) > 0.0f;
+    result_pt = result_pt.index({depth_valid_flags}).to(kps_point_local.device());
+    result_color = result_color.index({depth_valid_flags}).to(kps_point_local.device());
+    return std::make_tuple(result_pt, result_color);
+}
@@ -0,0 +1,152 @@
+/**
+ * This file is part of Photo-SLAM
+ *
+ * Copyright (C) 2023-2024 Longwei Li and Hui Cheng, Sun Yat-sen University.
+ * Copyright (C) 2023-2024 Huajian Huang and Sai-Kit Yeung, Hong Kong University of Science and Technology.
+ *
+ * Photo-SLAM is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Photo-SLAM is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with Photo-SLAM.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "include/training_statistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+TrainingStatistics::~TrainingStatistics()
+{
+    stop();
+}
+
+void TrainingStatistics::start(
+    std::filesystem::path csv_path,
+    std::size_t capacity,
+    int flush_interval_ms)
+{
+    stop();
+
+    if (csv_path.has_parent_path() && !std::filesystem::exists(csv_path.parent_path()))
+        std::filesystem::create_directories(csv_path.parent_path());
+    csv_path_ = csv_path;
+    out_stream_.open(csv_path_, std::ios::out | std::ios::trunc);
+    if (!out_stream_.is_open())
+        throw std::runtime_error("Cannot open training statistics at " + csv_path_.string());
+    out_stream_ << "iteration,keyframe_id,pyramid_level,loss,iteration_time_ms,num_gaussians\n";
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ring_.assign(std::max<std::size_t>(capacity, 1), TrainingRecord());
+        head_ = 0;
+        size_ = 0;
+        num_dropped_ = 0;
+        flush_interval_ms_ = flush_interval_ms;
+        stop_ = false;
+        recording_ = true;
+    }
+    writer_ = std::thread(&TrainingStatistics::writerLoop, this);
+}
+
+/**
+ * @brief Flush whatever is buffered and join the writer
+ */
+void TrainingStatistics::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!recording_)
+            return;
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (writer_.joinable())
+        writer_.join();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (num_dropped_)
+        std::cout << "[Gaussian Mapper]Training statistics dropped "
+                  << num_dropped_ << " records" << std::endl;
+    out_stream_.close();
+    recording_ = false;
+}
+
+bool TrainingStatistics::isRecording()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return recording_;
+}
+
+void TrainingStatistics::push(const TrainingRecord& record)
+{
+    bool wake_writer;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!recording_)
+            return;
+        std::size_t capacity = ring_.size();
+        if (size_ == capacity) {
+            // Overwrite the oldest record
+            head_ = (head_ + 1) % capacity;
+            --size_;
+            ++num_dropped_;
+        }
+        ring_[(head_ + size_) % capacity] = record;
+        ++size_;
+        wake_writer = (size_ >= std::max<std::size_t>(capacity / 2, 1));
+    }
+    if (wake_writer)
+        cv_.notify_one();
+}
+
+std::uint64_t TrainingStatistics::numDropped()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return num_dropped_;
+}
+
+void TrainingStatistics::writerLoop()
+{
+    std::vector<TrainingRecord> records;
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(flush_interval_ms_), [this] {
+                return stop_ || size_ >= std::max<std::size_t>(ring_.size() / 2, 1); });
+            // Take the buffered records out so the file is written without the lock
+            records.clear();
+            std::size_t capacity = ring_.size();
+            for (std::size_t i = 0; i < size_; ++i)
+                records.emplace_back(ring_[(head_ + i) % capacity]);
+            head_ = 0;
+            size_ = 0;
+            stopping = stop_;
+        }
+        flush(records);
+        if (stopping)
+            return;
+    }
+}
+
+void TrainingStatistics::flush(std::vector<TrainingRecord>& records)
+{
+    if (records.empty())
+        return;
+    for (const auto& record : records)
+        out_stream_ << record.iteration_ << ","
+                    << record.keyframe_id_ << ","
+                    << record.pyramid_level_ << ","
+                    << record.loss_ << ","
+                    << record.iteration_time_ms_ << ","
+                    << record.num_gaussians_ << "\n";
+    out_stream_.flush();
+}